@@ -48,8 +48,10 @@ HEADERS += include/AutoSegmentationTools.h \
            include/ManualSegmentationTools.h \
            include/MathTools.h \
            include/MeshSamplingTools.h \
+           include/NeighbourGraph.h \
            include/Neighbourhood.h \
            include/NormalDistribution.h \
+           include/OutOfCoreStorage.h \
            include/PointProjectionTools.h \
            include/Polyline.h \
            include/RayAndBox.h \
@@ -65,7 +67,9 @@ HEADERS += include/AutoSegmentationTools.h \
            include/SquareMatrix.h \
            include/StatisticalTestingTools.h \
            include/TrueKdTree.h \
+           include/TriangleBVH.h \
            include/WeibullDistribution.h \
+           src/AtomicCounter.h \
            src/Chi2Helper.h \
 #           include/msvc/stdint.h
 
@@ -87,8 +91,10 @@ SOURCES += src/AutoSegmentationTools.cpp \
            src/LocalModel.cpp \
            src/ManualSegmentationTools.cpp \
            src/MeshSamplingTools.cpp \
+           src/NeighbourGraph.cpp \
            src/Neighbourhood.cpp \
            src/NormalDistribution.cpp \
+           src/OutOfCoreStorage.cpp \
            src/NormalizedProgress.cpp \
            src/PointProjectionTools.cpp \
            src/Polyline.cpp \
@@ -101,6 +107,7 @@ SOURCES += src/AutoSegmentationTools.cpp \
            src/SimpleMesh.cpp \
            src/StatisticalTestingTools.cpp \
            src/TrueKdTree.cpp \
+           src/TriangleBVH.cpp \
            src/WeibullDistribution.cpp
 
 macx{
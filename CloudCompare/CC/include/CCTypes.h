@@ -19,10 +19,27 @@
 #ifndef CC_TYPES_HEADER
 #define CC_TYPES_HEADER
 
+#include "CCPlatform.h"
+
 //! Type of the coordinates of a (N-D) point
 typedef float PointCoordinateType;
 
 //! Type of a single scalar field value
 typedef float ScalarType;
 
+//CC_64BITS_POINT_INDEXES: enables 64 bits point indexes (clouds with more than 4 billion points)
+//Only available on 64 bits architectures. It costs 4 more bytes per stored index (see
+//ReferenceCloud), but nothing for the octree structure if OCTREE_CODES_64_BITS is defined
+//(as the 'IndexAndCode' structure is padded to 16 bytes anyway).
+#if defined(CC_64BITS_POINT_INDEXES) && !defined(CC_ENV_64)
+#error 64 bits point indexes require a 64 bits architecture
+#endif
+
+//! Type of a point index
+#ifdef CC_64BITS_POINT_INDEXES
+typedef unsigned long long PointIndexType;
+#else
+typedef unsigned PointIndexType;
+#endif
+
 #endif //CC_TYPES_HEADER
@@ -23,6 +23,10 @@
 #include "CCToolbox.h"
 #include "DgmOctree.h"
 
+//system
+#include <vector>
+#include <unordered_map>
+
 namespace CCLib
 {
 
@@ -30,6 +34,7 @@ class GenericProgressCallback;
 class GenericIndexedCloud;
 class GenericIndexedCloudPersist;
 class GenericIndexedMesh;
+class NeighbourGraph;
 class ReferenceCloud;
 class ReferenceCloudPersist;
 class SimpleCloud;
@@ -201,6 +206,45 @@ public:
 										DgmOctree* octree = 0,
 										GenericProgressCallback* progressCb = 0);
 
+	//! Statistical Outliers Removal (SOR) filter (based on a precomputed neighbour graph)
+	/** Same as the octree-based version but the neighbours are read from the graph
+		(which must contain at least the 'knn-1' nearest neighbours of each point, see NeighbourGraph::hasKnn).
+		\param graph neighbour graph (see NeighbourGraph::compute)
+		\param knn number of neighbors (the point itself included, as for the octree-based version)
+		\param nSigma number of sigmas under which the points should be kept
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return a reference cloud corresponding to the filtered cloud (on the graph associated cloud)
+	**/
+	static ReferenceCloud* sorFilter(	const NeighbourGraph& graph,
+										int knn = 6,
+										double nSigma = 1.0,
+										GenericProgressCallback* progressCb = 0);
+
+	//! Noise filter based on the distance to the approximate local surface (based on a precomputed neighbour graph)
+	/** Same as the octree-based version but the neighbours are read from the graph (which must contain
+		either the 'knn-1' nearest neighbours or the whole spherical neighbourhood of each point, see
+		NeighbourGraph::hasKnn and NeighbourGraph::hasSphere).
+		\param graph neighbour graph (see NeighbourGraph::compute)
+		\param kernelRadius neighborhood radius
+		\param nSigma number of sigmas under which the points should be kept
+		\param removeIsolatedPoints whether to remove isolated points (i.e. whith 3 points or less in the neighborhood)
+		\param useKnn whether to use a constant number of neighbors instead of a radius
+		\param knn number of neighbors (if useKnn is true - the point itself included)
+		\param useAbsoluteError whether to use an absolute error instead of 'n' sigmas
+		\param absoluteError absolute error (if useAbsoluteError is true)
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return a reference cloud corresponding to the filtered cloud (on the graph associated cloud)
+	**/
+	static ReferenceCloud* noiseFilter(	const NeighbourGraph& graph,
+										PointCoordinateType kernelRadius,
+										double nSigma,
+										bool removeIsolatedPoints = false,
+										bool useKnn = false,
+										int knn = 6,
+										bool useAbsoluteError = true,
+										double absoluteError = 0.0,
+										GenericProgressCallback* progressCb = 0);
+
 protected:
 
 	//! "Cellular" function to replace one set of points (contained in an octree cell) by a unique point
@@ -254,6 +298,103 @@ protected:
 	static bool applySORFilterAtLevel(	const DgmOctree::octreeCell& cell,
 										void** additionalParameters,
 										NormalizedProgress* nProgress = 0);
+
+	//! Applies the noise filter to a range of points (of the form NeighbourGraph::pointRangeFunc)
+	static bool applyNoiseFilterToPoints(	const NeighbourGraph& graph,
+											unsigned firstIndex,
+											unsigned lastIndex,
+											void** additionalParameters);
+
+	//! Computes the SOR filter mean distances for a range of points (of the form NeighbourGraph::pointRangeFunc)
+	static bool applySORFilterToPoints(	const NeighbourGraph& graph,
+										unsigned firstIndex,
+										unsigned lastIndex,
+										void** additionalParameters);
+};
+
+//! Streaming version of the spatial resampling (see CloudSamplingTools::resampleCloudSpatially)
+/** Points are submitted one by one (or chunk by chunk) and are only kept if no previously
+	kept point lies at less than the minimum distance. Kept points are stored in a sparse
+	hash grid so that memory only depends on the output size. Each kept point is stored in the
+	grid level whose cell size (minimum distance x 2^level) is the smallest one not below its own
+	distance, so that only the 27 cells around a new point are scanned at each level.
+	The input cloud therefore never needs to be fully loaded (e.g. a file can be resampled
+	while being read). For the same points in the same order, the selection is the same as
+	CloudSamplingTools::resampleCloudSpatially's.
+**/
+class CC_CORE_LIB_API SpatialStreamSampler
+{
+public:
+
+	//! Point submission result
+	enum Result { REJECTED = 0, KEPT = 1, NOT_ENOUGH_MEMORY = -1 };
+
+	//! Default constructor
+	/** \param minDistance the distance under which a point in the resulting cloud cannot have any neighbour (> 0)
+	**/
+	explicit SpatialStreamSampler(PointCoordinateType minDistance);
+
+	//! Returns the (default) minimum distance between points
+	inline PointCoordinateType minDistance() const { return m_minDistance; }
+
+	//! Submits a new point
+	/** \param P point
+		\return whether the point is kept or not (or NOT_ENOUGH_MEMORY)
+	**/
+	inline Result addPoint(const CCVector3& P) { return addPoint(P, m_minDistance); }
+
+	//! Submits a new point with a specific minimum distance (e.g. modulated by a scalar field)
+	/** \warning The distance is attached to the point if it's kept: it applies to the next submitted points
+		\param P point
+		\param minDistance the distance under which the next points won't be kept if this one is
+		\return whether the point is kept or not (or NOT_ENOUGH_MEMORY)
+	**/
+	Result addPoint(const CCVector3& P, PointCoordinateType minDistance);
+
+	//! Submits a chunk of points
+	/** \param chunk cloud chunk
+		\param modParams parameters of the subsampling behavior modulation with a scalar field (optional)
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return a reference cloud corresponding to the points of this chunk that are kept (or 0 if an error occurred)
+	**/
+	ReferenceCloud* addCloud(	GenericIndexedCloudPersist* chunk,
+								const CloudSamplingTools::SFModulationParams& modParams = CloudSamplingTools::SFModulationParams(),
+								GenericProgressCallback* progressCb = 0);
+
+	//! Returns the number of kept points
+	inline unsigned size() const { return static_cast<unsigned>(m_points.size()); }
+
+	//! Returns the kept points (in the submission order)
+	inline const std::vector<CCVector3>& keptPoints() const { return m_points; }
+
+	//! Returns the approximate memory used by the sampler (in bytes)
+	size_t memoryUsage() const;
+
+	//! Clears the sampler
+	void clear();
+
+protected:
+
+	//! Cell key type
+	typedef unsigned long long CellKey;
+
+	//! Returns the key of a given cell
+	static CellKey ComputeCellKey(long long i, long long j, long long k);
+
+	//! Cells of a grid level (first kept point of each non empty cell)
+	typedef std::unordered_map<CellKey, unsigned> GridLevel;
+
+	//! Default minimum distance (= step of the first grid level)
+	PointCoordinateType m_minDistance;
+
+	//! Kept points
+	std::vector<CCVector3> m_points;
+	//! Minimum distance attached to each kept point
+	std::vector<PointCoordinateType> m_distances;
+	//! Next kept point in the same cell (for each kept point)
+	std::vector<unsigned> m_nextInCell;
+	//! Grid levels (the cell size doubles from one level to the next)
+	std::vector<GridLevel> m_levels;
 };
 
 }
@@ -22,6 +22,7 @@
 //Local
 #include "GenericOctree.h"
 #include "CCPlatform.h"
+#include "OutOfCoreStorage.h"
 
 //system
 #include <vector>
@@ -105,7 +106,7 @@ public:
 	typedef std::vector<CellCode> cellCodesContainer;
 
 	//! Octree cell indexes container
-	typedef std::vector<unsigned> cellIndexesContainer;
+	typedef std::vector<PointIndexType> cellIndexesContainer;
 
 	//! Structure used during nearest neighbour search
 	/** Association between a point, its index and its square distance to the query point.
@@ -319,7 +320,7 @@ public:
 	struct IndexAndCode
 	{
 		//! index
-		unsigned theIndex;
+		PointIndexType theIndex;
 		//! cell code
 		CellCode theCode;
 
@@ -331,7 +332,7 @@ public:
 		}
 
 		//! Constructor from an index and a code
-		IndexAndCode(unsigned index, CellCode code)
+		IndexAndCode(PointIndexType index, CellCode code)
 			: theIndex(index)
 			, theCode(code)
 		{
@@ -344,6 +345,14 @@ public:
 		{
 		}
 
+		//! Assignment operator
+		inline IndexAndCode& operator = (const IndexAndCode& ic)
+		{
+			theIndex = ic.theIndex;
+			theCode = ic.theCode;
+			return *this;
+		}
+
 		//! Code-based 'less than' comparison operator
 		inline bool operator < (const IndexAndCode& iac) const
 		{
@@ -379,7 +388,9 @@ public:
 	};
 
 	//! Container of 'IndexAndCode' structures
-	typedef std::vector<IndexAndCode> cellsContainer;
+	/** Stored out-of-core if big enough (see OutOfCoreStorage::SetPolicy).
+	**/
+	typedef std::vector<IndexAndCode, OutOfCoreAllocator<IndexAndCode> > cellsContainer;
 
 	//! Octree cell descriptor
 	struct octreeCell
@@ -391,7 +402,7 @@ public:
 		//! Truncated cell code
 		CellCode truncatedCode;														//8 bytes
 		//! Cell index in octree structure (see m_thePointsAndTheirCellCodes)
-		unsigned index;																//4 bytes
+		PointIndexType index;														//4 bytes (8 bytes with 64 bits point indexes)
 		//! Set of points lying inside this cell
 		ReferenceCloud* points;														//8 bytes
 		//! Cell level of subdivision
@@ -422,6 +433,42 @@ public:
 	**/
 	typedef bool (*octreeCellFunc)(const octreeCell& cell, void**, NormalizedProgress*);
 
+	//! Load balancing statistics of a parallel octree traversal
+	/** See DgmOctree::executeFunctionForAllCellsAtLevel and
+		DgmOctree::executeFunctionForAllCellsStartingAtLevel.
+	**/
+	struct CellsProcessingStats
+	{
+		//! Number of threads
+		unsigned threadCount;
+		//! Number of processed cells
+		unsigned cellCount;
+		//! Number of cells processed first because of their (large) population
+		unsigned heavyCellCount;
+		//! Number of steal operations (a thread taking cells from another thread's queue)
+		unsigned stealCount;
+		//! Total (wall) duration of the process (in seconds)
+		double totalTime_s;
+		//! Cumulated idle time of all threads (in seconds)
+		double idleTime_s;
+		//! Duration of the longest cell processing (in seconds)
+		double maxCellTime_s;
+		//! Population of the longest cell to process
+		PointIndexType maxCellTimePopulation;
+
+		//! Default constructor
+		CellsProcessingStats()
+			: threadCount(0)
+			, cellCount(0)
+			, heavyCellCount(0)
+			, stealCount(0)
+			, totalTime_s(0)
+			, idleTime_s(0)
+			, maxCellTime_s(0)
+			, maxCellTimePopulation(0)
+		{}
+	};
+
 	/******************************/
 	/**          METHODS         **/
 	/******************************/
@@ -439,6 +486,7 @@ public:
 
 	//! Builds the structure
 	/** Octree 3D limits are determined automatically.
+		The cell codes are computed and sorted with the current build algorithm (see SetBuildAlgorithm).
 		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
 		\return the number of points projected in the octree
 	**/
@@ -466,7 +514,7 @@ public:
 	//! Returns the number of points projected into the octree
 	/** \return the number of projected points
 	**/
-	inline unsigned getNumberOfProjectedPoints() const { return m_numberOfProjectedPoints; }
+	inline PointIndexType getNumberOfProjectedPoints() const { return m_numberOfProjectedPoints; }
 
 	//! Returns the lower boundaries of the octree
 	/** \return the lower coordinates along X,Y and Z
@@ -548,7 +596,7 @@ public:
 		\return success
 	**/
 	bool getPointsInCellByCellIndex(ReferenceCloud* cloud,
-									unsigned cellIndex,
+									PointIndexType cellIndex,
 									unsigned char level,
 									bool clearOutputCloud = true) const;
 
@@ -924,7 +972,7 @@ public:	/***** CELLS POSITION HANDLING *****/
 	unsigned char findBestLevelForAGivenCellNumber(unsigned indicativeNumberOfCells) const;
 
 	//! Returns the ith cell code
-	inline const CellCode& getCellCode(unsigned index) const { return m_thePointsAndTheirCellCodes[index].theCode; }
+	inline const CellCode& getCellCode(PointIndexType index) const { return m_thePointsAndTheirCellCodes[index].theCode; }
 
 	//! Returns the list of codes corresponding to the octree cells for a given level of subdivision
 	/** Only the non empty cells are represented in the octree structure.
@@ -1015,10 +1063,13 @@ public:	/***** CELLS POSITION HANDLING *****/
 		(if no points lies in it) or to 1 (if some points lie in it, e.g. if it is indeed a
 		cell of this octree). This version of the algorithm can be applied by considering only
 		a specified list of octree cells (ignoring the others).
+		The grid is split in slabs of consecutive layers that are labeled in parallel (union-find)
+		and then merged. The labels don't depend on the number of threads.
 		\param cellCodes the cell codes to consider for the CC computation
 		\param level the level of subdivision at which to perform the algorithm
 		\param sixConnexity indicates if the CC's 3D connexity should be 6 (26 otherwise)
 		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\param multiThread whether to use parallel processing (if possible)
 		\return error code:
 			- '>= 0' = number of components
 			- '-1' = no cells (input)
@@ -1028,7 +1079,8 @@ public:	/***** CELLS POSITION HANDLING *****/
 	int extractCCs(	const cellCodesContainer& cellCodes,
 					unsigned char level,
 					bool sixConnexity,
-					GenericProgressCallback* progressCb = 0) const;
+					GenericProgressCallback* progressCb = 0,
+					bool multiThread = true) const;
 
 	//! Computes the connected components (considering the octree cells only) for a given level of subdivision (complete)
 	/** The octree is seen as a regular 3D grid, and each cell of this grid is either set to 0
@@ -1038,6 +1090,7 @@ public:	/***** CELLS POSITION HANDLING *****/
 		\param level the level of subdivision at which to perform the algorithm
 		\param sixConnexity indicates if the CC's 3D connexity should be 6 (26 otherwise)
 		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\param multiThread whether to use parallel processing (if possible)
 		\return error code:
 			- '>= 0' = number of components
 			- '-1' = no cells (input)
@@ -1046,7 +1099,8 @@ public:	/***** CELLS POSITION HANDLING *****/
 	**/
 	int extractCCs(	unsigned char level,
 					bool sixConnexity,
-					GenericProgressCallback* progressCb = 0) const;
+					GenericProgressCallback* progressCb = 0,
+					bool multiThread = true) const;
 
 	/**** OCTREE VISITOR ****/
 
@@ -1058,7 +1112,11 @@ public:	/***** CELLS POSITION HANDLING *****/
 		number of points, avoiding great loss of performances. The only limitation is when the
 		level of subdivision is deepest level. In this case no more splitting is possible.
 
-		Parallel processing is based on QtConcurrent::map system.
+		Parallel processing relies on a dedicated thread pool (the global Qt thread
+		pool is left untouched). Each thread processes a contiguous set of cells and
+		steals cells from the other threads once it's done. The most populated cells
+		are processed first. See getLastCellsProcessingStats for load balancing
+		statistics.
 
 		\param startingLevel the initial level of subdivision
 		\param func the function to apply
@@ -1085,7 +1143,11 @@ public:	/***** CELLS POSITION HANDLING *****/
 	/** The function to apply should be of the form DgmOctree::octreeCellFunc. In this case
 		the octree cells are scanned one by one at the same level of subdivision.
 
-		Parallel processing is based on QtConcurrent::map system.
+		Parallel processing relies on a dedicated thread pool (the global Qt thread
+		pool is left untouched). Each thread processes a contiguous set of cells and
+		steals cells from the other threads once it's done. The most populated cells
+		are processed first. See getLastCellsProcessingStats for load balancing
+		statistics.
 
 		\param level the level of subdivision
 		\param func the function to apply
@@ -1130,6 +1192,75 @@ public:	/***** CELLS POSITION HANDLING *****/
 	//! Returns whether multi-threading (parallel) computation is supported or not
 	static bool MultiThreadSupport();
 
+	//! Updates the copy of the points coordinates sorted in the octree order
+	/** This copy (structure of arrays, 12 bytes per point) is used by the nearest neighbour
+		search to process whole cells at once with SIMD instructions. It is not created when
+		the octree is built: it is meant to be created right before a batch of nearest neighbour
+		queries (e.g. a cloud-to-cloud distances computation) and released just after (see
+		releaseSortedPointsCoordinates). It is also released if the octree is cleared.
+		\warning Not thread-safe: must not be called while the octree is being queried.
+		\return success (if not enough memory, the nearest neighbour search falls back to the standard code)
+	**/
+	bool updateSortedPointsCoordinates();
+
+	//! Releases the copy of the points coordinates sorted in the octree order
+	/** Must be called as soon as the points of the associated cloud are moved or modified
+		without rebuilding the octree (as the copy would be outdated).
+	**/
+	void releaseSortedPointsCoordinates();
+
+	//! Returns the load balancing statistics of the last parallel traversal of this octree
+	/** Only updated by the multi-threaded versions of executeFunctionForAllCellsAtLevel
+		and executeFunctionForAllCellsStartingAtLevel.
+	**/
+	inline const CellsProcessingStats& getLastCellsProcessingStats() const { return m_lastCellsProcessingStats; }
+
+	//! Duration of the phases of the last octree build
+	struct BuildTimings
+	{
+		//! Cell codes computation (in seconds)
+		double projectionTime_s;
+		//! Codes sort (in seconds)
+		double sortTime_s;
+		//! Per-level cells statistics (in seconds)
+		double statisticsTime_s;
+		//! Total duration of the build (in seconds)
+		double totalTime_s;
+
+		//! Default constructor
+		BuildTimings()
+			: projectionTime_s(0)
+			, sortTime_s(0)
+			, statisticsTime_s(0)
+			, totalTime_s(0)
+		{}
+	};
+
+	//! Returns the duration of the phases of the last build of this octree
+	/** Meant to keep track of the build performances.
+	**/
+	inline const BuildTimings& getLastBuildTimings() const { return m_lastBuildTimings; }
+
+	//! Octree build algorithms
+	enum BuildAlgorithm
+	{
+		BUILD_STANDARD,			/**< sequential cell codes computation + comparison based sort (SortAlgo) **/
+		BUILD_PARALLEL_RADIX,	/**< parallel cell codes computation + parallel LSD radix sort of the codes **/
+	};
+
+	//! Sets the algorithm used to build the octrees (global setting)
+	/** BUILD_PARALLEL_RADIX is the default one. It is only multi-threaded if
+		MultiThreadSupport() returns true, and it needs a temporary buffer as big
+		as the octree structure (BUILD_STANDARD is used as fallback otherwise).
+		Whatever the algorithm, if the octree structure is stored out-of-core
+		(see OutOfCoreStorage::SetPolicy) the codes are sorted by runs that are
+		then merged (external merge sort) so as to keep the RAM usage bounded.
+	**/
+	static void SetBuildAlgorithm(BuildAlgorithm algo);
+
+	//! Returns the algorithm used to build the octrees (global setting)
+	static BuildAlgorithm GetBuildAlgorithm();
+
 protected:
 
 	/*******************************/
@@ -1162,7 +1293,7 @@ protected:
 	GenericIndexedCloudPersist* m_theAssociatedCloud;
 
 	//! Number of points projected in the octree
-	unsigned m_numberOfProjectedPoints;
+	PointIndexType m_numberOfProjectedPoints;
 
 	//! Min coordinates of the octree bounding-box
 	CCVector3 m_dimMin;
@@ -1187,6 +1318,17 @@ protected:
 	//! Std. dev. of cell population per level of subdivision
 	double m_stdDevCellPopulation[MAX_OCTREE_LEVEL+1];
 
+	//! Load balancing statistics of the last parallel traversal
+	CellsProcessingStats m_lastCellsProcessingStats;
+
+	//! Duration of the phases of the last build
+	BuildTimings m_lastBuildTimings;
+
+	//! Coordinates of the projected points in the same order as m_thePointsAndTheirCellCodes (one array per dimension)
+	/** See updateSortedPointsCoordinates. Empty if not available.
+	**/
+	std::vector<PointCoordinateType, OutOfCoreAllocator<PointCoordinateType> > m_sortedPointsCoordinates[3];
+
 	/******************************/
 	/**         METHODS          **/
 	/******************************/
@@ -1204,14 +1346,10 @@ protected:
 	void updateCellSizeTable();
 
 	//! Updates the tables containing the number of octree cells for each level of subdivision
-	void updateCellCountTable();
-
-	//! Computes statistics about cells for a given level of subdivision
-	/** This method requires some computation, therefore it shouldn't be
-		called too often.
-		\param level the level of subdivision
+	/** Also updates the max population, the average population and its std. dev.
+		for all levels at once, with a single (parallel) pass over the sorted codes.
 	**/
-	void computeCellsStatistics(unsigned char level);
+	void updateCellCountTable();
 
 	//! Returns the indexes of the neighbourhing (existing) cells of a given cell
 	/** This function is used by the nearest neighbours search algorithms.
@@ -1249,7 +1387,7 @@ protected:
 		\param bitDec binary shift corresponding to the level of subdivision (see GET_BIT_SHIFT)
 		\return the index of the cell (or 'm_numberOfProjectedPoints' if none found)
 	**/
-	unsigned getCellIndex(CellCode truncatedCellCode, unsigned char bitDec) const;
+	PointIndexType getCellIndex(CellCode truncatedCellCode, unsigned char bitDec) const;
 
 	//! Returns the index of a given cell represented by its code
 	/** Same algorithm as the other "getCellIndex" method, but in an optimized form.
@@ -1260,7 +1398,7 @@ protected:
 		\param end last index of the sub-list in which to perform the binary search
 		\return the index of the cell (or 'm_numberOfProjectedPoints' if none found)
 	**/
-	unsigned getCellIndex(CellCode truncatedCellCode, unsigned char bitDec, unsigned begin, unsigned end) const;
+	PointIndexType getCellIndex(CellCode truncatedCellCode, unsigned char bitDec, PointIndexType begin, PointIndexType end) const;
 };
 
 }
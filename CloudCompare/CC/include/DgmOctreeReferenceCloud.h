@@ -40,7 +40,7 @@ public:
 	DgmOctreeReferenceCloud(DgmOctree::NeighboursSet* associatedSet, unsigned count = 0);
 
 	//**** inherited form GenericCloud ****//
-	inline virtual unsigned size() const { return m_size; }
+	inline virtual PointIndexType size() const { return m_size; }
 	virtual void forEach(genericPointAction& action);
 	virtual void getBoundingBox(CCVector3& bbMin, CCVector3& bbMax);
 	//virtual unsigned char testVisibility(const CCVector3& P) const; //not supported
@@ -48,13 +48,13 @@ public:
 	inline virtual const CCVector3* getNextPoint() { return (m_globalIterator < size() ? m_set->at(m_globalIterator++).point : 0); }
 	inline virtual bool enableScalarField() { return true; } //use DgmOctree::PointDescriptor::squareDistd by default
 	inline virtual bool isScalarFieldEnabled() const { return true; } //use DgmOctree::PointDescriptor::squareDistd by default
-	inline virtual void setPointScalarValue(unsigned pointIndex, ScalarType value) { assert(pointIndex < size()); m_set->at(pointIndex).squareDistd = static_cast<double>(value); }
-	inline virtual ScalarType getPointScalarValue(unsigned pointIndex) const { assert(pointIndex < size()); return static_cast<ScalarType>(m_set->at(pointIndex).squareDistd); }
+	inline virtual void setPointScalarValue(PointIndexType pointIndex, ScalarType value) { assert(pointIndex < size()); m_set->at(pointIndex).squareDistd = static_cast<double>(value); }
+	inline virtual ScalarType getPointScalarValue(PointIndexType pointIndex) const { assert(pointIndex < size()); return static_cast<ScalarType>(m_set->at(pointIndex).squareDistd); }
 	//**** inherited form GenericIndexedCloud ****//
-	inline virtual const CCVector3* getPoint(unsigned index) { assert(index < size()); return m_set->at(index).point; }
-	inline virtual void getPoint(unsigned index, CCVector3& P) const  { assert(index < size()); P = *m_set->at(index).point; }
+	inline virtual const CCVector3* getPoint(PointIndexType index) { assert(index < size()); return m_set->at(index).point; }
+	inline virtual void getPoint(PointIndexType index, CCVector3& P) const  { assert(index < size()); P = *m_set->at(index).point; }
 	//**** inherited form GenericIndexedCloudPersist ****//
-	inline virtual const CCVector3* getPointPersistentPtr(unsigned index) { assert(index < size()); return m_set->at(index).point; }
+	inline virtual const CCVector3* getPointPersistentPtr(PointIndexType index) { assert(index < size()); return m_set->at(index).point; }
 
 	//! Forwards global iterator
 	inline void forwardIterator() { ++m_globalIterator; }
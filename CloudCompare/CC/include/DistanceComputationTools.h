@@ -24,6 +24,9 @@
 #include "CCToolbox.h"
 #include "DgmOctree.h"
 
+//system
+#include <vector>
+
 namespace CCLib
 {
 
@@ -36,6 +39,7 @@ class ChunkedPointCloud;
 class GenericProgressCallback;
 struct OctreeAndMeshIntersection;
 class ScalarField;
+class TriangleBVH;
 
 //! Several entity-to-entity distances computation algorithms (cloud-cloud, cloud-mesh, point-triangle, etc.)
 class CC_CORE_LIB_API DistanceComputationTools : public CCToolbox
@@ -52,13 +56,10 @@ public: //distance to clouds or meshes
 
 		//! Maximum search distance (true distance won't be computed if greater)
 		/** Set to -1 to deactivate (default).
-			\warning Not compatible with closest point set determination (see CPSet)
 		**/
 		ScalarType maxSearchDist;
 
 		//! Whether to use multi-thread or single thread mode
-		/** If maxSearchDist > 0, single thread mode will be forced.
-		**/
 		bool multiThread;
 
 		//! Maximum number of threads to use (0 = max)
@@ -94,10 +95,19 @@ public: //distance to clouds or meshes
 
 		//! Container of (references to) points to store the "Closest Point Set"
 		/** The Closest Point Set corresponds to (the reference to) each compared point's closest neighbour.
-			\warning Not compatible with max search distance (see maxSearchDist)
+			All the stored indexes are valid indexes of the reference cloud.
+			\warning If a max search distance is defined (see maxSearchDist), the points farther than this
+			distance have no closest point (their entry is then a mere placeholder). In this case the
+			CPSetValidity array must be provided as well.
 		**/
 		ReferenceCloud* CPSet;
 
+		//! Validity of each entry of the Closest Point Set (optional)
+		/** Only required if both the CPSet and a max search distance are defined. The array is resized to
+			the number of compared points: 1 if the point has a closest point (below maxSearchDist), 0 otherwise.
+		**/
+		std::vector<unsigned char>* CPSetValidity;
+
 		//! Split distances (one scalar field per dimension: X, Y and Z)
 		ScalarField* splitDistances[3];
 
@@ -119,6 +129,7 @@ public: //distance to clouds or meshes
 			, radiusForLocalModel(0)
 			, reuseExistingLocalModels(false)
 			, CPSet(0)
+			, CPSetValidity(0)
 			, resetFormerDistances(true)
 		{
 			splitDistances[0] = splitDistances[1] = splitDistances[2] = 0;
@@ -133,8 +144,6 @@ public: //distance to clouds or meshes
 		NAN_VALUE but one can avoid this by definining the Cloud2CloudDistanceComputationParams::resetFormerDistances
 		parameters to false. But even in this case, only values above Cloud2CloudDistanceComputationParams::maxSearchDist
 		will remain untouched.
-		\warning Max search distance (Cloud2CloudDistanceComputationParams::maxSearchDist > 0) is not compatible with the
-		determination of the Closest Point Set (Cloud2CloudDistanceComputationParams::CPSet)
 		\param comparedCloud the compared cloud (the distances will be computed on these points)
 		\param referenceCloud the reference cloud (the distances will be computed relatively to these points)
 		\param params distance computation parameters
@@ -176,7 +185,7 @@ public: //distance to clouds or meshes
 		//! Whether triangle normals should be computed in the 'direct' order (true) or 'indirect' (false)
 		bool flipNormals;
 
-		//! Whether to use multi-thread or single thread mode (if maxSearchDist > 0, single thread mode is forced)
+		//! Whether to use multi-thread or single thread mode
 		bool multiThread;
 
 		//! Maximum number of threads to use (0 = max)
@@ -184,10 +193,23 @@ public: //distance to clouds or meshes
 
 		//! Cloud to store the Closest Point Set
 		/** The cloud should be initialized but empty on input. It will have the same size as the compared cloud on output.
-			\warning Not compatible with maxSearchDist > 0.
+			If maxSearchDist > 0, the points farther than this distance are their own 'closest point'.
 		**/
 		ChunkedPointCloud* CPSet;
 
+		//! Structure used to find the nearest triangles
+		enum AccelerationStructure
+		{
+			AUTO_ACCELERATION,		/**< BVH if the triangles sizes are very heterogeneous (or ill-suited to 'octreeLevel'), octree otherwise **/
+			OCTREE_ACCELERATION,	/**< the triangles are projected in the octree cells (at 'octreeLevel') **/
+			BVH_ACCELERATION		/**< Bounding Volume Hierarchy of the triangles (see TriangleBVH) - 'octreeLevel' is ignored **/
+		};
+
+		//! Acceleration structure
+		/** Default value: AUTO_ACCELERATION. The octree is always used with the Distance Transform (see useDistanceMap).
+		**/
+		AccelerationStructure acceleration;
+
 		//! Default constructor
 		Cloud2MeshDistanceComputationParams()
 			: octreeLevel(0)
@@ -198,6 +220,7 @@ public: //distance to clouds or meshes
 			, multiThread(true)
 			, maxThreadCount(0)
 			, CPSet(0)
+			, acceleration(AUTO_ACCELERATION)
 		{}
 	};
 
@@ -364,7 +387,9 @@ public: //other methods
 	//! Synchronizes (and re-build if necessary) two octrees
 	/** Initializes the octrees before computing the distance between two clouds.
 		Check if both octree have the same sizes and limits (in 3D) and rebuild
-		them if necessary.
+		them if necessary. If both octrees are already built with the very same
+		bounding-box and contain all the points of their respective cloud, they
+		are kept as is (so that a caller can reuse the reference octree).
 		\param comparedCloud the cloud corresponding to the first octree
 		\param referenceCloud the cloud corresponding to the second octree
 		\param comparedOctree the first octree
@@ -406,6 +431,19 @@ protected:
 													Cloud2MeshDistanceComputationParams& params,
 													GenericProgressCallback* progressCb = 0);
 
+	//! Computes the distances between a point cloud and a mesh with a Bounding Volume Hierarchy
+	/** This method is used by computeCloud2MeshDistance (see Cloud2MeshDistanceComputationParams::acceleration).
+		\param pointCloud the compared cloud
+		\param bvh the hierarchy of the mesh triangles
+		\param params parameters
+		\param progressCb the client method can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return -1 if an error occurred (e.g. not enough memory), -2 if the process has been cancelled and 0 otherwise
+	**/
+	static int computeCloud2MeshDistanceWithBVH(	GenericIndexedCloudPersist* pointCloud,
+													const TriangleBVH& bvh,
+													Cloud2MeshDistanceComputationParams& params,
+													GenericProgressCallback* progressCb = 0);
+
 	//! Computes the "nearest neighbour distance" without local modeling for all points of an octree cell
 	/** This method has the generic syntax of a "cellular function" (see DgmOctree::localFunctionPtr).
 		Specific parameters are transmitted via the "additionalParameters" structure.
@@ -240,6 +240,25 @@ protected:
 	**/
 	virtual unsigned getNearestTrialCell();
 
+	//! Propagates the front with a parallel iterative solver
+	/** Block-based variant of the Fast Iterative Method: the grid is split in blocks of
+		cells which are updated (in parallel) until the front arrival times stop decreasing.
+		The local update is the same as the one of the sequential march (earliest arrival
+		time from the neighbours) so that both converge to the same times as long as the
+		front acceleration coefficients (see computeTCoefApprox) are positive.
+		The seeds should have already been initialized (ACTIVE cells). They are kept as is
+		and the other cells are left in their current state (only their arrival time is set).
+		\param[out] reachedCells indexes of the cells reached by the front (seeds excluded)
+		\return a negative value if a problem occurred (-3 = the solver did not converge)
+	**/
+	int propagateInParallel(std::vector<unsigned>& reachedCells);
+
+	//! Block of cells processed by propagateInParallel
+	struct PropagationBlock;
+
+	//! Updates the arrival times of a block of cells (see propagateInParallel)
+	static void ProcessPropagationBlock(PropagationBlock& block);
+
 	//! Resets the state of cells in a given list
 	/** Warning: the list will be cleared!
 	**/
@@ -86,6 +86,18 @@ public:
 	**/
 	void setJumpCoef(float value) { m_jumpCoef = value; }
 
+	//! Sets whether the front should be propagated with the parallel solver
+	/** See FastMarching::propagateInParallel. The cells are then accepted by
+		increasing arrival time (with the same detection threshold as the
+		sequential march - see setDetectionThreshold). If the parallel solver
+		doesn't converge, the sequential march is used instead.
+		Warning: only relevant if the acceleration is constant (see init). Otherwise
+		the front acceleration coefficients can be negative, in which case the
+		parallel solver is slower and the propagated area may differ.
+		\param state whether to use the parallel solver or not
+	**/
+	void setParallelPropagation(bool state) { m_parallelPropagation = state; }
+
 	//! Find peaks of local acceleration values
 	/** This method is useful when using this Fast Marching
 		algorithm in a Watershed process. Peak cells are
@@ -127,6 +139,10 @@ protected:
 	float m_jumpCoef;
 	//! Threshold for propagation stop
 	float m_detectionThreshold;
+	//! Whether the acceleration is constant (see init)
+	bool m_constantAcceleration;
+	//! Whether to use the parallel solver
+	bool m_parallelPropagation;
 
 };
 
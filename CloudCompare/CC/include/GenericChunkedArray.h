@@ -39,6 +39,8 @@ static const unsigned ELEMENT_INDEX_BIT_MASK = MAX_NUMBER_OF_ELEMENTS_PER_CHUNK-
 #endif
 
 #include "CCShareable.h"
+#include "CCTypes.h"
+#include "OutOfCoreStorage.h"
 
 //system
 #include <stdlib.h>
@@ -49,6 +51,8 @@ static const unsigned ELEMENT_INDEX_BIT_MASK = MAX_NUMBER_OF_ELEMENTS_PER_CHUNK-
 //! A generic array structure split in several small chunks to avoid the 'biggest contigous memory chunk' limit
 /** This very useful structure can be used to store n-uplets (n starting from 1) of scalar types (int, float, etc.)
 	or even objects, provided they have comparison operators ("<" and ">").
+	The n-uplets are always stored interleaved (x0,y0,z0,x1,y1,z1,...): the pointers returned by getValue,
+	chunkStartPtr or rangeStartPtr (and used as is by the display code) rely on this layout.
 	[SHAREABLE] It can be shared by multiple objects (it is deleted only when the last one 'releases' it).
 **/
 template <int N, class ElementType> class GenericChunkedArray : public CCShareable
@@ -60,6 +64,10 @@ public:
 	**/
 	GenericChunkedArray()
 		: CCShareable()
+#ifdef CC_ENV_64
+		, m_outOfCoreData(0)
+		, m_dataPtr(0)
+#endif
 		, m_count(0)
 		, m_capacity(0)
 		, m_iterator(0)
@@ -73,6 +81,10 @@ public:
 	**/
 	GenericChunkedArray(const GenericChunkedArray& gca)
 		: CCShareable()
+#ifdef CC_ENV_64
+		, m_outOfCoreData(0)
+		, m_dataPtr(0)
+#endif
 		, m_count(0)
 		, m_capacity(0)
 		, m_iterator(0)
@@ -95,13 +107,13 @@ public:
 	/** This corresponds to the number of inserted elements
 		\return the number of elements actually inserted into this array
 	**/
-	inline unsigned currentSize() const { return m_count; }
+	inline PointIndexType currentSize() const { return m_count; }
 
 	//! Returns the maximum array size
 	/** This is the total (reserved) size, not only the number of inserted elements
 		\return the number of elements that can be stored in this array
 	**/
-	inline unsigned capacity() const { return m_capacity; }
+	inline PointIndexType capacity() const { return m_capacity; }
 
 	//! Specifies if the array has been initialized or not
 	/** The array is initialized after a call to reserve or resize (with at least one element).
@@ -120,7 +132,11 @@ public:
 				+ static_cast<unsigned>(m_theChunks.capacity())*sizeof(ElementType*)
 				+ static_cast<unsigned>(m_perChunkCount.capacity())*sizeof(unsigned)
 #endif
+#ifdef CC_ENV_64
+				+ (m_outOfCoreData ? 0 : N*capacity()*sizeof(ElementType));
+#else
 				+ N*capacity()*sizeof(ElementType);
+#endif
 	}
 
 	//! Clears the array
@@ -132,6 +148,12 @@ public:
 		{
 #ifdef CC_ENV_64
 			m_data.clear();
+			if (m_outOfCoreData)
+			{
+				delete m_outOfCoreData;
+				m_outOfCoreData = 0;
+			}
+			m_dataPtr = 0;
 #else
 			while (!m_theChunks.empty())
 			{
@@ -165,7 +187,7 @@ public:
 			//default fill value = 0
 #ifdef CC_ENV_64
 			ElementType zero = 0;
-			std::fill(m_data.begin(), m_data.end(), zero);
+			std::fill(m_dataPtr, m_dataPtr + static_cast<size_t>(m_capacity) * N, zero);
 #else
 			for (size_t i=0; i<m_theChunks.size(); ++i)
 				memset(m_theChunks[i],0,m_perChunkCount[i]*sizeof(ElementType)*N);
@@ -176,7 +198,7 @@ public:
 			//we initialize the first chunk properly
 			//with a recursive copy of N*2^k bytes (k=0,1,2,...)
 #ifdef CC_ENV_64
-			ElementType* _cDest = &(m_data.front());
+			ElementType* _cDest = m_dataPtr;
 #else
 			ElementType* _cDest = m_theChunks.front();
 #endif
@@ -186,21 +208,21 @@ public:
 			_cDest += N;
 
 #ifdef CC_ENV_64
-			unsigned elemToFill = m_capacity;
+			PointIndexType elemToFill = m_capacity;
 #else
 			unsigned elemToFill = m_perChunkCount[0];
 #endif
-			unsigned elemFilled = 1;
-			unsigned copySize = 1;
+			PointIndexType elemFilled = 1;
+			PointIndexType copySize = 1;
 
 			//recurrence
 			while (elemFilled < elemToFill)
 			{
-				unsigned cs = elemToFill-elemFilled;
+				PointIndexType cs = elemToFill-elemFilled;
 				if (copySize < cs)
 					cs = copySize;
 				memcpy(_cDest,_cSrc,cs*sizeof(ElementType)*N);
-				_cDest += cs*static_cast<unsigned>(N);
+				_cDest += cs*static_cast<PointIndexType>(N);
 				elemFilled += cs;
 				copySize <<= 1;
 			}
@@ -226,16 +248,12 @@ public:
 		\param capacity the new number of elements
 		\return true if the method succeeds, false otherwise
 	**/
-	bool reserve(unsigned capacity)
+	bool reserve(PointIndexType capacity)
 	{
 #ifdef CC_ENV_64
-		try
+		if (!resizeData(capacity))
 		{
-			m_data.resize(capacity * N);
-		}
-		catch (const std::bad_alloc&)
-		{
-			//not enough memory
+			//not enough memory (or disk space)
 			return false;
 		}
 
@@ -291,7 +309,7 @@ public:
 		\param valueForNewElements the default value for the new elements (only necessary if the previous parameter is true)
 		\return true if the method succeeds, false otherwise
 	**/
-	bool resize(unsigned count, bool initNewElements = false, const ElementType* valueForNewElements = 0)
+	bool resize(PointIndexType count, bool initNewElements = false, const ElementType* valueForNewElements = 0)
 	{
 		//if the new size is 0, we can simply clear the array!
 		if (count == 0)
@@ -308,20 +326,15 @@ public:
 			if (initNewElements)
 			{
 				//m_capacity should be up-to-date after a call to 'reserve'
-				for (unsigned i=m_count; i<m_capacity; ++i)
+				for (PointIndexType i=m_count; i<m_capacity; ++i)
 					setValue(i,valueForNewElements);
 			}
 		}
 		else //last case: we have to reduce the array size
 		{
 #ifdef CC_ENV_64
-			try
+			if (!resizeData(count)) //shouldn't fail, smaller
 			{
-				m_data.resize(count * N); //shouldn't fail, smaller
-			}
-			catch (const std::bad_alloc&)
-			{
-				//not enough memory
 				return false;
 			}
 		
@@ -334,7 +347,7 @@ public:
 					return true;
 
 				//number of elements to remove
-				unsigned spaceToFree = m_capacity - count;
+				PointIndexType spaceToFree = m_capacity - count;
 				//number of elements in this chunk
 				unsigned numberOfElementsForThisChunk = m_perChunkCount.back();
 
@@ -383,7 +396,7 @@ public:
 		- global iterator may be invalidated
 		\param size new size (must be inferior to m_capacity)
 	**/
-	void setCurrentSize(unsigned size)
+	void setCurrentSize(PointIndexType size)
 	{
 		if (size > m_capacity)
 		{
@@ -398,7 +411,7 @@ public:
 	/** \param index an element index
 		\return pointer to the ith element.
 	**/
-	inline ElementType* operator[] (unsigned index) { return getValue(index); }
+	inline ElementType* operator[] (PointIndexType index) { return getValue(index); }
 
 	//***** data access *****//
 
@@ -431,11 +444,11 @@ public:
 	/** \param index the index of the element to return
 		\return a pointer to the ith element
 	**/
-	inline ElementType* getValue(unsigned index)
+	inline ElementType* getValue(PointIndexType index)
 	{
 		assert(index < m_capacity);
 #ifdef CC_ENV_64
-		return &(m_data[index * N]);
+		return m_dataPtr + static_cast<size_t>(index) * N;
 #else
 		return m_theChunks[index >> CHUNK_INDEX_BIT_DEC]+((index & ELEMENT_INDEX_BIT_MASK)*N);
 #endif
@@ -445,11 +458,11 @@ public:
 	/** \param index the index of the element to return
 		\return a pointer to the ith element
 	**/
-	inline const ElementType* getValue(unsigned index) const
+	inline const ElementType* getValue(PointIndexType index) const
 	{
 		assert(index < m_capacity);
 #ifdef CC_ENV_64
-		return &(m_data[index * N]);
+		return m_dataPtr + static_cast<size_t>(index) * N;
 #else
 		return m_theChunks[index >> CHUNK_INDEX_BIT_DEC]+((index & ELEMENT_INDEX_BIT_MASK)*N);
 #endif
@@ -459,7 +472,7 @@ public:
 	/** \param index the index of the element to update
 		\param value the new value for the element
 	**/
-	inline void setValue(unsigned index, const ElementType* value)
+	inline void setValue(PointIndexType index, const ElementType* value)
 	{
 		assert(index < m_capacity);
 		memcpy(getValue(index), value, N*sizeof(ElementType));
@@ -517,16 +530,25 @@ public:
 		memcpy(m_maxVal,m_minVal,sizeof(ElementType)*N);
 
 		//we update boundaries with all other values
-		for (unsigned i=1; i<m_count; ++i)
+		//(range by range, with branchless tests so that the inner loop can be vectorized)
+		for (PointIndexType i=1; i<m_count; )
 		{
-			const ElementType* val = getValue(i);
-			for (unsigned j=0; j<N; ++j)
+			PointIndexType rangeSize = m_count - i;
+			const ElementType* val = rangeStartPtr(i, rangeSize);
+			ElementType minVal[N], maxVal[N];
+			memcpy(minVal,m_minVal,sizeof(ElementType)*N);
+			memcpy(maxVal,m_maxVal,sizeof(ElementType)*N);
+			for (PointIndexType k=0; k<rangeSize; ++k, val += N)
 			{
-				if (val[j] < m_minVal[j])
-					m_minVal[j] = val[j];
-				else if (val[j] > m_maxVal[j])
-					m_maxVal[j] = val[j];
+				for (unsigned j=0; j<N; ++j)
+				{
+					minVal[j] = (val[j] < minVal[j] ? val[j] : minVal[j]);
+					maxVal[j] = (val[j] > maxVal[j] ? val[j] : maxVal[j]);
+				}
 			}
+			memcpy(m_minVal,minVal,sizeof(ElementType)*N);
+			memcpy(m_maxVal,maxVal,sizeof(ElementType)*N);
+			i += rangeSize;
 		}
 	}
 
@@ -534,7 +556,7 @@ public:
 	/** \param firstElementIndex first element index
 		\param secondElementIndex second element index
 	**/
-	void swap(unsigned firstElementIndex, unsigned secondElementIndex)
+	void swap(PointIndexType firstElementIndex, PointIndexType secondElementIndex)
 	{
 		assert(firstElementIndex < m_count && secondElementIndex < m_count);
 		ElementType* v1 = getValue(firstElementIndex);
@@ -553,10 +575,10 @@ public:
 
 #ifdef CC_ENV_64
 	//! Returns a pointer on the (contiguous) data array
-	inline ElementType* data() { return &(m_data.front()); }
+	inline ElementType* data() { return m_dataPtr; }
 
 	//! Returns a pointer on the (contiguous) data array (const version)
-	inline const ElementType* data() const { return &(m_data.front()); }
+	inline const ElementType* data() const { return m_dataPtr; }
 #endif //!CC_ENV_64
 	
 	//! Returns the number of chunks
@@ -564,7 +586,7 @@ public:
 	{
 #ifdef CC_ENV_64
 		//fake chunk count
-		return (m_count >> CHUNK_INDEX_BIT_DEC) + ((m_count & (MAX_NUMBER_OF_ELEMENTS_PER_CHUNK-1)) ? 1 : 0);
+		return static_cast<unsigned>((m_count >> CHUNK_INDEX_BIT_DEC) + ((m_count & (MAX_NUMBER_OF_ELEMENTS_PER_CHUNK-1)) ? 1 : 0));
 #else
 		return static_cast<unsigned>(m_theChunks.size());
 #endif
@@ -575,7 +597,7 @@ public:
 	{
 		assert(index < chunksCount());
 #ifdef CC_ENV_64
-		return  (index + 1 < chunksCount() ? MAX_NUMBER_OF_ELEMENTS_PER_CHUNK : currentSize() - index * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK);
+		return  (index + 1 < chunksCount() ? MAX_NUMBER_OF_ELEMENTS_PER_CHUNK : static_cast<unsigned>(currentSize() - static_cast<PointIndexType>(index) * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK));
 #else
 		return m_perChunkCount[index];
 #endif
@@ -586,7 +608,7 @@ public:
 	{
 		assert(index < chunksCount());
 #ifdef CC_ENV_64
-		return data() + (index * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK * N);
+		return data() + static_cast<size_t>(index) * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK * N;
 #else
 		return m_theChunks[index];
 #endif
@@ -597,12 +619,41 @@ public:
 	{
 		assert(index < chunksCount());
 #ifdef CC_ENV_64
-		return data() + (index * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK * N);
+		return data() + static_cast<size_t>(index) * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK * N;
 #else
 		return m_theChunks[index];
 #endif
 	}
 
+	//! Returns a pointer on a contiguous range of elements (stateless access)
+	/** Contrarily to the global iterator, this accessor doesn't modify the array
+		state. It can therefore be used concurrently by several threads (each
+		one working on its own range of elements).
+		\param firstIndex index of the first element of the range
+		\param count requested number of elements (input) / number of elements actually stored contiguously after 'firstIndex' (output, may be smaller)
+		\return a pointer on the first element of the range
+	**/
+	inline ElementType* rangeStartPtr(PointIndexType firstIndex, PointIndexType& count)
+	{
+		assert(firstIndex < m_count);
+#ifdef CC_ENV_64
+		PointIndexType maxCount = m_count - firstIndex;
+#else
+		unsigned maxCount = std::min<unsigned>(m_count - firstIndex, MAX_NUMBER_OF_ELEMENTS_PER_CHUNK - (firstIndex & ELEMENT_INDEX_BIT_MASK));
+#endif
+		if (count > maxCount)
+			count = maxCount;
+		return getValue(firstIndex);
+	}
+
+	//! Returns a pointer on a contiguous range of elements (stateless access, const version)
+	/** See GenericChunkedArray::rangeStartPtr.
+	**/
+	inline const ElementType* rangeStartPtr(PointIndexType firstIndex, PointIndexType& count) const
+	{
+		return const_cast<GenericChunkedArray*>(this)->rangeStartPtr(firstIndex, count);
+	}
+
 	//! Copy array data to another one
 	/** \warning only the array content is copied!
 		\param dest destination array (will be resized if necessary)
@@ -610,7 +661,7 @@ public:
 	**/
 	bool copy(GenericChunkedArray<N,ElementType>& dest) const
 	{
-		unsigned count = currentSize();
+		PointIndexType count = currentSize();
 		if (!dest.resize(count))
 		{
 			return false;
@@ -618,7 +669,7 @@ public:
 		
 		//copy content		
 #ifdef CC_ENV_64
-		std::copy(m_data.begin(), m_data.end(), dest.m_data.begin());
+		std::copy(m_dataPtr, m_dataPtr + static_cast<size_t>(count) * N, dest.m_dataPtr);
 #else
 		unsigned copyCount = 0;
 		assert(dest.m_theChunks.size() <= m_theChunks.size());
@@ -640,7 +691,10 @@ protected:
 	**/
 	virtual ~GenericChunkedArray()
 	{
-#ifndef CC_ENV_64
+#ifdef CC_ENV_64
+		if (m_outOfCoreData)
+			delete m_outOfCoreData;
+#else
 		while (!m_theChunks.empty())
 		{
 			delete[] m_theChunks.back();
@@ -649,6 +703,74 @@ protected:
 #endif
 	}
 
+#ifdef CC_ENV_64
+	//! Resizes the data buffer (in memory or out-of-core)
+	/** The data is stored out-of-core (see CCLib::OutOfCoreStorage) as soon as
+		the array becomes big enough with respect to the current policy. It then
+		remains out-of-core until the array is cleared.
+		\param count new number of elements
+		\return success
+	**/
+	bool resizeData(PointIndexType count)
+	{
+		size_t valueCount = static_cast<size_t>(count) * N;
+		size_t byteCount = valueCount * sizeof(ElementType);
+
+		if (m_outOfCoreData || CCLib::OutOfCoreStorage::ShouldBeUsed(byteCount))
+		{
+			if (!m_outOfCoreData)
+			{
+				try
+				{
+					m_outOfCoreData = new CCLib::OutOfCoreStorage;
+				}
+				catch (const std::bad_alloc&)
+				{
+					return false;
+				}
+				if (!m_outOfCoreData->resize(byteCount))
+				{
+					delete m_outOfCoreData;
+					m_outOfCoreData = 0;
+					return false;
+				}
+				//we transfer the data already stored in memory (if any)
+				if (!m_data.empty())
+				{
+					memcpy(m_outOfCoreData->data(), &(m_data.front()), std::min(m_data.size(), valueCount) * sizeof(ElementType));
+					std::vector<ElementType>().swap(m_data);
+				}
+			}
+			else
+			{
+				bool resized = m_outOfCoreData->resize(byteCount);
+				//the buffer address may have changed (even if the resize failed)
+				m_dataPtr = static_cast<ElementType*>(m_outOfCoreData->data());
+				if (!resized)
+				{
+					return false;
+				}
+			}
+			m_dataPtr = static_cast<ElementType*>(m_outOfCoreData->data());
+		}
+		else
+		{
+			try
+			{
+				m_data.resize(valueCount);
+			}
+			catch (const std::bad_alloc&)
+			{
+				//not enough memory
+				return false;
+			}
+			m_dataPtr = (m_data.empty() ? 0 : &(m_data.front()));
+		}
+
+		return true;
+	}
+#endif
+
 	//! Minimum values stored in array (along each dimension)
 	ElementType m_minVal[N];
 
@@ -656,8 +778,12 @@ protected:
 	ElementType m_maxVal[N];
 
 #ifdef CC_ENV_64
-	//! Data
+	//! Data (in memory)
 	std::vector<ElementType> m_data;
+	//! Data (out-of-core)
+	CCLib::OutOfCoreStorage* m_outOfCoreData;
+	//! Pointer on the actual data (either 'm_data' or 'm_outOfCoreData' content)
+	ElementType* m_dataPtr;
 #else
 	//! Arrays 'chunks'
 	std::vector<ElementType*> m_theChunks;
@@ -666,12 +792,12 @@ protected:
 #endif
 
 	//! Total number of elements
-	unsigned m_count;
+	PointIndexType m_count;
 	//! Max total number of elements
-	unsigned m_capacity;
+	PointIndexType m_capacity;
 
 	//! Iterator
-	unsigned m_iterator;
+	PointIndexType m_iterator;
 };
 
 //! Specialization of GenericChunkedArray for the case where N=1 (speed up)
@@ -686,6 +812,10 @@ public:
 		: CCShareable()
 		, m_minVal(0)
 		, m_maxVal(0)
+#ifdef CC_ENV_64
+		, m_outOfCoreData(0)
+		, m_dataPtr(0)
+#endif
 		, m_count(0)
 		, m_capacity(0)
 		, m_iterator(0)
@@ -698,6 +828,10 @@ public:
 		: CCShareable()
 		, m_minVal(gca.m_minVal)
 		, m_maxVal(gca.m_maxVal)
+#ifdef CC_ENV_64
+		, m_outOfCoreData(0)
+		, m_dataPtr(0)
+#endif
 		, m_count(0)
 		, m_capacity(0)
 		, m_iterator(0)
@@ -718,13 +852,13 @@ public:
 	/** This corresponds to the number of inserted elements
 		\return the number of elements actually inserted into this array
 	**/
-	inline unsigned currentSize() const { return m_count; }
+	inline PointIndexType currentSize() const { return m_count; }
 
 	//! Returns the maximum array size
 	/** This is the total (reserved) size, not only the number of inserted elements
 		\return the number of elements that can be stored in this array
 	**/
-	inline unsigned capacity() const { return m_capacity; }
+	inline PointIndexType capacity() const { return m_capacity; }
 
 	//! Specifies if the array has been initialized or not
 	/** The array is initialized after a call to reserve or resize (with at least one element).
@@ -743,7 +877,11 @@ public:
 				+ static_cast<unsigned>(m_theChunks.capacity())*sizeof(ElementType*)
 				+ static_cast<unsigned>(m_perChunkCount.capacity())*sizeof(unsigned)
 #endif
+#ifdef CC_ENV_64
+				+ (m_outOfCoreData ? 0 : capacity()*sizeof(ElementType));
+#else
 				+ capacity()*sizeof(ElementType);
+#endif
 	}
 	//! Clears the array
 	/** \param releaseMemory whether memory should be released or not (for quicker "refill")
@@ -754,6 +892,12 @@ public:
 		{
 #ifdef CC_ENV_64
 			m_data.clear();
+			if (m_outOfCoreData)
+			{
+				delete m_outOfCoreData;
+				m_outOfCoreData = 0;
+			}
+			m_dataPtr = 0;
 #else
 			while (!m_theChunks.empty())
 			{
@@ -782,7 +926,7 @@ public:
 		}
 
 #ifdef CC_ENV_64
-		std::fill(m_data.begin(), m_data.end(), fillValue);
+		std::fill(m_dataPtr, m_dataPtr + m_capacity, fillValue);
 #else
 		if (fillValue == 0)
 		{
@@ -800,13 +944,13 @@ public:
 			*_cDest++ = fillValue;
 
 			unsigned elemToFill = m_perChunkCount[0];
-			unsigned elemFilled = 1;
-			unsigned copySize = 1;
+			PointIndexType elemFilled = 1;
+			PointIndexType copySize = 1;
 
 			//recurrence
 			while (elemFilled < elemToFill)
 			{
-				unsigned cs = elemToFill-elemFilled;
+				PointIndexType cs = elemToFill-elemFilled;
 				if (copySize < cs)
 					cs = copySize;
 				memcpy(_cDest,_cSrc,cs*sizeof(ElementType));
@@ -835,16 +979,12 @@ public:
 		\param capacity the new number of elements
 		\return true if the method succeeds, false otherwise
 	**/
-	bool reserve(unsigned capacity)
+	bool reserve(PointIndexType capacity)
 	{
 #ifdef CC_ENV_64
-		try
-		{
-			m_data.resize(capacity);
-		}
-		catch (const std::bad_alloc&)
+		if (!resizeData(capacity))
 		{
-			//not enough memory
+			//not enough memory (or disk space)
 			return false;
 		}
 
@@ -899,7 +1039,7 @@ public:
 		\param valueForNewElements the default value for the new elements (only necessary if the previous parameter is true)
 		\return true if the method succeeds, false otherwise
 	**/
-	bool resize(unsigned count, bool initNewElements = false, const ElementType& valueForNewElements = 0)
+	bool resize(PointIndexType count, bool initNewElements = false, const ElementType& valueForNewElements = 0)
 	{
 		//if the new size is 0, we can simply clear the array!
 		if (count == 0)
@@ -915,20 +1055,15 @@ public:
 			if (initNewElements)
 			{
 				//m_capacity should be up-to-date after a call to 'reserve'
-				for (unsigned i=m_count; i<m_capacity; ++i)
+				for (PointIndexType i=m_count; i<m_capacity; ++i)
 					setValue(i,valueForNewElements);
 			}
 		}
 		else //last case: we have to reduce the array size
 		{
 #ifdef CC_ENV_64
-			try
-			{
-				m_data.resize(count); //shouldn't fail, smaller
-			}
-			catch (const std::bad_alloc&)
+			if (!resizeData(count)) //shouldn't fail, smaller
 			{
-				//not enough memory
 				return false;
 			}
 		
@@ -941,7 +1076,7 @@ public:
 					return true;
 
 				//number of elements to remove
-				unsigned spaceToFree = m_capacity-count;
+				PointIndexType spaceToFree = m_capacity-count;
 				//number of elements in this chunk
 				unsigned numberOfElementsForThisChunk = m_perChunkCount.back();
 
@@ -990,7 +1125,7 @@ public:
 		- global iterator may be invalidated
 		\param size new size (must be inferior to m_capacity)
 	**/
-	void setCurrentSize(unsigned size)
+	void setCurrentSize(PointIndexType size)
 	{
 		if (size > m_capacity)
 		{
@@ -1005,7 +1140,7 @@ public:
 	/** \param index an element index
 		\return pointer to the ith element.
 	**/
-	inline ElementType& operator[] (unsigned index) { return getValue(index); }
+	inline ElementType& operator[] (PointIndexType index) { return getValue(index); }
 
 	//***** data access *****//
 
@@ -1046,11 +1181,11 @@ public:
 	/** \param index the index of the element to return
 		\return a pointer to the ith element
 	**/
-	inline ElementType& getValue(unsigned index)
+	inline ElementType& getValue(PointIndexType index)
 	{
 		assert(index < m_capacity);
 #ifdef CC_ENV_64
-		return m_data[index];
+		return m_dataPtr[index];
 #else
 		return m_theChunks[index >> CHUNK_INDEX_BIT_DEC][index & ELEMENT_INDEX_BIT_MASK];
 #endif
@@ -1060,11 +1195,11 @@ public:
 	/** \param index the index of the element to return
 		\return a pointer to the ith element
 	**/
-	inline const ElementType& getValue(unsigned index) const
+	inline const ElementType& getValue(PointIndexType index) const
 	{
 		assert(index < m_capacity);
 #ifdef CC_ENV_64
-		return m_data[index];
+		return m_dataPtr[index];
 #else
 		return m_theChunks[index >> CHUNK_INDEX_BIT_DEC][index & ELEMENT_INDEX_BIT_MASK];
 #endif
@@ -1074,7 +1209,7 @@ public:
 	/** \param index the index of the element to update
 		\param value the new value for the element
 	**/
-	inline void setValue(unsigned index, const ElementType& value) { getValue(index) = value; }
+	inline void setValue(PointIndexType index, const ElementType& value) { getValue(index) = value; }
 
 	//! Returns the element with the minimum value stored in the array
 	/** The computeMinAndMax method must be called prior to this one
@@ -1115,7 +1250,7 @@ public:
 	virtual void computeMinAndMax()
 	{
 		//no points?
-		if (m_capacity == 0)
+		if (m_count == 0)
 		{
 			//all boundaries to zero
 			m_minVal = m_maxVal = 0;
@@ -1123,16 +1258,24 @@ public:
 		}
 
 		//we set the first element as min and max boundaries
-		m_minVal = m_minVal = getValue(0);
+		m_minVal = m_maxVal = getValue(0);
 
 		//we update boundaries with all other values
-		for (unsigned i=1; i<m_capacity; ++i)
+		//(range by range, with branchless tests so that the inner loop can be vectorized)
+		for (PointIndexType i=1; i<m_count; )
 		{
-			const ElementType& val = getValue(i);
-			if (val < m_minVal)
-				m_minVal = val;
-			else if (val > m_maxVal)
-				m_maxVal = val;
+			PointIndexType rangeSize = m_count - i;
+			const ElementType* val = rangeStartPtr(i, rangeSize);
+			ElementType minVal = m_minVal;
+			ElementType maxVal = m_maxVal;
+			for (PointIndexType k=0; k<rangeSize; ++k)
+			{
+				minVal = (val[k] < minVal ? val[k] : minVal);
+				maxVal = (val[k] > maxVal ? val[k] : maxVal);
+			}
+			m_minVal = minVal;
+			m_maxVal = maxVal;
+			i += rangeSize;
 		}
 	}
 
@@ -1140,7 +1283,7 @@ public:
 	/** \param firstElementIndex first element index
 		\param secondElementIndex second element index
 	**/
-	inline void swap(unsigned firstElementIndex, unsigned secondElementIndex)
+	inline void swap(PointIndexType firstElementIndex, PointIndexType secondElementIndex)
 	{
 		assert(firstElementIndex < m_count && secondElementIndex < m_count);
 		ElementType& v1 = (*this)[firstElementIndex];
@@ -1152,10 +1295,10 @@ public:
 
 #ifdef CC_ENV_64
 	//! Returns a pointer on the (contiguous) data array
-	inline ElementType* data() { return &(m_data.front()); }
+	inline ElementType* data() { return m_dataPtr; }
 
 	//! Returns a pointer on the (contiguous) data array (const version)
-	inline const ElementType* data() const { return &(m_data.front()); }
+	inline const ElementType* data() const { return m_dataPtr; }
 #endif //!CC_ENV_64
 
 	//! Returns the number of chunks
@@ -1163,7 +1306,7 @@ public:
 	{
 #ifdef CC_ENV_64
 		//fake chunk count
-		return (m_count >> CHUNK_INDEX_BIT_DEC) + ((m_count & (MAX_NUMBER_OF_ELEMENTS_PER_CHUNK-1)) ? 1 : 0);
+		return static_cast<unsigned>((m_count >> CHUNK_INDEX_BIT_DEC) + ((m_count & (MAX_NUMBER_OF_ELEMENTS_PER_CHUNK-1)) ? 1 : 0));
 #else
 		return static_cast<unsigned>(m_theChunks.size());
 #endif
@@ -1174,7 +1317,7 @@ public:
 	{
 		assert(index < chunksCount());
 #ifdef CC_ENV_64
-		return  (index + 1 < chunksCount() ? MAX_NUMBER_OF_ELEMENTS_PER_CHUNK : currentSize() - index * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK);
+		return  (index + 1 < chunksCount() ? MAX_NUMBER_OF_ELEMENTS_PER_CHUNK : static_cast<unsigned>(currentSize() - static_cast<PointIndexType>(index) * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK));
 #else
 		return m_perChunkCount[index];
 #endif
@@ -1185,7 +1328,7 @@ public:
 	{
 		assert(index < chunksCount());
 #ifdef CC_ENV_64
-		return data() + (index * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK);
+		return data() + static_cast<size_t>(index) * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK;
 #else
 		return m_theChunks[index];
 #endif
@@ -1196,12 +1339,41 @@ public:
 	{
 		assert(index < chunksCount());
 #ifdef CC_ENV_64
-		return data() + (index * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK);
+		return data() + static_cast<size_t>(index) * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK;
 #else
 		return m_theChunks[index];
 #endif
 	}
 
+	//! Returns a pointer on a contiguous range of elements (stateless access)
+	/** Contrarily to the global iterator, this accessor doesn't modify the array
+		state. It can therefore be used concurrently by several threads (each
+		one working on its own range of elements).
+		\param firstIndex index of the first element of the range
+		\param count requested number of elements (input) / number of elements actually stored contiguously after 'firstIndex' (output, may be smaller)
+		\return a pointer on the first element of the range
+	**/
+	inline ElementType* rangeStartPtr(PointIndexType firstIndex, PointIndexType& count)
+	{
+		assert(firstIndex < m_count);
+#ifdef CC_ENV_64
+		PointIndexType maxCount = m_count - firstIndex;
+#else
+		unsigned maxCount = std::min<unsigned>(m_count - firstIndex, MAX_NUMBER_OF_ELEMENTS_PER_CHUNK - (firstIndex & ELEMENT_INDEX_BIT_MASK));
+#endif
+		if (count > maxCount)
+			count = maxCount;
+		return &(getValue(firstIndex));
+	}
+
+	//! Returns a pointer on a contiguous range of elements (stateless access, const version)
+	/** See GenericChunkedArray::rangeStartPtr.
+	**/
+	inline const ElementType* rangeStartPtr(PointIndexType firstIndex, PointIndexType& count) const
+	{
+		return const_cast<GenericChunkedArray*>(this)->rangeStartPtr(firstIndex, count);
+	}
+
 	//! Copy array data to another one
 	/** \warning only the array content is copied!
 		\param dest destination array (will be resized if necessary)
@@ -1209,7 +1381,7 @@ public:
 	**/
 	bool copy(GenericChunkedArray<1,ElementType>& dest) const
 	{
-		unsigned count = currentSize();
+		PointIndexType count = currentSize();
 		if (!dest.resize(count))
 		{
 			return false;
@@ -1217,7 +1389,7 @@ public:
 		
 		//copy content		
 #ifdef CC_ENV_64
-		std::copy(m_data.begin(), m_data.end(), dest.m_data.begin());
+		std::copy(m_dataPtr, m_dataPtr + count, dest.m_dataPtr);
 #else
 		unsigned copyCount = 0;
 		assert(dest.m_theChunks.size() <= m_theChunks.size());
@@ -1239,7 +1411,10 @@ protected:
 	**/
 	virtual ~GenericChunkedArray()
 	{
-#ifndef CC_ENV_64
+#ifdef CC_ENV_64
+		if (m_outOfCoreData)
+			delete m_outOfCoreData;
+#else
 		while (!m_theChunks.empty())
 		{
 			delete[] m_theChunks.back();
@@ -1248,6 +1423,74 @@ protected:
 #endif
 	}
 
+#ifdef CC_ENV_64
+	//! Resizes the data buffer (in memory or out-of-core)
+	/** The data is stored out-of-core (see CCLib::OutOfCoreStorage) as soon as
+		the array becomes big enough with respect to the current policy. It then
+		remains out-of-core until the array is cleared.
+		\param count new number of elements
+		\return success
+	**/
+	bool resizeData(PointIndexType count)
+	{
+		size_t valueCount = count;
+		size_t byteCount = valueCount * sizeof(ElementType);
+
+		if (m_outOfCoreData || CCLib::OutOfCoreStorage::ShouldBeUsed(byteCount))
+		{
+			if (!m_outOfCoreData)
+			{
+				try
+				{
+					m_outOfCoreData = new CCLib::OutOfCoreStorage;
+				}
+				catch (const std::bad_alloc&)
+				{
+					return false;
+				}
+				if (!m_outOfCoreData->resize(byteCount))
+				{
+					delete m_outOfCoreData;
+					m_outOfCoreData = 0;
+					return false;
+				}
+				//we transfer the data already stored in memory (if any)
+				if (!m_data.empty())
+				{
+					memcpy(m_outOfCoreData->data(), &(m_data.front()), std::min(m_data.size(), valueCount) * sizeof(ElementType));
+					std::vector<ElementType>().swap(m_data);
+				}
+			}
+			else
+			{
+				bool resized = m_outOfCoreData->resize(byteCount);
+				//the buffer address may have changed (even if the resize failed)
+				m_dataPtr = static_cast<ElementType*>(m_outOfCoreData->data());
+				if (!resized)
+				{
+					return false;
+				}
+			}
+			m_dataPtr = static_cast<ElementType*>(m_outOfCoreData->data());
+		}
+		else
+		{
+			try
+			{
+				m_data.resize(valueCount);
+			}
+			catch (const std::bad_alloc&)
+			{
+				//not enough memory
+				return false;
+			}
+			m_dataPtr = (m_data.empty() ? 0 : &(m_data.front()));
+		}
+
+		return true;
+	}
+#endif
+
 	//! Minimum values stored in array (along each dimension)
 	ElementType m_minVal;
 
@@ -1255,8 +1498,12 @@ protected:
 	ElementType m_maxVal;
 
 #ifdef CC_ENV_64
-	//! Data
+	//! Data (in memory)
 	std::vector<ElementType> m_data;
+	//! Data (out-of-core)
+	CCLib::OutOfCoreStorage* m_outOfCoreData;
+	//! Pointer on the actual data (either 'm_data' or 'm_outOfCoreData' content)
+	ElementType* m_dataPtr;
 #else
 	//! Arrays 'chunks'
 	std::vector<ElementType*> m_theChunks;
@@ -1265,12 +1512,12 @@ protected:
 #endif
 
 	//! Total number of elements
-	unsigned m_count;
+	PointIndexType m_count;
 	//! Max total number of elements
-	unsigned m_capacity;
+	PointIndexType m_capacity;
 
 	//! Iterator
-	unsigned m_iterator;
+	PointIndexType m_iterator;
 };
 
 #endif //GENERIC_CHUNKED_ARRAY_HEADER
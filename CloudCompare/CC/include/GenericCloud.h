@@ -42,7 +42,7 @@ public:
 		/**	Virtual method to request the cloud size
 			\return the cloud size
 		**/
-		virtual unsigned size() const = 0;
+		virtual PointIndexType size() const = 0;
 
 		//! Fast iteration mechanism
 		/**	Virtual method to apply a function to the whole cloud
@@ -99,10 +99,10 @@ public:
 		virtual bool isScalarFieldEnabled() const = 0;
 
 		//! Sets the ith point associated scalar value
-		virtual void setPointScalarValue(unsigned pointIndex, ScalarType value) = 0;
+		virtual void setPointScalarValue(PointIndexType pointIndex, ScalarType value) = 0;
 
 		//! Returns the ith point associated scalar value
-		virtual ScalarType getPointScalarValue(unsigned pointIndex) const = 0;
+		virtual ScalarType getPointScalarValue(PointIndexType pointIndex) const = 0;
 };
 
 }
@@ -48,7 +48,7 @@ public:
 		\param index of the requested point (between 0 and the cloud size minus 1)
 		\return the requested point (undefined behavior if index is invalid)
 	**/
-	virtual const CCVector3* getPoint(unsigned index) = 0;
+	virtual const CCVector3* getPoint(PointIndexType index) = 0;
 
 	//! Returns the ith point
 	/**	Virtual method to request a point with a specific index.
@@ -56,7 +56,7 @@ public:
 		\param index of the requested point (between 0 and the cloud size minus 1)
 		\param P output point
 	**/
-	virtual void getPoint(unsigned index, CCVector3& P) const = 0;
+	virtual void getPoint(PointIndexType index, CCVector3& P) const = 0;
 };
 
 }
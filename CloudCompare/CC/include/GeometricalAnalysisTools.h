@@ -28,6 +28,7 @@ namespace CCLib
 
 class GenericProgressCallback;
 class GenericCloud;
+class NeighbourGraph;
 class ScalarField;
 
 //! Several algorithms to compute point-clouds geometric characteristics  (curvature, density, etc.)
@@ -101,6 +102,34 @@ public:
 								GenericProgressCallback* progressCb = 0,
 								DgmOctree* inputOctree = 0);
 
+	//! Computes the local density (at a given scale) based on a precomputed neighbour graph
+	/** Same as the octree-based version but the neighbours are read from the graph (which must
+		contain the whole spherical neighbourhood of each point, see NeighbourGraph::hasSphere).
+		\warning this method assumes the input scalar field is different from output.
+		\param graph neighbour graph (see NeighbourGraph::compute)
+		\param densityType the 'type' of density to compute
+		\param kernelRadius neighbouring sphere radius
+		\param progressCb client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return success (0) or error code (<0 - -6 if the graph doesn't contain the whole spherical neighbourhoods)
+	**/
+	static int computeLocalDensity(	const NeighbourGraph& graph,
+									Density densityType,
+									PointCoordinateType kernelRadius,
+									GenericProgressCallback* progressCb = 0);
+
+	//! Computes the local roughness based on a precomputed neighbour graph
+	/** Same as the octree-based version but the neighbours are read from the graph (which must
+		contain the whole spherical neighbourhood of each point, see NeighbourGraph::hasSphere).
+		\warning this method assumes the input scalar field is different from output.
+		\param graph neighbour graph (see NeighbourGraph::compute)
+		\param kernelRadius neighbouring sphere radius
+		\param progressCb client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return success (0) or error code (<0 - -6 if the graph doesn't contain the whole spherical neighbourhoods)
+	**/
+	static int computeRoughness(const NeighbourGraph& graph,
+								PointCoordinateType kernelRadius,
+								GenericProgressCallback* progressCb = 0);
+
 	//! Computes the gravity center of a point cloud
 	/** \warning this method uses the cloud global iterator
 		\param theCloud cloud
@@ -246,6 +275,18 @@ protected:
 														void** additionalParameters,
 														NormalizedProgress* nProgress = 0);
 
+	//! Computes the local density of a range of points (of the form NeighbourGraph::pointRangeFunc)
+	static bool computePointsDensity(	const NeighbourGraph& graph,
+										unsigned firstIndex,
+										unsigned lastIndex,
+										void** additionalParameters);
+
+	//! Computes the roughness of a range of points (of the form NeighbourGraph::pointRangeFunc)
+	static bool computePointsRoughness(	const NeighbourGraph& graph,
+										unsigned firstIndex,
+										unsigned lastIndex,
+										void** additionalParameters);
+
 	//! Flags duplicate points inside a cell
 	/**	\param cell structure describing the cell on which processing is applied
 		\param additionalParameters see method description
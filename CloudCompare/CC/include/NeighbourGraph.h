@@ -0,0 +1,152 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef NEIGHBOUR_GRAPH_HEADER
+#define NEIGHBOUR_GRAPH_HEADER
+
+//Local
+#include "DgmOctree.h"
+
+//system
+#include <vector>
+
+namespace CCLib
+{
+
+class GenericIndexedCloudPersist;
+class GenericProgressCallback;
+
+//! Cached neighbourhood graph of a point cloud
+/** For each point, the neighbours (the point itself excluded) are stored by increasing
+	distance in two compact arrays (indexes and squared distances). The graph is computed
+	once (in parallel if possible) and can then be shared by several processes (SOR and
+	noise filters, local density, roughness, etc.) instead of repeating the same
+	neighbourhood searches.
+**/
+class CC_CORE_LIB_API NeighbourGraph
+{
+public:
+
+	//! Default constructor
+	NeighbourGraph();
+
+	//! Computes the graph
+	/** Each point gets at least its 'knn' nearest neighbours (if knn > 0) as well as all
+		its neighbours lying inside a sphere of radius 'radius' (if radius > 0).
+		\param cloud point cloud
+		\param knn minimum number of neighbours per point (the point itself excluded)
+		\param radius radius of the spherical neighbourhood (or 0)
+		\param inputOctree the cloud octree if available
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\param maxThreadCount maximum number of threads (0 = all)
+		\return success
+	**/
+	bool compute(	GenericIndexedCloudPersist* cloud,
+					unsigned knn,
+					PointCoordinateType radius = 0,
+					DgmOctree* inputOctree = 0,
+					GenericProgressCallback* progressCb = 0,
+					int maxThreadCount = 0);
+
+	//! Clears the graph
+	void clear();
+
+	//! Returns whether the graph has been computed
+	inline bool isValid() const { return m_cloud != 0; }
+
+	//! Returns the associated cloud
+	inline GenericIndexedCloudPersist* associatedCloud() const { return m_cloud; }
+
+	//! Returns the number of points
+	inline unsigned size() const { return m_offsets.empty() ? 0 : static_cast<unsigned>(m_offsets.size() - 1); }
+
+	//! Returns the (guaranteed) number of nearest neighbours per point
+	inline unsigned knn() const { return m_knn; }
+
+	//! Returns the radius of the (complete) spherical neighbourhood of each point
+	inline PointCoordinateType radius() const { return m_radius; }
+
+	//! Returns whether the graph contains the 'knn' nearest neighbours of each point
+	inline bool hasKnn(unsigned knn) const { return isValid() && knn <= m_knn; }
+
+	//! Returns whether the graph contains the whole spherical neighbourhood of each point
+	inline bool hasSphere(PointCoordinateType radius) const { return isValid() && radius <= m_radius; }
+
+	//! Returns the number of neighbours of a given point
+	inline unsigned neighbourCount(unsigned pointIndex) const { return static_cast<unsigned>(m_offsets[pointIndex + 1] - m_offsets[pointIndex]); }
+
+	//! Returns the neighbours indexes of a given point (sorted by increasing distance)
+	inline const unsigned* neighbourIndexes(unsigned pointIndex) const { return m_indexes.data() + m_offsets[pointIndex]; }
+
+	//! Returns the neighbours squared distances of a given point (sorted by increasing distance)
+	inline const float* neighbourSquareDistances(unsigned pointIndex) const { return m_squareDistances.data() + m_offsets[pointIndex]; }
+
+	//! Returns the number of neighbours lying inside a sphere (see hasSphere)
+	unsigned neighbourCountInSphere(unsigned pointIndex, PointCoordinateType radius) const;
+
+	//! Returns the memory used by the graph (in bytes)
+	size_t memoryUsage() const;
+
+	//! Function applied to a range of points (see executeFunctionForAllPoints)
+	/** \param graph the neighbour graph
+		\param firstIndex first point index
+		\param lastIndex last point index (excluded)
+		\param additionalParameters custom parameters
+		\return false if an error occurred
+	**/
+	typedef bool (*pointRangeFunc)(const NeighbourGraph& graph, unsigned firstIndex, unsigned lastIndex, void** additionalParameters);
+
+	//! Applies a function to all the points (by ranges, in parallel if possible)
+	/** \param func function to apply
+		\param additionalParameters custom parameters (passed to the function)
+		\param multiThread whether the ranges can be processed in parallel
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\param functionTitle function title (for the progress dialog)
+		\return false if an error occurred or if the process was cancelled
+	**/
+	bool executeFunctionForAllPoints(	pointRangeFunc func,
+										void** additionalParameters,
+										bool multiThread = true,
+										GenericProgressCallback* progressCb = 0,
+										const char* functionTitle = 0) const;
+
+protected:
+
+	//! "Cellular" function to count (pass 0) or store (pass 1) the neighbours of the points of a cell
+	static bool ComputeNeighboursAtLevel(	const DgmOctree::octreeCell& cell,
+											void** additionalParameters,
+											NormalizedProgress* nProgress = 0);
+
+	//! Associated cloud
+	GenericIndexedCloudPersist* m_cloud;
+	//! Guaranteed number of nearest neighbours per point
+	unsigned m_knn;
+	//! Radius of the (complete) spherical neighbourhood of each point
+	PointCoordinateType m_radius;
+
+	//! Position of the neighbours of each point in the two arrays below (+ total count at the end)
+	std::vector<size_t> m_offsets;
+	//! Neighbours indexes
+	std::vector<unsigned> m_indexes;
+	//! Neighbours squared distances
+	std::vector<float> m_squareDistances;
+};
+
+}
+
+#endif //NEIGHBOUR_GRAPH_HEADER
@@ -0,0 +1,166 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef OUT_OF_CORE_STORAGE_HEADER
+#define OUT_OF_CORE_STORAGE_HEADER
+
+//Local
+#include "CCCoreLib.h"
+
+//system
+#include <stddef.h>
+#include <new>
+
+namespace CCLib
+{
+
+//! Memory buffer backed by a (temporary) memory-mapped file
+/** The operating system pages the data in and out on demand, so that
+	the RAM actually used by the buffer is bounded by the system page cache
+	and not by the buffer size. The backing file is created in the
+	directory specified with OutOfCoreStorage::SetPolicy and is automatically
+	deleted when the buffer is released.
+
+	The static 'policy' is used by GenericChunkedArray (64 bits version only)
+	to decide whether an array should be stored in memory or out-of-core.
+	\warning Only suited to POD types (the content is never constructed nor destroyed)
+**/
+class CC_CORE_LIB_API OutOfCoreStorage
+{
+public:
+
+	//! Default constructor
+	OutOfCoreStorage();
+
+	//! Destructor (unmaps the buffer and deletes the backing file)
+	virtual ~OutOfCoreStorage();
+
+	//! Resizes the buffer
+	/** The backing file is created on the first call. Existing data (up to the
+		smallest of the old and new sizes) is preserved.
+		\warning The buffer address may change!
+		\param byteCount new size (in bytes)
+		\return success
+	**/
+	bool resize(size_t byteCount);
+
+	//! Releases the buffer (and deletes the backing file)
+	void release();
+
+	//! Returns the buffer address (or 0 if not allocated)
+	inline void* data() const { return m_address; }
+
+	//! Returns the buffer size (in bytes)
+	inline size_t size() const { return m_size; }
+
+	//! Sets the out-of-core storage policy
+	/** \param directory directory where the backing files are created (0 or empty string = out-of-core storage disabled)
+		\param minByteCount minimum size of an array (in bytes) to be stored out-of-core
+	**/
+	static void SetPolicy(const char* directory, size_t minByteCount = 0);
+
+	//! Returns the directory where backing files are created (or 0 if out-of-core storage is disabled)
+	static const char* GetDirectory();
+
+	//! Returns whether an array of the given size should be stored out-of-core
+	static bool ShouldBeUsed(size_t byteCount);
+
+	//! Allocates a memory block (in memory or out-of-core depending on the current policy)
+	/** The block is stored out-of-core if ShouldBeUsed(byteCount) returns true,
+		and in memory otherwise (or if the backing file couldn't be created).
+		\param byteCount block size (in bytes)
+		\return block address (aligned on 16 bytes) or 0 if not enough memory
+	**/
+	static void* Allocate(size_t byteCount);
+
+	//! Releases a memory block allocated with Allocate
+	static void Free(void* address);
+
+protected:
+
+	//! Maps the backing file in memory (with the current size)
+	bool map();
+
+	//! Unmaps the backing file
+	void unmap();
+
+	//! Buffer address
+	void* m_address;
+	//! Buffer size (in bytes)
+	size_t m_size;
+
+#ifdef _WIN32
+	//! Backing file handle
+	void* m_fileHandle;
+	//! Mapping object handle
+	void* m_mappingHandle;
+#else
+	//! Backing file descriptor
+	int m_fileDescriptor;
+#endif
+};
+
+//! STL allocator relying on OutOfCoreStorage::Allocate
+/** Big enough containers are transparently stored in (temporary)
+	memory-mapped files. Shares the same restrictions as OutOfCoreStorage.
+**/
+template <class T> class OutOfCoreAllocator
+{
+public:
+
+	typedef T value_type;
+	typedef T* pointer;
+	typedef const T* const_pointer;
+	typedef T& reference;
+	typedef const T& const_reference;
+	typedef size_t size_type;
+	typedef ptrdiff_t difference_type;
+
+	template <class U> struct rebind { typedef OutOfCoreAllocator<U> other; };
+
+	OutOfCoreAllocator() throw() {}
+	OutOfCoreAllocator(const OutOfCoreAllocator&) throw() {}
+	template <class U> OutOfCoreAllocator(const OutOfCoreAllocator<U>&) throw() {}
+
+	inline pointer address(reference x) const { return &x; }
+	inline const_pointer address(const_reference x) const { return &x; }
+
+	pointer allocate(size_type n, const void* = 0)
+	{
+		if (n > max_size())
+			throw std::bad_alloc();
+		void* p = OutOfCoreStorage::Allocate(n * sizeof(T));
+		if (!p)
+			throw std::bad_alloc();
+		return static_cast<pointer>(p);
+	}
+
+	inline void deallocate(pointer p, size_type) { OutOfCoreStorage::Free(p); }
+
+	inline size_type max_size() const throw() { return static_cast<size_type>(-1) / sizeof(T); }
+
+	inline void construct(pointer p, const T& val) { new (static_cast<void*>(p)) T(val); }
+	inline void destroy(pointer p) { p->~T(); }
+};
+
+template <class T, class U> inline bool operator == (const OutOfCoreAllocator<T>&, const OutOfCoreAllocator<U>&) { return true; }
+template <class T, class U> inline bool operator != (const OutOfCoreAllocator<T>&, const OutOfCoreAllocator<U>&) { return false; }
+
+}
+
+#endif //OUT_OF_CORE_STORAGE_HEADER
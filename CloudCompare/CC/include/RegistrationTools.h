@@ -21,6 +21,11 @@
 
 //Local
 #include "PointProjectionTools.h"
+#include "GenericChunkedArray.h"
+
+//system
+#include <vector>
+#include <random>
 
 
 namespace CCLib
@@ -32,6 +37,7 @@ class GenericIndexedMesh;
 class GenericIndexedCloud;
 class KDTree;
 class ScalarField;
+class ReferenceCloud;
 
 //! Common point cloud registration algorithms
 class CC_CORE_LIB_API RegistrationTools : public CCToolbox
@@ -157,6 +163,16 @@ public:
 		ICP_ERROR_INVALID_INPUT			= 105,
 	};
 
+	//! Error metric minimized at each iteration
+	enum ERROR_METRIC
+	{
+		POINT_TO_POINT	= 0,	/**< Distance between each data point and its closest model point (Besl et al.) **/
+		POINT_TO_PLANE	= 1,	/**< Distance between each data point and the tangent plane at its closest model point (Chen and Medioni) **/
+	};
+
+	//! Container for per-point normals
+	typedef GenericChunkedArray<3,PointCoordinateType> NormalsContainer;
+
 	//! ICP Parameters
 	struct Parameters
 	{
@@ -172,6 +188,11 @@ public:
 			, dataWeights(0)
 			, transformationFilters(SKIP_NONE)
 			, maxThreadCount(0)
+			, errorMetric(POINT_TO_POINT)
+			, modelNormals(0)
+			, normalsNeighbourCount(12)
+			, maxCoupleDistance(0)
+			, multiResolutionLevels(1)
 		{}
 
 		//! Convergence type
@@ -206,6 +227,57 @@ public:
 
 		//! Maximum number of threads to use (0 = max)
 		int maxThreadCount;
+
+		//! Error metric
+		/** POINT_TO_PLANE is only supported if the model entity is a cloud (the
+			POINT_TO_POINT metric is used otherwise). It ignores 'adjustScale'.
+			Note that the RMS is then computed with point-to-plane distances.
+		**/
+		ERROR_METRIC errorMetric;
+
+		//! Normals of the model points (i.e. only if the model entity is a cloud) (optional)
+		/** Only used with the POINT_TO_PLANE metric. If not set, the normals
+			are estimated by fitting a plane on the nearest neighbours of each
+			model point (see 'normalsNeighbourCount').
+		**/
+		NormalsContainer* modelNormals;
+
+		//! Number of neighbours used to estimate the model normals (if not set)
+		unsigned normalsNeighbourCount;
+
+		//! Maximum distance between the points of a couple (0 = no limit)
+		/** Farther couples are ignored at each iteration (as long as enough couples remain).
+		**/
+		PointCoordinateType maxCoupleDistance;
+
+		//! Number of resolution levels (coarse-to-fine registration)
+		/** If greater than 1, the clouds are first registered at coarse octree levels
+			(see CloudSamplingTools::subsampleCloudWithOctreeAtLevel) with a max couple
+			distance shrinking with the cell size. The last stage is a standard registration
+			with all the other parameters. Speeds up the convergence with large initial offsets.
+		**/
+		unsigned multiResolutionLevels;
+	};
+
+	//! Timings of a single ICP step (in seconds)
+	struct IterationTimings
+	{
+		IterationTimings()
+			: distancesTime_s(0)
+			, registrationTime_s(0)
+			, totalTime_s(0)
+		{}
+
+		//! Time spent computing the distances (and the closest point set)
+		/** For the first step, this includes the construction of the model octree.
+		**/
+		double distancesTime_s;
+
+		//! Time spent estimating the transformation
+		double registrationTime_s;
+
+		//! Total time of the step
+		double totalTime_s;
 	};
 
 	//! Registers two clouds or a cloud and a mesh
@@ -220,6 +292,7 @@ public:
 		\param[out] finalRMS final error (RMS)
 		\param[out] finalPointCount number of points used to compute the final RMS
 		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\param[out] iterationTimings timings of each step (optional): the first entry corresponds to the initial distances computation, then one entry per iteration
 		\return algorithm result
 	**/
 	static RESULT_TYPE Register(	GenericIndexedCloudPersist* modelCloud,
@@ -229,8 +302,46 @@ public:
 									ScaledTransformation& totalTrans,
 									double& finalRMS,
 									unsigned& finalPointCount,
-									GenericProgressCallback* progressCb = 0);
+									GenericProgressCallback* progressCb = 0,
+									std::vector<IterationTimings>* iterationTimings = 0);
+
+protected:
 
+	//! Coarse-to-fine registration (see Parameters::multiResolutionLevels)
+	/** Same parameters as Register.
+	**/
+	static RESULT_TYPE RegisterMultiResolution(	GenericIndexedCloudPersist* modelCloud,
+												GenericIndexedMesh* modelMesh,
+												GenericIndexedCloudPersist* dataCloud,
+												const Parameters& params,
+												ScaledTransformation& totalTrans,
+												double& finalRMS,
+												unsigned& finalPointCount,
+												GenericProgressCallback* progressCb,
+												std::vector<IterationTimings>* iterationTimings);
+
+	//! Point-to-plane registration procedure (one step)
+	/** Linearized least squares minimization of the (weighted) distances between
+		the transformed points P[i] and the tangent planes at their closest model
+		points X[i] (Chen and Medioni 1991 / Low 2004):
+
+			X = R.P + T (no scale)
+
+		Couples with an invalid (null) normal are ignored. Degenerate configurations
+		(e.g. a single plane) are handled by ignoring the unconstrained directions.
+
+		\param P the cloud to register (data)
+		\param X the closest points in the model cloud
+		\param modelNormals normals of the model cloud (indexed by the global index of the points of X)
+		\param trans the resulting transformation
+		\param coupleWeights weights for each (Pi,Xi) couple (optional)
+		\return success
+	**/
+	static bool PointToPlaneRegistrationProcedure(	GenericCloud* P,
+													ReferenceCloud* X,
+													const std::vector<CCVector3>& modelNormals,
+													ScaledTransformation& trans,
+													ScalarField* coupleWeights = 0);
 
 };
 
@@ -251,6 +362,9 @@ public:
         \param nbTries number of tries to find a base in the reference cloud
 		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
         \param nbMaxCandidates if>0, maximal number of candidate bases allowed for each step. Otherwise the number of candidates is not bounded
+		\param randomSeed seed of the random bases selection (for a given seed the result is reproducible, whatever the number of threads). If 0, a time-based seed is used
+		\param targetScoreRatio if>0, the process stops as soon as this ratio of data points (in [0,1]) are registered (i.e. lie at less than delta from the model)
+		\param multiThread whether the trials should be processed in parallel (if supported)
 		\return false: failure ; true: success.
     **/
     static bool RegisterClouds(	GenericIndexedCloud* modelCloud,
@@ -262,7 +376,10 @@ public:
                                 unsigned nbBases,
                                 unsigned nbTries,
                                 GenericProgressCallback* progressCb=0,
-                                unsigned nbMaxCandidates = 0);
+                                unsigned nbMaxCandidates = 0,
+                                unsigned randomSeed = 0,
+                                double targetScoreRatio = 0,
+                                bool multiThread = true);
 
 protected:
 
@@ -280,12 +397,14 @@ protected:
 		\param overlap estimation of the overlap rate
         \param nbTries the maximum number of tries to find a base
         \param base the resulting base
+        \param generator random number generator
         \return false: failure ; true: success
     **/
     static bool FindBase(	GenericIndexedCloud* cloud,
                             PointCoordinateType overlap,
                             unsigned nbTries,
-                            Base &base);
+                            Base &base,
+                            std::mt19937& generator);
 
     /*! Find bases which are congruent to a specified 4 points base
         \param tree the KD-tree build from data cloud
@@ -302,15 +421,23 @@ protected:
     //! Registration score computation function
     /**!
         \param modelTree KD-tree containing the model point cloud
-        \param dataCloud data point cloud
+        \param dataPoints data points (contiguous copy of the data cloud)
         \param dataToModel transformation that, applied to data points, register model and data clouds
         \param delta tolerance above which data points are not counted (if a point is less than delta-appart from de model cloud, then it is counted)
+        \param scoreToBeat the process stops as soon as the score can't be strictly greater than this value anymore (the returned score is then partial)
         \return the number of data points which are distance-appart from the model cloud
     **/
     static unsigned ComputeRegistrationScore(	KDTree *modelTree,
-												GenericIndexedCloud *dataCloud,
+												const std::vector<CCVector3>& dataPoints,
 												ScalarType delta,
-												const ScaledTransformation& dataToModel);
+												const ScaledTransformation& dataToModel,
+												unsigned scoreToBeat = 0);
+
+    //! 4PCS trial (i.e. one random reference base and all its congruent candidates)
+    struct Trial;
+
+    //! Processes a single 4PCS trial (see RegisterClouds)
+    static void ProcessTrial(Trial& trial);
 
     //! Find the 3D pseudo intersection between two lines
     /** This function finds the 3D point which is the nearest from the both lines (when this point is unique, i.e. when
@@ -45,22 +45,22 @@ public:
 	virtual ~SimpleCloud();
 
 	//**** inherited form GenericCloud ****//
-	virtual unsigned size() const;
+	virtual PointIndexType size() const;
 	virtual void forEach(genericPointAction& action);
 	virtual void getBoundingBox(CCVector3& bbMin, CCVector3& bbMax);
 	virtual void placeIteratorAtBegining();
 	virtual const CCVector3* getNextPoint();
 	virtual bool enableScalarField();
 	virtual bool isScalarFieldEnabled() const;
-	virtual void setPointScalarValue(unsigned pointIndex, ScalarType value);
-	virtual ScalarType getPointScalarValue(unsigned pointIndex) const;
+	virtual void setPointScalarValue(PointIndexType pointIndex, ScalarType value);
+	virtual ScalarType getPointScalarValue(PointIndexType pointIndex) const;
 
 	//**** inherited form GenericIndexedCloud ****//
-	inline virtual const CCVector3* getPoint(unsigned index) {return getPointPersistentPtr(index);}
-	virtual void getPoint(unsigned index, CCVector3& P) const;
+	inline virtual const CCVector3* getPoint(PointIndexType index) {return getPointPersistentPtr(index);}
+	virtual void getPoint(PointIndexType index, CCVector3& P) const;
 
 	//**** inherited form GenericIndexedCloudPersist ****//
-	virtual const CCVector3* getPointPersistentPtr(unsigned index);
+	virtual const CCVector3* getPointPersistentPtr(PointIndexType index);
 
 	//! Clears cloud
 	void clear();
@@ -80,12 +80,12 @@ public:
 	//! Reserves some memory for hosting the points
 	/** \param n the number of points
 	**/
-	virtual bool reserve(unsigned n);
+	virtual bool reserve(PointIndexType n);
 
 	//! Presets the size of the vector used to store the points
 	/** \param n the number of points
 	**/
-	virtual bool resize(unsigned n);
+	virtual bool resize(PointIndexType n);
 
 	//! Applies a rigid transformation to the cloud
 	/** WARNING: THIS METHOD IS NOT COMPATIBLE WITH PARALLEL STRATEGIES
@@ -112,7 +112,7 @@ protected:
 	ScalarField* m_scalarField;
 
 	//! Iterator on the points container
-	unsigned globalIterator;
+	PointIndexType globalIterator;
 
 	//! Bounding-box validity
 	bool m_validBB;
@@ -0,0 +1,123 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef TRIANGLE_BVH_HEADER
+#define TRIANGLE_BVH_HEADER
+
+//Local
+#include "CCGeom.h"
+#include "CCCoreLib.h"
+
+//system
+#include <vector>
+
+namespace CCLib
+{
+
+class GenericIndexedMesh;
+class GenericProgressCallback;
+
+//! Bounding Volume Hierarchy of the triangles of a mesh
+/** The hierarchy is built with the (binned) Surface Area Heuristic. Contrarily to a regular
+	grid or an octree level, its nodes adapt to the size of the triangles, which makes it well
+	suited to meshes mixing very large and very small triangles (e.g. CAD models).
+	The BVH keeps its own copy of the triangles vertices so that it can be queried by several
+	threads at once.
+**/
+class CC_CORE_LIB_API TriangleBVH
+{
+public:
+
+	//! Default constructor
+	TriangleBVH();
+
+	//! Builds the hierarchy
+	/** \param mesh triangular mesh
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return success
+	**/
+	bool build(GenericIndexedMesh* mesh, GenericProgressCallback* progressCb = 0);
+
+	//! Clears the hierarchy
+	void clear();
+
+	//! Returns whether the hierarchy has been built
+	inline bool isValid() const { return !m_nodes.empty(); }
+
+	//! Returns the number of triangles
+	inline unsigned size() const { return static_cast<unsigned>(m_triangleIndexes.size()); }
+
+	//! Returns the number of nodes (including leaves)
+	inline unsigned nodeCount() const { return static_cast<unsigned>(m_nodes.size()); }
+
+	//! Returns the memory used by the hierarchy (in bytes)
+	size_t memoryUsage() const;
+
+	//! Nearest triangle (see findNearestTriangle)
+	struct NearestTriangle
+	{
+		//! Triangle index (in the mesh)
+		unsigned triangleIndex;
+		//! Squared distance to the triangle
+		double squareDist;
+		//! Whether the point lies on the negative side of the triangle (see DistanceComputationTools::computePoint2TriangleDistance)
+		bool negativeSide;
+	};
+
+	//! Finds the nearest triangle to a given point
+	/** The nodes farther than the current nearest triangle (or than 'maxSquareDist') are skipped.
+		\param P query point
+		\param maxSquareDist only the triangles strictly closer than this (squared) distance are considered
+		\param result the nearest triangle (if any)
+		\param nearestPoint optional: returns the nearest point on the nearest triangle
+		\return whether a triangle has been found
+	**/
+	bool findNearestTriangle(	const CCVector3& P,
+								double maxSquareDist,
+								NearestTriangle& result,
+								CCVector3* nearestPoint = 0) const;
+
+protected:
+
+	//! Hierarchy node
+	struct Node
+	{
+		//! Bounding-box min corner
+		CCVector3 bbMin;
+		//! Bounding-box max corner
+		CCVector3 bbMax;
+		//! Index of the first triangle (leaf) or of the first child (node - the second one follows)
+		unsigned first;
+		//! Number of triangles (leaf) or 0 (node)
+		unsigned count;
+	};
+
+	//! Returns the squared distance between a point and the bounding-box of a node (0 if inside)
+	static double SquareDistanceToNode(const CCVector3& P, const Node& node);
+
+	//! Nodes (the root node comes first)
+	std::vector<Node> m_nodes;
+	//! Triangles indexes (in the mesh - in the leaves order)
+	std::vector<unsigned> m_triangleIndexes;
+	//! Triangles vertices (3 per triangle - in the leaves order)
+	std::vector<CCVector3> m_vertices;
+};
+
+}
+
+#endif //TRIANGLE_BVH_HEADER
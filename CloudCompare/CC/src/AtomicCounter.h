@@ -0,0 +1,58 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_ATOMIC_COUNTER_HEADER
+#define CC_ATOMIC_COUNTER_HEADER
+
+#ifdef USE_QT
+
+//we use Qt for the atomic counter
+#include <QAtomicInt>
+
+//! Qt 4/5 compatible QAtomicInt
+class AtomicCounter : public QAtomicInt
+{
+public:
+	explicit AtomicCounter(int value = 0) : QAtomicInt(value) {}
+
+#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
+	inline int load() const { return *this; }
+	inline void store(int value) { *static_cast<QAtomicInt*>(this) = value; }
+#endif
+};
+
+#else
+
+//we use a fake QAtomicInt
+
+//! Fake QAtomicInt
+/** \warning Not thread safe!
+**/
+class AtomicCounter
+{
+public:
+	explicit AtomicCounter(int value = 0) : m_value(value) {}
+	inline int load() const { return m_value; }
+	inline void store(int value) { m_value = value; }
+	inline int fetchAndAddRelaxed(int add) { int original = m_value; m_value += add; return original; }
+	int m_value;
+};
+
+#endif
+
+#endif //CC_ATOMIC_COUNTER_HEADER
@@ -63,8 +63,8 @@ void ChunkedPointCloud::forEach(genericPointAction& action)
 		return;
 	}
 
-	unsigned n = size();
-	for (unsigned i = 0; i < n; ++i)
+	PointIndexType n = size();
+	for (PointIndexType i = 0; i < n; ++i)
 	{
 		action(*getPoint(i), (*currentOutScalarFieldArray)[i]);
 	}
@@ -97,9 +97,9 @@ const CCVector3* ChunkedPointCloud::getNextPoint()
 	return (m_currentPointIndex < m_points->currentSize() ? point(m_currentPointIndex++) : 0);
 }
 
-bool ChunkedPointCloud::resize(unsigned newCount)
+bool ChunkedPointCloud::resize(PointIndexType newCount)
 {
-	unsigned oldCount = m_points->currentSize();
+	PointIndexType oldCount = m_points->currentSize();
 
 	//we try to enlarge the 3D points array
 	if (!m_points->resize(newCount))
@@ -126,7 +126,7 @@ bool ChunkedPointCloud::resize(unsigned newCount)
 	return true;
 }
 
-bool ChunkedPointCloud::reserve(unsigned newCapacity)
+bool ChunkedPointCloud::reserve(PointIndexType newCapacity)
 {
 	//we try to enlarge the 3D points array
 	if (!m_points->reserve(newCapacity))
@@ -165,32 +165,43 @@ void ChunkedPointCloud::addPoint(const CCVector3 &P)
 
 void ChunkedPointCloud::applyTransformation(PointProjectionTools::Transformation& trans)
 {
-	unsigned count = size();
+	bool applyScale = (fabs(static_cast<double>(trans.s) - 1.0) > ZERO_TOLERANCE);
+	bool applyRotation = trans.R.isValid();
+	bool applyTranslation = (trans.T.norm() > ZERO_TOLERANCE); //T applied only if it makes sense
 
-	//always apply the scale before everything (applying before or after rotation does not changes anything)
-	if (fabs(static_cast<double>(trans.s) - 1.0) > ZERO_TOLERANCE)
-	{
-		for (unsigned i=0; i<count; ++i)
-			*point(i) *= trans.s;
-		m_validBB = false; //invalidate bb
-	}
+	if (!applyScale && !applyRotation && !applyTranslation)
+		return;
 
-	if (trans.R.isValid())
+	//we process the points range by range (stateless access to contiguous data)
+	PointIndexType count = size();
+	for (PointIndexType i=0; i<count; )
 	{
-		for (unsigned i=0; i<count; ++i)
+		PointIndexType rangeSize = count - i;
+		CCVector3* P = reinterpret_cast<CCVector3*>(m_points->rangeStartPtr(i, rangeSize));
+
+		//always apply the scale before everything (applying before or after rotation does not changes anything)
+		if (applyScale)
 		{
-			CCVector3* P = point(i);
-			(*P) = trans.R * (*P);
+			for (PointIndexType j=0; j<rangeSize; ++j)
+				P[j] *= trans.s;
 		}
-		m_validBB = false;
-	}
 
-	if (trans.T.norm() > ZERO_TOLERANCE) //T applied only if it makes sense
-	{
-		for (unsigned i=0; i<count; ++i)
-			*point(i) += trans.T;
-		m_validBB = false;
+		if (applyRotation)
+		{
+			for (PointIndexType j=0; j<rangeSize; ++j)
+				P[j] = trans.R * P[j];
+		}
+
+		if (applyTranslation)
+		{
+			for (PointIndexType j=0; j<rangeSize; ++j)
+				P[j] += trans.T;
+		}
+
+		i += rangeSize;
 	}
+
+	m_validBB = false; //invalidate bb
 }
 
 /***********************/
@@ -207,7 +218,7 @@ bool ChunkedPointCloud::isScalarFieldEnabled() const
 		return false;
 	}
 
-	unsigned sfValuesCount = currentInScalarFieldArray->currentSize();
+	PointIndexType sfValuesCount = currentInScalarFieldArray->currentSize();
 	return (sfValuesCount > 0 && sfValuesCount >= m_points->currentSize());
 }
 
@@ -246,7 +257,7 @@ bool ChunkedPointCloud::enableScalarField()
 	return currentInScalarField->resize(m_points->capacity());
 }
 
-void ChunkedPointCloud::setPointScalarValue(unsigned pointIndex, ScalarType value)
+void ChunkedPointCloud::setPointScalarValue(PointIndexType pointIndex, ScalarType value)
 {
 	assert(m_currentInScalarFieldIndex>=0 && m_currentInScalarFieldIndex<(int)m_scalarFields.size());
 	//slow version
@@ -258,7 +269,7 @@ void ChunkedPointCloud::setPointScalarValue(unsigned pointIndex, ScalarType valu
 	m_scalarFields[m_currentInScalarFieldIndex]->setValue(pointIndex, value);
 }
 
-ScalarType ChunkedPointCloud::getPointScalarValue(unsigned pointIndex) const
+ScalarType ChunkedPointCloud::getPointScalarValue(PointIndexType pointIndex) const
 {
 	assert(m_currentOutScalarFieldIndex >= 0 && m_currentOutScalarFieldIndex < static_cast<int>(m_scalarFields.size()));
 
@@ -377,7 +388,7 @@ bool ChunkedPointCloud::renameScalarField(int index, const char* newName)
 	return false;
 }
 
-void ChunkedPointCloud::swapPoints(unsigned firstIndex, unsigned secondIndex)
+void ChunkedPointCloud::swapPoints(PointIndexType firstIndex, PointIndexType secondIndex)
 {
 	if (	firstIndex == secondIndex
 		||	firstIndex >= m_points->currentSize()
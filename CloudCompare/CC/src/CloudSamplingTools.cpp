@@ -27,11 +27,13 @@
 #include "SimpleMesh.h"
 #include "GenericProgressCallback.h"
 #include "DgmOctreeReferenceCloud.h"
+#include "NeighbourGraph.h"
 #include "DistanceComputationTools.h"
 #include "ScalarField.h"
 #include "ScalarFieldTools.h"
 
 //system
+#include <algorithm>
 #include <assert.h>
 #include <random>
 
@@ -471,6 +473,53 @@ ReferenceCloud* CloudSamplingTools::resampleCloudSpatially(GenericIndexedCloudPe
 	return sampledCloud;
 }
 
+//! Keeps the points whose mean distance to their neighbors is below avg + nSigma * std. dev. (see CloudSamplingTools::sorFilter)
+static ReferenceCloud* KeepPointsBelowMeanDistance(	GenericIndexedCloudPersist* inputCloud,
+													const std::vector<PointCoordinateType>& meanDistances,
+													double nSigma)
+{
+	unsigned pointCount = static_cast<unsigned>(meanDistances.size());
+	if (pointCount == 0)
+	{
+		assert(false);
+		return 0;
+	}
+
+	//deduce the average distance and std. dev.
+	double sumDist = 0;
+	double sumSquareDist = 0;
+	for (unsigned i=0; i<pointCount; ++i)
+	{
+		sumDist += meanDistances[i];
+		sumSquareDist += meanDistances[i]*meanDistances[i];
+	}
+	double avgDist = sumDist / pointCount;
+	double stdDev = sqrt(fabs(sumSquareDist / pointCount - avgDist*avgDist));
+
+	//deduce the max distance
+	double maxDist = avgDist + nSigma * stdDev;
+
+	ReferenceCloud* filteredCloud = new ReferenceCloud(inputCloud);
+	if (!filteredCloud->reserve(pointCount))
+	{
+		//not enough memory
+		delete filteredCloud;
+		return 0;
+	}
+
+	for (unsigned i=0; i<pointCount; ++i)
+	{
+		if (meanDistances[i] <= maxDist)
+		{
+			filteredCloud->addPointIndex(i);
+		}
+	}
+
+	filteredCloud->resize(filteredCloud->size());
+
+	return filteredCloud;
+}
+
 ReferenceCloud* CloudSamplingTools::sorFilter(	GenericIndexedCloudPersist* inputCloud,
 												int knn/*=6*/,
 												double nSigma/*=1.0*/,
@@ -513,7 +562,6 @@ ReferenceCloud* CloudSamplingTools::sorFilter(	GenericIndexedCloudPersist* input
 			//not enough memory
 			break;
 		}
-		double avgDist = 0, stdDev = 0;
 
 		//1st step: compute the average distance to the neighbors
 		{
@@ -534,43 +582,10 @@ ReferenceCloud* CloudSamplingTools::sorFilter(	GenericIndexedCloudPersist* input
 				//something went wrong
 				break;
 			}
-
-			//deduce the average distance and std. dev.
-			double sumDist = 0;
-			double sumSquareDist = 0;
-			for (unsigned i=0; i<pointCount; ++i)
-			{
-				sumDist += meanDistances[i];
-				sumSquareDist += meanDistances[i]*meanDistances[i];
-			}
-			avgDist = sumDist / pointCount;
-			stdDev = sqrt(fabs(sumSquareDist / pointCount - avgDist*avgDist));
 		}
 
 		//2nd step: remove the farthest points 
-		{
-			//deduce the max distance
-			double maxDist = avgDist + nSigma * stdDev;
-
-			filteredCloud = new ReferenceCloud(inputCloud);
-			if (!filteredCloud->reserve(pointCount))
-			{
-				//not enough memory
-				delete filteredCloud;
-				filteredCloud = 0;
-				break;
-			}
-
-			for (unsigned i=0; i<pointCount; ++i)
-			{
-				if (meanDistances[i] <= maxDist)
-				{
-					filteredCloud->addPointIndex(i);
-				}
-			}
-
-			filteredCloud->resize(filteredCloud->size());
-		}
+		filteredCloud = KeepPointsBelowMeanDistance(inputCloud, meanDistances, nSigma);
 	}
 
 	if (!inputOctree)
@@ -582,6 +597,49 @@ ReferenceCloud* CloudSamplingTools::sorFilter(	GenericIndexedCloudPersist* input
 	return filteredCloud;
 }
 
+ReferenceCloud* CloudSamplingTools::sorFilter(	const NeighbourGraph& graph,
+												int knn/*=6*/,
+												double nSigma/*=1.0*/,
+												GenericProgressCallback* progressCb/*=0*/)
+{
+	if (knn <= 1 || !graph.hasKnn(static_cast<unsigned>(knn-1)) || graph.size() <= static_cast<unsigned>(knn))
+	{
+		//invalid input
+		assert(false);
+		return 0;
+	}
+
+	std::vector<PointCoordinateType> meanDistances;
+	try
+	{
+		meanDistances.resize(graph.size(),0);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return 0;
+	}
+
+	//1st step: compute the average distance to the neighbors
+	unsigned neighborCount = static_cast<unsigned>(knn-1); //the point itself is not in the graph
+	void* additionalParameters[] = {reinterpret_cast<void*>(&neighborCount),
+									reinterpret_cast<void*>(&meanDistances)
+	};
+
+	if (!graph.executeFunctionForAllPoints(	&applySORFilterToPoints,
+											additionalParameters,
+											true,
+											progressCb,
+											"SOR filter"))
+	{
+		//something went wrong
+		return 0;
+	}
+
+	//2nd step: remove the farthest points 
+	return KeepPointsBelowMeanDistance(graph.associatedCloud(), meanDistances, nSigma);
+}
+
 ReferenceCloud* CloudSamplingTools::noiseFilter(GenericIndexedCloudPersist* inputCloud,
 												PointCoordinateType kernelRadius,
 												double nSigma,
@@ -666,6 +724,81 @@ ReferenceCloud* CloudSamplingTools::noiseFilter(GenericIndexedCloudPersist* inpu
 	return filteredCloud;
 }
 
+ReferenceCloud* CloudSamplingTools::noiseFilter(const NeighbourGraph& graph,
+												PointCoordinateType kernelRadius,
+												double nSigma,
+												bool removeIsolatedPoints/*=false*/,
+												bool useKnn/*=false*/,
+												int knn/*=6*/,
+												bool useAbsoluteError/*=true*/,
+												double absoluteError/*=0.0*/,
+												GenericProgressCallback* progressCb/*=0*/)
+{
+	if (	graph.size() < 2
+		||	(useKnn && (knn <= 0 || !graph.hasKnn(static_cast<unsigned>(knn-1))))
+		||	(!useKnn && (kernelRadius <= 0 || !graph.hasSphere(kernelRadius))) )
+	{
+		//invalid input
+		assert(false);
+		return 0;
+	}
+
+	unsigned pointCount = graph.size();
+
+	//whether each point is kept or not
+	std::vector<unsigned char> keptPoints;
+	try
+	{
+		keptPoints.resize(pointCount,0);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return 0;
+	}
+
+	//additional parameters
+	void* additionalParameters[] = {reinterpret_cast<void*>(&keptPoints),
+									reinterpret_cast<void*>(&kernelRadius),
+									reinterpret_cast<void*>(&nSigma),
+									reinterpret_cast<void*>(&removeIsolatedPoints),
+									reinterpret_cast<void*>(&useKnn),
+									reinterpret_cast<void*>(&knn),
+									reinterpret_cast<void*>(&useAbsoluteError),
+									reinterpret_cast<void*>(&absoluteError)
+	};
+
+	if (!graph.executeFunctionForAllPoints(	&applyNoiseFilterToPoints,
+											additionalParameters,
+											true,
+											progressCb,
+											"Noise filter"))
+	{
+		//something went wrong
+		return 0;
+	}
+
+	ReferenceCloud* filteredCloud = new ReferenceCloud(graph.associatedCloud());
+	if (!filteredCloud->reserve(pointCount))
+	{
+		//not enough memory
+		delete filteredCloud;
+		return 0;
+	}
+
+	for (unsigned i=0; i<pointCount; ++i)
+	{
+		if (keptPoints[i])
+		{
+			filteredCloud->addPointIndex(i);
+		}
+	}
+
+	filteredCloud->resize(filteredCloud->size());
+
+	return filteredCloud;
+}
+
 bool CloudSamplingTools::resampleCellAtLevel(	const DgmOctree::octreeCell& cell,
 												void** additionalParameters,
 												NormalizedProgress* nProgress/*=0*/)
@@ -740,6 +873,47 @@ bool CloudSamplingTools::subsampleCellAtLevel(	const DgmOctree::octreeCell& cell
 	return cloud->addPointIndex(cell.points->getPointGlobalIndex(selectedPointIndex));
 }
 
+//! Returns whether a point is close enough to the LS plane fitted on its neighbors (see CloudSamplingTools::noiseFilter)
+static bool IsCloseToLocalSurface(	GenericIndexedCloudPersist* neighboursCloud,
+									const CCVector3& queryPoint,
+									double nSigma,
+									bool useAbsoluteError,
+									double absoluteError)
+{
+	Neighbourhood Z(neighboursCloud);
+
+	const PointCoordinateType* lsPlane = Z.getLSPlane();
+	if (!lsPlane)
+	{
+		//TODO: ???
+		return false;
+	}
+
+	double maxD = absoluteError;
+	if (!useAbsoluteError)
+	{
+		//compute the std. dev. to this plane
+		unsigned realNeighborCount = neighboursCloud->size();
+		double sum_d = 0;
+		double sum_d2 = 0;
+		for (unsigned j=0; j<realNeighborCount; ++j)
+		{
+			const CCVector3* P = neighboursCloud->getPoint(j);
+			double d = CCLib::DistanceComputationTools::computePoint2PlaneDistance(P,lsPlane);
+			sum_d += d;
+			sum_d2 += d*d;
+		}
+
+		double stddev = sqrt(fabs(sum_d2*realNeighborCount - sum_d*sum_d))/realNeighborCount;
+		maxD = stddev * nSigma;
+	}
+
+	//distance from the query point to the plane
+	double d = fabs(CCLib::DistanceComputationTools::computePoint2PlaneDistance(&queryPoint,lsPlane));
+
+	return (d <= maxD);
+}
+
 bool CloudSamplingTools::applyNoiseFilterAtLevel(	const DgmOctree::octreeCell& cell,
 													void** additionalParameters,
 													NormalizedProgress* nProgress/*=0*/)
@@ -794,41 +968,9 @@ bool CloudSamplingTools::applyNoiseFilterAtLevel(	const DgmOctree::octreeCell& c
 				std::swap(nNSS.pointsInNeighbourhood[localIndex],nNSS.pointsInNeighbourhood[neighborCount-1]);
 			}
 
-			unsigned realNeighborCount = neighborCount-1;
-			DgmOctreeReferenceCloud neighboursCloud(&nNSS.pointsInNeighbourhood,realNeighborCount); //we don't take the query point into account!
-			Neighbourhood Z(&neighboursCloud);
-
-			const PointCoordinateType* lsPlane = Z.getLSPlane();
-			if (lsPlane)
-			{
-				double maxD = absoluteError;
-				if (!useAbsoluteError)
-				{
-					//compute the std. dev. to this plane
-					double sum_d = 0;
-					double sum_d2 = 0;
-					for (unsigned j=0; j<realNeighborCount; ++j)
-					{
-						const CCVector3* P = neighboursCloud.getPoint(j);
-						double d = CCLib::DistanceComputationTools::computePoint2PlaneDistance(P,lsPlane);
-						sum_d += d;
-						sum_d2 += d*d;
-					}
-
-					double stddev = sqrt(fabs(sum_d2*realNeighborCount - sum_d*sum_d))/realNeighborCount;
-					maxD = stddev * nSigma;
-				}
-
-				//distance from the query point to the plane
-				double d = fabs(CCLib::DistanceComputationTools::computePoint2PlaneDistance(&nNSS.queryPoint,lsPlane));
-
-				if (d <= maxD)
-					cloud->addPointIndex(globalIndex);
-			}
-			else
-			{
-				//TODO: ???
-			}
+			DgmOctreeReferenceCloud neighboursCloud(&nNSS.pointsInNeighbourhood,neighborCount-1); //we don't take the query point into account!
+			if (IsCloseToLocalSurface(&neighboursCloud, nNSS.queryPoint, nSigma, useAbsoluteError, absoluteError))
+				cloud->addPointIndex(globalIndex);
 		}
 		else
 		{
@@ -903,3 +1045,297 @@ bool CloudSamplingTools::applySORFilterAtLevel(	const DgmOctree::octreeCell& cel
 
 	return true;
 }
+
+bool CloudSamplingTools::applyNoiseFilterToPoints(	const NeighbourGraph& graph,
+													unsigned firstIndex,
+													unsigned lastIndex,
+													void** additionalParameters)
+{
+	std::vector<unsigned char>& keptPoints	= *static_cast<std::vector<unsigned char>*>(additionalParameters[0]);
+	PointCoordinateType kernelRadius		= *static_cast<PointCoordinateType*>(additionalParameters[1]);
+	double nSigma							= *static_cast<double*>(additionalParameters[2]);
+	bool removeIsolatedPoints				= *static_cast<bool*>(additionalParameters[3]);
+	bool useKnn								= *static_cast<bool*>(additionalParameters[4]);
+	int knn									= *static_cast<int*>(additionalParameters[5]);
+	bool useAbsoluteError					= *static_cast<bool*>(additionalParameters[6]);
+	double absoluteError					= *static_cast<double*>(additionalParameters[7]);
+
+	GenericIndexedCloudPersist* cloud = graph.associatedCloud();
+
+	//neighbours (the point itself excluded)
+	DgmOctree::NeighboursSet neighbours;
+	try
+	{
+		neighbours.reserve(useKnn ? static_cast<size_t>(knn) : 64);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return false;
+	}
+
+	for (unsigned i=firstIndex; i<lastIndex; ++i)
+	{
+		unsigned realNeighborCount = (useKnn ? std::min(static_cast<unsigned>(knn-1), graph.neighbourCount(i)) : graph.neighbourCountInSphere(i,kernelRadius));
+
+		if (realNeighborCount >= 3) //we want 3 points or more (other than the point itself!)
+		{
+			const unsigned* indexes = graph.neighbourIndexes(i);
+			const float* squareDistances = graph.neighbourSquareDistances(i);
+			try
+			{
+				neighbours.resize(realNeighborCount);
+			}
+			catch (const std::bad_alloc&)
+			{
+				//not enough memory
+				return false;
+			}
+			for (unsigned j=0; j<realNeighborCount; ++j)
+			{
+				neighbours[j] = DgmOctree::PointDescriptor(cloud->getPoint(indexes[j]), indexes[j], squareDistances[j]);
+			}
+
+			DgmOctreeReferenceCloud neighboursCloud(&neighbours,realNeighborCount);
+			keptPoints[i] = IsCloseToLocalSurface(&neighboursCloud, *cloud->getPoint(i), nSigma, useAbsoluteError, absoluteError) ? 1 : 0;
+		}
+		else
+		{
+			//not enough points to fit a plane AND compute distances to it
+			keptPoints[i] = removeIsolatedPoints ? 0 : 1;
+		}
+	}
+
+	return true;
+}
+
+bool CloudSamplingTools::applySORFilterToPoints(	const NeighbourGraph& graph,
+													unsigned firstIndex,
+													unsigned lastIndex,
+													void** additionalParameters)
+{
+	unsigned neighborCount							= *static_cast<unsigned*>(additionalParameters[0]);
+	std::vector<PointCoordinateType>& meanDistances	= *static_cast<std::vector<PointCoordinateType>*>(additionalParameters[1]);
+
+	for (unsigned i=firstIndex; i<lastIndex; ++i)
+	{
+		//the graph neighbours are sorted by increasing distance
+		const float* squareDistances = graph.neighbourSquareDistances(i);
+		double sumDist = 0;
+		for (unsigned j=0; j<neighborCount; ++j)
+		{
+			sumDist += sqrt(static_cast<double>(squareDistances[j]));
+		}
+
+		meanDistances[i] = static_cast<PointCoordinateType>(sumDist / neighborCount);
+	}
+
+	return true;
+}
+
+SpatialStreamSampler::SpatialStreamSampler(PointCoordinateType minDistance)
+	: m_minDistance(minDistance)
+{
+	assert(minDistance > 0);
+}
+
+SpatialStreamSampler::CellKey SpatialStreamSampler::ComputeCellKey(long long i, long long j, long long k)
+{
+	//21 bits per dimension: far away cells may share the same key (which is
+	//harmless, as the distances to their points are tested anyway)
+	static const CellKey c_mask = (1 << 21) - 1;
+	return	 (static_cast<CellKey>(i) & c_mask)
+		|	((static_cast<CellKey>(j) & c_mask) << 21)
+		|	((static_cast<CellKey>(k) & c_mask) << 42);
+}
+
+SpatialStreamSampler::Result SpatialStreamSampler::addPoint(const CCVector3& P, PointCoordinateType minDistance)
+{
+	if (minDistance < 0)
+		minDistance = 0;
+
+	//look for a kept point whose distance is too small in the neighbouring cells of each level
+	//(the points of a given level can't reach beyond the 27 cells around P)
+	double step = m_minDistance;
+	for (size_t level = 0; level < m_levels.size(); ++level, step *= 2)
+	{
+		const GridLevel& cells = m_levels[level];
+		if (cells.empty())
+			continue;
+
+		long long ci = static_cast<long long>(floor(P.x / step));
+		long long cj = static_cast<long long>(floor(P.y / step));
+		long long ck = static_cast<long long>(floor(P.z / step));
+
+		for (long long i=ci-1; i<=ci+1; ++i)
+		{
+			for (long long j=cj-1; j<=cj+1; ++j)
+			{
+				for (long long k=ck-1; k<=ck+1; ++k)
+				{
+					GridLevel::const_iterator it = cells.find(ComputeCellKey(i, j, k));
+					if (it == cells.end())
+						continue;
+
+					for (unsigned index = it->second; index != static_cast<unsigned>(-1); index = m_nextInCell[index])
+					{
+						double d2 = (m_points[index] - P).norm2d();
+						double r = m_distances[index];
+						if (d2 <= r*r)
+						{
+							return REJECTED;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	//the point is kept (in the first level whose cells are bigger than its distance)
+	size_t level = 0;
+	step = m_minDistance;
+	while (step < minDistance)
+	{
+		step *= 2;
+		++level;
+	}
+
+	try
+	{
+		if (level >= m_levels.size())
+			m_levels.resize(level + 1);
+
+		long long ci = static_cast<long long>(floor(P.x / step));
+		long long cj = static_cast<long long>(floor(P.y / step));
+		long long ck = static_cast<long long>(floor(P.z / step));
+
+		unsigned index = static_cast<unsigned>(m_points.size());
+		std::pair<GridLevel::iterator, bool> cell = m_levels[level].insert(std::make_pair(ComputeCellKey(ci, cj, ck), index));
+		m_points.push_back(P);
+		m_distances.push_back(minDistance);
+		m_nextInCell.push_back(cell.second ? static_cast<unsigned>(-1) : cell.first->second);
+		cell.first->second = index;
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory (we don't know how far we went)
+		clear();
+		return NOT_ENOUGH_MEMORY;
+	}
+
+	return KEPT;
+}
+
+ReferenceCloud* SpatialStreamSampler::addCloud(	GenericIndexedCloudPersist* chunk,
+												const CloudSamplingTools::SFModulationParams& modParams,
+												GenericProgressCallback* progressCb/*=0*/)
+{
+	assert(chunk);
+	unsigned pointCount = chunk->size();
+
+	ReferenceCloud* sampledCloud = new ReferenceCloud(chunk);
+	const unsigned c_reserveStep = 65536;
+	if (!sampledCloud->reserve(std::min(pointCount, c_reserveStep)))
+	{
+		delete sampledCloud;
+		return 0;
+	}
+
+	//progress notification
+	NormalizedProgress normProgress(progressCb, pointCount);
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
+		{
+			progressCb->setMethodTitle("Spatial resampling");
+			char buffer[256];
+			sprintf(buffer, "Points: %u\nMin dist.: %f", pointCount, m_minDistance);
+			progressCb->setInfo(buffer);
+		}
+		progressCb->update(0);
+		progressCb->start();
+	}
+
+	bool error = false;
+	for (unsigned i=0; i<pointCount; ++i)
+	{
+		//parameters modulation
+		PointCoordinateType minDistBetweenPoints = m_minDistance;
+		if (modParams.enabled)
+		{
+			ScalarType sfVal = chunk->getPointScalarValue(i);
+			if (ScalarField::ValidValue(sfVal))
+				minDistBetweenPoints = static_cast<PointCoordinateType>(sfVal * modParams.a + modParams.b);
+		}
+
+		Result result = addPoint(*chunk->getPoint(i), minDistBetweenPoints);
+		if (result == NOT_ENOUGH_MEMORY)
+		{
+			error = true;
+			break;
+		}
+		else if (result == KEPT)
+		{
+			if (	(sampledCloud->size() == sampledCloud->capacity() && !sampledCloud->reserve(sampledCloud->capacity() + c_reserveStep))
+				||	!sampledCloud->addPointIndex(i))
+			{
+				//not enough memory
+				error = true;
+				break;
+			}
+		}
+
+		//progress indicator
+		if (progressCb && !normProgress.oneStep())
+		{
+			//cancel process
+			error = true;
+			break;
+		}
+	}
+
+	//remove unnecessarily allocated memory
+	if (!error)
+	{
+		if (sampledCloud->capacity() > sampledCloud->size())
+			sampledCloud->resize(sampledCloud->size());
+	}
+	else
+	{
+		delete sampledCloud;
+		sampledCloud = 0;
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	return sampledCloud;
+}
+
+size_t SpatialStreamSampler::memoryUsage() const
+{
+	//approximate cost of a hash map node (key + value + next pointer + bucket)
+	static const size_t c_cellNodeSize = sizeof(CellKey) + sizeof(unsigned) + 2 * sizeof(void*);
+
+	size_t usage =	m_points.capacity() * sizeof(CCVector3)
+		+	m_distances.capacity() * sizeof(PointCoordinateType)
+		+	m_nextInCell.capacity() * sizeof(unsigned)
+		+	m_levels.capacity() * sizeof(GridLevel);
+
+	for (size_t i = 0; i < m_levels.size(); ++i)
+	{
+		usage += m_levels[i].size() * c_cellNodeSize;
+	}
+
+	return usage;
+}
+
+void SpatialStreamSampler::clear()
+{
+	m_points.clear();
+	m_distances.clear();
+	m_nextInCell.clear();
+	m_levels.clear();
+}
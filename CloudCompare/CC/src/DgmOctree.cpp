@@ -33,6 +33,10 @@
 #include <assert.h>
 #include <stdio.h>
 #include <set>
+#include <queue>
+#include <functional>
+#include <chrono>
+#include <limits>
 
 //DGM: tests in progress
 //#define COMPUTE_NN_SEARCH_STATISTICS
@@ -45,6 +49,24 @@
 #endif
 #endif
 
+#ifdef ENABLE_MT_OCTREE
+#include <QtConcurrentMap>
+#include <QThread>
+#endif
+
+//enables SIMD distances computation for the nearest neighbours search
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENABLE_SIMD_NN_SEARCH
+#endif
+
+#ifdef ENABLE_SIMD_NN_SEARCH
+#ifdef __AVX__
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+#endif
+
 using namespace CCLib;
 
 /**********************************/
@@ -183,6 +205,536 @@ bool DgmOctree::MultiThreadSupport()
 #endif
 }
 
+//! Current octree build algorithm
+static DgmOctree::BuildAlgorithm s_buildAlgorithm = DgmOctree::BUILD_PARALLEL_RADIX;
+
+void DgmOctree::SetBuildAlgorithm(BuildAlgorithm algo)
+{
+	s_buildAlgorithm = algo;
+}
+
+DgmOctree::BuildAlgorithm DgmOctree::GetBuildAlgorithm()
+{
+	return s_buildAlgorithm;
+}
+
+/**********************************/
+/*       OCTREE BUILD HELPERS     */
+/**********************************/
+
+//! Applies a function to a range of jobs (in parallel if possible)
+template<class Job> static void ProcessBuildJobs(Job* jobs, size_t count, void (*func)(Job&), bool multiThread)
+{
+#ifdef ENABLE_MT_OCTREE
+	if (multiThread && count > 1)
+	{
+		QtConcurrent::blockingMap(jobs, jobs + count, func);
+		return;
+	}
+#else
+	(void)multiThread;
+#endif
+	for (size_t i = 0; i < count; ++i)
+	{
+		func(jobs[i]);
+	}
+}
+
+//! Applies a function to a set of jobs (in parallel if possible)
+template<class Job> static void ProcessBuildJobs(std::vector<Job>& jobs, void (*func)(Job&), bool multiThread)
+{
+	if (!jobs.empty())
+	{
+		ProcessBuildJobs(&(jobs[0]), jobs.size(), func, multiThread);
+	}
+}
+
+//! Returns the number of jobs to use for a parallel process
+static unsigned BuildThreadCount(bool multiThread)
+{
+#ifdef ENABLE_MT_OCTREE
+	if (multiThread)
+	{
+		return static_cast<unsigned>(std::max(1, QThread::idealThreadCount()));
+	}
+#else
+	(void)multiThread;
+#endif
+	return 1;
+}
+
+//! Build timer (see DgmOctree::getLastBuildTimings)
+typedef std::chrono::steady_clock BuildClock;
+
+//! Returns the time elapsed since a given instant (in seconds)
+static double SecondsSince(const BuildClock::time_point& start)
+{
+	return std::chrono::duration<double>(BuildClock::now() - start).count();
+}
+
+//! Number of points per projection chunk (see DgmOctree::genericBuild)
+static const unsigned PROJECTION_CHUNK_SIZE = (1 << 16);
+
+//! Chunk of points to project in the octree (see DgmOctree::genericBuild)
+struct ProjectionChunk
+{
+	//! Octree
+	const DgmOctree* octree;
+	//! Cloud
+	GenericIndexedCloudPersist* cloud;
+	//! Accepted points box (min corner)
+	CCVector3 pointsMin;
+	//! Accepted points box (max corner)
+	CCVector3 pointsMax;
+	//! Output (the projected points are stored contiguously from here)
+	DgmOctree::IndexAndCode* output;
+	//! First point index
+	PointIndexType firstIndex;
+	//! Number of points in this chunk
+	PointIndexType count;
+	//! Number of points actually projected
+	PointIndexType projectedCount;
+	//! Min and max cell positions (at the deepest level)
+	int fillIndexes[6];
+};
+
+//! Computes the cell code of all the points of a chunk
+static void ProjectPointsChunk(ProjectionChunk& chunk)
+{
+	chunk.projectedCount = 0;
+
+	DgmOctree::IndexAndCode* it = chunk.output;
+	int* fillIndexes = chunk.fillIndexes;
+	const int maxLength = DgmOctree::MAX_OCTREE_LENGTH;
+
+	for (PointIndexType i = chunk.firstIndex; i < chunk.firstIndex + chunk.count; ++i)
+	{
+		const CCVector3* P = chunk.cloud->getPoint(i);
+
+		//does the point falls in the 'accepted points' box?
+		//(potentially different from the octree box - see DgmOctree::build)
+		if (	(P->x >= chunk.pointsMin[0]) && (P->x <= chunk.pointsMax[0])
+			&&	(P->y >= chunk.pointsMin[1]) && (P->y <= chunk.pointsMax[1])
+			&&	(P->z >= chunk.pointsMin[2]) && (P->z <= chunk.pointsMax[2]) )
+		{
+			//compute the position of the cell that includes this point
+			Tuple3i cellPos;
+			chunk.octree->getTheCellPosWhichIncludesThePoint(P, cellPos);
+
+			//clipping X
+			if (cellPos.x < 0)
+				cellPos.x = 0;
+			else if (cellPos.x >= maxLength)
+				cellPos.x = maxLength-1;
+			//clipping Y
+			if (cellPos.y < 0)
+				cellPos.y = 0;
+			else if (cellPos.y >= maxLength)
+				cellPos.y = maxLength-1;
+			//clipping Z
+			if (cellPos.z < 0)
+				cellPos.z = 0;
+			else if (cellPos.z >= maxLength)
+				cellPos.z = maxLength-1;
+
+			it->theIndex = i;
+			it->theCode = DgmOctree::GenerateTruncatedCellCode(cellPos, DgmOctree::MAX_OCTREE_LEVEL);
+
+			if (chunk.projectedCount)
+			{
+				if (fillIndexes[0] > cellPos.x)
+					fillIndexes[0] = cellPos.x;
+				else if (fillIndexes[3] < cellPos.x)
+					fillIndexes[3] = cellPos.x;
+
+				if (fillIndexes[1] > cellPos.y)
+					fillIndexes[1] = cellPos.y;
+				else if (fillIndexes[4] < cellPos.y)
+					fillIndexes[4] = cellPos.y;
+
+				if (fillIndexes[2] > cellPos.z)
+					fillIndexes[2] = cellPos.z;
+				else if (fillIndexes[5] < cellPos.z)
+					fillIndexes[5] = cellPos.z;
+			}
+			else
+			{
+				fillIndexes[0] = fillIndexes[3] = cellPos.x;
+				fillIndexes[1] = fillIndexes[4] = cellPos.y;
+				fillIndexes[2] = fillIndexes[5] = cellPos.z;
+			}
+
+			++it;
+			++chunk.projectedCount;
+		}
+	}
+}
+
+//! Radix sort: number of bits per digit
+static const unsigned RADIX_BITS = 11;
+//! Radix sort: number of buckets per digit
+static const unsigned RADIX_BUCKETS = (1 << RADIX_BITS);
+
+//! Block of cell codes processed by a single thread during the radix sort
+struct RadixSortBlock
+{
+	//! Source buffer (whole)
+	DgmOctree::IndexAndCode* src;
+	//! Destination buffer (whole)
+	DgmOctree::IndexAndCode* dst;
+	//! First element of the block (in 'src')
+	size_t begin;
+	//! Last element of the block + 1 (in 'src')
+	size_t end;
+	//! Current digit shift
+	unsigned char shift;
+	//! Bits that are set in all codes of the block
+	DgmOctree::CellCode andMask;
+	//! Bits that are set in at least one code of the block
+	DgmOctree::CellCode orMask;
+	//! Bucket counts (then write positions) for the current digit
+	size_t buckets[RADIX_BUCKETS];
+};
+
+//! Radix sort: computes the bits that vary inside a block
+static void RadixSortBlockMasks(RadixSortBlock& block)
+{
+	DgmOctree::CellCode andMask = ~static_cast<DgmOctree::CellCode>(0);
+	DgmOctree::CellCode orMask = 0;
+	for (size_t i = block.begin; i < block.end; ++i)
+	{
+		andMask &= block.src[i].theCode;
+		orMask |= block.src[i].theCode;
+	}
+	block.andMask = andMask;
+	block.orMask = orMask;
+}
+
+//! Radix sort: computes the histogram of the current digit for a block
+static void RadixSortBlockHistogram(RadixSortBlock& block)
+{
+	memset(block.buckets, 0, sizeof(size_t) * RADIX_BUCKETS);
+	for (size_t i = block.begin; i < block.end; ++i)
+	{
+		++block.buckets[(block.src[i].theCode >> block.shift) & (RADIX_BUCKETS - 1)];
+	}
+}
+
+//! Radix sort: moves the elements of a block at their position for the current digit
+static void RadixSortBlockScatter(RadixSortBlock& block)
+{
+	for (size_t i = block.begin; i < block.end; ++i)
+	{
+		const DgmOctree::IndexAndCode& ic = block.src[i];
+		block.dst[block.buckets[(ic.theCode >> block.shift) & (RADIX_BUCKETS - 1)]++] = ic;
+	}
+}
+
+//! Sorts the octree structure by ascending cell code order with a (parallel) LSD radix sort
+/** The sort is stable. Digits shared by all the codes are skipped.
+	\return false if there's not enough memory (nothing is changed in this case)
+**/
+static bool RadixSortCellCodes(DgmOctree::cellsContainer& codes, bool multiThread)
+{
+	size_t count = codes.size();
+	if (count < 2)
+	{
+		return true;
+	}
+
+	DgmOctree::cellsContainer buffer;
+	try
+	{
+		buffer.resize(count);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+
+	//split the structure in (roughly) equal blocks
+	unsigned blockCount = BuildThreadCount(multiThread);
+	if (blockCount > count / RADIX_BUCKETS)
+	{
+		blockCount = std::max<unsigned>(1, static_cast<unsigned>(count / RADIX_BUCKETS));
+	}
+	std::vector<RadixSortBlock> blocks;
+	try
+	{
+		blocks.resize(blockCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+	for (unsigned k = 0; k < blockCount; ++k)
+	{
+		blocks[k].begin = (count * k) / blockCount;
+		blocks[k].end = (count * (k + 1)) / blockCount;
+		blocks[k].src = &(codes[0]);
+		blocks[k].dst = &(buffer[0]);
+	}
+
+	//we look for the bits that actually vary (to skip the useless passes)
+	ProcessBuildJobs(blocks, RadixSortBlockMasks, multiThread);
+	DgmOctree::CellCode andMask = ~static_cast<DgmOctree::CellCode>(0);
+	DgmOctree::CellCode orMask = 0;
+	for (unsigned k = 0; k < blockCount; ++k)
+	{
+		andMask &= blocks[k].andMask;
+		orMask |= blocks[k].orMask;
+	}
+	const DgmOctree::CellCode varyingBits = (orMask & ~andMask);
+
+	const unsigned codeBits = 3 * DgmOctree::MAX_OCTREE_LEVEL;
+	bool sortedInBuffer = false;
+	for (unsigned shift = 0; shift < codeBits; shift += RADIX_BITS)
+	{
+		if (((varyingBits >> shift) & (RADIX_BUCKETS - 1)) == 0)
+		{
+			//all codes share the same digit
+			continue;
+		}
+
+		for (unsigned k = 0; k < blockCount; ++k)
+		{
+			blocks[k].shift = static_cast<unsigned char>(shift);
+		}
+		ProcessBuildJobs(blocks, RadixSortBlockHistogram, multiThread);
+
+		//convert the counts to write positions (bucket by bucket, then block by block, for stability)
+		size_t pos = 0;
+		for (unsigned b = 0; b < RADIX_BUCKETS; ++b)
+		{
+			for (unsigned k = 0; k < blockCount; ++k)
+			{
+				size_t n = blocks[k].buckets[b];
+				blocks[k].buckets[b] = pos;
+				pos += n;
+			}
+		}
+		assert(pos == count);
+
+		ProcessBuildJobs(blocks, RadixSortBlockScatter, multiThread);
+
+		//swap buffers
+		for (unsigned k = 0; k < blockCount; ++k)
+		{
+			std::swap(blocks[k].src, blocks[k].dst);
+		}
+		sortedInBuffer = !sortedInBuffer;
+	}
+
+	if (sortedInBuffer)
+	{
+		codes.swap(buffer);
+	}
+
+	return true;
+}
+
+//! External merge sort: max number of cell codes per run (i.e. sorted at once)
+static const size_t EXTERNAL_SORT_RUN_SIZE = (1 << 23);
+
+//! Run of cell codes sorted independently during the external merge sort
+struct ExternalSortRun
+{
+	//! First element
+	DgmOctree::IndexAndCode* begin;
+	//! Last element + 1
+	DgmOctree::IndexAndCode* end;
+};
+
+//! External merge sort: sorts a single run
+static void SortExternalSortRun(ExternalSortRun& run)
+{
+	std::sort(run.begin, run.end, DgmOctree::IndexAndCode::codeComp);
+}
+
+//! Sorts the octree structure by ascending cell code order with an external merge sort
+/** Dedicated to structures stored out-of-core: the codes are sorted by runs
+	(in place, so that only the pages of the runs being sorted are loaded)
+	that are then merged sequentially in a second out-of-core buffer.
+	Equal codes keep the order of their runs.
+	\return false if there's not enough memory (nothing is changed in this case)
+**/
+static bool ExternalMergeSortCellCodes(DgmOctree::cellsContainer& codes, bool multiThread)
+{
+	size_t count = codes.size();
+	if (count < 2)
+	{
+		return true;
+	}
+
+	//split the structure in runs
+	size_t runCount = (count + EXTERNAL_SORT_RUN_SIZE - 1) / EXTERNAL_SORT_RUN_SIZE;
+	std::vector<ExternalSortRun> runs;
+	try
+	{
+		runs.resize(runCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+	for (size_t k = 0; k < runCount; ++k)
+	{
+		runs[k].begin = &(codes[0]) + k * EXTERNAL_SORT_RUN_SIZE;
+		runs[k].end = &(codes[0]) + std::min(count, (k + 1) * EXTERNAL_SORT_RUN_SIZE);
+	}
+
+	if (runCount == 1)
+	{
+		SortExternalSortRun(runs.front());
+		return true;
+	}
+
+	//the merged structure will be stored out-of-core as well
+	DgmOctree::cellsContainer merged;
+	try
+	{
+		merged.resize(count);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return false;
+	}
+
+	ProcessBuildJobs(runs, SortExternalSortRun, multiThread);
+
+	//k-way merge of the sorted runs
+	typedef std::pair<DgmOctree::CellCode, size_t> RunHead; //code + run index
+	std::priority_queue< RunHead, std::vector<RunHead>, std::greater<RunHead> > heads;
+	for (size_t k = 0; k < runCount; ++k)
+	{
+		heads.push(RunHead(runs[k].begin->theCode, k));
+	}
+
+	DgmOctree::IndexAndCode* out = &(merged[0]);
+	while (!heads.empty())
+	{
+		ExternalSortRun& run = runs[heads.top().second];
+		heads.pop();
+
+		//copy all the elements of this run with the same code at once
+		DgmOctree::CellCode code = run.begin->theCode;
+		do
+		{
+			*out++ = *run.begin++;
+		}
+		while (run.begin != run.end && run.begin->theCode == code);
+
+		if (run.begin != run.end)
+		{
+			heads.push(RunHead(run.begin->theCode, static_cast<size_t>(&run - &(runs[0]))));
+		}
+	}
+	assert(out == &(merged[0]) + count);
+
+	codes.swap(merged);
+
+	return true;
+}
+
+/**********************************/
+/*   NEAREST NEIGHBOURS KERNELS   */
+/**********************************/
+
+//The squared distances are always computed exactly as CCVector3::norm2d does (i.e. coordinates
+//difference in single precision, then sum of the squares in double precision from X to Z) so that
+//the SIMD and scalar versions give the very same results.
+
+//! Number of points processed at once when scanning a whole octree cell
+static const unsigned NN_DISTANCES_BLOCK_SIZE = 64;
+
+#ifdef ENABLE_SIMD_NN_SEARCH
+//! Computes the squared norms of 4 vectors (given as coordinates differences)
+static inline void StoreSquareNorms4(__m128 dx, __m128 dy, __m128 dz, double* out)
+{
+#ifdef __AVX__
+	__m256d x = _mm256_cvtps_pd(dx);
+	__m256d y = _mm256_cvtps_pd(dy);
+	__m256d z = _mm256_cvtps_pd(dz);
+	_mm256_storeu_pd(out, _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, x), _mm256_mul_pd(y, y)), _mm256_mul_pd(z, z)));
+#else
+	__m128d x = _mm_cvtps_pd(dx);
+	__m128d y = _mm_cvtps_pd(dy);
+	__m128d z = _mm_cvtps_pd(dz);
+	_mm_storeu_pd(out, _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y)), _mm_mul_pd(z, z)));
+	x = _mm_cvtps_pd(_mm_movehl_ps(dx, dx));
+	y = _mm_cvtps_pd(_mm_movehl_ps(dy, dy));
+	z = _mm_cvtps_pd(_mm_movehl_ps(dz, dz));
+	_mm_storeu_pd(out + 2, _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, x), _mm_mul_pd(y, y)), _mm_mul_pd(z, z)));
+#endif
+}
+#endif
+
+//! Computes the squared distances between a query point and contiguous points (structure of arrays)
+static void ComputeSquareDistances(	const PointCoordinateType* x,
+									const PointCoordinateType* y,
+									const PointCoordinateType* z,
+									unsigned count,
+									const CCVector3& Q,
+									double* squareDists)
+{
+	unsigned i = 0;
+#ifdef ENABLE_SIMD_NN_SEARCH
+	const __m128 qx = _mm_set1_ps(Q.x);
+	const __m128 qy = _mm_set1_ps(Q.y);
+	const __m128 qz = _mm_set1_ps(Q.z);
+	for (; i + 4 <= count; i += 4)
+	{
+		StoreSquareNorms4(	_mm_sub_ps(_mm_loadu_ps(x + i), qx),
+							_mm_sub_ps(_mm_loadu_ps(y + i), qy),
+							_mm_sub_ps(_mm_loadu_ps(z + i), qz),
+							squareDists + i);
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		squareDists[i] = CCVector3(x[i] - Q.x, y[i] - Q.y, z[i] - Q.z).norm2d();
+	}
+}
+
+//! Computes the squared distances between a query point and a set of neighbours (starting from a given index)
+static void ComputeSquareDistances(DgmOctree::NeighboursSet& neighbours, size_t firstIndex, const CCVector3& Q)
+{
+	size_t count = neighbours.size();
+	if (firstIndex >= count)
+	{
+		return;
+	}
+	DgmOctree::PointDescriptor* p = &(neighbours[0]);
+
+	size_t i = firstIndex;
+#ifdef ENABLE_SIMD_NN_SEARCH
+	const __m128 qx = _mm_set1_ps(Q.x);
+	const __m128 qy = _mm_set1_ps(Q.y);
+	const __m128 qz = _mm_set1_ps(Q.z);
+	double squareDists[4];
+	for (; i + 4 <= count; i += 4)
+	{
+		//gather the coordinates of 4 points at once
+		const CCVector3* A = p[i].point;
+		const CCVector3* B = p[i + 1].point;
+		const CCVector3* C = p[i + 2].point;
+		const CCVector3* D = p[i + 3].point;
+		StoreSquareNorms4(	_mm_sub_ps(_mm_setr_ps(A->x, B->x, C->x, D->x), qx),
+							_mm_sub_ps(_mm_setr_ps(A->y, B->y, C->y, D->y), qy),
+							_mm_sub_ps(_mm_setr_ps(A->z, B->z, C->z, D->z), qz),
+							squareDists);
+		p[i].squareDistd = squareDists[0];
+		p[i + 1].squareDistd = squareDists[1];
+		p[i + 2].squareDistd = squareDists[2];
+		p[i + 3].squareDistd = squareDists[3];
+	}
+#endif
+	for (; i < count; ++i)
+	{
+		p[i].squareDistd = (*p[i].point - Q).norm2d();
+	}
+}
+
 /**********************************/
 /*        EVERYTHING ELSE!        */
 /**********************************/
@@ -208,6 +760,8 @@ void DgmOctree::clear()
 	m_numberOfProjectedPoints = 0;
 	m_thePointsAndTheirCellCodes.clear();
 
+	releaseSortedPointsCoordinates();
+
 	memset(m_fillIndexes, 0, sizeof(int)*(MAX_OCTREE_LEVEL + 1) * 6);
 	memset(m_cellSize, 0, sizeof(PointCoordinateType)*(MAX_OCTREE_LEVEL + 2));
 	updateCellCountTable();
@@ -244,12 +798,22 @@ int DgmOctree::build(	const CCVector3& octreeMin,
 
 int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
 {
-	unsigned pointCount = (m_theAssociatedCloud ? m_theAssociatedCloud->size() : 0);
+	m_lastBuildTimings = BuildTimings();
+	BuildClock::time_point buildStart = BuildClock::now();
+
+	PointIndexType pointCount = (m_theAssociatedCloud ? m_theAssociatedCloud->size() : 0);
 	if (pointCount == 0)
 	{
 		//no cloud/point?!
 		return -1;
 	}
+#ifdef CC_64BITS_POINT_INDEXES
+	if (pointCount > std::numeric_limits<unsigned>::max())
+	{
+		//the cells are still scanned with 32 bits indexes (and the number of points is returned as an int)
+		return -1;
+	}
+#endif
 
 	//allocate memory
 	try
@@ -272,88 +836,100 @@ int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
 		{
 			progressCb->setMethodTitle("Build Octree");
 			char infosBuffer[256];
-			sprintf(infosBuffer, "Projecting %u points\nMax. depth: %i", pointCount, MAX_OCTREE_LEVEL);
+			sprintf(infosBuffer, "Projecting %u points\nMax. depth: %i", static_cast<unsigned>(pointCount), MAX_OCTREE_LEVEL);
 			progressCb->setInfo(infosBuffer);
 		}
 		progressCb->update(0);
 		progressCb->start();
 	}
-	NormalizedProgress nprogress(progressCb, pointCount, 90); //first phase: 90% (we keep 10% for sort)
 
-	//fill indexes table (we'll fill the max. level, then deduce the others from this one)
-	int* fillIndexesAtMaxLevel = m_fillIndexes + (MAX_OCTREE_LEVEL * 6);
+	bool parallelBuild = (s_buildAlgorithm == BUILD_PARALLEL_RADIX);
 
-	//for all points
-	cellsContainer::iterator it = m_thePointsAndTheirCellCodes.begin();
-	for (unsigned i=0; i<pointCount; i++)
+	//we split the cloud in chunks (processed in parallel if possible)
+	std::vector<ProjectionChunk> chunks;
+	try
 	{
-		const CCVector3* P = m_theAssociatedCloud->getPoint(i);
-
-		//does the point falls in the 'accepted points' box?
-		//(potentially different from the octree box - see DgmOctree::build)
-		if (	(P->x >= m_pointsMin[0]) && (P->x <= m_pointsMax[0])
-			&&	(P->y >= m_pointsMin[1]) && (P->y <= m_pointsMax[1])
-			&&	(P->z >= m_pointsMin[2]) && (P->z <= m_pointsMax[2]) )
-		{
-			//compute the position of the cell that includes this point
-			Tuple3i cellPos;
-			getTheCellPosWhichIncludesThePoint(P, cellPos);
+		chunks.resize((pointCount + PROJECTION_CHUNK_SIZE - 1) / PROJECTION_CHUNK_SIZE);
+	}
+	catch (const std::bad_alloc&) //out of memory
+	{
+		m_thePointsAndTheirCellCodes.clear();
+		if (progressCb)
+			progressCb->stop();
+		return -1;
+	}
+	NormalizedProgress nprogress(progressCb, static_cast<unsigned>(chunks.size()), 90); //first phase: 90% (we keep 10% for sort)
 
-			//clipping X
-			if (cellPos.x < 0)
-				cellPos.x = 0;
-			else if (cellPos.x >= MAX_OCTREE_LENGTH)
-				cellPos.x = MAX_OCTREE_LENGTH-1;
-			//clipping Y
-			if (cellPos.y < 0)
-				cellPos.y = 0;
-			else if (cellPos.y >= MAX_OCTREE_LENGTH)
-				cellPos.y = MAX_OCTREE_LENGTH-1;
-			//clipping Z
-			if (cellPos.z < 0)
-				cellPos.z = 0;
-			else if (cellPos.z >= MAX_OCTREE_LENGTH)
-				cellPos.z = MAX_OCTREE_LENGTH-1;
+	for (size_t k = 0; k < chunks.size(); ++k)
+	{
+		ProjectionChunk& chunk = chunks[k];
+		chunk.octree = this;
+		chunk.cloud = m_theAssociatedCloud;
+		chunk.pointsMin = m_pointsMin;
+		chunk.pointsMax = m_pointsMax;
+		chunk.firstIndex = static_cast<PointIndexType>(k * PROJECTION_CHUNK_SIZE);
+		chunk.count = std::min<PointIndexType>(PROJECTION_CHUNK_SIZE, pointCount - chunk.firstIndex);
+		chunk.output = &(m_thePointsAndTheirCellCodes[chunk.firstIndex]);
+		chunk.projectedCount = 0;
+	}
 
-			it->theIndex = i;
-			it->theCode = GenerateTruncatedCellCode(cellPos, MAX_OCTREE_LEVEL);
+	//for all points (by groups of chunks, so that the progress is only notified by this thread)
+	BuildClock::time_point phaseStart = BuildClock::now();
+	const size_t chunksPerGroup = (progressCb ? static_cast<size_t>(BuildThreadCount(parallelBuild)) * 4 : chunks.size());
+	for (size_t firstChunk = 0; firstChunk < chunks.size(); firstChunk += chunksPerGroup)
+	{
+		size_t groupSize = std::min(chunksPerGroup, chunks.size() - firstChunk);
+		ProcessBuildJobs(&(chunks[firstChunk]), groupSize, ProjectPointsChunk, parallelBuild);
 
-			if (m_numberOfProjectedPoints)
-			{
-				if (fillIndexesAtMaxLevel[0] > cellPos.x)
-					fillIndexesAtMaxLevel[0] = cellPos.x;
-				else if (fillIndexesAtMaxLevel[3] < cellPos.x)
-					fillIndexesAtMaxLevel[3] = cellPos.x;
-
-				if (fillIndexesAtMaxLevel[1] > cellPos.y)
-					fillIndexesAtMaxLevel[1] = cellPos.y;
-				else if (fillIndexesAtMaxLevel[4] < cellPos.y)
-					fillIndexesAtMaxLevel[4] = cellPos.y;
-
-				if (fillIndexesAtMaxLevel[2] > cellPos.z)
-					fillIndexesAtMaxLevel[2] = cellPos.z;
-				else if (fillIndexesAtMaxLevel[5] < cellPos.z)
-					fillIndexesAtMaxLevel[5] = cellPos.z;
-			}
-			else
+		for (size_t k = 0; k < groupSize; ++k)
+		{
+			if (!nprogress.oneStep())
 			{
-				fillIndexesAtMaxLevel[0] = fillIndexesAtMaxLevel[3] = cellPos.x;
-				fillIndexesAtMaxLevel[1] = fillIndexesAtMaxLevel[4] = cellPos.y;
-				fillIndexesAtMaxLevel[2] = fillIndexesAtMaxLevel[5] = cellPos.z;
+				//process canceled by the user
+				m_thePointsAndTheirCellCodes.clear();
+				m_numberOfProjectedPoints = 0;
+				progressCb->stop();
+				return 0;
 			}
+		}
+	}
 
-			++it;
-			++m_numberOfProjectedPoints;
+	//fill indexes table (we'll fill the max. level, then deduce the others from this one)
+	int* fillIndexesAtMaxLevel = m_fillIndexes + (MAX_OCTREE_LEVEL * 6);
+
+	//merge the chunks (the projected points must be contiguous)
+	for (size_t k = 0; k < chunks.size(); ++k)
+	{
+		const ProjectionChunk& chunk = chunks[k];
+		if (chunk.projectedCount == 0)
+			continue;
+
+		if (m_numberOfProjectedPoints != chunk.firstIndex)
+		{
+			assert(m_numberOfProjectedPoints < chunk.firstIndex);
+			std::copy(	chunk.output,
+						chunk.output + chunk.projectedCount,
+						m_thePointsAndTheirCellCodes.begin() + m_numberOfProjectedPoints);
 		}
 
-		if (!nprogress.oneStep())
+		if (m_numberOfProjectedPoints)
 		{
-			m_thePointsAndTheirCellCodes.clear();
-			m_numberOfProjectedPoints = 0;
-			progressCb->stop();
-			return 0;
+			for (int dim = 0; dim < 3; ++dim)
+			{
+				if (fillIndexesAtMaxLevel[dim] > chunk.fillIndexes[dim])
+					fillIndexesAtMaxLevel[dim] = chunk.fillIndexes[dim];
+				if (fillIndexesAtMaxLevel[dim + 3] < chunk.fillIndexes[dim + 3])
+					fillIndexesAtMaxLevel[dim + 3] = chunk.fillIndexes[dim + 3];
+			}
+		}
+		else
+		{
+			memcpy(fillIndexesAtMaxLevel, chunk.fillIndexes, sizeof(int) * 6);
 		}
+
+		m_numberOfProjectedPoints += chunk.projectedCount;
 	}
+	chunks.clear();
 
 	//we deduce the lower levels 'fill indexes' from the highest level
 	{
@@ -375,11 +951,29 @@ int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
 		progressCb->setInfo("Sorting cells...");
 	}
 
+	m_lastBuildTimings.projectionTime_s = SecondsSince(phaseStart);
+
 	//we sort the 'cells' by ascending code order
-	SortAlgo(m_thePointsAndTheirCellCodes.begin(), m_thePointsAndTheirCellCodes.end(), IndexAndCode::codeComp);
+	phaseStart = BuildClock::now();
+	bool sorted = false;
+	if (OutOfCoreStorage::ShouldBeUsed(m_thePointsAndTheirCellCodes.size() * sizeof(IndexAndCode)))
+	{
+		//out-of-core structure: external merge sort
+		sorted = ExternalMergeSortCellCodes(m_thePointsAndTheirCellCodes, parallelBuild);
+	}
+	if (!sorted && (!parallelBuild || !RadixSortCellCodes(m_thePointsAndTheirCellCodes, true)))
+	{
+		SortAlgo(m_thePointsAndTheirCellCodes.begin(), m_thePointsAndTheirCellCodes.end(), IndexAndCode::codeComp);
+	}
+
+	m_lastBuildTimings.sortTime_s = SecondsSince(phaseStart);
 
 	//update the pre-computed 'number of cells per level of subdivision' array
+	phaseStart = BuildClock::now();
 	updateCellCountTable();
+	m_lastBuildTimings.statisticsTime_s = SecondsSince(phaseStart);
+
+	m_lastBuildTimings.totalTime_s = SecondsSince(buildStart);
 
 	//end of process notification
 	if (progressCb)
@@ -389,14 +983,14 @@ int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
 			char buffer[256];
 			if (m_numberOfProjectedPoints == pointCount)
 			{
-				sprintf(buffer, "[Octree::build] Octree successfully built... %u points (ok)!", m_numberOfProjectedPoints);
+				sprintf(buffer, "[Octree::build] Octree successfully built... %u points (ok)!", static_cast<unsigned>(m_numberOfProjectedPoints));
 			}
 			else
 			{
 				if (m_numberOfProjectedPoints == 0)
 					sprintf(buffer, "[Octree::build] Warning : no point projected in the Octree!");
 				else
-					sprintf(buffer, "[Octree::build] Warning: some points have been filtered out (%u/%u)", pointCount - m_numberOfProjectedPoints, pointCount);
+					sprintf(buffer, "[Octree::build] Warning: some points have been filtered out (%u/%u)", static_cast<unsigned>(pointCount - m_numberOfProjectedPoints), static_cast<unsigned>(pointCount));
 			}
 			progressCb->setInfo(buffer);
 		}
@@ -409,6 +1003,41 @@ int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
 	return static_cast<int>(m_numberOfProjectedPoints);
 }
 
+bool DgmOctree::updateSortedPointsCoordinates()
+{
+	try
+	{
+		for (int dim = 0; dim < 3; ++dim)
+		{
+			m_sortedPointsCoordinates[dim].resize(m_numberOfProjectedPoints);
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory: the nearest neighbours search will use the cloud points directly
+		releaseSortedPointsCoordinates();
+		return false;
+	}
+
+	for (PointIndexType i = 0; i < m_numberOfProjectedPoints; ++i)
+	{
+		const CCVector3* P = m_theAssociatedCloud->getPointPersistentPtr(m_thePointsAndTheirCellCodes[i].theIndex);
+		m_sortedPointsCoordinates[0][i] = P->x;
+		m_sortedPointsCoordinates[1][i] = P->y;
+		m_sortedPointsCoordinates[2][i] = P->z;
+	}
+
+	return true;
+}
+
+void DgmOctree::releaseSortedPointsCoordinates()
+{
+	for (int dim = 0; dim < 3; ++dim)
+	{
+		std::vector<PointCoordinateType, OutOfCoreAllocator<PointCoordinateType> >().swap(m_sortedPointsCoordinates[dim]);
+	}
+}
+
 void DgmOctree::updateMinAndMaxTables()
 {
 	if (!m_theAssociatedCloud)
@@ -434,84 +1063,166 @@ void DgmOctree::updateCellSizeTable()
 	}
 }
 
-void DgmOctree::updateCellCountTable()
+//! Block of the sorted octree structure scanned by a single thread to compute the cells statistics
+/** Cell boundaries are detected between consecutive elements, for all levels at once:
+	if two consecutive codes differ at a given level, they differ at all deeper levels.
+	Only the cells fully included in a block are accounted for here. The cells that
+	straddle two blocks are deduced afterwards from the first and last boundaries.
+**/
+struct CellsStatisticsBlock
+{
+	//! Octree structure (whole)
+	const DgmOctree::IndexAndCode* codes;
+	//! First element of the block (a boundary at 'i' means that element 'i' starts a new cell)
+	size_t begin;
+	//! Last element of the block + 1
+	size_t end;
+	//! Number of boundaries inside the block (per level)
+	unsigned boundaryCount[DgmOctree::MAX_OCTREE_LEVEL + 1];
+	//! First boundary inside the block (per level)
+	size_t firstBoundary[DgmOctree::MAX_OCTREE_LEVEL + 1];
+	//! Last boundary inside the block (per level)
+	size_t lastBoundary[DgmOctree::MAX_OCTREE_LEVEL + 1];
+	//! Max population of the cells fully included in the block (per level)
+	unsigned maxPop[DgmOctree::MAX_OCTREE_LEVEL + 1];
+	//! Sum of the populations of the cells fully included in the block (per level)
+	double sum[DgmOctree::MAX_OCTREE_LEVEL + 1];
+	//! Sum of the squared populations of the cells fully included in the block (per level)
+	double sum2[DgmOctree::MAX_OCTREE_LEVEL + 1];
+};
+
+//! Cells statistics: scans a block of the sorted octree structure
+static void ScanCellsStatisticsBlock(CellsStatisticsBlock& block)
 {
-	//level 0 is just the octree bounding-box
-	for (unsigned char i=0; i<=MAX_OCTREE_LEVEL; ++i)
+	const unsigned char maxLevel = static_cast<unsigned char>(DgmOctree::MAX_OCTREE_LEVEL);
+	memset(block.boundaryCount, 0, sizeof(unsigned) * (maxLevel + 1));
+	memset(block.maxPop, 0, sizeof(unsigned) * (maxLevel + 1));
+	memset(block.sum, 0, sizeof(double) * (maxLevel + 1));
+	memset(block.sum2, 0, sizeof(double) * (maxLevel + 1));
+
+	for (size_t i = block.begin; i < block.end; ++i)
 	{
-		computeCellsStatistics(i);
+		DgmOctree::CellCode diff = (block.codes[i - 1].theCode ^ block.codes[i].theCode);
+		if (diff == 0)
+			continue;
+
+		//look for the first level at which the two codes differ
+		unsigned char firstLevel = maxLevel;
+		while (firstLevel > 1 && (diff >> DgmOctree::GET_BIT_SHIFT(firstLevel - 1)) != 0)
+			--firstLevel;
+
+		for (unsigned char level = firstLevel; level <= maxLevel; ++level)
+		{
+			if (block.boundaryCount[level])
+			{
+				unsigned pop = static_cast<unsigned>(i - block.lastBoundary[level]);
+				if (block.maxPop[level] < pop)
+					block.maxPop[level] = pop;
+				block.sum[level] += static_cast<double>(pop);
+				block.sum2[level] += static_cast<double>(pop) * static_cast<double>(pop);
+			}
+			else
+			{
+				block.firstBoundary[level] = i;
+			}
+			block.lastBoundary[level] = i;
+			++block.boundaryCount[level];
+		}
 	}
 }
 
-void DgmOctree::computeCellsStatistics(unsigned char level)
+void DgmOctree::updateCellCountTable()
 {
-	assert(level <= MAX_OCTREE_LEVEL);
-
 	//empty octree case?!
 	if (m_thePointsAndTheirCellCodes.empty())
 	{
 		//DGM: we make as if there were 1 point to avoid some degenerated cases!
-		m_cellCount[level] = 1;
-		m_maxCellPopulation[level] = 1;
-		m_averageCellPopulation[level] = 1.0;
-		m_stdDevCellPopulation[level] = 0.0;
+		for (int level = 0; level <= MAX_OCTREE_LEVEL; ++level)
+		{
+			m_cellCount[level] = 1;
+			m_maxCellPopulation[level] = 1;
+			m_averageCellPopulation[level] = 1.0;
+			m_stdDevCellPopulation[level] = 0.0;
+		}
 		return;
 	}
 
+	size_t count = m_thePointsAndTheirCellCodes.size();
+
 	//level '0' specific case
-	if (level == 0)
+	m_cellCount[0] = 1;
+	m_maxCellPopulation[0] = static_cast<unsigned>(count);
+	m_averageCellPopulation[0] = static_cast<double>(count);
+	m_stdDevCellPopulation[0] = 0.0;
+
+	//single pass over the sorted codes for all the other levels (split in blocks)
+	bool multiThread = (s_buildAlgorithm == BUILD_PARALLEL_RADIX);
+	unsigned blockCount = std::max<unsigned>(1, std::min<unsigned>(BuildThreadCount(multiThread), static_cast<unsigned>(count / PROJECTION_CHUNK_SIZE)));
+	std::vector<CellsStatisticsBlock> blocks;
+	try
 	{
-		m_cellCount[level] = 1;
-		m_maxCellPopulation[level] = static_cast<unsigned>(m_thePointsAndTheirCellCodes.size());
-		m_averageCellPopulation[level] = static_cast<double>(m_thePointsAndTheirCellCodes.size());
-		m_stdDevCellPopulation[level] = 0.0;
-		return;
+		blocks.resize(blockCount);
 	}
+	catch (const std::bad_alloc&)
+	{
+		//we'll do it sequentially
+		blocks.resize(1);
+		blockCount = 1;
+	}
+	for (unsigned k = 0; k < blockCount; ++k)
+	{
+		blocks[k].codes = &(m_thePointsAndTheirCellCodes[0]);
+		blocks[k].begin = std::max<size_t>(1, (count * k) / blockCount);
+		blocks[k].end = (count * (k + 1)) / blockCount;
+	}
+	ProcessBuildJobs(blocks, ScanCellsStatisticsBlock, multiThread);
 
-	//binary shift for cell code truncation
-	unsigned char bitDec = GET_BIT_SHIFT(level);
-
-	//iterator on octree elements
-	cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
-
-	//we init scan with first element
-	CellCode predCode = (p->theCode >> bitDec);
-	unsigned counter = 0;
-	unsigned cellCounter = 0;
-	unsigned maxCellPop = 0;
-	double sum = 0.0, sum2 = 0.0;
-
-	for (; p != m_thePointsAndTheirCellCodes.end(); ++p)
+	//merge the blocks statistics (the cells straddling two blocks are closed here)
+	for (int level = 1; level <= MAX_OCTREE_LEVEL; ++level)
 	{
-		CellCode currentCode = (p->theCode >> bitDec);
-		if (predCode != currentCode)
+		unsigned cellCount = 0;
+		unsigned maxCellPop = 0;
+		double sum = 0.0, sum2 = 0.0;
+		size_t cellStart = 0;
+
+		for (unsigned k = 0; k <= blockCount; ++k)
 		{
-			sum += static_cast<double>(cellCounter);
-			sum2 += static_cast<double>(cellCounter) * static_cast<double>(cellCounter);
+			size_t cellEnd = count;
+			if (k < blockCount)
+			{
+				const CellsStatisticsBlock& block = blocks[k];
+				if (block.boundaryCount[level] == 0)
+					continue;
+				cellEnd = block.firstBoundary[level];
+			}
 
-			if (maxCellPop<cellCounter)
-				maxCellPop = cellCounter;
+			//close the current cell
+			unsigned pop = static_cast<unsigned>(cellEnd - cellStart);
+			if (maxCellPop < pop)
+				maxCellPop = pop;
+			sum += static_cast<double>(pop);
+			sum2 += static_cast<double>(pop) * static_cast<double>(pop);
+			++cellCount;
 
-			//new cell
-			predCode = currentCode;
-			cellCounter = 0;
-			++counter;
+			if (k < blockCount)
+			{
+				//add the cells fully included in the block
+				const CellsStatisticsBlock& block = blocks[k];
+				if (maxCellPop < block.maxPop[level])
+					maxCellPop = block.maxPop[level];
+				sum += block.sum[level];
+				sum2 += block.sum2[level];
+				cellCount += block.boundaryCount[level] - 1;
+				cellStart = block.lastBoundary[level];
+			}
 		}
-		++cellCounter;
-	}
 
-	//don't forget last cell!
-	sum += static_cast<double>(cellCounter);
-	sum2 += static_cast<double>(cellCounter) * static_cast<double>(cellCounter);
-	if (maxCellPop < cellCounter)
-		maxCellPop = cellCounter;
-	++counter;
-
-	assert(counter > 0);
-	m_cellCount[level] = counter;
-	m_maxCellPopulation[level] = maxCellPop;
-	m_averageCellPopulation[level] = sum/static_cast<double>(counter);
-	m_stdDevCellPopulation[level] = sqrt(sum2/static_cast<double>(counter) - m_averageCellPopulation[level]*m_averageCellPopulation[level]);
+		assert(cellCount > 0);
+		m_cellCount[level] = cellCount;
+		m_maxCellPopulation[level] = maxCellPop;
+		m_averageCellPopulation[level] = sum / static_cast<double>(cellCount);
+		m_stdDevCellPopulation[level] = sqrt(sum2 / static_cast<double>(cellCount) - m_averageCellPopulation[level] * m_averageCellPopulation[level]);
+	}
 }
 
 void DgmOctree::getBoundingBox(CCVector3& bbMin, CCVector3& bbMax) const
@@ -571,7 +1282,7 @@ bool DgmOctree::getPointsInCell(CellCode cellCode,
 		cellCode >>= bitDec;
 	}
 
-	unsigned cellIndex = getCellIndex(cellCode, bitDec);
+	PointIndexType cellIndex = getCellIndex(cellCode, bitDec);
 	//check that cell exists!
 	if (cellIndex < m_numberOfProjectedPoints)
 	{
@@ -585,15 +1296,15 @@ bool DgmOctree::getPointsInCell(CellCode cellCode,
 	return true;
 }
 
-unsigned DgmOctree::getCellIndex(CellCode truncatedCellCode, unsigned char bitDec) const
+PointIndexType DgmOctree::getCellIndex(CellCode truncatedCellCode, unsigned char bitDec) const
 {
 	//inspired from the algorithm proposed by MATT PULVER (see http://eigenjoy.com/2011/01/21/worlds-fastest-binary-search/)
 	//DGM:	it's not faster, but the code is simpler ;)
-	unsigned i = 0;
-	unsigned b = (1 << static_cast<int>( log(static_cast<double>(m_numberOfProjectedPoints-1)) / LOG_NAT_2 ));
+	PointIndexType i = 0;
+	PointIndexType b = (static_cast<PointIndexType>(1) << static_cast<int>( log(static_cast<double>(m_numberOfProjectedPoints-1)) / LOG_NAT_2 ));
 	for ( ; b ; b >>= 1 )
 	{
-		unsigned j = i | b;
+		PointIndexType j = i | b;
 		if ( j < m_numberOfProjectedPoints)
 		{
 			CellCode middleCode = (m_thePointsAndTheirCellCodes[j].theCode >> bitDec);
@@ -625,7 +1336,7 @@ static double s_binarySearchCount = 0.0;
 #endif
 
 #ifdef ADAPTATIVE_BINARY_SEARCH
-unsigned DgmOctree::getCellIndex(CellCode truncatedCellCode, unsigned char bitDec, unsigned begin, unsigned end) const
+PointIndexType DgmOctree::getCellIndex(CellCode truncatedCellCode, unsigned char bitDec, PointIndexType begin, PointIndexType end) const
 {
 	assert(truncatedCellCode != INVALID_CELL_CODE);
 	assert(end >= begin);
@@ -651,7 +1362,7 @@ unsigned DgmOctree::getCellIndex(CellCode truncatedCellCode, unsigned char bitDe
 	while (true)
 	{
 		float centralPoint = 0.5f + 0.75f*(static_cast<float>(truncatedCellCode-beginCode)/(-0.5f)); //0.75 = speed coef (empirical)
-		unsigned middle = begin + static_cast<unsigned>(centralPoint*float(end-begin));
+		PointIndexType middle = begin + static_cast<PointIndexType>(centralPoint*float(end-begin));
 		CellCode middleCode = (m_thePointsAndTheirCellCodes[middle].theCode >> bitDec);
 
 		if (middleCode < truncatedCellCode)
@@ -692,7 +1403,7 @@ unsigned DgmOctree::getCellIndex(CellCode truncatedCellCode, unsigned char bitDe
 
 #else
 
-unsigned DgmOctree::getCellIndex(CellCode truncatedCellCode, unsigned char bitDec, unsigned begin, unsigned end) const
+PointIndexType DgmOctree::getCellIndex(CellCode truncatedCellCode, unsigned char bitDec, PointIndexType begin, PointIndexType end) const
 {
 	assert(truncatedCellCode != INVALID_CELL_CODE);
 	assert(end >= begin && end < m_numberOfProjectedPoints);
@@ -703,12 +1414,12 @@ unsigned DgmOctree::getCellIndex(CellCode truncatedCellCode, unsigned char bitDe
 
 	//inspired from the algorithm proposed by MATT PULVER (see http://eigenjoy.com/2011/01/21/worlds-fastest-binary-search/)
 	//DGM:	it's not faster, but the code is simpler ;)
-	unsigned i = 0;
-	unsigned count = end-begin+1;
-	unsigned b = (1 << static_cast<int>( log(static_cast<double>(count-1)) / LOG_NAT_2 ));
+	PointIndexType i = 0;
+	PointIndexType count = end-begin+1;
+	PointIndexType b = (static_cast<PointIndexType>(1) << static_cast<int>( log(static_cast<double>(count-1)) / LOG_NAT_2 ));
 	for ( ; b ; b >>= 1 )
 	{
-		unsigned j = i | b;
+		PointIndexType j = i | b;
 		if ( j < count)
 		{
 			CellCode middleCode = (m_thePointsAndTheirCellCodes[begin+j].theCode >> bitDec);
@@ -878,7 +1589,7 @@ void DgmOctree::getNeighborCellsAround(const Tuple3i& cellPos,
 				{
 					CellCode c2 = c1 | (GenerateCellCodeForDim(cellPos.z+k) << 2);
 
-					unsigned index = getCellIndex(c2,bitDec);
+					PointIndexType index = getCellIndex(c2,bitDec);
 					if (index < m_numberOfProjectedPoints)
 					{
 						neighborCellsIndexes.push_back(index);
@@ -892,7 +1603,7 @@ void DgmOctree::getNeighborCellsAround(const Tuple3i& cellPos,
 				{
 					CellCode c2 = c1 | (GenerateCellCodeForDim(cellPos.z-neighbourhoodLength) << 2);
 
-					unsigned index = getCellIndex(c2,bitDec);
+					PointIndexType index = getCellIndex(c2,bitDec);
 					if (index < m_numberOfProjectedPoints)
 					{
 						neighborCellsIndexes.push_back(index);
@@ -903,7 +1614,7 @@ void DgmOctree::getNeighborCellsAround(const Tuple3i& cellPos,
 				{
 					CellCode c2 = c1+(GenerateCellCodeForDim(cellPos.z+kMax) << 2);
 
-					unsigned index = getCellIndex(c2,bitDec);
+					PointIndexType index = getCellIndex(c2,bitDec);
 					if (index < m_numberOfProjectedPoints)
 					{
 						neighborCellsIndexes.push_back(index);
@@ -951,7 +1662,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSearchStruct &n
 				{
 					CellCode c2 = c1 | (GenerateCellCodeForDim(nNSS.cellPos.z+k) << 2);
 
-					unsigned index = getCellIndex(c2,bitDec);
+					PointIndexType index = getCellIndex(c2,bitDec);
 					if (index < m_numberOfProjectedPoints)
 					{
 						//we increase 'pointsInNeighbourCells' capacity with average cell size
@@ -982,7 +1693,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSearchStruct &n
 				{
 					CellCode c2 = c1 | (GenerateCellCodeForDim(nNSS.cellPos.z-neighbourhoodLength) << 2);
 
-					unsigned index = getCellIndex(c2,bitDec);
+					PointIndexType index = getCellIndex(c2,bitDec);
 					if (index < m_numberOfProjectedPoints)
 					{
 						//we increase 'nNSS.pointsInNeighbourhood' capacity with average cell size
@@ -1010,7 +1721,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSearchStruct &n
 				{
 					CellCode c2 = c1 | (GenerateCellCodeForDim(nNSS.cellPos.z+neighbourhoodLength) << 2);
 
-					unsigned index = getCellIndex(c2,bitDec);
+					PointIndexType index = getCellIndex(c2,bitDec);
 					if (index < m_numberOfProjectedPoints)
 					{
 						//we increase 'nNSS.pointsInNeighbourhood' capacity with average cell size
@@ -1053,7 +1764,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
 	{
 		//we don't look if the cell is inside the octree as it is generally the case
 		CellCode truncatedCellCode = GenerateTruncatedCellCode(nNSS.cellPos,nNSS.level);
-		unsigned index = getCellIndex(truncatedCellCode,bitDec);
+		PointIndexType index = getCellIndex(truncatedCellCode,bitDec);
 		if (index < m_numberOfProjectedPoints)
 		{
 			//add cell descriptor to cells list
@@ -1087,7 +1798,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
     int &kMinAbs = limits[4];
     int &kMaxAbs = limits[5];
 
-    unsigned old_index = 0;
+    PointIndexType old_index = 0;
     CellCode old_c2 = 0;
 	Tuple3i currentCellPos;
 
@@ -1107,7 +1818,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
                     CellCode c2 = c1 | (GenerateCellCodeForDim(v2)<<2);
 
 					//look for corresponding cell
-                    unsigned index = (old_c2 < c2 ? getCellIndex(c2,bitDec,old_index,m_numberOfProjectedPoints-1) : getCellIndex(c2,bitDec,0,old_index));
+                    PointIndexType index = (old_c2 < c2 ? getCellIndex(c2,bitDec,old_index,m_numberOfProjectedPoints-1) : getCellIndex(c2,bitDec,0,old_index));
                     if (index < m_numberOfProjectedPoints)
                     {
 						//add cell descriptor to cells list
@@ -1147,7 +1858,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
                     CellCode c2 = c1 | (GenerateCellCodeForDim(v2)<<2);
 
 					//look for corresponding cell
-                    unsigned index = (old_c2 < c2 ? getCellIndex(c2,bitDec,old_index,m_numberOfProjectedPoints-1) : getCellIndex(c2,bitDec,0,old_index));
+                    PointIndexType index = (old_c2 < c2 ? getCellIndex(c2,bitDec,old_index,m_numberOfProjectedPoints-1) : getCellIndex(c2,bitDec,0,old_index));
                     if (index < m_numberOfProjectedPoints)
                     {
 						//add cell descriptor to cells list
@@ -1187,7 +1898,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
                     CellCode c2 = c0 | (GenerateCellCodeForDim(v2)<<2);
 
 					//look for corresponding cell
-                    unsigned index = (old_c2 < c2 ? getCellIndex(c2,bitDec,old_index,m_numberOfProjectedPoints-1) : getCellIndex(c2,bitDec,0,old_index));
+                    PointIndexType index = (old_c2 < c2 ? getCellIndex(c2,bitDec,old_index,m_numberOfProjectedPoints-1) : getCellIndex(c2,bitDec,0,old_index));
                     if (index < m_numberOfProjectedPoints)
                     {
 						//add cell descriptor to cells list
@@ -1227,7 +1938,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
                     CellCode c2 = c0 | (GenerateCellCodeForDim(v2)<<2);
 
 					//look for corresponding cell
-                    unsigned index = (old_c2 < c2 ? getCellIndex(c2,bitDec,old_index,m_numberOfProjectedPoints-1) : getCellIndex(c2,bitDec,0,old_index));
+                    PointIndexType index = (old_c2 < c2 ? getCellIndex(c2,bitDec,old_index,m_numberOfProjectedPoints-1) : getCellIndex(c2,bitDec,0,old_index));
                     if (index < m_numberOfProjectedPoints)
                     {
 						//add cell descriptor to cells list
@@ -1266,7 +1977,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
 				{
 					CellCode c1 = c0 | (GenerateCellCodeForDim(v1)<<1);
 					//look for corresponding cell
-					unsigned index = (old_c2 < c1 ? getCellIndex(c1,bitDec,old_index,m_numberOfProjectedPoints-1) : getCellIndex(c1,bitDec,0,old_index));
+					PointIndexType index = (old_c2 < c1 ? getCellIndex(c1,bitDec,old_index,m_numberOfProjectedPoints-1) : getCellIndex(c1,bitDec,0,old_index));
 					if (index < m_numberOfProjectedPoints)
 					{
 						//add cell descriptor to cells list
@@ -1305,7 +2016,7 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
 				{
 					CellCode c1 = c0 | (GenerateCellCodeForDim(v1)<<1);
 					//look for corresponding cell
-					unsigned index = (old_c2 < c1 ? getCellIndex(c1,bitDec,old_index,m_numberOfProjectedPoints-1) : getCellIndex(c1,bitDec,0,old_index));
+					PointIndexType index = (old_c2 < c1 ? getCellIndex(c1,bitDec,old_index,m_numberOfProjectedPoints-1) : getCellIndex(c1,bitDec,0,old_index));
 					if (index < m_numberOfProjectedPoints)
 					{
 						//add cell descriptor to cells list
@@ -1353,7 +2064,7 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
 
 		//check for existence of an 'including' cell
 		CellCode truncatedCellCode = GenerateTruncatedCellCode(nNSS.cellPos, nNSS.level);
-		unsigned index = (truncatedCellCode == INVALID_CELL_CODE ? m_numberOfProjectedPoints : getCellIndex(truncatedCellCode,bitDec));
+		PointIndexType index = (truncatedCellCode == INVALID_CELL_CODE ? m_numberOfProjectedPoints : getCellIndex(truncatedCellCode,bitDec));
 
 		visitedCellDistance = 1;
 
@@ -1420,6 +2131,9 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
 	//cells for which we have already computed the distances from their points to the query point
 	unsigned alreadyProcessedCells = 0;
 
+	//whether the (SIMD friendly) copy of the points coordinates can be used
+	const bool useSortedCoordinates = (m_numberOfProjectedPoints != 0 && m_sortedPointsCoordinates[0].size() == m_numberOfProjectedPoints);
+
 	//Min (squared) distance of neighbours
 	double minSquareDist = -1.0;
 
@@ -1445,11 +2159,44 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
 		for (q = nNSS.minimalCellsSetToVisit.begin()+alreadyProcessedCells; q != nNSS.minimalCellsSetToVisit.end(); ++q)
 		{
 			//current cell index (== index of its first point)
-			unsigned m = *q;
+			PointIndexType m = *q;
 
 			//we scan the whole cell to see if it contains a closer point
 			cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+m;
 			CellCode code = (p->theCode >> bitDec);
+
+			if (useSortedCoordinates)
+			{
+				//look for the end of the cell
+				PointIndexType cellEnd = m + 1;
+				while (cellEnd < m_numberOfProjectedPoints && (m_thePointsAndTheirCellCodes[cellEnd].theCode >> bitDec) == code)
+					++cellEnd;
+
+				//compute the distances by blocks
+				double squareDists[NN_DISTANCES_BLOCK_SIZE];
+				for (PointIndexType blockStart = m; blockStart < cellEnd; blockStart += NN_DISTANCES_BLOCK_SIZE)
+				{
+					unsigned blockSize = static_cast<unsigned>(std::min<PointIndexType>(NN_DISTANCES_BLOCK_SIZE, cellEnd - blockStart));
+					ComputeSquareDistances(	&(m_sortedPointsCoordinates[0][blockStart]),
+											&(m_sortedPointsCoordinates[1][blockStart]),
+											&(m_sortedPointsCoordinates[2][blockStart]),
+											blockSize,
+											nNSS.queryPoint,
+											squareDists);
+
+					//we keep track of the closest one
+					for (unsigned i = 0; i < blockSize; ++i)
+					{
+						if (squareDists[i] < minSquareDist || minSquareDist < 0)
+						{
+							nNSS.theNearestPointIndex = m_thePointsAndTheirCellCodes[blockStart + i].theIndex;
+							minSquareDist = squareDists[i];
+						}
+					}
+				}
+				continue;
+			}
+
 			while (m < m_numberOfProjectedPoints && (p->theCode >> bitDec) == code)
 			{
 				//square distance to query point
@@ -1522,7 +2269,7 @@ unsigned DgmOctree::findNearestNeighborsStartingFromCell(	NearestNeighboursSearc
 
 		//check for existence of 'including' cell
 		CellCode truncatedCellCode = GenerateTruncatedCellCode(nNSS.cellPos, nNSS.level);
-		unsigned index = (truncatedCellCode == INVALID_CELL_CODE ? m_numberOfProjectedPoints : getCellIndex(truncatedCellCode,bitDec));
+		PointIndexType index = (truncatedCellCode == INVALID_CELL_CODE ? m_numberOfProjectedPoints : getCellIndex(truncatedCellCode,bitDec));
 
 		visitedCellDistance = 1;
 
@@ -1621,9 +2368,8 @@ unsigned DgmOctree::findNearestNeighborsStartingFromCell(	NearestNeighboursSearc
 		}
 
 		//we compute distances for the new points
+		ComputeSquareDistances(nNSS.pointsInNeighbourhood, alreadyProcessedPoints, nNSS.queryPoint);
 		NeighboursSet::iterator q;
-		for (q = nNSS.pointsInNeighbourhood.begin()+alreadyProcessedPoints; q != nNSS.pointsInNeighbourhood.end(); ++q)
-			q->squareDistd = (*q->point - nNSS.queryPoint).norm2d();
 		alreadyProcessedPoints = static_cast<unsigned>(nNSS.pointsInNeighbourhood.size());
 
 		//equivalent spherical neighbourhood radius (as we are actually looking to 'square' neighbourhoods,
@@ -1725,7 +2471,7 @@ int DgmOctree::getPointsInSphericalNeighbourhood(	const CCVector3& sphereCenter,
 				{
 					//2nd test: does this cell exists?
 					CellCode truncatedCellCode = GenerateTruncatedCellCode(cellPos, level);
-					unsigned cellIndex = getCellIndex(truncatedCellCode,bitDec);
+					PointIndexType cellIndex = getCellIndex(truncatedCellCode,bitDec);
 
 					//if yes get the corresponding points
 					if (cellIndex < m_numberOfProjectedPoints)
@@ -1895,7 +2641,7 @@ size_t DgmOctree::getPointsInBoxNeighbourhood(BoxNeighbourhood& params) const
 				//test if this cell exists
 				Tuple3i cellPos(i, j, k);
 				CellCode truncatedCellCode = GenerateTruncatedCellCode(cellPos, params.level);
-				unsigned cellIndex = getCellIndex(truncatedCellCode,bitDec);
+				PointIndexType cellIndex = getCellIndex(truncatedCellCode,bitDec);
 
 				//if yes, we can test the corresponding points
 				if (cellIndex < m_numberOfProjectedPoints)
@@ -2015,7 +2761,7 @@ size_t DgmOctree::getPointsInCylindricalNeighbourhood(CylindricalNeighbourhood&
 				{
 					//2nd test: does this cell exists?
 					CellCode truncatedCellCode = GenerateTruncatedCellCode(cellPos, params.level);
-					unsigned cellIndex = getCellIndex(truncatedCellCode,bitDec);
+					PointIndexType cellIndex = getCellIndex(truncatedCellCode,bitDec);
 
 					//if yes get the corresponding points
 					if (cellIndex < m_numberOfProjectedPoints)
@@ -2173,7 +2919,7 @@ size_t DgmOctree::getPointsInCylindricalNeighbourhoodProgressive(ProgressiveCyli
 					{
 						//2nd test: does this cell exists?
 						CellCode truncatedCellCode = GenerateTruncatedCellCode(cellPos, params.level);
-						unsigned cellIndex = getCellIndex(truncatedCellCode,bitDec);
+						PointIndexType cellIndex = getCellIndex(truncatedCellCode,bitDec);
 
 						//if yes get the corresponding points
 						if (cellIndex < m_numberOfProjectedPoints)
@@ -2355,12 +3101,14 @@ int DgmOctree::findNeighborsInASphereStartingFromCell(NearestNeighboursSpherical
 
 #else //TEST_CELLS_FOR_SPHERICAL_NN
 
+	//we compute the distances for all the points
+	ComputeSquareDistances(nNSS.pointsInNeighbourhood, 0, nNSS.queryPoint);
+
 	//point by point scan
 	NeighboursSet::iterator p = nNSS.pointsInNeighbourhood.begin();
 	size_t k = nNSS.pointsInNeighbourhood.size();
 	for (size_t i=0; i<k; ++i,++p)
 	{
-		p->squareDistd = (*p->point - nNSS.queryPoint).norm2d();
 		//if the distance is inferior to the sphere radius...
 		if (p->squareDistd <= squareRadius)
 		{
@@ -2417,8 +3165,8 @@ unsigned char DgmOctree::findBestLevelForAGivenNeighbourhoodSizeExtraction(Point
 
 unsigned char DgmOctree::findBestLevelForComparisonWithOctree(const DgmOctree* theOtherOctree) const
 {
-	unsigned ptsA = getNumberOfProjectedPoints();
-	unsigned ptsB = theOtherOctree->getNumberOfProjectedPoints();
+	PointIndexType ptsA = getNumberOfProjectedPoints();
+	PointIndexType ptsB = theOtherOctree->getNumberOfProjectedPoints();
 
 	int maxOctreeLevel = MAX_OCTREE_LEVEL;
 	if (std::min(ptsA,ptsB) < 16)
@@ -2435,7 +3183,7 @@ unsigned char DgmOctree::findBestLevelForComparisonWithOctree(const DgmOctree* t
 		diff(i,m_thePointsAndTheirCellCodes,theOtherOctree->m_thePointsAndTheirCellCodes,diffA,diffB,cellsA,cellsB);
 
 		//we use a linear model for prediction
-		estimatedTime[i] = ((static_cast<double>(ptsA)*ptsB) / cellsB) * 0.001 + diffA;
+		estimatedTime[i] = ((static_cast<double>(ptsA)*static_cast<double>(ptsB)) / cellsB) * 0.001 + diffA;
 
 		if (estimatedTime[i] < estimatedTime[bestLevel])
 			bestLevel = i;
@@ -2582,7 +3330,7 @@ bool DgmOctree::getCellIndexes(unsigned char level, cellIndexesContainer& vec) c
 
 	CellCode predCode = (p->theCode >> bitDec)+1; //pred value must be different than the first element's
 
-	for (unsigned i=0,j=0; i<m_numberOfProjectedPoints; ++i,++p)
+	for (PointIndexType i=0,j=0; i<m_numberOfProjectedPoints; ++i,++p)
 	{
 		CellCode currentCode = (p->theCode >> bitDec);
 
@@ -2596,7 +3344,7 @@ bool DgmOctree::getCellIndexes(unsigned char level, cellIndexesContainer& vec) c
 }
 
 bool DgmOctree::getPointsInCellByCellIndex(	ReferenceCloud* cloud,
-											unsigned cellIndex,
+											PointIndexType cellIndex,
 											unsigned char level,
 											bool clearOutputCloud/* = true*/) const
 {
@@ -2757,11 +3505,11 @@ void DgmOctree::diff(unsigned char octreeLevel, const cellsContainer &codesA, co
 	}
 }
 
-int DgmOctree::extractCCs(unsigned char level, bool sixConnexity, GenericProgressCallback* progressCb) const
+int DgmOctree::extractCCs(unsigned char level, bool sixConnexity, GenericProgressCallback* progressCb, bool multiThread) const
 {
 	std::vector<CellCode> cellCodes;
 	getCellCodes(level,cellCodes);
-	return extractCCs(cellCodes, level, sixConnexity, progressCb);
+	return extractCCs(cellCodes, level, sixConnexity, progressCb, multiThread);
 }
 
 struct IndexAndCodeExt
@@ -2784,19 +3532,224 @@ struct IndexAndCodeExt
 		, theCode(0)
 	{}
 
-	//! Compares two IndexAndCodeExt instances based on their index
-	/** \param a first IndexAndCode structure
-		\param b second IndexAndCode structure
-		\return whether the index of 'a' is smaller than the index of 'b'
-	**/
-	static bool indexComp(const IndexAndCodeExt& a, const IndexAndCodeExt& b) throw()
+	//! Compares two IndexAndCodeExt instances based on their index
+	/** \param a first IndexAndCode structure
+		\param b second IndexAndCode structure
+		\return whether the index of 'a' is smaller than the index of 'b'
+	**/
+	static bool indexComp(const IndexAndCodeExt& a, const IndexAndCodeExt& b) throw()
+	{
+		return a.theIndex < b.theIndex;
+	}
+
+};
+
+//! Shared parameters of the connected components labeling (see DgmOctree::extractCCs)
+struct CCLabelingContext
+{
+	//! Cells (sorted by index)
+	const std::vector<IndexAndCodeExt>* cells;
+	//! Union-find structure (parent of each cell)
+	std::vector<unsigned>* parents;
+	//! Level of subdivision
+	unsigned char level;
+	//! Min cell position
+	Tuple3i indexMin;
+	//! Width of a slice (including margins)
+	int sliceWidth;
+	//! Size of a slice (including margins)
+	int sliceSize;
+	//! Number of neighbors in the current slice
+	unsigned char neighborsInCurrentSlice;
+	//! Number of neighbors in the preceding slice
+	unsigned char neighborsInPrecedingSlice;
+	//! Relative positions of the neighbors in the current slice (maximum size to simplify code...)
+	int currentSliceNeighborsShifts[4];
+	//! Relative positions of the neighbors in the preceding slice (maximum size to simplify code...)
+	int precedingSliceNeighborsShifts[9];
+	//! Progress notification (one step per layer)
+	NormalizedProgress* nProgress;
+};
+
+//! Slab of consecutive cells (made of complete layers) labeled independently
+struct CCLabelingSlab
+{
+	const CCLabelingContext* context;
+	size_t firstCell;
+	size_t lastCell; //excluded
+	bool success;
+};
+
+//! Range of cells to flag with their component label
+struct CCFlaggingJob
+{
+	const DgmOctree* octree;
+	const std::vector<IndexAndCodeExt>* cells;
+	const std::vector<unsigned>* labels;
+	unsigned char level;
+	size_t firstCell;
+	size_t lastCell; //excluded
+	NormalizedProgress* nProgress;
+	bool success;
+};
+
+//! Returns the layer (Z) of a cell
+static inline IndexAndCodeExt::IndexType CCLayer(const CCLabelingContext& context, const IndexAndCodeExt& cell)
+{
+	return cell.theIndex >> (context.level << 1);
+}
+
+//! Returns the position of a cell in its slice
+static inline int CCSlicePos(const CCLabelingContext& context, const IndexAndCodeExt& cell)
+{
+	const IndexAndCodeExt::IndexType gridCoordMask = (static_cast<IndexAndCodeExt::IndexType>(1) << context.level) - 1;
+	int iind = static_cast<int>(cell.theIndex & gridCoordMask);
+	int jind = static_cast<int>((cell.theIndex >> context.level) & gridCoordMask);
+	return (iind - context.indexMin.x + 1) + (jind - context.indexMin.y + 1) * context.sliceWidth;
+}
+
+//! Returns the root of a cell's component (with path halving)
+static inline unsigned FindCCRoot(std::vector<unsigned>& parents, unsigned i)
+{
+	while (parents[i] != i)
+	{
+		parents[i] = parents[parents[i]];
+		i = parents[i];
+	}
+	return i;
+}
+
+//! Merges the components of two cells (the root is always the cell with the smallest index)
+static inline void MergeCCs(std::vector<unsigned>& parents, unsigned a, unsigned b)
+{
+	a = FindCCRoot(parents, a);
+	b = FindCCRoot(parents, b);
+	if (a < b)
+		parents[b] = a;
+	else if (b < a)
+		parents[a] = b;
+}
+
+//! Labels the cells of a slab (the cells of its first layer are not connected to the preceding slab)
+static void LabelCCSlab(CCLabelingSlab& slab)
+{
+	slab.success = false;
+
+	const CCLabelingContext& context = *slab.context;
+	const std::vector<IndexAndCodeExt>& cells = *context.cells;
+	std::vector<unsigned>& parents = *context.parents;
+
+	//temporary virtual 'slices' (cell index + 1, or 0 if empty)
+	std::vector<unsigned> slice;
+	std::vector<unsigned> oldSlice;
+	try
+	{
+		slice.resize(context.sliceSize, 0);
+		oldSlice.resize(context.sliceSize, 0);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return;
+	}
+
+	//cells of the preceding layer
+	size_t oldLayerStart = slab.firstCell;
+	size_t oldLayerEnd = slab.firstCell;
+
+	size_t layerStart = slab.firstCell;
+	while (layerStart < slab.lastCell)
+	{
+		const IndexAndCodeExt::IndexType layer = CCLayer(context, cells[layerStart]);
+		//the preceding slice is only relevant if it is just below the current one
+		bool precedingSliceIsNeighbor = (oldLayerEnd > oldLayerStart && CCLayer(context, cells[oldLayerStart]) + 1 == layer);
+
+		//for each cell of the slice
+		size_t layerEnd = layerStart;
+		for (; layerEnd < slab.lastCell && CCLayer(context, cells[layerEnd]) == layer; ++layerEnd)
+		{
+			unsigned cellIndex = static_cast<unsigned>(layerEnd);
+			int cellPos = CCSlicePos(context, cells[layerEnd]);
+			parents[cellIndex] = cellIndex;
+
+			//we look if the cell has neighbors inside the slice
+			const unsigned* _slice = &(slice[cellPos]);
+			for (unsigned char n = 0; n < context.neighborsInCurrentSlice; n++)
+			{
+				assert(cellPos + context.currentSliceNeighborsShifts[n] < context.sliceSize);
+				unsigned neighbor = _slice[context.currentSliceNeighborsShifts[n]];
+				if (neighbor)
+					MergeCCs(parents, cellIndex, neighbor - 1);
+			}
+
+			//and in the previous slice
+			if (precedingSliceIsNeighbor)
+			{
+				const unsigned* _oldSlice = &(oldSlice[cellPos]);
+				for (unsigned char n = 0; n < context.neighborsInPrecedingSlice; n++)
+				{
+					assert(cellPos + context.precedingSliceNeighborsShifts[n] < context.sliceSize);
+					unsigned neighbor = _oldSlice[context.precedingSliceNeighborsShifts[n]];
+					if (neighbor)
+						MergeCCs(parents, cellIndex, neighbor - 1);
+				}
+			}
+
+			slice[cellPos] = cellIndex + 1;
+		}
+
+		//reset the preceding slice (only its own cells are set) before swapping
+		for (size_t i = oldLayerStart; i < oldLayerEnd; ++i)
+			oldSlice[CCSlicePos(context, cells[i])] = 0;
+		std::swap(slice, oldSlice);
+
+		oldLayerStart = layerStart;
+		oldLayerEnd = layerEnd;
+		layerStart = layerEnd;
+
+		if (context.nProgress)
+			context.nProgress->oneStep();
+	}
+
+	slab.success = true;
+}
+
+//! Flags the points of a range of cells with their component label
+static void FlagCCPoints(CCFlaggingJob& job)
+{
+	job.success = false;
+
+	ReferenceCloud Y(job.octree->associatedCloud());
+	try
+	{
+		for (size_t i = job.firstCell; i < job.lastCell; i++)
+		{
+			const unsigned& label = (*job.labels)[i];
+			assert(label > 0);
+			if (!job.octree->getPointsInCell((*job.cells)[i].theCode, job.level, &Y, true))
+				return;
+			Y.placeIteratorAtBegining();
+			ScalarType d = static_cast<ScalarType>(label);
+			for (unsigned j = 0; j < Y.size(); ++j)
+			{
+				Y.setCurrentPointScalarValue(d);
+				Y.forwardIterator();
+			}
+
+			if (job.nProgress)
+				job.nProgress->oneStep();
+		}
+	}
+	catch (const std::bad_alloc&)
 	{
-		return a.theIndex < b.theIndex;
+		//not enough memory
+		return;
 	}
 
-};
+	job.success = true;
+}
 
-int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, unsigned char level, bool sixConnexity, GenericProgressCallback* progressCb) const
+int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, unsigned char level, bool sixConnexity, GenericProgressCallback* progressCb, bool multiThread) const
 {
 	size_t numberOfCells = cellCodes.size();
 	if (numberOfCells == 0) //no cells!
@@ -2859,76 +3812,85 @@ int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, unsigned char lev
 	//we sort the cells
 	SortAlgo(ccCells.begin(), ccCells.end(), IndexAndCodeExt::indexComp); //ascending index code order
 
-	const int& di = gridSize.x;
-	const int& dj = gridSize.y;
-	const int& step = gridSize.z;
-
-	//relative neighbos positions (either 6 or 26 total - but we only use half of it)
-	unsigned char neighborsInCurrentSlice = 0, neighborsInPrecedingSlice = 0;
-	int currentSliceNeighborsShifts[4], precedingSliceNeighborsShifts[9]; //maximum size to simplify code...
-
+	//relative neighbors positions (either 6 or 26 total - but we only use half of it)
+	CCLabelingContext context;
+	context.cells = &ccCells;
+	context.parents = 0;
+	context.level = level;
+	context.indexMin = indexMin;
+	context.sliceWidth = gridSize.x + 2; //add a margin to avoid "boundary effects"
+	context.sliceSize = context.sliceWidth * (gridSize.y + 2);
+	context.nProgress = 0;
+
+	const int& dw = context.sliceWidth;
 	if (sixConnexity) //6-connexity
 	{
-		neighborsInCurrentSlice = 2;
-		currentSliceNeighborsShifts[0] = -(di + 2);
-		currentSliceNeighborsShifts[1] = -1;
+		context.neighborsInCurrentSlice = 2;
+		context.currentSliceNeighborsShifts[0] = -dw;
+		context.currentSliceNeighborsShifts[1] = -1;
 
-		neighborsInPrecedingSlice = 1;
-		precedingSliceNeighborsShifts[0] = 0;
+		context.neighborsInPrecedingSlice = 1;
+		context.precedingSliceNeighborsShifts[0] = 0;
 	}
 	else //26-connexity
 	{
-		neighborsInCurrentSlice = 4;
-		currentSliceNeighborsShifts[0] = -1 - (di + 2);
-		currentSliceNeighborsShifts[1] = -(di + 2);
-		currentSliceNeighborsShifts[2] = 1 - (di + 2);
-		currentSliceNeighborsShifts[3] = -1;
-
-		neighborsInPrecedingSlice = 9;
-		precedingSliceNeighborsShifts[0] = -1 - (di + 2);
-		precedingSliceNeighborsShifts[1] = -(di + 2);
-		precedingSliceNeighborsShifts[2] = 1 - (di + 2);
-		precedingSliceNeighborsShifts[3] = -1;
-		precedingSliceNeighborsShifts[4] = 0;
-		precedingSliceNeighborsShifts[5] = 1;
-		precedingSliceNeighborsShifts[6] = -1 + (di + 2);
-		precedingSliceNeighborsShifts[7] = (di + 2);
-		precedingSliceNeighborsShifts[8] = 1 + (di + 2);
-	}
-
-	//shared structures (to avoid repeated allocations)
-	std::vector<int> neighboursVal, neighboursMin;
-	try
-	{
-		neighboursVal.reserve(neighborsInCurrentSlice + neighborsInPrecedingSlice);
-		neighboursMin.reserve(neighborsInCurrentSlice + neighborsInPrecedingSlice);
-	}
-	catch (const std::bad_alloc&)
-	{
-		//not enough memory
-		return -2;
+		context.neighborsInCurrentSlice = 4;
+		context.currentSliceNeighborsShifts[0] = -1 - dw;
+		context.currentSliceNeighborsShifts[1] = -dw;
+		context.currentSliceNeighborsShifts[2] = 1 - dw;
+		context.currentSliceNeighborsShifts[3] = -1;
+
+		context.neighborsInPrecedingSlice = 9;
+		context.precedingSliceNeighborsShifts[0] = -1 - dw;
+		context.precedingSliceNeighborsShifts[1] = -dw;
+		context.precedingSliceNeighborsShifts[2] = 1 - dw;
+		context.precedingSliceNeighborsShifts[3] = -1;
+		context.precedingSliceNeighborsShifts[4] = 0;
+		context.precedingSliceNeighborsShifts[5] = 1;
+		context.precedingSliceNeighborsShifts[6] = -1 + dw;
+		context.precedingSliceNeighborsShifts[7] = dw;
+		context.precedingSliceNeighborsShifts[8] = 1 + dw;
 	}
 
-	//temporary virtual 'slices'
-	int sliceSize = (di + 2) * (dj + 2); //add a margin to avoid "boundary effects"
-	std::vector<int> slice;
-	std::vector<int> oldSlice;
-	//equivalence table between 'on the fly' labels
-	std::vector<int> equivalentLabels;
-	std::vector<int> cellIndexToLabel;
-
+	//union-find structure (one entry per cell - replaced by the component labels at the end)
+	std::vector<unsigned> parents;
+	//slice used to merge the slabs
+	std::vector<unsigned> slice;
+	//slabs of complete layers (processed independently)
+	std::vector<CCLabelingSlab> slabs;
 	try
 	{
-		slice.resize(sliceSize);
-		oldSlice.resize(sliceSize, 0); //previous slice is empty by default
-		equivalentLabels.resize(numberOfCells + 2, 0);
-		cellIndexToLabel.resize(numberOfCells, 0);
+		parents.resize(numberOfCells);
+		slice.resize(context.sliceSize, 0);
+
+		unsigned slabCount = BuildThreadCount(multiThread);
+		slabs.reserve(slabCount);
+		size_t firstCell = 0;
+		for (unsigned s = 1; s <= slabCount && firstCell < numberOfCells; ++s)
+		{
+			//same number of cells per slab (roughly, as a layer can't be split)
+			size_t lastCell = std::max(firstCell + 1, (numberOfCells * s) / slabCount);
+			const IndexAndCodeExt::IndexType layer = CCLayer(context, ccCells[lastCell - 1]);
+			while (lastCell < numberOfCells && CCLayer(context, ccCells[lastCell]) == layer)
+				++lastCell;
+
+			CCLabelingSlab slab;
+			slab.context = &context;
+			slab.firstCell = firstCell;
+			slab.lastCell = lastCell;
+			slab.success = false;
+			slabs.push_back(slab);
+
+			firstCell = lastCell;
+		}
+		assert(firstCell == numberOfCells);
 	}
 	catch (const std::bad_alloc&)
 	{
 		//not enough memory
 		return -2;
 	}
+	context.parents = &parents;
 
 	//progress notification
 	if (progressCb)
@@ -2944,200 +3906,85 @@ int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, unsigned char lev
 		progressCb->start();
 	}
 
-	//current label
-	size_t currentLabel = 1;
-
-	//process each slice
+	//label each slab (in parallel if possible)
 	{
-		unsigned counter = 0;
-		const IndexAndCodeExt::IndexType gridCoordMask = (static_cast<IndexAndCodeExt::IndexType>(1) << level) - 1;
-		std::vector<IndexAndCodeExt>::const_iterator _ccCells = ccCells.begin();
-		NormalizedProgress nprogress(progressCb, step);
+		NormalizedProgress nprogress(progressCb, gridSize.z);
+		context.nProgress = (progressCb ? &nprogress : 0);
 
-		for (int k = indexMin.z; k < indexMin.z + step; k++)
-		{
-			//initialize the 'current' slice
-			std::fill(slice.begin(), slice.end(), 0);
-
-			//for each cell of the slice
-			while (counter < numberOfCells && static_cast<int>(_ccCells->theIndex >> (level << 1)) == k)
-			{
-				int iind = static_cast<int>(_ccCells->theIndex & gridCoordMask);
-				int jind = static_cast<int>((_ccCells->theIndex >> level) & gridCoordMask);
-				int cellIndex = (iind - indexMin.x + 1) + (jind - indexMin.y + 1)*(di + 2);
-				++_ccCells;
-
-				//we look if the cell has neighbors inside the slice
-				int* _slice = &(slice[cellIndex]);
-				{
-					for (unsigned char n = 0; n < neighborsInCurrentSlice; n++)
-					{
-						assert(cellIndex + currentSliceNeighborsShifts[n] < sliceSize);
-						const int& neighborLabel = _slice[currentSliceNeighborsShifts[n]];
-						if (neighborLabel > 1)
-							neighboursVal.push_back(neighborLabel);
-					}
-				}
-
-				//and in the previous slice
-				const int* _oldSlice = &(oldSlice[cellIndex]);
-				{
-					for (unsigned char n = 0; n < neighborsInPrecedingSlice; n++)
-					{
-						assert(cellIndex + precedingSliceNeighborsShifts[n] < sliceSize);
-						const int& neighborLabel = _oldSlice[precedingSliceNeighborsShifts[n]];
-						if (neighborLabel > 1)
-							neighboursVal.push_back(neighborLabel);
-					}
-				}
-
-				//number of neighbors for current cell
-				size_t p = neighboursVal.size();
-
-				if (p == 0) //no neighbor
-				{
-					*_slice = static_cast<int>(++currentLabel); //we create a new label
-				}
-				else if (p == 1) //1 neighbor
-				{
-					*_slice = neighboursVal.back(); //we'll use its label
-					neighboursVal.pop_back();
-				}
-				else //more than 1 neighbor?
-				{
-					//we get the smallest label
-					SortAlgo(neighboursVal.begin(), neighboursVal.end());
-					int smallestLabel = neighboursVal[0];
+		ProcessBuildJobs(slabs, LabelCCSlab, multiThread);
 
-					//if they are not the same
-					if (smallestLabel != neighboursVal.back())
-					{
-						int lastLabel = 0;
-						neighboursMin.clear();
-						//we get the smallest equivalent label for each neighbor's branch
-						{
-							for (size_t n = 0; n < p; n++)
-							{
-								// ... we start from its C.C. index
-								int label = neighboursVal[n];
-								//if it's not the same as the previous neighbor's
-								if (label != lastLabel)
-								{
-									//we update the 'before' value
-									assert(label < static_cast<int>(numberOfCells)+2);
-									lastLabel = label;
+		context.nProgress = 0;
+	}
 
-									//we look for its real equivalent value
-									while (equivalentLabels[label] > 1)
-									{
-										label = equivalentLabels[label];
-										assert(label < static_cast<int>(numberOfCells)+2);
-									}
+	bool success = true;
+	for (size_t s = 0; s < slabs.size(); ++s)
+		success &= slabs[s].success;
 
-									neighboursMin.push_back(label);
-								}
-							}
-						}
+	//merge the components across the slabs boundaries
+	for (size_t s = 1; s < slabs.size() && success; ++s)
+	{
+		const CCLabelingSlab& precedingSlab = slabs[s - 1];
+		const CCLabelingSlab& slab = slabs[s];
 
-						//get the smallest one
-						SortAlgo(neighboursMin.begin(), neighboursMin.end());
-						smallestLabel = neighboursMin.front();
+		//the last layer of the preceding slab must be just below the first layer of this slab
+		const IndexAndCodeExt::IndexType precedingLayer = CCLayer(context, ccCells[precedingSlab.lastCell - 1]);
+		const IndexAndCodeExt::IndexType layer = CCLayer(context, ccCells[slab.firstCell]);
+		if (precedingLayer + 1 != layer)
+			continue;
 
-						//update the equivalence table by the way
-						//for all other branches
-						lastLabel = smallestLabel;
-						{
-							for (size_t n = 1; n < neighboursMin.size(); n++)
-							{
-								int label = neighboursMin[n];
-								assert(label < static_cast<int>(numberOfCells)+2);
-								//we don't process it if it's the same label as the previous neighbor
-								if (label != lastLabel)
-								{
-									equivalentLabels[label] = smallestLabel;
-									lastLabel = label;
-								}
-							}
-						}
-					}
+		size_t precedingLayerStart = precedingSlab.lastCell;
+		while (precedingLayerStart > precedingSlab.firstCell && CCLayer(context, ccCells[precedingLayerStart - 1]) == precedingLayer)
+			--precedingLayerStart;
 
-					//update current cell label
-					*_slice = smallestLabel;
-					neighboursVal.clear();
-				}
+		for (size_t i = precedingLayerStart; i < precedingSlab.lastCell; ++i)
+			slice[CCSlicePos(context, ccCells[i])] = static_cast<unsigned>(i) + 1;
 
-				cellIndexToLabel[counter++] = *_slice;
+		for (size_t i = slab.firstCell; i < slab.lastCell && CCLayer(context, ccCells[i]) == layer; ++i)
+		{
+			const unsigned* _slice = &(slice[CCSlicePos(context, ccCells[i])]);
+			for (unsigned char n = 0; n < context.neighborsInPrecedingSlice; n++)
+			{
+				unsigned neighbor = _slice[context.precedingSliceNeighborsShifts[n]];
+				if (neighbor)
+					MergeCCs(parents, static_cast<unsigned>(i), neighbor - 1);
 			}
-
-			if (counter == numberOfCells)
-				break;
-
-			std::swap(slice, oldSlice);
-
-			nprogress.oneStep();
 		}
+
+		for (size_t i = precedingLayerStart; i < precedingSlab.lastCell; ++i)
+			slice[CCSlicePos(context, ccCells[i])] = 0;
 	}
 
 	//release some memory
 	slice.clear();
-	oldSlice.clear();
 
 	if (progressCb)
 	{
 		progressCb->stop();
 	}
 
-	if (currentLabel < 2)
-	{
-		//No component found
-		return -3;
-	}
-
-	//path compression (http://en.wikipedia.org/wiki/Union_find)
-	assert(currentLabel < numberOfCells + 2);
+	if (!success)
 	{
-		for (size_t i = 2; i <= currentLabel; i++)
-		{
-			int label = equivalentLabels[i];
-			assert(label < static_cast<int>(numberOfCells)+2);
-			while (equivalentLabels[label] > 1) //equivalentLabels[0] == 0 !!!
-			{
-				label = equivalentLabels[label];
-				assert(label < static_cast<int>(numberOfCells)+2);
-			}
-			equivalentLabels[i] = label;
-		}
+		//not enough memory
+		return -2;
 	}
 
-	//update leaves
+	//we create (following) indexes for each components
+	//(the root of a component is its first cell, so they are numbered in the same order as before)
+	int numberOfComponents = 0;
+	for (size_t i = 0; i < numberOfCells; i++)
 	{
-		for (size_t i = 0; i < numberOfCells; i++)
-		{
-			int label = cellIndexToLabel[i];
-			assert(label < static_cast<int>(numberOfCells)+2);
-			if (equivalentLabels[label] > 1)
-				cellIndexToLabel[i] = equivalentLabels[label];
-		}
+		assert(parents[i] <= i);
+		if (parents[i] == i)
+			parents[i] = static_cast<unsigned>(++numberOfComponents); //labels start at '1'
+		else
+			parents[i] = parents[parents[i]]; //the preceding cells already have their label
 	}
 
-	//hack: we use "equivalentLabels" to count how many components will have to be created
-	int numberOfComponents = 0;
+	if (numberOfComponents == 0)
 	{
-		std::fill(equivalentLabels.begin(), equivalentLabels.end(), 0);
-
-		for (size_t i = 0; i < numberOfCells; i++)
-		{
-			assert(cellIndexToLabel[i] > 1 && cellIndexToLabel[i] < static_cast<int>(numberOfCells)+2);
-			equivalentLabels[cellIndexToLabel[i]] = 1;
-		}
-
-		//we create (following) indexes for each components
-		for (size_t i = 2; i < numberOfCells + 2; i++)
-			if (equivalentLabels[i] == 1)
-				equivalentLabels[i] = ++numberOfComponents; //labels start at '1'
+		//No component found
+		return -3;
 	}
-	assert(equivalentLabels[0] == 0);
-	assert(equivalentLabels[1] == 0);
 
 	//we flag each component's points with its label
 	{
@@ -3155,23 +4002,35 @@ int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, unsigned char lev
 		}
 		NormalizedProgress nprogress(progressCb, static_cast<unsigned>(numberOfCells));
 
-		ReferenceCloud Y(m_theAssociatedCloud);
-		for (size_t i = 0; i < numberOfCells; i++)
+		std::vector<CCFlaggingJob> jobs;
+		try
 		{
-			assert(cellIndexToLabel[i] < static_cast<int>(numberOfCells)+2);
-
-			const int& label = equivalentLabels[cellIndexToLabel[i]];
-			assert(label > 0);
-			getPointsInCell(ccCells[i].theCode, level, &Y, true);
-			Y.placeIteratorAtBegining();
-			ScalarType d = static_cast<ScalarType>(label);
-			for (unsigned j = 0; j < Y.size(); ++j)
+			unsigned jobCount = BuildThreadCount(multiThread);
+			jobs.resize(jobCount);
+			for (unsigned j = 0; j < jobCount; ++j)
 			{
-				Y.setCurrentPointScalarValue(d);
-				Y.forwardIterator();
+				jobs[j].octree = this;
+				jobs[j].cells = &ccCells;
+				jobs[j].labels = &parents;
+				jobs[j].level = level;
+				jobs[j].firstCell = (numberOfCells * j) / jobCount;
+				jobs[j].lastCell = (numberOfCells * (j + 1)) / jobCount;
+				jobs[j].nProgress = (progressCb ? &nprogress : 0);
+				jobs[j].success = false;
 			}
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			success = false;
+		}
 
-			nprogress.oneStep();
+		if (success)
+		{
+			ProcessBuildJobs(jobs, FlagCCPoints, multiThread);
+
+			for (size_t j = 0; j < jobs.size(); ++j)
+				success &= jobs[j].success;
 		}
 
 		if (progressCb)
@@ -3180,7 +4039,7 @@ int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, unsigned char lev
 		}
 	}
 
-	return numberOfComponents;
+	return success ? numberOfComponents : -2;
 }
 
 /*** Octree-based cloud traversal mechanism ***/
@@ -3223,75 +4082,388 @@ DgmOctree::octreeCell::~octreeCell()
 
 #include <QtCore>
 #include <QApplication>
-#include <QtConcurrentMap>
 #include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QElapsedTimer>
+
+//local
+#include "AtomicCounter.h"
 
 /*** FOR THE MULTI THREADING WRAPPER ***/
 struct octreeCellDesc
 {
 	DgmOctree::CellCode truncatedCode;
-	unsigned i1, i2;
+	PointIndexType i1, i2;
 	unsigned char level;
 };
 
-static DgmOctree* s_octree_MT = 0;
-static DgmOctree::octreeCellFunc s_func_MT = 0;
-static void** s_userParams_MT = 0;
-static GenericProgressCallback* s_progressCb_MT = 0;
-static NormalizedProgress* s_normProgressCb_MT = 0;
-static bool s_cellFunc_MT_success = true;
+//! Cells whose population is larger than this factor times the average population are processed first
+static const double HEAVY_CELL_POPULATION_FACTOR = 4.0;
+
+//! Queue of cells of a worker thread
+/** The owner takes cells from the front, the other threads steal cells from the back.
+**/
+struct CellsQueue
+{
+	//! Mutex protecting 'front' and 'back'
+	QMutex mutex;
+	//! Next cell to process
+	size_t front;
+	//! Last cell to process + 1
+	size_t back;
+	//! Time spent processing cells (in ns)
+	qint64 busyTime_ns;
+	//! Longest cell processing time (in ns)
+	qint64 maxCellTime_ns;
+	//! Population of the longest cell to process
+	PointIndexType maxCellTimePopulation;
+	//! Number of steal operations
+	unsigned stealCount;
+
+	CellsQueue()
+		: front(0)
+		, back(0)
+		, busyTime_ns(0)
+		, maxCellTime_ns(0)
+		, maxCellTimePopulation(0)
+		, stealCount(0)
+	{}
+
+	//! Returns the number of remaining cells
+	inline size_t remaining()
+	{
+		QMutexLocker locker(&mutex);
+		return (back > front ? back - front : 0);
+	}
+};
+
+//! Shared context of a parallel octree traversal
+struct CellsProcessingContext
+{
+	//! Octree
+	DgmOctree* octree;
+	//! Function to apply to each cell
+	DgmOctree::octreeCellFunc func;
+	//! User parameters
+	void** userParams;
+	//! Progress callback
+	GenericProgressCallback* progressCb;
+	//! Normalized progress
+	NormalizedProgress* normProgressCb;
+	//! Process state (1 = ok, 0 = failed/canceled)
+	AtomicCounter success;
+
+	//! Cells to process (the 'heavyCellCount' first ones are processed first)
+	std::vector<octreeCellDesc> cells;
+	//! Number of heavy cells
+	size_t heavyCellCount;
+	//! Next heavy cell to process
+	AtomicCounter nextHeavyCell;
+
+	//! Queues (one per thread)
+	CellsQueue* queues;
+	//! Number of queues (threads)
+	unsigned queueCount;
+
+	CellsProcessingContext()
+		: octree(0)
+		, func(0)
+		, userParams(0)
+		, progressCb(0)
+		, normProgressCb(0)
+		, success(1)
+		, heavyCellCount(0)
+		, nextHeavyCell(0)
+		, queues(0)
+		, queueCount(0)
+	{}
+
+	~CellsProcessingContext()
+	{
+		if (queues)
+			delete[] queues;
+		if (normProgressCb)
+			delete normProgressCb;
+	}
+};
+
+//! Compares two cells based on their population (decreasing order)
+static bool CellPopulationComp(const octreeCellDesc& a, const octreeCellDesc& b)
+{
+	return (a.i2 - a.i1) > (b.i2 - b.i1);
+}
 
-void LaunchOctreeCellFunc_MT(const octreeCellDesc& desc)
+static void LaunchOctreeCellFunc_MT(CellsProcessingContext& context, const octreeCellDesc& desc)
 {
 	//skip cell if process is aborted/has failed
-	if (!s_cellFunc_MT_success)
+	if (context.success.load() == 0)
 	{
 		return;
 	}
 
-	const DgmOctree::cellsContainer& pointsAndCodes = s_octree_MT->pointsAndTheirCellCodes();
+	const DgmOctree::cellsContainer& pointsAndCodes = context.octree->pointsAndTheirCellCodes();
 
 	//cell descriptor
-	DgmOctree::octreeCell cell(s_octree_MT);
+	DgmOctree::octreeCell cell(context.octree);
 	cell.level = desc.level;
 	cell.index = desc.i1;
 	cell.truncatedCode = desc.truncatedCode;
+	bool success = false;
 	if (cell.points->reserve(desc.i2 - desc.i1 + 1))
 	{
-		for (unsigned i = desc.i1; i <= desc.i2; ++i)
+		for (PointIndexType i = desc.i1; i <= desc.i2; ++i)
 		{
 			cell.points->addPointIndex(pointsAndCodes[i].theIndex);
 		}
 
-		s_cellFunc_MT_success &= (*s_func_MT)(cell, s_userParams_MT, s_normProgressCb_MT);
-	}
-	else
-	{
-		s_cellFunc_MT_success = false;
+		success = (*context.func)(cell, context.userParams, context.normProgressCb);
 	}
 
-	if (!s_cellFunc_MT_success)
+	if (!success)
 	{
+		context.success.store(0);
+
 		//TODO: display a message to make clear that the cancel order has been acknowledged!
-		if (s_progressCb_MT)
+		if (context.progressCb)
 		{
-			if (s_progressCb_MT->textCanBeEdited())
+			if (context.progressCb->textCanBeEdited())
 			{
-				s_progressCb_MT->setInfo("Cancelling...");
+				context.progressCb->setInfo("Cancelling...");
 			}
 			QApplication::processEvents();
 		}
+	}
+}
 
-		//if (s_normProgressCb_MT)
-		//{
-		//	//QApplication::processEvents(); //let the application breath!
-		//	if (!s_normProgressCb_MT->oneStep())
-		//	{
-		//		s_cellFunc_MT_success = false;
-		//		return;
-		//	}
-		//}
+//! Worker thread of a parallel octree traversal
+class CellsWorker : public QRunnable
+{
+public:
+
+	CellsWorker(CellsProcessingContext& context, unsigned queueIndex)
+		: m_context(context)
+		, m_queue(context.queues[queueIndex])
+	{}
+
+	virtual void run()
+	{
+		while (m_context.success.load() != 0)
+		{
+			size_t cellIndex = 0;
+			if (!nextCell(cellIndex))
+			{
+				//nothing left to process
+				break;
+			}
+
+			const octreeCellDesc& desc = m_context.cells[cellIndex];
+
+			QElapsedTimer timer;
+			timer.start();
+			LaunchOctreeCellFunc_MT(m_context, desc);
+			qint64 cellTime_ns = timer.nsecsElapsed();
+
+			m_queue.busyTime_ns += cellTime_ns;
+			if (m_queue.maxCellTime_ns < cellTime_ns)
+			{
+				m_queue.maxCellTime_ns = cellTime_ns;
+				m_queue.maxCellTimePopulation = desc.i2 - desc.i1 + 1;
+			}
+		}
+	}
+
+protected:
+
+	//! Returns the next cell to process (heavy cells first, then own queue, then stolen cells)
+	bool nextCell(size_t& cellIndex)
+	{
+		//heavy cells
+		if (static_cast<size_t>(m_context.nextHeavyCell.load()) < m_context.heavyCellCount)
+		{
+			size_t heavyIndex = static_cast<size_t>(m_context.nextHeavyCell.fetchAndAddRelaxed(1));
+			if (heavyIndex < m_context.heavyCellCount)
+			{
+				cellIndex = heavyIndex;
+				return true;
+			}
+		}
+
+		while (true)
+		{
+			//own queue
+			{
+				QMutexLocker locker(&m_queue.mutex);
+				if (m_queue.front < m_queue.back)
+				{
+					cellIndex = m_queue.front++;
+					return true;
+				}
+			}
+
+			//steal the second half of the most loaded queue
+			CellsQueue* victim = 0;
+			size_t victimRemaining = 0;
+			for (unsigned i = 0; i < m_context.queueCount; ++i)
+			{
+				size_t remaining = m_context.queues[i].remaining();
+				if (remaining > victimRemaining)
+				{
+					victim = m_context.queues + i;
+					victimRemaining = remaining;
+				}
+			}
+
+			if (!victim)
+			{
+				//all the queues are empty
+				return false;
+			}
+
+			size_t stolenFront = 0, stolenBack = 0;
+			{
+				QMutexLocker locker(&victim->mutex);
+				if (victim->front < victim->back)
+				{
+					size_t half = (victim->back - victim->front + 1) / 2;
+					stolenBack = victim->back;
+					stolenFront = victim->back - half;
+					victim->back = stolenFront;
+				}
+			}
+
+			if (stolenFront < stolenBack)
+			{
+				QMutexLocker locker(&m_queue.mutex);
+				m_queue.front = stolenFront;
+				m_queue.back = stolenBack;
+				++m_queue.stealCount;
+			}
+			//otherwise the victim emptied its queue in the meantime: we try again
+		}
+	}
+
+	//! Shared context
+	CellsProcessingContext& m_context;
+	//! Own queue
+	CellsQueue& m_queue;
+};
+
+//! Processes a set of cells in parallel
+/** The most populated cells are processed first. The other cells are split in contiguous
+	sets (one per thread) and the threads steal cells from each others once they are done.
+	\param context processing context (cells, function, etc.)
+	\param maxThreadCount max number of threads (0 = all)
+	\param stats load balancing statistics (output)
+	\return success
+**/
+static bool ProcessCells_MT(CellsProcessingContext& context, int maxThreadCount, DgmOctree::CellsProcessingStats& stats)
+{
+	std::vector<octreeCellDesc>& cells = context.cells;
+	if (cells.empty())
+	{
+		return true;
+	}
+
+	if (maxThreadCount <= 0)
+	{
+		maxThreadCount = QThread::idealThreadCount();
+	}
+	unsigned threadCount = static_cast<unsigned>(std::max(1, maxThreadCount));
+	if (threadCount > cells.size())
+	{
+		threadCount = static_cast<unsigned>(cells.size());
+	}
+
+	//we move the heavy cells at the beginning (by decreasing population)
+	{
+		unsigned long long popSum = 0;
+		for (size_t i = 0; i < cells.size(); ++i)
+		{
+			popSum += cells[i].i2 - cells[i].i1 + 1;
+		}
+		const PointIndexType heavyThreshold = static_cast<PointIndexType>(HEAVY_CELL_POPULATION_FACTOR * popSum / cells.size());
+
+		std::vector<octreeCellDesc> heavyCells;
+		size_t lightCount = 0;
+		for (size_t i = 0; i < cells.size(); ++i)
+		{
+			if (cells[i].i2 - cells[i].i1 + 1 > heavyThreshold)
+			{
+				try
+				{
+					heavyCells.push_back(cells[i]);
+				}
+				catch (const std::bad_alloc&)
+				{
+					//not enough memory: we'll process this cell normally
+					cells[lightCount++] = cells[i];
+				}
+			}
+			else
+			{
+				cells[lightCount++] = cells[i];
+			}
+		}
+
+		if (!heavyCells.empty())
+		{
+			std::sort(heavyCells.begin(), heavyCells.end(), CellPopulationComp);
+
+			//shift the light cells and put the heavy ones first
+			std::copy_backward(cells.begin(), cells.begin() + lightCount, cells.end());
+			std::copy(heavyCells.begin(), heavyCells.end(), cells.begin());
+		}
+		context.heavyCellCount = heavyCells.size();
+	}
+
+	//we split the other cells in contiguous sets (one per thread)
+	context.queueCount = threadCount;
+	context.queues = new CellsQueue[threadCount];
+	{
+		size_t lightCount = cells.size() - context.heavyCellCount;
+		for (unsigned t = 0; t < threadCount; ++t)
+		{
+			context.queues[t].front = context.heavyCellCount + (lightCount * t) / threadCount;
+			context.queues[t].back = context.heavyCellCount + (lightCount * (t + 1)) / threadCount;
+		}
+	}
+
+	//we use a dedicated thread pool (so as to leave the global one untouched)
+	QElapsedTimer timer;
+	timer.start();
+	{
+		QThreadPool threadPool;
+		threadPool.setMaxThreadCount(static_cast<int>(threadCount));
+		for (unsigned t = 0; t < threadCount; ++t)
+		{
+			threadPool.start(new CellsWorker(context, t)); //auto-deleted
+		}
+		threadPool.waitForDone();
+	}
+	qint64 totalTime_ns = timer.nsecsElapsed();
+
+	//statistics
+	stats = DgmOctree::CellsProcessingStats();
+	stats.threadCount = threadCount;
+	stats.cellCount = static_cast<unsigned>(cells.size());
+	stats.heavyCellCount = static_cast<unsigned>(context.heavyCellCount);
+	stats.totalTime_s = totalTime_ns / 1.0e9;
+	qint64 busyTime_ns = 0;
+	for (unsigned t = 0; t < threadCount; ++t)
+	{
+		const CellsQueue& queue = context.queues[t];
+		busyTime_ns += queue.busyTime_ns;
+		stats.stealCount += queue.stealCount;
+		if (queue.maxCellTime_ns / 1.0e9 > stats.maxCellTime_s)
+		{
+			stats.maxCellTime_s = queue.maxCellTime_ns / 1.0e9;
+			stats.maxCellTimePopulation = queue.maxCellTimePopulation;
+		}
 	}
+	stats.idleTime_s = std::max<qint64>(0, threadCount * totalTime_ns - busyTime_ns) / 1.0e9;
+
+	return (context.success.load() != 0);
 }
 
 #endif
@@ -3468,17 +4640,12 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(	unsigned char level,
 		//don't forget the last cell!
 		cells.push_back(cellDesc);
 
-		//static wrap
-		s_octree_MT = this;
-		s_func_MT = func;
-		s_userParams_MT = additionalParameters;
-		s_cellFunc_MT_success = true;
-		s_progressCb_MT = progressCb;
-		if (s_normProgressCb_MT)
-		{
-			delete s_normProgressCb_MT;
-			s_normProgressCb_MT = 0;
-		}
+		//processing context
+		CellsProcessingContext context;
+		context.octree = this;
+		context.func = func;
+		context.userParams = additionalParameters;
+		context.progressCb = progressCb;
 
 		//progress notification
 		if (progressCb)
@@ -3494,7 +4661,7 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(	unsigned char level,
 				progressCb->setInfo(buffer);
 			}
 			progressCb->update(0);
-			s_normProgressCb_MT = new NormalizedProgress(progressCb,m_theAssociatedCloud->size());
+			context.normProgressCb = new NormalizedProgress(progressCb,m_theAssociatedCloud->size());
 			progressCb->start();
 		}
 
@@ -3505,12 +4672,8 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(	unsigned char level,
 		s_binarySearchCount = 0.0;
 #endif
 
-		if (maxThreadCount == 0)
-		{
-			maxThreadCount = QThread::idealThreadCount();
-		}
-		QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
-		QtConcurrent::blockingMap(cells, LaunchOctreeCellFunc_MT);
+		context.cells.swap(cells);
+		bool success = ProcessCells_MT(context, maxThreadCount, m_lastCellsProcessingStats);
 
 #ifdef COMPUTE_NN_SEARCH_STATISTICS
 		FILE* fp = fopen("octree_log.txt", "at");
@@ -3527,24 +4690,16 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(	unsigned char level,
 		}
 #endif
 
-		s_octree_MT = 0;
-		s_func_MT = 0;
-		s_userParams_MT = 0;
-
 		if (progressCb)
 		{
 			progressCb->stop();
-			if (s_normProgressCb_MT)
-				delete s_normProgressCb_MT;
-			s_normProgressCb_MT = 0;
-			s_progressCb_MT = 0;
 		}
 
-		//if something went wrong, we clear everything and return 0!
-		if (!s_cellFunc_MT_success)
-			cells.clear();
+		//if something went wrong, we return 0!
+		if (!success)
+			return 0;
 
-		return static_cast<unsigned>(cells.size());
+		return static_cast<unsigned>(context.cells.size());
 	}
 #endif
 }
@@ -3644,7 +4799,7 @@ unsigned DgmOctree::executeFunctionForAllCellsStartingAtLevel(unsigned char star
 			//new cell
 			cell.truncatedCode = (startingElement->theCode >> currentBitDec);
 			//we can already 'add' (virtually) the first point to the current cell description struct
-			unsigned elements = 1;
+			PointIndexType elements = 1;
 
 			//progress notification
 #ifndef ENABLE_DOWN_TOP_TRAVERSAL
@@ -3796,7 +4951,7 @@ unsigned DgmOctree::executeFunctionForAllCellsStartingAtLevel(unsigned char star
 			break;
 			}
 			//*/
-			for (unsigned i = 0; i < elements; ++i)
+			for (PointIndexType i = 0; i < elements; ++i)
 			{
 				cell.points->addPointIndex((startingElement++)->theIndex);
 			}
@@ -3869,7 +5024,7 @@ unsigned DgmOctree::executeFunctionForAllCellsStartingAtLevel(unsigned char star
 			//new cell
 			cellDesc.truncatedCode = (startingElement->theCode >> currentBitDec);
 			//we can already 'add' (virtually) the first point to the current cell description struct
-			unsigned elements = 1;
+			PointIndexType elements = 1;
 
 			//let's test the following points
 			for (cellsContainer::const_iterator p = startingElement+1; p != m_thePointsAndTheirCellCodes.end(); ++p)
@@ -3993,7 +5148,7 @@ unsigned DgmOctree::executeFunctionForAllCellsStartingAtLevel(unsigned char star
 			cellDesc.i2 = cellDesc.i1 + (elements-1);
 			cells.push_back(cellDesc);
 			popSum += static_cast<unsigned long long>(elements);
-			popSum2 += static_cast<unsigned long long>(elements*elements);
+			popSum2 += static_cast<unsigned long long>(elements) * elements;
 			if (maxPop < elements)
 				maxPop = elements;
 
@@ -4017,14 +5172,12 @@ unsigned DgmOctree::executeFunctionForAllCellsStartingAtLevel(unsigned char star
 		double mean = static_cast<double>(popSum) / cells.size();
 		double stddev = sqrt(static_cast<double>(popSum2 - popSum*popSum)) / cells.size();
 
-		//static wrap
-		s_octree_MT = this;
-		s_func_MT = func;
-		s_userParams_MT = additionalParameters;
-		s_cellFunc_MT_success = true;
-		if (s_normProgressCb_MT)
-			delete s_normProgressCb_MT;
-		s_normProgressCb_MT = 0;
+		//processing context
+		CellsProcessingContext context;
+		context.octree = this;
+		context.func = func;
+		context.userParams = additionalParameters;
+		context.progressCb = progressCb;
 
 		//progress notification
 		if (progressCb)
@@ -4039,11 +5192,7 @@ unsigned DgmOctree::executeFunctionForAllCellsStartingAtLevel(unsigned char star
 				sprintf(buffer, "Octree levels %i - %i\nCells: %i\nAverage population: %3.2f (+/-%3.2f)\nMax population: %llu", startingLevel, MAX_OCTREE_LEVEL, static_cast<int>(cells.size()), mean, stddev, maxPop);
 				progressCb->setInfo(buffer);
 			}
-			if (s_normProgressCb_MT)
-			{
-				delete s_normProgressCb_MT;
-			}
-			s_normProgressCb_MT = new NormalizedProgress(progressCb,static_cast<unsigned>(cells.size()));
+			context.normProgressCb = new NormalizedProgress(progressCb,static_cast<unsigned>(cells.size()));
 			progressCb->update(0);
 			progressCb->start();
 		}
@@ -4055,12 +5204,8 @@ unsigned DgmOctree::executeFunctionForAllCellsStartingAtLevel(unsigned char star
 		s_binarySearchCount = 0.0;
 #endif
 
-		if (maxThreadCount == 0)
-		{
-			maxThreadCount = QThread::idealThreadCount();
-		}
-		QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
-		QtConcurrent::blockingMap(cells, LaunchOctreeCellFunc_MT);
+		context.cells.swap(cells);
+		bool success = ProcessCells_MT(context, maxThreadCount, m_lastCellsProcessingStats);
 
 #ifdef COMPUTE_NN_SEARCH_STATISTICS
 		FILE* fp=fopen("octree_log.txt","at");
@@ -4077,23 +5222,16 @@ unsigned DgmOctree::executeFunctionForAllCellsStartingAtLevel(unsigned char star
 		}
 #endif
 
-		s_octree_MT = 0;
-		s_func_MT = 0;
-		s_userParams_MT = 0;
-
 		if (progressCb)
 		{
 			progressCb->stop();
-			if (s_normProgressCb_MT)
-				delete s_normProgressCb_MT;
-			s_normProgressCb_MT = 0;
 		}
 
-		//if something went wrong, we clear everything and return 0!
-		if (!s_cellFunc_MT_success)
-			cells.clear();
+		//if something went wrong, we return 0!
+		if (!success)
+			return 0;
 
-		return static_cast<unsigned>(cells.size());
+		return static_cast<unsigned>(context.cells.size());
 	}
 #endif
 }
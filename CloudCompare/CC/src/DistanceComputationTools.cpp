@@ -36,8 +36,10 @@
 #include "LocalModel.h"
 #include "SimpleTriangle.h"
 #include "ScalarField.h"
+#include "TriangleBVH.h"
 
 //system
+#include <algorithm>
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
@@ -50,6 +52,23 @@
 #endif
 #endif
 
+#ifdef ENABLE_CLOUD2MESH_DIST_MT
+#include <QtConcurrentMap>
+#endif
+
+//enables SIMD point-to-triangles distances computation
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ENABLE_SIMD_TRIANGLE_DIST
+#endif
+
+#ifdef ENABLE_SIMD_TRIANGLE_DIST
+#ifdef __AVX__
+#include <immintrin.h>
+#else
+#include <emmintrin.h>
+#endif
+#endif
+
 namespace CCLib
 {
 
@@ -147,9 +166,10 @@ int DistanceComputationTools::computeCloud2CloudDistance(	GenericIndexedCloudPer
 {
 	assert(comparedCloud && referenceCloud);
 
-	if (params.CPSet && params.maxSearchDist > 0)
+	if (params.CPSet && params.maxSearchDist > 0 && (!params.CPSetValidity || referenceCloud->size() == 0))
 	{
-		//we can't use a 'max search distance' criterion if the "Closest Point Set" is requested
+		//with a 'max search distance' criterion, some points may have no closest point: we need
+		//the validity array to report them (and at least one reference point as placeholder)
 		assert(false);
 		return -666;
 	}
@@ -182,8 +202,6 @@ int DistanceComputationTools::computeCloud2CloudDistance(	GenericIndexedCloudPer
 	//closest point set
 	if (params.CPSet)
 	{
-		assert(maxSearchSquareDistd <= 0);
-		
 		if (!params.CPSet->resize(comparedCloud->size()))
 		{
 			//not enough memory
@@ -193,6 +211,30 @@ int DistanceComputationTools::computeCloud2CloudDistance(	GenericIndexedCloudPer
 				delete referenceOctree;
 			return -1;
 		}
+
+		if (maxSearchSquareDistd > 0)
+		{
+			//the points farther than 'maxSearchDist' won't be processed (they may even lie outside the octree):
+			//they keep a valid placeholder index and are flagged as having no closest point
+			try
+			{
+				params.CPSetValidity->assign(comparedCloud->size(), 0);
+			}
+			catch (const std::bad_alloc&)
+			{
+				//not enough memory
+				if (comparedOctree && !compOctree)
+					delete comparedOctree;
+				if (referenceOctree && !refOctree)
+					delete referenceOctree;
+				return -1;
+			}
+
+			for (unsigned i = 0; i < comparedCloud->size(); ++i)
+			{
+				params.CPSet->setPointIndex(i, 0);
+			}
+		}
 	}
 
 	//by default we reset any former value stored in the 'enabled' scalar field
@@ -241,6 +283,12 @@ int DistanceComputationTools::computeCloud2CloudDistance(	GenericIndexedCloudPer
 
 	int result = 0;
 
+	//SIMD friendly copy of the reference points (for the nearest neighbour search)
+	//DGM: it is released right after so that it can't be outdated if the reference cloud is modified
+	//(no big deal if there's not enough memory, the search will use the points directly)
+	if (referenceOctree)
+		referenceOctree->updateSortedPointsCoordinates();
+
 	if (comparedOctree->executeFunctionForAllCellsAtLevel(	params.octreeLevel,
 															params.localModel == NO_MODEL ? computeCellHausdorffDistance : computeCellHausdorffDistanceWithLocalModel,
 															additionalParameters,
@@ -253,6 +301,9 @@ int DistanceComputationTools::computeCloud2CloudDistance(	GenericIndexedCloudPer
 		result = -2;
 	}
 
+	if (referenceOctree)
+		referenceOctree->releaseSortedPointsCoordinates();
+
 	if (comparedOctree && !compOctree)
 	{
 		delete comparedOctree;
@@ -312,6 +363,27 @@ DistanceComputationTools::SOReturnCode
 		}
 	}
 
+	//if both octrees have already been built with the same bounding-box and if all
+	//the points of both clouds have been projected, we can use them as is (this way
+	//the caller can keep the reference octree across several calls, see ICP)
+	if (	comparedOctree && referenceOctree
+		&&	comparedOctree->getNumberOfProjectedPoints() == nA
+		&&	referenceOctree->getNumberOfProjectedPoints() == nB )
+	{
+		bool sameBox = true;
+		for (unsigned char k=0; k<3; k++)
+		{
+			if (	comparedOctree->getOctreeMins().u[k] != referenceOctree->getOctreeMins().u[k]
+				||	comparedOctree->getOctreeMaxs().u[k] != referenceOctree->getOctreeMaxs().u[k] )
+			{
+				sameBox = false;
+				break;
+			}
+		}
+		if (sameBox)
+			return SYNCHRONIZED;
+	}
+
 	CCVector3 minPoints = minD;
 	CCVector3 maxPoints = maxD;
 
@@ -453,7 +525,10 @@ bool DistanceComputationTools::computeCellHausdorffDistance(const DgmOctree::oct
 
 				if (params->CPSet)
 				{
-					params->CPSet->setPointIndex(cell.points->getPointGlobalIndex(i), nNSS.theNearestPointIndex);
+					unsigned index = cell.points->getPointGlobalIndex(i);
+					params->CPSet->setPointIndex(index, nNSS.theNearestPointIndex);
+					if (nNSS.maxSearchSquareDistd > 0)
+						(*params->CPSetValidity)[index] = 1;
 				}
 
 				if (computeSplitDistances)
@@ -470,10 +545,6 @@ bool DistanceComputationTools::computeCellHausdorffDistance(const DgmOctree::oct
 						params->splitDistances[2]->setValue(index, static_cast<ScalarType>(nNSS.queryPoint.z - P.z));
 				}
 			}
-			else
-			{
-				assert(!params->CPSet);
-			}
 		}
 		else
 		{
@@ -694,9 +765,13 @@ bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(	const
 				distPt = static_cast<ScalarType>(sqrt(nNSS.maxSearchSquareDistd));
 			}
 
-			if (params->CPSet)
+			if (params->CPSet && squareDistToNearestPoint >= 0)
 			{
-				params->CPSet->setPointIndex(cell.points->getPointGlobalIndex(i), nNSS.theNearestPointIndex);
+				//(otherwise no neighbour below 'maxSearchDist' --> the point keeps its placeholder and its 'invalid' flag)
+				unsigned index = cell.points->getPointGlobalIndex(i);
+				params->CPSet->setPointIndex(index, nNSS.theNearestPointIndex);
+				if (nNSS.maxSearchSquareDistd > 0)
+					(*params->CPSetValidity)[index] = 1;
 			}
 		}
 	
@@ -978,6 +1053,318 @@ int DistanceComputationTools::intersectMeshWithOctree(	OctreeAndMeshIntersection
 	return result;
 }
 
+/**********************************/
+/* POINT TO TRIANGLES DISTANCES   */
+/**********************************/
+
+#ifdef ENABLE_SIMD_TRIANGLE_DIST
+#ifdef __AVX__
+//! SIMD vector of doubles (4 triangles at once)
+typedef __m256d SimdDouble;
+static inline SimdDouble SimdLoad(const double* p) { return _mm256_loadu_pd(p); }
+static inline void SimdStore(double* p, SimdDouble a) { _mm256_storeu_pd(p, a); }
+static inline SimdDouble SimdSet1(double v) { return _mm256_set1_pd(v); }
+static inline SimdDouble SimdAdd(SimdDouble a, SimdDouble b) { return _mm256_add_pd(a, b); }
+static inline SimdDouble SimdSub(SimdDouble a, SimdDouble b) { return _mm256_sub_pd(a, b); }
+static inline SimdDouble SimdMul(SimdDouble a, SimdDouble b) { return _mm256_mul_pd(a, b); }
+static inline SimdDouble SimdMin(SimdDouble a, SimdDouble b) { return _mm256_min_pd(a, b); }
+static inline SimdDouble SimdMax(SimdDouble a, SimdDouble b) { return _mm256_max_pd(a, b); }
+static inline SimdDouble SimdAnd(SimdDouble a, SimdDouble b) { return _mm256_and_pd(a, b); }
+static inline SimdDouble SimdGreaterOrEqual(SimdDouble a, SimdDouble b) { return _mm256_cmp_pd(a, b, _CMP_GE_OQ); }
+static inline SimdDouble SimdGreater(SimdDouble a, SimdDouble b) { return _mm256_cmp_pd(a, b, _CMP_GT_OQ); }
+static inline SimdDouble SimdSelect(SimdDouble mask, SimdDouble a, SimdDouble b) { return _mm256_blendv_pd(b, a, mask); }
+static const unsigned SIMD_DOUBLE_WIDTH = 4;
+#else
+//! SIMD vector of doubles (2 triangles at once)
+typedef __m128d SimdDouble;
+static inline SimdDouble SimdLoad(const double* p) { return _mm_loadu_pd(p); }
+static inline void SimdStore(double* p, SimdDouble a) { _mm_storeu_pd(p, a); }
+static inline SimdDouble SimdSet1(double v) { return _mm_set1_pd(v); }
+static inline SimdDouble SimdAdd(SimdDouble a, SimdDouble b) { return _mm_add_pd(a, b); }
+static inline SimdDouble SimdSub(SimdDouble a, SimdDouble b) { return _mm_sub_pd(a, b); }
+static inline SimdDouble SimdMul(SimdDouble a, SimdDouble b) { return _mm_mul_pd(a, b); }
+static inline SimdDouble SimdMin(SimdDouble a, SimdDouble b) { return _mm_min_pd(a, b); }
+static inline SimdDouble SimdMax(SimdDouble a, SimdDouble b) { return _mm_max_pd(a, b); }
+static inline SimdDouble SimdAnd(SimdDouble a, SimdDouble b) { return _mm_and_pd(a, b); }
+static inline SimdDouble SimdGreaterOrEqual(SimdDouble a, SimdDouble b) { return _mm_cmpge_pd(a, b); }
+static inline SimdDouble SimdGreater(SimdDouble a, SimdDouble b) { return _mm_cmpgt_pd(a, b); }
+static inline SimdDouble SimdSelect(SimdDouble mask, SimdDouble a, SimdDouble b) { return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b)); }
+static const unsigned SIMD_DOUBLE_WIDTH = 2;
+#endif
+#endif
+
+//! Set of triangles prepared for fast point-to-triangles distances computation
+/** The per-triangle data (first vertex, edges, normal and barycentric basis) is computed
+	once and stored as a structure of arrays, so that several triangles can be processed
+	at once (SIMD). As in DistanceComputationTools::computePoint2TriangleDistance, all
+	computations are done with double precision.
+**/
+class TriangleBatch
+{
+public:
+
+	//! Default constructor
+	TriangleBatch()
+		: m_count(0)
+		, m_stride(0)
+	{}
+
+	//! Prepares a set of triangles
+	/** The triangles are stored in reverse order (i.e. in the order they are popped from
+		'triangleIndexes' by ComparePointsAndTriangles).
+		\return false if there's not enough memory
+	**/
+	bool prepare(GenericIndexedMesh* mesh, const std::vector<unsigned>& triangleIndexes, size_t count)
+	{
+		m_count = 0;
+		if (count == 0)
+		{
+			return false;
+		}
+
+		//we pad the arrays to process complete blocks only
+		size_t stride = ((count + 3) / 4) * 4;
+		try
+		{
+			if (m_squareDists.size() < stride)
+			{
+				m_data.resize(COMPONENT_COUNT * stride);
+				m_squareDists.resize(stride);
+				m_planeDists.resize(stride);
+			}
+			m_indexes.resize(count);
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			m_stride = 0;
+			return false;
+		}
+		m_stride = stride;
+
+		for (size_t i = 0; i < stride; ++i)
+		{
+			//the padding triangles are copies of the last one (they can't be 'strictly' closer)
+			unsigned triIndex = triangleIndexes[count - 1 - std::min(i, count - 1)];
+			if (i < count)
+			{
+				m_indexes[i] = triIndex;
+			}
+
+			CCVector3 A, B, C;
+			mesh->getTriangleVertices(triIndex, A, B, C);
+
+			CCVector3d AB(B.x - A.x, B.y - A.y, B.z - A.z);
+			CCVector3d AC(C.x - A.x, C.y - A.y, C.z - A.z);
+			CCVector3d N = AB.cross(AC);
+
+			double a00 = AB.dot(AB);
+			double a01 = AB.dot(AC);
+			double a11 = AC.dot(AC);
+			double bc2 = a00 - 2 * a01 + a11;
+			//the squared norm of the normal is also the determinant of the barycentric basis (a00 * a11 - a01 * a01)
+			double n2 = N.norm2();
+
+			component(AX)[i] = A.x;
+			component(AY)[i] = A.y;
+			component(AZ)[i] = A.z;
+			component(ABX)[i] = AB.x;
+			component(ABY)[i] = AB.y;
+			component(ABZ)[i] = AB.z;
+			component(ACX)[i] = AC.x;
+			component(ACY)[i] = AC.y;
+			component(ACZ)[i] = AC.z;
+			component(NX)[i] = N.x;
+			component(NY)[i] = N.y;
+			component(NZ)[i] = N.z;
+			component(A00)[i] = a00;
+			component(A01)[i] = a01;
+			component(A11)[i] = a11;
+			//degenerate triangles (or edges) get null inverses
+			component(INV_N2)[i] = (n2 > 0 ? 1.0 / n2 : 0);
+			component(INV_AB2)[i] = (a00 > 0 ? 1.0 / a00 : 0);
+			component(INV_AC2)[i] = (a11 > 0 ? 1.0 / a11 : 0);
+			component(INV_BC2)[i] = (bc2 > 0 ? 1.0 / bc2 : 0);
+		}
+
+		m_count = count;
+		return true;
+	}
+
+	//! Returns the number of triangles
+	inline size_t size() const { return m_count; }
+
+	//! Returns the index of a triangle (in the mesh)
+	inline unsigned triangleIndex(size_t i) const { return m_indexes[i]; }
+
+	//! Returns the nearest triangle to a given point
+	/** \param P query point
+		\param squareDist squared distance to the nearest triangle
+		\param negativeSide whether the point lies on the negative side of the nearest triangle (see DistanceComputationTools::computePoint2TriangleDistance)
+		\return the position of the nearest triangle in the batch (the first one in case of equality)
+	**/
+	size_t findNearestTriangle(const CCVector3& P, double& squareDist, bool& negativeSide)
+	{
+		assert(m_count != 0);
+		computeDistances(P);
+
+		size_t nearest = 0;
+		for (size_t i = 1; i < m_count; ++i)
+		{
+			if (m_squareDists[i] < m_squareDists[nearest])
+			{
+				nearest = i;
+			}
+		}
+
+		squareDist = m_squareDists[nearest];
+		negativeSide = (m_planeDists[nearest] < 0);
+		return nearest;
+	}
+
+protected:
+
+	//! Per-triangle data
+	enum Component {	AX, AY, AZ,			//first vertex
+						ABX, ABY, ABZ,		//1st edge
+						ACX, ACY, ACZ,		//2nd edge
+						NX, NY, NZ,			//normal (not normalized)
+						A00, A01, A11,		//barycentric basis (dot products of AB and AC)
+						INV_N2,				//inverse of the normal squared norm (= inverse of the barycentric basis determinant)
+						INV_AB2, INV_AC2, INV_BC2,	//inverse of the edges squared lengths
+						COMPONENT_COUNT
+	};
+
+	//! Returns the array of a given component
+	inline double* component(Component c) { return &(m_data[c * m_stride]); }
+
+	//! Computes the squared distances and the (non normalized) signed distances to the triangles planes
+	void computeDistances(const CCVector3& P)
+	{
+		const double* ax = component(AX);
+		const double* ay = component(AY);
+		const double* az = component(AZ);
+		const double* abx = component(ABX);
+		const double* aby = component(ABY);
+		const double* abz = component(ABZ);
+		const double* acx = component(ACX);
+		const double* acy = component(ACY);
+		const double* acz = component(ACZ);
+		const double* nx = component(NX);
+		const double* ny = component(NY);
+		const double* nz = component(NZ);
+		const double* a00 = component(A00);
+		const double* a01 = component(A01);
+		const double* a11 = component(A11);
+		const double* invN2 = component(INV_N2);
+		const double* invAB2 = component(INV_AB2);
+		const double* invAC2 = component(INV_AC2);
+		const double* invBC2 = component(INV_BC2);
+
+		size_t i = 0;
+#ifdef ENABLE_SIMD_TRIANGLE_DIST
+		const SimdDouble px = SimdSet1(P.x);
+		const SimdDouble py = SimdSet1(P.y);
+		const SimdDouble pz = SimdSet1(P.z);
+		const SimdDouble zero = SimdSet1(0.0);
+		const SimdDouble one = SimdSet1(1.0);
+		for (; i < m_stride; i += SIMD_DOUBLE_WIDTH)
+		{
+			SimdDouble apx = SimdSub(px, SimdLoad(ax + i));
+			SimdDouble apy = SimdSub(py, SimdLoad(ay + i));
+			SimdDouble apz = SimdSub(pz, SimdLoad(az + i));
+			SimdDouble ABx = SimdLoad(abx + i), ABy = SimdLoad(aby + i), ABz = SimdLoad(abz + i);
+			SimdDouble ACx = SimdLoad(acx + i), ACy = SimdLoad(acy + i), ACz = SimdLoad(acz + i);
+			SimdDouble BCx = SimdSub(ACx, ABx), BCy = SimdSub(ACy, ABy), BCz = SimdSub(ACz, ABz);
+
+			SimdDouble d1 = SimdAdd(SimdAdd(SimdMul(apx, ABx), SimdMul(apy, ABy)), SimdMul(apz, ABz));
+			SimdDouble d2 = SimdAdd(SimdAdd(SimdMul(apx, ACx), SimdMul(apy, ACy)), SimdMul(apz, ACz));
+			SimdDouble dn = SimdAdd(SimdAdd(SimdMul(apx, SimdLoad(nx + i)), SimdMul(apy, SimdLoad(ny + i))), SimdMul(apz, SimdLoad(nz + i)));
+
+			//barycentric coordinates of the projection
+			SimdDouble inv = SimdLoad(invN2 + i);
+			SimdDouble s = SimdMul(SimdSub(SimdMul(SimdLoad(a11 + i), d1), SimdMul(SimdLoad(a01 + i), d2)), inv);
+			SimdDouble t = SimdMul(SimdSub(SimdMul(SimdLoad(a00 + i), d2), SimdMul(SimdLoad(a01 + i), d1)), inv);
+			SimdDouble inside = SimdAnd(SimdAnd(SimdGreaterOrEqual(s, zero), SimdGreaterOrEqual(t, zero)),
+										SimdAnd(SimdGreaterOrEqual(one, SimdAdd(s, t)), SimdGreater(inv, zero)));
+
+			//distance to the plane
+			SimdDouble planeDist2 = SimdMul(SimdMul(dn, dn), inv);
+
+			//distance to the edges
+			SimdDouble u = SimdMin(SimdMax(SimdMul(d1, SimdLoad(invAB2 + i)), zero), one);
+			SimdDouble ex = SimdSub(apx, SimdMul(u, ABx));
+			SimdDouble ey = SimdSub(apy, SimdMul(u, ABy));
+			SimdDouble ez = SimdSub(apz, SimdMul(u, ABz));
+			SimdDouble edgeDist2 = SimdAdd(SimdAdd(SimdMul(ex, ex), SimdMul(ey, ey)), SimdMul(ez, ez));
+
+			u = SimdMin(SimdMax(SimdMul(d2, SimdLoad(invAC2 + i)), zero), one);
+			ex = SimdSub(apx, SimdMul(u, ACx));
+			ey = SimdSub(apy, SimdMul(u, ACy));
+			ez = SimdSub(apz, SimdMul(u, ACz));
+			edgeDist2 = SimdMin(edgeDist2, SimdAdd(SimdAdd(SimdMul(ex, ex), SimdMul(ey, ey)), SimdMul(ez, ez)));
+
+			SimdDouble bpx = SimdSub(apx, ABx);
+			SimdDouble bpy = SimdSub(apy, ABy);
+			SimdDouble bpz = SimdSub(apz, ABz);
+			SimdDouble d3 = SimdAdd(SimdAdd(SimdMul(bpx, BCx), SimdMul(bpy, BCy)), SimdMul(bpz, BCz));
+			u = SimdMin(SimdMax(SimdMul(d3, SimdLoad(invBC2 + i)), zero), one);
+			ex = SimdSub(bpx, SimdMul(u, BCx));
+			ey = SimdSub(bpy, SimdMul(u, BCy));
+			ez = SimdSub(bpz, SimdMul(u, BCz));
+			edgeDist2 = SimdMin(edgeDist2, SimdAdd(SimdAdd(SimdMul(ex, ex), SimdMul(ey, ey)), SimdMul(ez, ez)));
+
+			SimdStore(&(m_squareDists[i]), SimdSelect(inside, planeDist2, edgeDist2));
+			SimdStore(&(m_planeDists[i]), dn);
+		}
+#endif
+		for (; i < m_stride; ++i)
+		{
+			CCVector3d AP(P.x - ax[i], P.y - ay[i], P.z - az[i]);
+			CCVector3d AB(abx[i], aby[i], abz[i]);
+			CCVector3d AC(acx[i], acy[i], acz[i]);
+			CCVector3d BC = AC - AB;
+
+			double d1 = AP.dot(AB);
+			double d2 = AP.dot(AC);
+			double dn = AP.x * nx[i] + AP.y * ny[i] + AP.z * nz[i];
+			m_planeDists[i] = dn;
+
+			//barycentric coordinates of the projection
+			double s = (a11[i] * d1 - a01[i] * d2) * invN2[i];
+			double t = (a00[i] * d2 - a01[i] * d1) * invN2[i];
+			if (s >= 0 && t >= 0 && s + t <= 1.0 && invN2[i] > 0)
+			{
+				//the point projects inside the triangle
+				m_squareDists[i] = dn * dn * invN2[i];
+				continue;
+			}
+
+			//otherwise the nearest point lies on one of the edges
+			double u = std::min(std::max(d1 * invAB2[i], 0.0), 1.0);
+			double edgeDist2 = (AP - u * AB).norm2();
+			u = std::min(std::max(d2 * invAC2[i], 0.0), 1.0);
+			edgeDist2 = std::min(edgeDist2, (AP - u * AC).norm2());
+			CCVector3d BP = AP - AB;
+			u = std::min(std::max(BP.dot(BC) * invBC2[i], 0.0), 1.0);
+			m_squareDists[i] = std::min(edgeDist2, (BP - u * BC).norm2());
+		}
+	}
+
+	//! Per-triangle data (structure of arrays)
+	std::vector<double> m_data;
+	//! Triangles indexes
+	std::vector<unsigned> m_indexes;
+	//! Squared distances (for the current query point)
+	std::vector<double> m_squareDists;
+	//! Non normalized signed distances to the triangles planes (for the current query point)
+	std::vector<double> m_planeDists;
+	//! Number of triangles
+	size_t m_count;
+	//! Size of each component array (number of triangles + padding)
+	size_t m_stride;
+};
+
 //! Method used by computeCloud2MeshDistanceWithOctree
 void ComparePointsAndTriangles(	ReferenceCloud& Yk,
 								unsigned& remainingPoints,
@@ -986,7 +1373,8 @@ void ComparePointsAndTriangles(	ReferenceCloud& Yk,
 								size_t& trianglesToTestCount,
 								std::vector<ScalarType>& minDists,
 								ScalarType maxRadius,
-								CCLib::DistanceComputationTools::Cloud2MeshDistanceComputationParams& params)
+								CCLib::DistanceComputationTools::Cloud2MeshDistanceComputationParams& params,
+								TriangleBatch& batch)
 {
 	assert(mesh);
 	assert(remainingPoints <= Yk.size());
@@ -997,7 +1385,55 @@ void ComparePointsAndTriangles(	ReferenceCloud& Yk,
 	CCVector3 nearestPoint;
 	CCVector3* _nearestPoint = params.CPSet ? &nearestPoint : 0;
 
-	//for each triangle
+	//we compare each point with all the triangles at once (if there's enough memory)
+	if (batch.prepare(mesh, trianglesToTest, trianglesToTestCount))
+	{
+		trianglesToTestCount = 0;
+
+		//for each point inside the current cell
+		for (unsigned j=0; j<remainingPoints; ++j)
+		{
+			const CCVector3* P = Yk.getPoint(j);
+
+			//get the nearest triangle
+			double squareDist = 0;
+			bool negativeSide = false;
+			size_t nearestTri = batch.findNearestTriangle(*P, squareDist, negativeSide);
+
+			//keep the distance if it's smaller
+			ScalarType min_d = Yk.getPointScalarValue(j);
+			ScalarType dPTri = 0;
+			bool isSmaller = false;
+			if (params.signedDistances)
+			{
+				//we have to use absolute distances
+				dPTri = static_cast<ScalarType>(sqrt(squareDist));
+				isSmaller = (!ScalarField::ValidValue(min_d) || min_d*min_d > dPTri*dPTri);
+				if (negativeSide != params.flipNormals)
+					dPTri = -dPTri;
+			}
+			else //squared distances
+			{
+				dPTri = static_cast<ScalarType>(squareDist);
+				isSmaller = (!ScalarField::ValidValue(min_d) || dPTri < min_d);
+			}
+
+			if (isSmaller)
+			{
+				Yk.setPointScalarValue(j, dPTri);
+				if (params.CPSet)
+				{
+					//Closest Point Set: save the nearest point as well
+					CCLib::SimpleTriangle tri;
+					mesh->getTriangleVertices(batch.triangleIndex(nearestTri), tri.A, tri.B, tri.C);
+					DistanceComputationTools::computePoint2TriangleDistance(P, &tri, false, _nearestPoint);
+					*const_cast<CCVector3*>(params.CPSet->getPoint(Yk.getPointGlobalIndex(j))) = *_nearestPoint;
+				}
+			}
+		}
+	}
+
+	//otherwise, for each triangle
 	while (trianglesToTestCount != 0)
 	{
 		//we query the vertex coordinates
@@ -1088,47 +1524,105 @@ int ComputeMaxNeighborhoodLength(ScalarType maxSearchDist, PointCoordinateType c
 
 #ifdef ENABLE_CLOUD2MESH_DIST_MT
 
-#include <QtCore>
-#include <QApplication>
-#include <QtConcurrentMap>
+#include <QMutex>
 
 /*** MULTI THREADING WRAPPER ***/
 
-static DgmOctree* s_octree_MT = 0;
-static NormalizedProgress* s_normProgressCb_MT = 0;
-static OctreeAndMeshIntersection* s_intersection_MT = 0;
-static bool s_cellFunc_MT_success = true;
-static CCLib::DistanceComputationTools::Cloud2MeshDistanceComputationParams s_params_MT;
+//! Pool of 'processed triangles' tables (shared by the threads of a parallel cloud-to-mesh distances computation)
+/** Each table stores for each triangle the stamp of the last cell that has tested it.
+	As stamps are unique (index of the cell in the octree + 1), tables never need to be reset.
+**/
+class ProcessedTrianglesPool
+{
+public:
 
-//'processTriangles' mechanism (based on bit mask)
-#include <QtCore/QBitArray>
-static std::vector<QBitArray*> s_bitArrayPool_MT;
-static bool s_useBitArrays_MT = true;
-static QMutex s_currentBitMaskMutex;
+	//! Default constructor
+	explicit ProcessedTrianglesPool(unsigned triangleCount)
+		: m_triangleCount(triangleCount)
+	{}
 
-void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
-{
-	if (!s_cellFunc_MT_success)
+	//! Destructor
+	~ProcessedTrianglesPool()
 	{
-		//skip this cell if the process is aborted / has failed
-		return;
+		while (!m_tables.empty())
+		{
+			delete m_tables.back();
+			m_tables.pop_back();
+		}
 	}
 
-	if (s_normProgressCb_MT)
+	//! Returns an available table (or 0 if there's not enough memory)
+	std::vector<unsigned>* acquire()
 	{
-		QApplication::processEvents(); //let the application breath!
-		if (!s_normProgressCb_MT->oneStep())
 		{
-			s_cellFunc_MT_success = false;
+			QMutexLocker locker(&m_mutex);
+			if (!m_tables.empty())
+			{
+				std::vector<unsigned>* table = m_tables.back();
+				m_tables.pop_back();
+				return table;
+			}
+		}
+
+		try
+		{
+			return new std::vector<unsigned>(m_triangleCount, 0);
+		}
+		catch (const std::bad_alloc&)
+		{
+			//no big deal, we can do without it!
+			return 0;
+		}
+	}
+
+	//! Gives a table back to the pool
+	void release(std::vector<unsigned>* table)
+	{
+		if (!table)
+		{
 			return;
 		}
+
+		QMutexLocker locker(&m_mutex);
+		try
+		{
+			m_tables.push_back(table);
+		}
+		catch (const std::bad_alloc&)
+		{
+			delete table;
+		}
 	}
 
-	ReferenceCloud Yk(s_octree_MT->associatedCloud());
-	s_octree_MT->getPointsInCellByCellIndex(&Yk, desc.theIndex, s_params_MT.octreeLevel);
+protected:
+
+	//! Number of triangles
+	unsigned m_triangleCount;
+	//! Available tables
+	std::vector< std::vector<unsigned>* > m_tables;
+	//! Mutex
+	QMutex m_mutex;
+};
+
+//Description of expected 'additionalParameters'
+// [0] -> (OctreeAndMeshIntersection*): octree/mesh intersection structure
+// [1] -> (Cloud2MeshDistanceComputationParams*): parameters
+// [2] -> (ProcessedTrianglesPool*): pool of 'processed triangles' tables
+static bool cloudMeshDistCellFunc_MT(	const DgmOctree::octreeCell& cell,
+										void** additionalParameters,
+										NormalizedProgress* nProgress/*=0*/)
+{
+	//additional parameters
+	const OctreeAndMeshIntersection* intersection							= reinterpret_cast<OctreeAndMeshIntersection*>(additionalParameters[0]);
+	DistanceComputationTools::Cloud2MeshDistanceComputationParams* params	= reinterpret_cast<DistanceComputationTools::Cloud2MeshDistanceComputationParams*>(additionalParameters[1]);
+	ProcessedTrianglesPool* processedTrianglesPool							= reinterpret_cast<ProcessedTrianglesPool*>(additionalParameters[2]);
+
+	const DgmOctree* octree = cell.parentOctree;
+	ReferenceCloud& Yk = *cell.points;
 
 	//min distance array
 	unsigned remainingPoints = Yk.size();
+	const unsigned pointCount = remainingPoints;
 
 	std::vector<ScalarType> minDists;
 	try
@@ -1138,18 +1632,17 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 	catch (const std::bad_alloc&)
 	{
 		//not enough memory
-		s_cellFunc_MT_success = false;
-		return;
+		return false;
 	}
 
 	//get cell pos
 	Tuple3i startPos;
-	s_octree_MT->getCellPos(desc.theCode, s_params_MT.octreeLevel, startPos, true);
+	octree->getCellPos(cell.truncatedCode, cell.level, startPos, true);
 
 	//get the distance to the nearest and farthest boundaries
 	int maxDistToBoundaries = 0;
-	Tuple3i distToLowerBorder = startPos - s_intersection_MT->minFillIndexes;
-	Tuple3i distToUpperBorder = s_intersection_MT->maxFillIndexes - startPos;
+	Tuple3i distToLowerBorder = startPos - intersection->minFillIndexes;
+	Tuple3i distToUpperBorder = intersection->maxFillIndexes - startPos;
 	for (unsigned k = 0; k<3; ++k)
 	{
 		maxDistToBoundaries = std::max(maxDistToBoundaries, distToLowerBorder.u[k]);
@@ -1157,58 +1650,50 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 	}
 	int maxIntDist = maxDistToBoundaries;
 
-	if (s_params_MT.maxSearchDist > 0)
+	if (params->maxSearchDist > 0)
 	{
 		//no need to look farther than 'maxNeighbourhoodLength'
-		int maxNeighbourhoodLength = ComputeMaxNeighborhoodLength(s_params_MT.maxSearchDist, s_octree_MT->getCellSize(s_params_MT.octreeLevel));
+		int maxNeighbourhoodLength = ComputeMaxNeighborhoodLength(params->maxSearchDist, octree->getCellSize(cell.level));
 		if (maxNeighbourhoodLength < maxIntDist)
 			maxIntDist = maxNeighbourhoodLength;
 
-		ScalarType maxDistance = s_params_MT.maxSearchDist;
-		if (!s_params_MT.signedDistances)
+		ScalarType maxDistance = params->maxSearchDist;
+		if (!params->signedDistances)
 		{
 			//we compute squared distances when not in 'signed' mode!
-			maxDistance = s_params_MT.maxSearchDist*s_params_MT.maxSearchDist;
+			maxDistance = params->maxSearchDist*params->maxSearchDist;
 		}
 
 		for (unsigned j = 0; j < remainingPoints; ++j)
+		{
 			Yk.setPointScalarValue(j, maxDistance);
+			if (params->CPSet)
+			{
+				//points farther than 'maxSearchDist' are their own 'closest point'
+				*const_cast<CCVector3*>(params->CPSet->getPoint(Yk.getPointGlobalIndex(j))) = *Yk.getPoint(j);
+			}
+		}
 	}
 
 	//determine the cell center
 	CCVector3 cellCenter;
-	s_octree_MT->computeCellCenter(startPos, s_params_MT.octreeLevel, cellCenter);
+	octree->computeCellCenter(startPos, cell.level, cellCenter);
 
 	//express 'startPos' relatively to the grid borders
-	startPos -= s_intersection_MT->minFillIndexes;
+	startPos -= intersection->minFillIndexes;
 
 	//octree cell size
-	const PointCoordinateType& cellLength = s_octree_MT->getCellSize(s_params_MT.octreeLevel);
+	const PointCoordinateType& cellLength = octree->getCellSize(cell.level);
 
 	//useful variables
 	std::vector<unsigned> trianglesToTest;
 	size_t trianglesToTestCount = 0;
 	size_t trianglesToTestCapacity = 0;
+	TriangleBatch triangleBatch;
 
-	//bit mask for efficient comparisons
-	QBitArray* bitArray = 0;
-	if (s_useBitArrays_MT)
-	{
-		s_currentBitMaskMutex.lock();
-		if (s_bitArrayPool_MT.empty())
-		{
-			bitArray = new QBitArray();
-			bitArray->resize(s_intersection_MT->mesh->size());
-			//s_bitArrayPool_MT.push_back(bitArray);
-		}
-		else
-		{
-			bitArray = s_bitArrayPool_MT.back();
-			s_bitArrayPool_MT.pop_back();
-		}
-		s_currentBitMaskMutex.unlock();
-		bitArray->fill(0);
-	}
+	//'processed triangles' table for efficient comparisons
+	std::vector<unsigned>* processTriangles = processedTrianglesPool->acquire();
+	const unsigned cellStamp = static_cast<unsigned>(cell.index + 1);
 
 	//for each point, we pre-compute its distance to the nearest cell border
 	//(will be handy later)
@@ -1253,7 +1738,7 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 					{
 						//are there any triangles near this cell?
 						cellPos.z = startPos.z+k;
-						TriangleList* triList = s_intersection_MT->perCellTriangleList.getValue(cellPos);
+						TriangleList* triList = intersection->perCellTriangleList.getValue(cellPos);
 						if (triList)
 						{
 							if (trianglesToTestCount + triList->indexes.size() > trianglesToTestCapacity)
@@ -1264,14 +1749,14 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 							//let's test all the triangles that intersect this cell
 							for (unsigned p = 0; p<triList->indexes.size(); ++p)
 							{
-								if (bitArray)
+								if (processTriangles)
 								{
 									unsigned indexTri = triList->indexes[p];
 									//if the triangles has not been processed yet
-									if (!bitArray->testBit(indexTri))
+									if ((*processTriangles)[indexTri] != cellStamp)
 									{
 										trianglesToTest[trianglesToTestCount++] = indexTri;
-										bitArray->setBit(indexTri);
+										(*processTriangles)[indexTri] = cellStamp;
 									}
 								}
 								else
@@ -1288,7 +1773,7 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 					{
 						//are there any triangles near this cell?
 						cellPos.z = startPos.z - e;
-						TriangleList* triList = s_intersection_MT->perCellTriangleList.getValue(cellPos);
+						TriangleList* triList = intersection->perCellTriangleList.getValue(cellPos);
 						if (triList)
 						{
 							if (trianglesToTestCount + triList->indexes.size() > trianglesToTestCapacity)
@@ -1299,14 +1784,14 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 							//let's test all the triangles that intersect this cell
 							for (unsigned p = 0; p<triList->indexes.size(); ++p)
 							{
-								if (bitArray)
+								if (processTriangles)
 								{
 									const unsigned& indexTri = triList->indexes[p];
 									//if the triangles has not been processed yet
-									if (!bitArray->testBit(indexTri))
+									if ((*processTriangles)[indexTri] != cellStamp)
 									{
 										trianglesToTest[trianglesToTestCount++] = indexTri;
-										bitArray->setBit(indexTri);
+										(*processTriangles)[indexTri] = cellStamp;
 									}
 								}
 								else
@@ -1321,7 +1806,7 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 					{
 						//are there any triangles near this cell?
 						cellPos.z = startPos.z + f;
-						TriangleList* triList = s_intersection_MT->perCellTriangleList.getValue(cellPos);
+						TriangleList* triList = intersection->perCellTriangleList.getValue(cellPos);
 						if (triList)
 						{
 							if (trianglesToTestCount + triList->indexes.size() > trianglesToTestCapacity)
@@ -1332,14 +1817,14 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 							//let's test all the triangles that intersect this cell
 							for (unsigned p = 0; p<triList->indexes.size(); ++p)
 							{
-								if (bitArray)
+								if (processTriangles)
 								{
 									const unsigned& indexTri = triList->indexes[p];
 									//if the triangles has not been processed yet
-									if (!bitArray->testBit(indexTri))
+									if ((*processTriangles)[indexTri] != cellStamp)
 									{
 										trianglesToTest[trianglesToTestCount++] = indexTri;
-										bitArray->setBit(indexTri);
+										(*processTriangles)[indexTri] = cellStamp;
 									}
 								}
 								else
@@ -1353,16 +1838,19 @@ void cloudMeshDistCellFunc_MT(const DgmOctree::IndexAndCode& desc)
 			}
 		}
 
-		ComparePointsAndTriangles(Yk, remainingPoints, s_intersection_MT->mesh, trianglesToTest, trianglesToTestCount, minDists, maxRadius, s_params_MT);
+		ComparePointsAndTriangles(Yk, remainingPoints, intersection->mesh, trianglesToTest, trianglesToTestCount, minDists, maxRadius, *params, triangleBatch);
 	}
 
-	//release bit mask
-	if (bitArray)
+	//release the 'processed triangles' table
+	processedTrianglesPool->release(processTriangles);
+
+	if (nProgress && !nProgress->steps(pointCount))
 	{
-		s_currentBitMaskMutex.lock();
-		s_bitArrayPool_MT.push_back(bitArray);
-		s_currentBitMaskMutex.unlock();
+		//process cancelled by the user
+		return false;
 	}
+
+	return true;
 }
 
 #endif
@@ -1373,7 +1861,6 @@ int DistanceComputationTools::computeCloud2MeshDistanceWithOctree(	OctreeAndMesh
 {
 	assert(intersection);
 	assert(!params.signedDistances || !intersection->distanceTransform); //signed distances are not compatible with Distance Transform acceleration
-	assert(!params.multiThread || params.maxSearchDist <= 0); //maxSearchDist is not compatible with parallel processing
 
 	DgmOctree* octree = intersection->octree;
 	if (!octree)
@@ -1386,7 +1873,6 @@ int DistanceComputationTools::computeCloud2MeshDistanceWithOctree(	OctreeAndMesh
 	//Closest Point Set
 	if (params.CPSet)
 	{
-		assert(params.maxSearchDist <= 0);
 		assert(params.useDistanceMap == false);
 
 		//reserve memory for the Closest Point Set
@@ -1477,6 +1963,7 @@ int DistanceComputationTools::computeCloud2MeshDistanceWithOctree(	OctreeAndMesh
 		std::vector<unsigned> trianglesToTest;
 		size_t trianglesToTestCount = 0;
 		size_t trianglesToTestCapacity = 0;
+		TriangleBatch triangleBatch;
 		unsigned numberOfTriangles = mesh->size();
 
 		//acceleration structure
@@ -1565,7 +2052,14 @@ int DistanceComputationTools::computeCloud2MeshDistanceWithOctree(	OctreeAndMesh
 				}
 				
 				for (unsigned j = 0; j < remainingPoints; ++j)
+				{
 					Yk.setPointScalarValue(j, maxDistance);
+					if (params.CPSet)
+					{
+						//points farther than 'maxSearchDist' are their own 'closest point'
+						*const_cast<CCVector3*>(params.CPSet->getPoint(Yk.getPointGlobalIndex(j))) = *Yk.getPoint(j);
+					}
+				}
 			}
 
 			//let's find the nearest triangles for each point in the neighborhood 'Yk'
@@ -1699,7 +2193,7 @@ int DistanceComputationTools::computeCloud2MeshDistanceWithOctree(	OctreeAndMesh
 					}
 				}
 
-				ComparePointsAndTriangles(Yk, remainingPoints, mesh, trianglesToTest, trianglesToTestCount, minDists, maxRadius, params);
+				ComparePointsAndTriangles(Yk, remainingPoints, mesh, trianglesToTest, trianglesToTestCount, minDists, maxRadius, params, triangleBatch);
 			}
 
 			//Yk.clear(); //not necessary
@@ -1716,68 +2210,266 @@ int DistanceComputationTools::computeCloud2MeshDistanceWithOctree(	OctreeAndMesh
 #ifdef ENABLE_CLOUD2MESH_DIST_MT
 	else
 	{
-		//extraction des indexes et codes des cellules du niveau "octreeLevel"
-		DgmOctree::cellsContainer cellsDescs;
-		octree->getCellCodesAndIndexes(params.octreeLevel,cellsDescs,true);
+		//the cells are processed in parallel by the octree (see DgmOctree::executeFunctionForAllCellsAtLevel)
+		ProcessedTrianglesPool processedTrianglesPool(intersection->mesh->size());
+
+		void* additionalParameters[] = {	reinterpret_cast<void*>(intersection),
+											reinterpret_cast<void*>(&params),
+											reinterpret_cast<void*>(&processedTrianglesPool)
+		};
+
+		if (octree->executeFunctionForAllCellsAtLevel(	params.octreeLevel,
+														cloudMeshDistCellFunc_MT,
+														additionalParameters,
+														true,
+														progressCb,
+														params.signedDistances ? "Compute signed distances" : "Compute distances",
+														params.maxThreadCount) == 0)
+		{
+			//something went wrong (or the process has been cancelled)
+			return -2;
+		}
 
-		unsigned numberOfCells = (unsigned)cellsDescs.size();
+		return 0;
+	}
+#endif
+}
 
-		//Progress callback
-		NormalizedProgress nProgress(progressCb,numberOfCells);
-		if (progressCb)
+//convert all 'distances' (squared in fact) to their square root
+inline void applySqrtToPointDist(const CCVector3 &aPoint, ScalarType& aScalarValue)
+{
+	if (ScalarField::ValidValue(aScalarValue))
+		aScalarValue = sqrt(aScalarValue);
+}
+
+//! Decides whether a BVH should be used instead of the octree (see Cloud2MeshDistanceComputationParams::AUTO_ACCELERATION)
+/** The triangles are rasterized in the octree cells at a single level, which is inefficient if the triangles
+	sizes are very heterogeneous (e.g. large planar faces and small details in CAD models) or if most of the
+	surface is made of triangles much bigger (each of them is then listed by many cells, and far from each
+	other) or much smaller (each cell then lists many triangles) than the cells.
+	\param mesh mesh
+	\param cellSize octree cell size (at the octree level that would be used)
+	\return whether a BVH is preferable
+**/
+static bool BVHIsPreferable(GenericIndexedMesh* mesh, PointCoordinateType cellSize)
+{
+	//max ratio between the 'area weighted' median and the median of the triangles sizes
+	static const double MAX_SIZE_RATIO = 32.0;
+	//max ratio between the triangles sizes and the cell size (or conversely)
+	static const double MAX_CELL_RATIO = 16.0;
+	//max number of triangles considered to compute the statistics
+	static const unsigned MAX_SAMPLE_COUNT = 100000;
+
+	unsigned triCount = mesh->size();
+	unsigned step = std::max(1u, triCount / MAX_SAMPLE_COUNT);
+
+	//size (longest edge) and area of each triangle
+	std::vector< std::pair<double, double> > sizes;
+	try
+	{
+		sizes.reserve(triCount / step + 1);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return false;
+	}
+
+	double totalArea = 0;
+	for (unsigned i = 0; i < triCount; i += step)
+	{
+		CCVector3 A, B, C;
+		mesh->getTriangleVertices(i, A, B, C);
+		CCVector3d AB(B.x - A.x, B.y - A.y, B.z - A.z);
+		CCVector3d AC(C.x - A.x, C.y - A.y, C.z - A.z);
+		double size = std::max(AB.norm2(), std::max(AC.norm2(), (AC - AB).norm2()));
+		double area = AB.cross(AC).norm() / 2;
+		sizes.push_back(std::pair<double, double>(sqrt(size), area));
+		totalArea += area;
+	}
+	std::sort(sizes.begin(), sizes.end());
+
+	//median size
+	double median = sizes[sizes.size() / 2].first;
+
+	//size of the triangles covering (at least) half of the surface
+	double areaMedian = sizes.back().first;
+	{
+		double area = 0;
+		for (size_t i = 0; i < sizes.size(); ++i)
 		{
-			if (progressCb->textCanBeEdited())
+			area += sizes[i].second;
+			if (area >= totalArea / 2)
 			{
-				char buffer[256];
-				sprintf(buffer, "Cells: %u", numberOfCells);
-				progressCb->setInfo(buffer);
-				progressCb->setMethodTitle("Compute signed distances");
+				areaMedian = sizes[i].first;
+				break;
 			}
-			progressCb->update(0);
-			progressCb->start();
 		}
+	}
 
-		s_octree_MT = octree;
-		s_normProgressCb_MT = &nProgress;
-		s_cellFunc_MT_success = true;
-		s_params_MT = params;
-		s_intersection_MT = intersection;
-		//acceleration structure
-		s_useBitArrays_MT = true;
+	return	areaMedian > MAX_SIZE_RATIO * median		//heterogeneous triangles
+		||	areaMedian > MAX_CELL_RATIO * cellSize		//big triangles (listed in many cells)
+		||	median * MAX_CELL_RATIO < cellSize;			//small triangles (many triangles per cell)
+}
+
+//! Range of points to process (see DistanceComputationTools::computeCloud2MeshDistanceWithBVH)
+struct BVHDistancesJob
+{
+	GenericIndexedCloudPersist* cloud;
+	const TriangleBVH* bvh;
+	const DistanceComputationTools::Cloud2MeshDistanceComputationParams* params;
+	unsigned firstIndex;
+	unsigned lastIndex;
+};
 
-		//Single thread emulation
-		//for (unsigned i=0; i<numberOfCells; ++i)
-		//	cloudMeshDistCellFunc_MT(cellsDescs[i]);
+//! Computes the distances between a range of points and the mesh (with a BVH)
+static void ComputeBVHDistances(BVHDistancesJob& job)
+{
+	const DistanceComputationTools::Cloud2MeshDistanceComputationParams& params = *job.params;
+
+	//the search is restricted to 'maxSearchDist' (if any)
+	double maxSquareDist = std::numeric_limits<double>::infinity();
+	if (params.maxSearchDist > 0)
+	{
+		maxSquareDist = static_cast<double>(params.maxSearchDist) * params.maxSearchDist;
+	}
+
+	for (unsigned i = job.firstIndex; i < job.lastIndex; ++i)
+	{
+		CCVector3 P;
+		job.cloud->getPoint(i, P);
+		CCVector3* nearestPoint = params.CPSet ? const_cast<CCVector3*>(params.CPSet->getPoint(i)) : 0;
 
-		int maxThreadCount = params.maxThreadCount;
-		if (maxThreadCount == 0)
+		TriangleBVH::NearestTriangle nearest;
+		if (job.bvh->findNearestTriangle(P, maxSquareDist, nearest, nearestPoint))
 		{
-			maxThreadCount = QThread::idealThreadCount();
+			if (params.signedDistances)
+			{
+				ScalarType d = static_cast<ScalarType>(sqrt(nearest.squareDist));
+				job.cloud->setPointScalarValue(i, nearest.negativeSide != params.flipNormals ? -d : d);
+			}
+			else
+			{
+				//we compute squared distances when not in 'signed' mode!
+				job.cloud->setPointScalarValue(i, static_cast<ScalarType>(nearest.squareDist));
+			}
 		}
-		QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
-		QtConcurrent::blockingMap(cellsDescs, cloudMeshDistCellFunc_MT);
+		else if (params.maxSearchDist > 0)
+		{
+			//the point is farther than 'maxSearchDist'
+			job.cloud->setPointScalarValue(i, params.signedDistances ? params.maxSearchDist : params.maxSearchDist * params.maxSearchDist);
+			if (nearestPoint)
+			{
+				//points farther than 'maxSearchDist' are their own 'closest point'
+				*nearestPoint = P;
+			}
+		}
+	}
+}
 
-		s_octree_MT = 0;
-		s_normProgressCb_MT = 0;
-		s_intersection_MT = 0;
+int DistanceComputationTools::computeCloud2MeshDistanceWithBVH(	GenericIndexedCloudPersist* pointCloud,
+																const TriangleBVH& bvh,
+																Cloud2MeshDistanceComputationParams& params,
+																GenericProgressCallback* progressCb/*=0*/)
+{
+	//number of points per job
+	static const unsigned POINTS_PER_JOB = 1024;
+	//number of jobs processed between two progress notifications
+	static const unsigned JOBS_PER_BATCH = 64;
+
+	assert(pointCloud && bvh.isValid());
+	unsigned pointCount = pointCloud->size();
 
-		//clean acceleration structure
-		while (!s_bitArrayPool_MT.empty())
+	//Closest Point Set
+	if (params.CPSet)
+	{
+		//reserve memory for the Closest Point Set
+		if (!params.CPSet->resize(pointCount))
 		{
-			delete s_bitArrayPool_MT.back();
-			s_bitArrayPool_MT.pop_back();
+			//not enough memory
+			return -1;
 		}
+	}
+
+	bool multiThread = false;
+#ifdef ENABLE_CLOUD2MESH_DIST_MT
+	multiThread = params.multiThread;
+#endif
+
+	//jobs processed in parallel (at most 'maxThreadCount' at once)
+	unsigned batchSize = 1;
+	if (multiThread)
+	{
+		batchSize = (params.maxThreadCount > 0 ? static_cast<unsigned>(params.maxThreadCount) : JOBS_PER_BATCH);
+	}
+
+	std::vector<BVHDistancesJob> batch;
+	try
+	{
+		batch.reserve(batchSize);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return -1;
+	}
 
-		return (s_cellFunc_MT_success ? 0 : -2);
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
+		{
+			progressCb->setMethodTitle(params.signedDistances ? "Compute signed distances" : "Compute distances");
+			char buffer[256];
+			sprintf(buffer, "Points: %u\nTriangles: %u (BVH)", pointCount, bvh.size());
+			progressCb->setInfo(buffer);
+		}
+		progressCb->update(0);
+		progressCb->start();
 	}
+
+	int result = 0;
+	unsigned firstIndex = 0;
+	while (firstIndex < pointCount)
+	{
+		batch.clear();
+		while (batch.size() < batchSize && firstIndex < pointCount)
+		{
+			BVHDistancesJob job;
+			job.cloud = pointCloud;
+			job.bvh = &bvh;
+			job.params = &params;
+			job.firstIndex = firstIndex;
+			job.lastIndex = std::min(firstIndex + POINTS_PER_JOB, pointCount);
+			batch.push_back(job);
+			firstIndex = job.lastIndex;
+		}
+
+#ifdef ENABLE_CLOUD2MESH_DIST_MT
+		if (multiThread && batch.size() > 1)
+			QtConcurrent::blockingMap(batch, ComputeBVHDistances);
+		else
 #endif
-}
+		for (size_t i = 0; i < batch.size(); ++i)
+			ComputeBVHDistances(batch[i]);
 
-//convert all 'distances' (squared in fact) to their square root
-inline void applySqrtToPointDist(const CCVector3 &aPoint, ScalarType& aScalarValue)
-{
-	if (ScalarField::ValidValue(aScalarValue))
-		aScalarValue = sqrt(aScalarValue);
+		if (progressCb)
+		{
+			progressCb->update((100.0f * firstIndex) / pointCount);
+			if (progressCb->isCancelRequested())
+			{
+				//process cancelled by the user
+				result = -2;
+				break;
+			}
+		}
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	return result;
 }
 
 int DistanceComputationTools::computeCloud2MeshDistance(	GenericIndexedCloudPersist* pointCloud,
@@ -1800,9 +2492,8 @@ int DistanceComputationTools::computeCloud2MeshDistance(	GenericIndexedCloudPers
 	}
 	if (params.CPSet)
 	{
-		//Closest Point Set determination is incompatible with distance map approximation and max seach distance
+		//Closest Point Set determination is incompatible with distance map approximation
 		params.useDistanceMap = false;
-		params.maxSearchDist = 0;
 	}
 
 	//compute the (cubical) bounding box that contains both the cloud and the mehs BBs
@@ -1827,6 +2518,41 @@ int DistanceComputationTools::computeCloud2MeshDistance(	GenericIndexedCloudPers
 		CCMiscTools::MakeMinAndMaxCubical(minCubifiedBB,maxCubifiedBB);
 	}
 
+	//use a BVH instead of the octree?
+	if (!params.useDistanceMap && params.acceleration != Cloud2MeshDistanceComputationParams::OCTREE_ACCELERATION)
+	{
+		bool useBVH = (params.acceleration == Cloud2MeshDistanceComputationParams::BVH_ACCELERATION);
+		if (!useBVH)
+		{
+			//we deduce the grid cell size very simply (as the bbox has been "cubified")
+			PointCoordinateType cellSize = (maxCubifiedBB.x - minCubifiedBB.x) / (1 << params.octreeLevel);
+			useBVH = BVHIsPreferable(mesh, cellSize);
+		}
+
+		if (useBVH)
+		{
+			TriangleBVH bvh;
+			if (!bvh.build(mesh, progressCb))
+			{
+				return -8;
+			}
+
+			//reset the output distances
+			pointCloud->enableScalarField();
+			pointCloud->forEach(ScalarFieldTools::SetScalarValueToNaN);
+
+			int result = computeCloud2MeshDistanceWithBVH(pointCloud, bvh, params, progressCb);
+
+			//don't forget to compute the square root of the (squared) unsigned distances
+			if (result == 0 && !params.signedDistances)
+			{
+				pointCloud->forEach(applySqrtToPointDist);
+			}
+
+			return (result < 0 ? -7 : 0);
+		}
+	}
+
 	//compute the octree if necessary
 	DgmOctree tempOctree(pointCloud);
 	DgmOctree* octree = cloudOctree;
@@ -2338,6 +3064,8 @@ bool DistanceComputationTools::computeGeodesicDistances(GenericIndexedCloudPersi
 		delete octree;
 		return false;
 	}
+	//constant acceleration: the parallel solver gives the same result
+	fm.setParallelPropagation(true);
 
 	//on cherche la cellule de l'octree qui englobe le "seedPoint"
 	Tuple3i cellPos;
@@ -2483,7 +3211,7 @@ int DistanceComputationTools::computeApproxCloud2CloudDistance(	GenericIndexedCl
 
 		while (!theIndexes.empty())
 		{
-			unsigned theIndex = theIndexes.back();
+			PointIndexType theIndex = theIndexes.back();
 			theIndexes.pop_back();
 
 			Tuple3i cellPos;
@@ -22,13 +22,30 @@
 #include "DgmOctree.h"
 
 //system
+#include <algorithm>
 #include <assert.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#ifdef USE_QT
+#ifndef QT_DEBUG
+//enables multi-threading handling
+#define ENABLE_MT_FAST_MARCHING
+#endif
+#endif
+
+#ifdef ENABLE_MT_FAST_MARCHING
+#include <QtConcurrentMap>
+#endif
+
 using namespace CCLib;
 
+//! Size of the blocks of cells processed by FastMarching::propagateInParallel (along each dimension)
+static const unsigned c_propagationBlockSize = 8;
+//! Maximum number of sweeps over a block before handing over to the other blocks
+static const unsigned c_propagationBlockMaxSweeps = 2 * c_propagationBlockSize;
+
 FastMarching::FastMarching()
 	: m_initialized(false)
 	, m_dx(0)
@@ -368,3 +385,291 @@ float FastMarching::computeT(unsigned index)
 
 	return static_cast<float>(Tij);
 }
+
+struct FastMarching::PropagationBlock
+{
+	//! Associated Fast Marching instance
+	FastMarching* fm;
+	//! Block index
+	unsigned index;
+	//! First cell position (grid coordinates)
+	unsigned pos[3];
+	//! Number of cells along each dimension
+	unsigned size[3];
+	//! Whether the block arrival times have converged
+	bool converged;
+	//! Whether arrival times have changed on the block borders
+	bool bordersChanged;
+};
+
+void FastMarching::ProcessPropagationBlock(PropagationBlock& block)
+{
+	FastMarching* fm = block.fm;
+	Cell** grid = fm->m_theGrid;
+	const float T_INF = Cell::T_INF();
+
+	block.converged = false;
+	block.bordersChanged = false;
+
+	//Gauss-Seidel sweeps (in alternate directions) until the arrival times stop decreasing
+	for (unsigned sweep=0; sweep<c_propagationBlockMaxSweeps; ++sweep)
+	{
+		bool changed = false;
+		bool forward = ((sweep & 1) == 0);
+
+		for (unsigned kk=0; kk<block.size[2]; ++kk)
+		{
+			unsigned k = block.pos[2] + (forward ? kk : block.size[2]-1-kk);
+			bool kBorder = (kk == 0 || kk+1 == block.size[2]);
+
+			for (unsigned jj=0; jj<block.size[1]; ++jj)
+			{
+				unsigned j = block.pos[1] + (forward ? jj : block.size[1]-1-jj);
+				bool jBorder = (jj == 0 || jj+1 == block.size[1]);
+
+				for (unsigned ii=0; ii<block.size[0]; ++ii)
+				{
+					unsigned i = block.pos[0] + (forward ? ii : block.size[0]-1-ii);
+					unsigned index = i + j * fm->m_rowSize + k * fm->m_sliceSize;
+
+					Cell* theCell = grid[index];
+					if (!theCell || theCell->state == Cell::ACTIVE_CELL)
+						continue;
+
+					//earliest arrival time from the neighbors (same as FastMarching::computeT)
+					float T = theCell->T;
+					for (unsigned n=0; n<fm->m_numberOfNeighbours; ++n)
+					{
+						Cell* nCell = grid[static_cast<int>(index) + fm->m_neighboursIndexShift[n]];
+						if (nCell && nCell->T < T_INF)
+						{
+							float t = static_cast<float>(static_cast<double>(nCell->T) + static_cast<double>(fm->m_neighboursDistance[n]) * static_cast<double>(fm->computeTCoefApprox(nCell,theCell)));
+							if (t < T)
+								T = t;
+						}
+					}
+
+					if (T < theCell->T)
+					{
+						theCell->T = T;
+						changed = true;
+						if (kBorder || jBorder || ii == 0 || ii+1 == block.size[0])
+							block.bordersChanged = true;
+					}
+				}
+			}
+		}
+
+		if (!changed)
+		{
+			block.converged = true;
+			break;
+		}
+	}
+}
+
+//! Activates a block of cells and its neighbours (see FastMarching::propagateInParallel)
+static bool ActivatePropagationBlocks(	unsigned bi,
+										unsigned bj,
+										unsigned bk,
+										const unsigned blockDim[3],
+										std::vector<unsigned char>& isActive,
+										std::vector<unsigned> activeBlocks[8],
+										bool includeCentralBlock = true)
+{
+	for (unsigned k=(bk > 0 ? bk-1 : 0); k<=std::min(bk+1,blockDim[2]-1); ++k)
+	{
+		for (unsigned j=(bj > 0 ? bj-1 : 0); j<=std::min(bj+1,blockDim[1]-1); ++j)
+		{
+			for (unsigned i=(bi > 0 ? bi-1 : 0); i<=std::min(bi+1,blockDim[0]-1); ++i)
+			{
+				unsigned index = i + j * blockDim[0] + k * blockDim[0] * blockDim[1];
+				if (isActive[index] || (!includeCentralBlock && i == bi && j == bj && k == bk))
+					continue;
+
+				try
+				{
+					//blocks with the same 'color' (parity of their 3 coordinates) don't share any neighbouring cell
+					activeBlocks[(i & 1) | ((j & 1) << 1) | ((k & 1) << 2)].push_back(index);
+				}
+				catch (const std::bad_alloc&)
+				{
+					//not enough memory
+					return false;
+				}
+				isActive[index] = 1;
+			}
+		}
+	}
+
+	return true;
+}
+
+int FastMarching::propagateInParallel(std::vector<unsigned>& reachedCells)
+{
+	reachedCells.clear();
+
+	if (!m_initialized)
+		return -1;
+
+	//grid of blocks
+	const unsigned B = c_propagationBlockSize;
+	const unsigned blockDim[3] = { (m_dx+B-1)/B, (m_dy+B-1)/B, (m_dz+B-1)/B };
+	const unsigned blockCount = blockDim[0] * blockDim[1] * blockDim[2];
+
+	//active blocks (sorted by 'color' - see ActivatePropagationBlocks - as blocks with the
+	//same color can be processed concurrently)
+	std::vector<unsigned> activeBlocks[8];
+	std::vector<unsigned char> isActive;
+	std::vector<unsigned char> isVisited;
+	std::vector<PropagationBlock> jobs;
+	try
+	{
+		isActive.resize(blockCount, 0);
+		isVisited.resize(blockCount, 0);
+		jobs.reserve(blockCount/8 + 1);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return -2;
+	}
+
+	//the blocks including the seeds are activated first
+	for (size_t s=0; s<m_activeCells.size(); ++s)
+	{
+		unsigned index = m_activeCells[s];
+		unsigned k = index / m_sliceSize;
+		unsigned j = (index - k * m_sliceSize) / m_rowSize;
+		unsigned i = index - k * m_sliceSize - j * m_rowSize;
+		assert(i > 0 && j > 0 && k > 0);
+		if (!ActivatePropagationBlocks((i-1)/B, (j-1)/B, (k-1)/B, blockDim, isActive, activeBlocks))
+			return -2;
+	}
+
+	//each round, the converged area grows at least by one block
+	bool converged = false;
+	for (unsigned round=0; round<=blockCount; ++round)
+	{
+		bool activeBlocksRemaining = false;
+		for (unsigned color=0; color<8; ++color)
+		{
+			if (activeBlocks[color].empty())
+				continue;
+			activeBlocksRemaining = true;
+
+			jobs.clear();
+			for (size_t b=0; b<activeBlocks[color].size(); ++b)
+			{
+				unsigned index = activeBlocks[color][b];
+				isActive[index] = 0;
+				isVisited[index] = 1;
+
+				unsigned bk = index / (blockDim[0] * blockDim[1]);
+				unsigned bj = (index - bk * blockDim[0] * blockDim[1]) / blockDim[0];
+				unsigned bi = index - bk * blockDim[0] * blockDim[1] - bj * blockDim[0];
+
+				PropagationBlock block;
+				block.fm = this;
+				block.index = index;
+				block.pos[0] = 1 + bi * B;
+				block.pos[1] = 1 + bj * B;
+				block.pos[2] = 1 + bk * B;
+				block.size[0] = std::min(B, m_dx - bi * B);
+				block.size[1] = std::min(B, m_dy - bj * B);
+				block.size[2] = std::min(B, m_dz - bk * B);
+				block.converged = false;
+				block.bordersChanged = false;
+				jobs.push_back(block);
+			}
+			activeBlocks[color].clear();
+
+#ifdef ENABLE_MT_FAST_MARCHING
+			if (jobs.size() > 1)
+				QtConcurrent::blockingMap(jobs, ProcessPropagationBlock);
+			else
+#endif
+			for (size_t b=0; b<jobs.size(); ++b)
+				ProcessPropagationBlock(jobs[b]);
+
+			//activate the blocks that should be processed (again)
+			for (size_t b=0; b<jobs.size(); ++b)
+			{
+				const PropagationBlock& block = jobs[b];
+				unsigned bi = (block.pos[0]-1) / B;
+				unsigned bj = (block.pos[1]-1) / B;
+				unsigned bk = (block.pos[2]-1) / B;
+
+				if (block.bordersChanged)
+				{
+					//the neighbouring blocks should be updated (as well as the block itself if it hasn't converged yet)
+					if (!ActivatePropagationBlocks(bi, bj, bk, blockDim, isActive, activeBlocks, !block.converged))
+						return -2;
+				}
+				else if (!block.converged && !isActive[block.index])
+				{
+					activeBlocks[color].push_back(block.index);
+					isActive[block.index] = 1;
+				}
+			}
+		}
+
+		if (!activeBlocksRemaining)
+		{
+			converged = true;
+			break;
+		}
+	}
+
+	//we collect (or reset) the reached cells
+	bool notEnoughMemory = false;
+	for (unsigned index=0; index<blockCount; ++index)
+	{
+		if (!isVisited[index])
+			continue;
+
+		unsigned bk = index / (blockDim[0] * blockDim[1]);
+		unsigned bj = (index - bk * blockDim[0] * blockDim[1]) / blockDim[0];
+		unsigned bi = index - bk * blockDim[0] * blockDim[1] - bj * blockDim[0];
+
+		for (unsigned k=1+bk*B; k<=std::min(m_dz,(bk+1)*B); ++k)
+		{
+			for (unsigned j=1+bj*B; j<=std::min(m_dy,(bj+1)*B); ++j)
+			{
+				for (unsigned i=1+bi*B; i<=std::min(m_dx,(bi+1)*B); ++i)
+				{
+					unsigned cellIndex = i + j * m_rowSize + k * m_sliceSize;
+					Cell* theCell = m_theGrid[cellIndex];
+					if (!theCell || theCell->state == Cell::ACTIVE_CELL || theCell->T == Cell::T_INF())
+						continue;
+
+					if (converged && !notEnoughMemory)
+					{
+						try
+						{
+							reachedCells.push_back(cellIndex);
+							continue;
+						}
+						catch (const std::bad_alloc&)
+						{
+							notEnoughMemory = true;
+						}
+					}
+
+					theCell->T = Cell::T_INF();
+				}
+			}
+		}
+	}
+
+	if (!converged || notEnoughMemory)
+	{
+		//reset the already collected cells as well
+		for (size_t c=0; c<reachedCells.size(); ++c)
+			m_theGrid[reachedCells[c]]->T = Cell::T_INF();
+		reachedCells.clear();
+		return notEnoughMemory ? -2 : -3;
+	}
+
+	return 0;
+}
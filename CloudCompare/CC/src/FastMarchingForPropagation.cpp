@@ -25,6 +25,7 @@
 #include "ScalarFieldTools.h"
 
 //system
+#include <algorithm>
 #include <string.h>
 #include <assert.h>
 #include <math.h> //expm1
@@ -35,6 +36,8 @@ FastMarchingForPropagation::FastMarchingForPropagation()
 	: FastMarching()
 	, m_jumpCoef(0)							//resistance a l'avancement du front, en fonction de Cell->f (ici, pas de resistance)
 	, m_detectionThreshold(Cell::T_INF())	//saut relatif de la valeur d'arrivee qui arrete la propagation (ici, "desactive")
+	, m_constantAcceleration(false)
+	, m_parallelPropagation(false)
 {
 }
 
@@ -49,6 +52,8 @@ int FastMarchingForPropagation::init(	GenericCloud* theCloud,
 	if (result < 0)
 		return result;
 
+	m_constantAcceleration = constantAcceleration;
+
 	//on remplit la grille
 	DgmOctree::cellCodesContainer cellCodes;
 	theOctree->getCellCodes(level,cellCodes,true);
@@ -154,6 +159,58 @@ int FastMarchingForPropagation::step()
 
 int FastMarchingForPropagation::propagate()
 {
+	if (m_parallelPropagation)
+	{
+		std::vector<unsigned> reachedCells;
+		int result = propagateInParallel(reachedCells);
+		if (result >= 0)
+		{
+			//the cells are accepted by increasing arrival time (as with the sequential march)
+			std::vector< std::pair<float,unsigned> > sortedCells;
+			try
+			{
+				sortedCells.resize(reachedCells.size());
+			}
+			catch (const std::bad_alloc&)
+			{
+				//not enough memory
+				for (size_t i=0; i<reachedCells.size(); ++i)
+					addTrialCell(reachedCells[i]);
+				return -2;
+			}
+			for (size_t i=0; i<reachedCells.size(); ++i)
+				sortedCells[i] = std::pair<float,unsigned>(m_theGrid[reachedCells[i]]->T, reachedCells[i]);
+			std::sort(sortedCells.begin(), sortedCells.end());
+
+			//last arrival time
+			float lastT = (m_activeCells.empty() ? 0 : m_theGrid[m_activeCells.back()]->T);
+
+			size_t i = 0;
+			for (; i<sortedCells.size(); ++i)
+			{
+				if (sortedCells[i].first-lastT > m_detectionThreshold * m_cellSize)
+					break;
+
+				addActiveCell(sortedCells[i].second);
+				lastT = sortedCells[i].first;
+			}
+
+			//the remaining cells are flagged as TRIAL cells (so that they are reset afterwards)
+			for (; i<sortedCells.size(); ++i)
+			{
+				addTrialCell(sortedCells[i].second);
+			}
+
+			return 0;
+		}
+		else if (result != -3)
+		{
+			return result;
+		}
+
+		//the parallel solver didn't converge (negative acceleration coefficients?): we use the sequential march instead
+	}
+
 	initTrialCells();
 
 	int result = 1;
@@ -237,6 +294,12 @@ template <typename T> T expm1(T x)
 
 float FastMarchingForPropagation::computeTCoefApprox(Cell* currentCell, Cell* neighbourCell) const
 {
+	if (m_constantAcceleration)
+	{
+		//constant front speed: the arrival time is the distance
+		return 1.0f;
+	}
+
 	PropagationCell* cCell = static_cast<PropagationCell*>(currentCell);
 	PropagationCell* nCell = static_cast<PropagationCell*>(neighbourCell);
 	return expm1(m_jumpCoef * (cCell->f-nCell->f));
@@ -26,6 +26,7 @@
 #include "GenericCloud.h"
 #include "DistanceComputationTools.h"
 #include "DgmOctreeReferenceCloud.h"
+#include "NeighbourGraph.h"
 #include "ScalarField.h"
 #include "ScalarFieldTools.h"
 
@@ -403,6 +404,24 @@ bool GeometricalAnalysisTools::computeApproxPointsDensityInACellAtLevel(const Dg
 	return true;
 }
 
+//! Returns the dimensional coefficient of a given density type (or -1 if the type is invalid)
+static double ComputeDensityDimensionalCoef(GeometricalAnalysisTools::Density densityType, PointCoordinateType kernelRadius)
+{
+	switch (densityType)
+	{
+	case GeometricalAnalysisTools::DENSITY_KNN:
+		return 1.0;
+	case GeometricalAnalysisTools::DENSITY_2D:
+		return M_PI * (static_cast<double>(kernelRadius) * kernelRadius);
+	case GeometricalAnalysisTools::DENSITY_3D:
+		return s_UnitSphereVolume * ((static_cast<double>(kernelRadius) * kernelRadius) * kernelRadius);
+	default:
+		break;
+	}
+
+	return -1.0;
+}
+
 int GeometricalAnalysisTools::computeLocalDensity(	GenericIndexedCloudPersist* theCloud,
 													Density densityType,
 													PointCoordinateType kernelRadius,
@@ -417,19 +436,9 @@ int GeometricalAnalysisTools::computeLocalDensity(	GenericIndexedCloudPersist* t
 		return -2;
 
 	//compute the right dimensional coef based on the expected output
-	double dimensionalCoef = 1.0;
-	switch (densityType)
+	double dimensionalCoef = ComputeDensityDimensionalCoef(densityType, kernelRadius);
+	if (dimensionalCoef <= 0)
 	{
-	case DENSITY_KNN:
-		dimensionalCoef = 1.0;
-		break;
-	case DENSITY_2D:
-		dimensionalCoef = M_PI * (static_cast<double>(kernelRadius) * kernelRadius);
-		break;
-	case DENSITY_3D:
-		dimensionalCoef = s_UnitSphereVolume * ((static_cast<double>(kernelRadius) * kernelRadius) * kernelRadius);
-		break;
-	default:
 		assert(false);
 		return -5;
 	}
@@ -630,6 +639,160 @@ bool GeometricalAnalysisTools::computePointsRoughnessInACellAtLevel(const DgmOct
 	return true;
 }
 
+int GeometricalAnalysisTools::computeLocalDensity(	const NeighbourGraph& graph,
+													Density densityType,
+													PointCoordinateType kernelRadius,
+													GenericProgressCallback* progressCb/*=0*/)
+{
+	GenericIndexedCloudPersist* theCloud = graph.associatedCloud();
+	if (!theCloud)
+		return -1;
+
+	if (theCloud->size() < 3)
+		return -2;
+
+	if (!graph.hasSphere(kernelRadius))
+		return -6;
+
+	//compute the right dimensional coef based on the expected output
+	double dimensionalCoef = ComputeDensityDimensionalCoef(densityType, kernelRadius);
+	if (dimensionalCoef <= 0)
+	{
+		assert(false);
+		return -5;
+	}
+
+	theCloud->enableScalarField();
+
+	//parameters
+	void* additionalParameters[] = {	static_cast<void*>(&kernelRadius),
+										static_cast<void*>(&dimensionalCoef) };
+
+	if (!graph.executeFunctionForAllPoints(	&computePointsDensity,
+											additionalParameters,
+											true,
+											progressCb,
+											"Local Density Computation"))
+	{
+		//something went wrong
+		return -4;
+	}
+
+	return 0;
+}
+
+//"PER-RANGE" METHOD: LOCAL DENSITY
+//ADDITIONNAL PARAMETERS (2):
+// [0] -> (PointCoordinateType*) kernelRadius : spherical neighborhood radius
+// [1] -> (double*) dimensionalCoef : neighborhood dimensional coefficient
+bool GeometricalAnalysisTools::computePointsDensity(	const NeighbourGraph& graph,
+														unsigned firstIndex,
+														unsigned lastIndex,
+														void** additionalParameters)
+{
+	//parameter(s)
+	PointCoordinateType radius = *static_cast<PointCoordinateType*>(additionalParameters[0]);
+	double dimensionalCoef = *static_cast<double*>(additionalParameters[1]);
+
+	assert(dimensionalCoef > 0);
+
+	GenericIndexedCloudPersist* cloud = graph.associatedCloud();
+
+	for (unsigned i=firstIndex; i<lastIndex; ++i)
+	{
+		//the point itself is not in the graph (but it is counted by the octree-based version)
+		unsigned neighborCount = graph.neighbourCountInSphere(i,radius) + 1;
+
+		ScalarType density = static_cast<ScalarType>(neighborCount/dimensionalCoef);
+		cloud->setPointScalarValue(i,density);
+	}
+
+	return true;
+}
+
+int GeometricalAnalysisTools::computeRoughness(const NeighbourGraph& graph, PointCoordinateType kernelRadius, GenericProgressCallback* progressCb/*=0*/)
+{
+	GenericIndexedCloudPersist* theCloud = graph.associatedCloud();
+	if (!theCloud)
+		return -1;
+
+	if (theCloud->size() < 3)
+		return -2;
+
+	if (!graph.hasSphere(kernelRadius))
+		return -6;
+
+	theCloud->enableScalarField();
+
+	//parameters
+	void* additionalParameters[1] = { static_cast<void*>(&kernelRadius) };
+
+	if (!graph.executeFunctionForAllPoints(	&computePointsRoughness,
+											additionalParameters,
+											true,
+											progressCb,
+											"Roughness Computation"))
+	{
+		//something went wrong
+		return -4;
+	}
+
+	return 0;
+}
+
+//"PER-RANGE" METHOD: ROUGHNESS ESTIMATION (LEAST SQUARES PLANE FIT)
+//ADDITIONNAL PARAMETERS (1):
+// [0] -> (PointCoordinateType*) kernelRadius : neighbourhood radius
+bool GeometricalAnalysisTools::computePointsRoughness(	const NeighbourGraph& graph,
+														unsigned firstIndex,
+														unsigned lastIndex,
+														void** additionalParameters)
+{
+	//parameter(s)
+	PointCoordinateType radius = *static_cast<PointCoordinateType*>(additionalParameters[0]);
+
+	GenericIndexedCloudPersist* cloud = graph.associatedCloud();
+
+	//neighbours (the point itself excluded)
+	DgmOctree::NeighboursSet neighbours;
+
+	for (unsigned i=firstIndex; i<lastIndex; ++i)
+	{
+		ScalarType d = NAN_VALUE;
+
+		unsigned neighborCount = graph.neighbourCountInSphere(i,radius);
+		if (neighborCount >= 3) //the point itself is not in the graph
+		{
+			const unsigned* indexes = graph.neighbourIndexes(i);
+			const float* squareDistances = graph.neighbourSquareDistances(i);
+			try
+			{
+				neighbours.resize(neighborCount);
+			}
+			catch (const std::bad_alloc&)
+			{
+				//not enough memory
+				return false;
+			}
+			for (unsigned j=0; j<neighborCount; ++j)
+			{
+				neighbours[j] = DgmOctree::PointDescriptor(cloud->getPoint(indexes[j]), indexes[j], squareDistances[j]);
+			}
+
+			DgmOctreeReferenceCloud neighboursCloud(&neighbours,neighborCount);
+			Neighbourhood Z(&neighboursCloud);
+
+			const PointCoordinateType* lsPlane = Z.getLSPlane();
+			if (lsPlane)
+				d = fabs(DistanceComputationTools::computePoint2PlaneDistance(cloud->getPoint(i),lsPlane));
+		}
+
+		cloud->setPointScalarValue(i,d);
+	}
+
+	return true;
+}
+
 CCVector3 GeometricalAnalysisTools::computeGravityCenter(GenericCloud* theCloud)
 {
 	assert(theCloud);
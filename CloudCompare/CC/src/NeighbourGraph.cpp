@@ -0,0 +1,407 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "NeighbourGraph.h"
+
+//local
+#include "GenericIndexedCloudPersist.h"
+#include "GenericProgressCallback.h"
+#include "ReferenceCloud.h"
+
+//system
+#include <algorithm>
+#include <assert.h>
+#include <stdio.h>
+
+#ifdef USE_QT
+#ifndef QT_DEBUG
+//enables multi-threading handling
+#define ENABLE_MT_NEIGHBOUR_GRAPH
+#endif
+#endif
+
+#ifdef ENABLE_MT_NEIGHBOUR_GRAPH
+#include <QtConcurrentMap>
+#endif
+
+using namespace CCLib;
+
+NeighbourGraph::NeighbourGraph()
+	: m_cloud(0)
+	, m_knn(0)
+	, m_radius(0)
+{
+}
+
+void NeighbourGraph::clear()
+{
+	m_cloud = 0;
+	m_knn = 0;
+	m_radius = 0;
+	m_offsets.clear();
+	m_indexes.clear();
+	m_squareDistances.clear();
+}
+
+bool NeighbourGraph::compute(	GenericIndexedCloudPersist* cloud,
+								unsigned knn,
+								PointCoordinateType radius/*=0*/,
+								DgmOctree* inputOctree/*=0*/,
+								GenericProgressCallback* progressCb/*=0*/,
+								int maxThreadCount/*=0*/)
+{
+	clear();
+
+	if (!cloud || (knn == 0 && radius <= 0))
+	{
+		//invalid input
+		assert(false);
+		return false;
+	}
+
+	unsigned pointCount = cloud->size();
+	if (pointCount == 0)
+	{
+		return false;
+	}
+
+	DgmOctree* octree = inputOctree;
+	if (!octree)
+	{
+		octree = new DgmOctree(cloud);
+		if (octree->build(progressCb) < 1)
+		{
+			delete octree;
+			return false;
+		}
+	}
+
+	m_knn = knn;
+	m_radius = std::max<PointCoordinateType>(radius, 0);
+
+	bool success = false;
+	for (unsigned step=0; step<1; ++step) //fake loop for easy break
+	{
+		try
+		{
+			m_offsets.resize(pointCount + 1, 0);
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			break;
+		}
+
+		unsigned char level = (m_radius > 0 ? octree->findBestLevelForAGivenNeighbourhoodSizeExtraction(m_radius) : octree->findBestLevelForAGivenPopulationPerCell(knn + 1));
+
+		int pass = 0;
+		void* additionalParameters[] = {	reinterpret_cast<void*>(this),
+											reinterpret_cast<void*>(&pass)
+		};
+
+		//1st pass: count the neighbours of each point (only necessary for spherical neighbourhoods)
+		if (m_radius > 0)
+		{
+			if (octree->executeFunctionForAllCellsAtLevel(	level,
+															&ComputeNeighboursAtLevel,
+															additionalParameters,
+															true,
+															progressCb,
+															"Neighbour graph (1/2)",
+															maxThreadCount) == 0)
+			{
+				//something went wrong
+				break;
+			}
+		}
+		else
+		{
+			unsigned count = std::min(knn, pointCount - 1);
+			for (unsigned i=0; i<pointCount; ++i)
+				m_offsets[i + 1] = count;
+		}
+
+		//deduce the position of each point neighbours
+		for (unsigned i=0; i<pointCount; ++i)
+			m_offsets[i + 1] += m_offsets[i];
+
+		try
+		{
+			m_indexes.resize(m_offsets.back());
+			m_squareDistances.resize(m_offsets.back());
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			break;
+		}
+
+		//2nd pass: store the neighbours
+		pass = 1;
+		if (octree->executeFunctionForAllCellsAtLevel(	level,
+														&ComputeNeighboursAtLevel,
+														additionalParameters,
+														true,
+														progressCb,
+														m_radius > 0 ? "Neighbour graph (2/2)" : "Neighbour graph",
+														maxThreadCount) == 0)
+		{
+			//something went wrong
+			break;
+		}
+
+		success = true;
+	}
+
+	if (!inputOctree)
+	{
+		delete octree;
+		octree = 0;
+	}
+
+	if (!success)
+	{
+		clear();
+		return false;
+	}
+
+	m_cloud = cloud;
+	return true;
+}
+
+bool NeighbourGraph::ComputeNeighboursAtLevel(	const DgmOctree::octreeCell& cell,
+												void** additionalParameters,
+												NormalizedProgress* nProgress/*=0*/)
+{
+	NeighbourGraph* graph	=  static_cast<NeighbourGraph*>(additionalParameters[0]);
+	int pass				= *static_cast<int*>(additionalParameters[1]);
+
+	const PointCoordinateType radius = graph->m_radius;
+	const unsigned knn = graph->m_knn;
+
+	//structures for nearest neighbors search (spherical and kNN)
+	DgmOctree::NearestNeighboursSphericalSearchStruct sphereNNSS;
+	DgmOctree::NearestNeighboursSearchStruct knnNNSS;
+	{
+		sphereNNSS.level = cell.level;
+		cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, sphereNNSS.cellPos, true);
+		cell.parentOctree->computeCellCenter(sphereNNSS.cellPos, cell.level, sphereNNSS.cellCenter);
+		if (radius > 0)
+		{
+			sphereNNSS.prepare(radius, cell.parentOctree->getCellSize(sphereNNSS.level));
+		}
+
+		knnNNSS.level = cell.level;
+		knnNNSS.minNumberOfNeighbors = knn + 1; //the point itself will be ignored
+		cell.parentOctree->getCellPos(cell.truncatedCode, cell.level, knnNNSS.cellPos, true);
+		knnNNSS.cellCenter = sphereNNSS.cellCenter;
+	}
+
+	unsigned n = cell.points->size(); //number of points in the current cell
+
+	//for each point in the cell
+	for (unsigned i=0; i<n; ++i)
+	{
+		const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
+
+		const DgmOctree::NeighboursSet* neighbours = 0;
+		unsigned neighborCount = 0;
+		unsigned maxCount = 0;
+
+		//neighbours inside the sphere first
+		if (radius > 0)
+		{
+			cell.points->getPoint(i, sphereNNSS.queryPoint);
+			neighborCount = cell.parentOctree->findNeighborsInASphereStartingFromCell(sphereNNSS, radius, true);
+			if (neighborCount > knn) //the point itself is in the sphere
+			{
+				neighbours = &sphereNNSS.pointsInNeighbourhood;
+				maxCount = neighborCount;
+			}
+		}
+
+		//otherwise the (knn+1) nearest neighbours (which include the points inside the sphere, if any)
+		if (!neighbours)
+		{
+			cell.points->getPoint(i, knnNNSS.queryPoint);
+			neighborCount = cell.parentOctree->findNearestNeighborsStartingFromCell(knnNNSS);
+			neighbours = &knnNNSS.pointsInNeighbourhood;
+			maxCount = knn;
+		}
+
+		if (pass == 0)
+		{
+			//count the neighbours (the point itself excluded)
+			unsigned count = 0;
+			for (unsigned j=0; j<neighborCount && count<maxCount; ++j)
+				if ((*neighbours)[j].pointIndex != globalIndex)
+					++count;
+			graph->m_offsets[globalIndex + 1] = count;
+		}
+		else
+		{
+			//store the neighbours (the point itself excluded)
+			size_t pos = graph->m_offsets[globalIndex];
+			size_t end = graph->m_offsets[globalIndex + 1];
+			for (unsigned j=0; j<neighborCount && pos<end; ++j)
+			{
+				const DgmOctree::PointDescriptor& desc = (*neighbours)[j];
+				if (desc.pointIndex != globalIndex)
+				{
+					graph->m_indexes[pos] = desc.pointIndex;
+					graph->m_squareDistances[pos] = static_cast<float>(desc.squareDistd);
+					++pos;
+				}
+			}
+			assert(pos == end);
+		}
+
+		if (nProgress && !nProgress->oneStep())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+unsigned NeighbourGraph::neighbourCountInSphere(unsigned pointIndex, PointCoordinateType radius) const
+{
+	const float* squareDistances = neighbourSquareDistances(pointIndex);
+	const float* end = squareDistances + neighbourCount(pointIndex);
+	float squareRadius = static_cast<float>(static_cast<double>(radius) * radius);
+
+	//neighbours are sorted by increasing distance
+	return static_cast<unsigned>(std::upper_bound(squareDistances, end, squareRadius) - squareDistances);
+}
+
+size_t NeighbourGraph::memoryUsage() const
+{
+	return	m_offsets.capacity() * sizeof(size_t)
+		+	m_indexes.capacity() * sizeof(unsigned)
+		+	m_squareDistances.capacity() * sizeof(float);
+}
+
+//! Number of points per range (see NeighbourGraph::executeFunctionForAllPoints)
+static const unsigned c_pointRangeSize = 4096;
+//! Number of ranges processed between two progress notifications
+static const unsigned c_rangesPerBatch = 64;
+
+//! Range of points to process (see NeighbourGraph::executeFunctionForAllPoints)
+struct PointRangeJob
+{
+	const NeighbourGraph* graph;
+	NeighbourGraph::pointRangeFunc func;
+	void** additionalParameters;
+	unsigned firstIndex;
+	unsigned lastIndex;
+	bool success;
+};
+
+//! Processes a range of points
+static void ProcessPointRange(PointRangeJob& job)
+{
+	job.success = job.func(*job.graph, job.firstIndex, job.lastIndex, job.additionalParameters);
+}
+
+bool NeighbourGraph::executeFunctionForAllPoints(	pointRangeFunc func,
+													void** additionalParameters,
+													bool multiThread/*=true*/,
+													GenericProgressCallback* progressCb/*=0*/,
+													const char* functionTitle/*=0*/) const
+{
+	if (!isValid() || !func)
+	{
+		assert(false);
+		return false;
+	}
+
+	unsigned pointCount = size();
+
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
+		{
+			if (functionTitle)
+				progressCb->setMethodTitle(functionTitle);
+			char buffer[256];
+			sprintf(buffer, "Points: %u", pointCount);
+			progressCb->setInfo(buffer);
+		}
+		progressCb->update(0);
+		progressCb->start();
+	}
+
+	std::vector<PointRangeJob> batch;
+	try
+	{
+		batch.reserve(c_rangesPerBatch);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return false;
+	}
+
+	bool success = true;
+	unsigned firstIndex = 0;
+	while (success && firstIndex < pointCount)
+	{
+		//prepare the next batch of ranges
+		batch.clear();
+		while (batch.size() < c_rangesPerBatch && firstIndex < pointCount)
+		{
+			PointRangeJob job;
+			job.graph = this;
+			job.func = func;
+			job.additionalParameters = additionalParameters;
+			job.firstIndex = firstIndex;
+			job.lastIndex = std::min(firstIndex + c_pointRangeSize, pointCount);
+			job.success = false;
+			batch.push_back(job);
+			firstIndex = job.lastIndex;
+		}
+
+#ifdef ENABLE_MT_NEIGHBOUR_GRAPH
+		if (multiThread && batch.size() > 1)
+			QtConcurrent::blockingMap(batch, ProcessPointRange);
+		else
+#else
+		(void)multiThread;
+#endif
+		for (size_t i=0; i<batch.size(); ++i)
+			ProcessPointRange(batch[i]);
+
+		for (size_t i=0; i<batch.size(); ++i)
+			success &= batch[i].success;
+
+		if (progressCb)
+		{
+			progressCb->update((100.0f * firstIndex) / pointCount);
+			if (progressCb->isCancelRequested())
+				success = false;
+		}
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	return success;
+}
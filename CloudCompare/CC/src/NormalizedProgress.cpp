@@ -17,47 +17,12 @@
 //##########################################################################
 
 #include "GenericProgressCallback.h"
+#include "AtomicCounter.h"
 
 //system
 #include <assert.h>
 #include <math.h>
 
-#ifdef USE_QT
-
-//we use Qt for the atomic counter
-#include <QAtomicInt>
-
-//! Qt 4/5 compatible QAtomicInt
-class AtomicCounter : public QAtomicInt
-{
-public:
-	AtomicCounter() : QAtomicInt(0) {}
-
-#if (QT_VERSION < QT_VERSION_CHECK(5, 0, 0))
-	inline int load() { return *this; }
-	inline void store(int value) { *static_cast<QAtomicInt*>(this) = value; }
-#endif
-};
-
-#else
-
-//we use a fake QAtomicInt
-
-//! Fake QAtomicInt
-/** \warning Not thread safe!
-**/
-class AtomicCounter
-{
-public:
-	AtomicCounter() : m_value(0) {}
-	inline int load() { return m_value; }
-	inline void store(int value) { m_value = value; }
-	inline int fetchAndAddRelaxed(int add) { int original = m_value; m_value += add; return original; }
-	int m_value;
-};
-
-#endif
-
 using namespace CCLib;
 
 NormalizedProgress::NormalizedProgress(	GenericProgressCallback* callback,
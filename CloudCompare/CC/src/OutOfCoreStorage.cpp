@@ -0,0 +1,351 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "OutOfCoreStorage.h"
+
+//system
+#include <assert.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+using namespace CCLib;
+
+//! Directory where the backing files are created (empty = out-of-core storage disabled)
+static std::string s_outOfCoreDirectory;
+//! Minimum size of an array (in bytes) to be stored out-of-core
+static size_t s_outOfCoreMinByteCount = 0;
+
+void OutOfCoreStorage::SetPolicy(const char* directory, size_t minByteCount/*=0*/)
+{
+	s_outOfCoreDirectory = (directory ? directory : "");
+	s_outOfCoreMinByteCount = minByteCount;
+}
+
+const char* OutOfCoreStorage::GetDirectory()
+{
+	return s_outOfCoreDirectory.empty() ? 0 : s_outOfCoreDirectory.c_str();
+}
+
+bool OutOfCoreStorage::ShouldBeUsed(size_t byteCount)
+{
+	return !s_outOfCoreDirectory.empty() && byteCount != 0 && byteCount >= s_outOfCoreMinByteCount;
+}
+
+#ifdef _WIN32
+//! Creates a new (temporary) backing file in the policy directory
+/** \return file handle (or INVALID_HANDLE_VALUE on error)
+**/
+static HANDLE CreateBackingFile()
+{
+	const char* directory = OutOfCoreStorage::GetDirectory();
+	char filename[MAX_PATH];
+	if (!GetTempFileNameA(directory ? directory : ".", "cco", 0, filename))
+		return INVALID_HANDLE_VALUE;
+	//the file is automatically deleted once all its handles are closed
+	return CreateFileA(	filename,
+						GENERIC_READ | GENERIC_WRITE,
+						0,
+						0,
+						CREATE_ALWAYS,
+						FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+						0);
+}
+#else
+//! Creates a new (temporary) backing file in the policy directory
+/** \return file descriptor (or -1 on error)
+**/
+static int CreateBackingFile()
+{
+	const char* directory = OutOfCoreStorage::GetDirectory();
+	std::string pattern = std::string(directory ? directory : ".") + "/ccOutOfCore_XXXXXX";
+	std::vector<char> filename(pattern.begin(), pattern.end());
+	filename.push_back(0);
+	int fd = mkstemp(&(filename.front()));
+	if (fd < 0)
+		return -1;
+	//the file will be deleted as soon as it is closed
+	unlink(&(filename.front()));
+	return fd;
+}
+#endif
+
+//! Header of the blocks allocated with OutOfCoreStorage::Allocate
+struct BlockHeader
+{
+	//! Total size of the block (header included)
+	size_t byteCount;
+	//! Whether the block is a mapped file or not
+	size_t mapped;
+};
+//! Size reserved for the block header (keeps the data aligned on 16 bytes)
+static const size_t BLOCK_HEADER_SIZE = 16;
+
+//! Maps a new (temporary) file of the given size in memory
+/** \return mapped address (or 0 on error)
+**/
+static void* MapNewFile(size_t byteCount)
+{
+	void* address = 0;
+#ifdef _WIN32
+	HANDLE fileHandle = CreateBackingFile();
+	if (fileHandle == INVALID_HANDLE_VALUE)
+		return 0;
+	ULARGE_INTEGER size;
+	size.QuadPart = byteCount;
+	HANDLE mappingHandle = CreateFileMappingA(fileHandle, 0, PAGE_READWRITE, size.HighPart, size.LowPart, 0);
+	if (mappingHandle)
+	{
+		address = MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, byteCount);
+		//the view keeps the mapping (and the file) alive
+		CloseHandle(mappingHandle);
+	}
+	CloseHandle(fileHandle);
+#else
+	int fd = CreateBackingFile();
+	if (fd < 0)
+		return 0;
+#ifdef __linux__
+	//make sure the disk space is actually available (see OutOfCoreStorage::resize)
+	bool fileOk = (posix_fallocate(fd, 0, static_cast<off_t>(byteCount)) == 0);
+#else
+	bool fileOk = (ftruncate(fd, static_cast<off_t>(byteCount)) == 0);
+#endif
+	if (fileOk)
+	{
+		address = mmap(0, byteCount, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+		if (address == MAP_FAILED)
+			address = 0;
+	}
+	//the mapping keeps the file alive
+	close(fd);
+#endif
+	return address;
+}
+
+void* OutOfCoreStorage::Allocate(size_t byteCount)
+{
+	size_t totalByteCount = byteCount + BLOCK_HEADER_SIZE;
+	if (totalByteCount < byteCount) //overflow
+		return 0;
+
+	BlockHeader* header = 0;
+	bool mapped = false;
+	if (ShouldBeUsed(byteCount))
+	{
+		header = static_cast<BlockHeader*>(MapNewFile(totalByteCount));
+		mapped = (header != 0);
+	}
+	if (!header)
+	{
+		header = static_cast<BlockHeader*>(malloc(totalByteCount));
+		if (!header)
+			return 0;
+	}
+
+	header->byteCount = totalByteCount;
+	header->mapped = (mapped ? 1 : 0);
+
+	return reinterpret_cast<char*>(header) + BLOCK_HEADER_SIZE;
+}
+
+void OutOfCoreStorage::Free(void* address)
+{
+	if (!address)
+		return;
+
+	BlockHeader* header = reinterpret_cast<BlockHeader*>(static_cast<char*>(address) - BLOCK_HEADER_SIZE);
+	if (header->mapped)
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(header);
+#else
+		munmap(header, header->byteCount);
+#endif
+	}
+	else
+	{
+		free(header);
+	}
+}
+
+OutOfCoreStorage::OutOfCoreStorage()
+	: m_address(0)
+	, m_size(0)
+#ifdef _WIN32
+	, m_fileHandle(INVALID_HANDLE_VALUE)
+	, m_mappingHandle(0)
+#else
+	, m_fileDescriptor(-1)
+#endif
+{
+}
+
+OutOfCoreStorage::~OutOfCoreStorage()
+{
+	release();
+}
+
+void OutOfCoreStorage::release()
+{
+	unmap();
+	m_size = 0;
+
+#ifdef _WIN32
+	if (m_fileHandle != INVALID_HANDLE_VALUE)
+	{
+		//the file is automatically deleted (FILE_FLAG_DELETE_ON_CLOSE)
+		CloseHandle(m_fileHandle);
+		m_fileHandle = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (m_fileDescriptor >= 0)
+	{
+		//the file has already been unlinked (see 'resize')
+		close(m_fileDescriptor);
+		m_fileDescriptor = -1;
+	}
+#endif
+}
+
+bool OutOfCoreStorage::map()
+{
+	assert(!m_address);
+	if (m_size == 0)
+		return true;
+
+#ifdef _WIN32
+	ULARGE_INTEGER size;
+	size.QuadPart = m_size;
+	m_mappingHandle = CreateFileMappingA(m_fileHandle, 0, PAGE_READWRITE, size.HighPart, size.LowPart, 0);
+	if (!m_mappingHandle)
+		return false;
+	m_address = MapViewOfFile(m_mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, m_size);
+	if (!m_address)
+	{
+		CloseHandle(m_mappingHandle);
+		m_mappingHandle = 0;
+		return false;
+	}
+#else
+	void* address = mmap(0, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fileDescriptor, 0);
+	if (address == MAP_FAILED)
+		return false;
+	m_address = address;
+#endif
+
+	return true;
+}
+
+void OutOfCoreStorage::unmap()
+{
+#ifdef _WIN32
+	if (m_address)
+		UnmapViewOfFile(m_address);
+	if (m_mappingHandle)
+	{
+		CloseHandle(m_mappingHandle);
+		m_mappingHandle = 0;
+	}
+#else
+	if (m_address)
+		munmap(m_address, m_size);
+#endif
+	m_address = 0;
+}
+
+bool OutOfCoreStorage::resize(size_t byteCount)
+{
+	if (byteCount == m_size)
+		return true;
+
+	//create the backing file (first call)
+#ifdef _WIN32
+	if (m_fileHandle == INVALID_HANDLE_VALUE)
+	{
+		m_fileHandle = CreateBackingFile();
+		if (m_fileHandle == INVALID_HANDLE_VALUE)
+			return false;
+	}
+#else
+	if (m_fileDescriptor < 0)
+	{
+		m_fileDescriptor = CreateBackingFile();
+		if (m_fileDescriptor < 0)
+			return false;
+	}
+#endif
+
+	unmap();
+
+	//resize the backing file
+#ifdef _WIN32
+	LARGE_INTEGER newSize;
+	newSize.QuadPart = static_cast<LONGLONG>(byteCount);
+	if (!SetFilePointerEx(m_fileHandle, newSize, 0, FILE_BEGIN) || !SetEndOfFile(m_fileHandle))
+	{
+		//restore the previous mapping
+		map();
+		return false;
+	}
+#else
+	if (ftruncate(m_fileDescriptor, static_cast<off_t>(byteCount)) != 0)
+	{
+		//restore the previous mapping
+		map();
+		return false;
+	}
+#ifdef __linux__
+	//make sure the disk space is actually available (otherwise
+	//writing in the mapped memory would raise a SIGBUS signal)
+	if (byteCount > m_size && posix_fallocate(m_fileDescriptor, static_cast<off_t>(m_size), static_cast<off_t>(byteCount - m_size)) != 0)
+	{
+		//restore the previous file size
+		if (ftruncate(m_fileDescriptor, static_cast<off_t>(m_size)) != 0)
+		{
+			//the file keeps the new (sparse) size: the previous mapping is still valid as
+			//the file is bigger, but the disk space beyond m_size is not reserved anymore
+			assert(false);
+		}
+		//restore the previous mapping
+		map();
+		return false;
+	}
+#endif
+#endif
+
+	size_t previousSize = m_size;
+	m_size = byteCount;
+	if (!map())
+	{
+		//try to go back to the previous state
+		m_size = previousSize;
+		map();
+		return false;
+	}
+
+	return true;
+}
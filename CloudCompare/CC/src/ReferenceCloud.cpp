@@ -88,7 +88,7 @@ void ReferenceCloud::updateBBWithPoint(const CCVector3& P)
 void ReferenceCloud::computeBB()
 {
 	//empty cloud?!
-	unsigned count = size();
+	PointIndexType count = size();
 	if (count == 0)
 	{
 		m_bbMin = m_bbMax = CCVector3(0,0,0);
@@ -99,7 +99,7 @@ void ReferenceCloud::computeBB()
 	const CCVector3* P = getPointPersistentPtr(0);
 	m_bbMin = m_bbMax = *P;
 
-	for (unsigned i=1; i<count; ++i)
+	for (PointIndexType i=1; i<count; ++i)
 	{
 		P = getPointPersistentPtr(i);
 		updateBBWithPoint(*P);
@@ -117,12 +117,12 @@ void ReferenceCloud::getBoundingBox(CCVector3& bbMin, CCVector3& bbMax)
 	bbMax = m_bbMax;
 }
 
-bool ReferenceCloud::reserve(unsigned n)
+bool ReferenceCloud::reserve(PointIndexType n)
 {
 	return m_theIndexes->reserve(n);
 }
 
-bool ReferenceCloud::resize(unsigned n)
+bool ReferenceCloud::resize(PointIndexType n)
 {
 	return m_theIndexes->resize(n);
 }
@@ -134,10 +134,10 @@ const CCVector3* ReferenceCloud::getCurrentPointCoordinates() const
 	return m_theAssociatedCloud->getPointPersistentPtr(m_theIndexes->getValue(m_globalIterator));
 }
 
-bool ReferenceCloud::addPointIndex(unsigned globalIndex)
+bool ReferenceCloud::addPointIndex(PointIndexType globalIndex)
 {
 	if (m_theIndexes->capacity() == m_theIndexes->currentSize())
-		if (!m_theIndexes->reserve(m_theIndexes->capacity() + std::min<unsigned>(std::max<unsigned>(1,m_theIndexes->capacity()/2),4096))) //not enough space --> +50% (or 4096)
+		if (!m_theIndexes->reserve(m_theIndexes->capacity() + std::min<PointIndexType>(std::max<PointIndexType>(1,m_theIndexes->capacity()/2),4096))) //not enough space --> +50% (or 4096)
 			return false;
 
 	m_theIndexes->addElement(globalIndex);
@@ -146,7 +146,7 @@ bool ReferenceCloud::addPointIndex(unsigned globalIndex)
 	return true;
 }
 
-bool ReferenceCloud::addPointIndex(unsigned firstIndex, unsigned lastIndex)
+bool ReferenceCloud::addPointIndex(PointIndexType firstIndex, PointIndexType lastIndex)
 {
 	if (firstIndex >= lastIndex)
 	{
@@ -154,13 +154,13 @@ bool ReferenceCloud::addPointIndex(unsigned firstIndex, unsigned lastIndex)
 		return false;
 	}
 
-	unsigned range = lastIndex-firstIndex; //lastIndex is excluded
-    unsigned pos = size();
+	PointIndexType range = lastIndex-firstIndex; //lastIndex is excluded
+    PointIndexType pos = size();
 
 	if (size()<pos+range && !m_theIndexes->resize(pos+range))
 		return false;
 	
-	for (unsigned i=0; i<range; ++i,++firstIndex)
+	for (PointIndexType i=0; i<range; ++i,++firstIndex)
 		m_theIndexes->setValue(pos++,firstIndex);
 
 	invalidateBoundingBox();
@@ -168,7 +168,7 @@ bool ReferenceCloud::addPointIndex(unsigned firstIndex, unsigned lastIndex)
 	return true;
 }
 
-void ReferenceCloud::setPointIndex(unsigned localIndex, unsigned globalIndex)
+void ReferenceCloud::setPointIndex(PointIndexType localIndex, PointIndexType globalIndex)
 {
 	assert(localIndex < size());
 	m_theIndexes->setValue(localIndex,globalIndex);
@@ -179,10 +179,10 @@ void ReferenceCloud::forEach(genericPointAction& action)
 {
 	assert(m_theAssociatedCloud);
 
-	unsigned count = size();
-	for (unsigned i=0; i<count; ++i)
+	PointIndexType count = size();
+	for (PointIndexType i=0; i<count; ++i)
 	{
-		const unsigned& index = m_theIndexes->getValue(i);
+		const PointIndexType& index = m_theIndexes->getValue(i);
 		ScalarType d = m_theAssociatedCloud->getPointScalarValue(index);
 		ScalarType d2 = d;
 		action(*m_theAssociatedCloud->getPointPersistentPtr(index),d2);
@@ -191,11 +191,11 @@ void ReferenceCloud::forEach(genericPointAction& action)
 	}
 }
 
-void ReferenceCloud::removePointGlobalIndex(unsigned localIndex)
+void ReferenceCloud::removePointGlobalIndex(PointIndexType localIndex)
 {
 	assert(localIndex < size());
 
-	unsigned lastIndex = size()-1;
+	PointIndexType lastIndex = size()-1;
 	//swap the value to be removed with the last one
 	m_theIndexes->setValue(localIndex,m_theIndexes->getValue(lastIndex));
 	m_theIndexes->setCurrentSize(lastIndex);
@@ -212,17 +212,17 @@ bool ReferenceCloud::add(const ReferenceCloud& cloud)
 	if (!m_theIndexes || !cloud.m_theAssociatedCloud || m_theAssociatedCloud != cloud.m_theAssociatedCloud)
 		return false;
 
-	unsigned newCount = (cloud.m_theIndexes ? cloud.m_theIndexes->currentSize() : 0);
+	PointIndexType newCount = (cloud.m_theIndexes ? cloud.m_theIndexes->currentSize() : 0);
 	if (newCount == 0)
 		return true;
 
 	//reserve memory
-	unsigned count = m_theIndexes->currentSize();
+	PointIndexType count = m_theIndexes->currentSize();
 	if (!m_theIndexes->resize(count + newCount))
 		return false;
 
 	//copy new indexes (warning: no duplicate check!)
-	for (unsigned i=0; i<newCount; ++i)
+	for (PointIndexType i=0; i<newCount; ++i)
 		(*m_theIndexes)[count+i] = (*cloud.m_theIndexes)[i];
 
 	invalidateBoundingBox();
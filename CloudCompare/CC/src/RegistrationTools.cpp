@@ -25,13 +25,16 @@
 #include "GenericIndexedCloudPersist.h"
 #include "ReferenceCloud.h"
 #include "DgmOctree.h"
+#include "DgmOctreeReferenceCloud.h"
 #include "DistanceComputationTools.h"
 #include "CCConst.h"
+#include "CCMiscTools.h"
 #include "CloudSamplingTools.h"
 #include "ScalarFieldTools.h"
 #include "NormalDistribution.h"
 #include "ManualSegmentationTools.h"
 #include "GeometricalAnalysisTools.h"
+#include "Neighbourhood.h"
 #include "KdTree.h"
 #include "SimpleCloud.h"
 #include "ChunkedPointCloud.h"
@@ -43,6 +46,18 @@
 #include <time.h>
 #include <algorithm>
 #include <assert.h>
+#include <chrono>
+
+#ifdef USE_QT
+#ifndef QT_DEBUG
+//enables multi-threading handling
+#define ENABLE_MT_REGISTRATION
+#endif
+#endif
+
+#ifdef ENABLE_MT_REGISTRATION
+#include <QtConcurrentMap>
+#endif
 
 using namespace CCLib;
 
@@ -153,6 +168,187 @@ struct DataCloud
 	ChunkedPointCloud* CPSetPlain;
 };
 
+typedef std::chrono::steady_clock ICPClock;
+
+static double SecondsSince(const ICPClock::time_point& start)
+{
+	return std::chrono::duration<double>(ICPClock::now() - start).count();
+}
+
+static void StoreStepTimings(	std::vector<ICPRegistrationTools::IterationTimings>* iterationTimings,
+								ICPRegistrationTools::IterationTimings& stepTimings,
+								const ICPClock::time_point& stepStart)
+{
+	if (!iterationTimings)
+		return;
+
+	stepTimings.totalTime_s = SecondsSince(stepStart);
+	try
+	{
+		iterationTimings->push_back(stepTimings);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not a big deal
+	}
+}
+
+//! Minimum number of couples to keep when 'Parameters::maxCoupleDistance' is set
+static const unsigned c_minCoupleCount = 16;
+
+//! Margin added to the model octree box so that it keeps containing the data cloud while it moves
+static const double c_modelOctreeBoxMargin = 0.25;
+
+//! Computes the distances between the (moving) data cloud and the model cloud
+/** The model octree is only (re)built if the data cloud doesn't fit in its box anymore:
+	it can therefore be reused from one ICP iteration to the next. Only the (small)
+	data octree is rebuilt each time, with the very same box so that both octrees are
+	directly considered as synchronized (see DistanceComputationTools::synchronizeOctrees).
+**/
+static int ComputeCloud2ModelDistances(	ReferenceCloud* dataCloud,
+										GenericIndexedCloudPersist* modelCloud,
+										DgmOctree* modelOctree,
+										DistanceComputationTools::Cloud2CloudDistanceComputationParams& params,
+										GenericProgressCallback* progressCb = 0)
+{
+	assert(dataCloud && modelCloud && modelOctree);
+
+	CCVector3 dataMin, dataMax;
+	dataCloud->getBoundingBox(dataMin, dataMax);
+
+	//does the current model octree box still contain the data cloud?
+	bool rebuildModelOctree = (modelOctree->getNumberOfProjectedPoints() != modelCloud->size());
+	if (!rebuildModelOctree)
+	{
+		const CCVector3& octreeMin = modelOctree->getOctreeMins();
+		const CCVector3& octreeMax = modelOctree->getOctreeMaxs();
+		for (unsigned char k=0; k<3; k++)
+		{
+			if (dataMin.u[k] < octreeMin.u[k] || dataMax.u[k] > octreeMax.u[k])
+			{
+				rebuildModelOctree = true;
+				break;
+			}
+		}
+	}
+
+	if (rebuildModelOctree)
+	{
+		CCVector3 boxMin, boxMax;
+		modelCloud->getBoundingBox(boxMin, boxMax);
+		for (unsigned char k=0; k<3; k++)
+		{
+			boxMin.u[k] = std::min(boxMin.u[k], dataMin.u[k]);
+			boxMax.u[k] = std::max(boxMax.u[k], dataMax.u[k]);
+		}
+		//we take some margin as the data cloud will move
+		CCMiscTools::MakeMinAndMaxCubical(boxMin, boxMax, c_modelOctreeBoxMargin);
+
+		if (modelOctree->build(boxMin, boxMax, 0, 0, progressCb) < static_cast<int>(modelCloud->size()))
+		{
+			modelOctree->clear();
+			return -1;
+		}
+	}
+
+	//the data octree is built with the same box as the model one
+	DgmOctree dataOctree(dataCloud);
+	if (dataOctree.build(modelOctree->getOctreeMins(), modelOctree->getOctreeMaxs(), 0, 0, progressCb) < static_cast<int>(dataCloud->size()))
+	{
+		//not enough memory
+		return -1;
+	}
+
+	return DistanceComputationTools::computeCloud2CloudDistance(dataCloud, modelCloud, params, progressCb, &dataOctree, modelOctree);
+}
+
+//"PER-CELL" METHOD: NORMALS ESTIMATION (LS PLANE ON THE K NEAREST NEIGHBOURS)
+//ADDITIONAL PARAMETERS (2):
+// [0] -> (unsigned*) knn: number of neighbours
+// [1] -> (std::vector<CCVector3>*) normals: output normals (per point)
+static bool ComputeCellNormalsAtLevel(	const DgmOctree::octreeCell& cell,
+										void** additionalParameters,
+										NormalizedProgress* nProgress = 0)
+{
+	unsigned knn					= *static_cast<unsigned*>(additionalParameters[0]);
+	std::vector<CCVector3>& normals	= *static_cast<std::vector<CCVector3>*>(additionalParameters[1]);
+
+	//structure for nearest neighbors search
+	DgmOctree::NearestNeighboursSearchStruct nNSS;
+	nNSS.level = cell.level;
+	nNSS.minNumberOfNeighbors = knn;
+	cell.parentOctree->getCellPos(cell.truncatedCode,cell.level,nNSS.cellPos,true);
+	cell.parentOctree->computeCellCenter(nNSS.cellPos,cell.level,nNSS.cellCenter);
+
+	unsigned n = cell.points->size(); //number of points in the current cell
+
+	//for each point in the cell
+	for (unsigned i=0; i<n; ++i)
+	{
+		cell.points->getPoint(i,nNSS.queryPoint);
+
+		//look for the k nearest neighbors (sorted by distance)
+		unsigned neighborCount = std::min(cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS), knn);
+
+		CCVector3 N(0,0,0);
+		if (neighborCount >= 3)
+		{
+			DgmOctreeReferenceCloud neighboursCloud(&nNSS.pointsInNeighbourhood,neighborCount);
+			Neighbourhood Z(&neighboursCloud);
+			const CCVector3* lsNormal = Z.getLSPlaneNormal();
+			if (lsNormal)
+				N = *lsNormal;
+		}
+		normals[cell.points->getPointGlobalIndex(i)] = N;
+
+		if (nProgress && !nProgress->oneStep())
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+//! Estimates the normals of all the points of a cloud (a null vector is set if the estimation fails)
+static bool EstimateNormals(DgmOctree* octree,
+							unsigned knn,
+							std::vector<CCVector3>& normals,
+							int maxThreadCount,
+							GenericProgressCallback* progressCb = 0)
+{
+	assert(octree && octree->associatedCloud());
+	unsigned pointCount = octree->associatedCloud()->size();
+
+	//we can't look for more neighbours than available
+	knn = std::min(knn, pointCount);
+	if (knn < 3)
+		return false;
+
+	try
+	{
+		normals.resize(pointCount, CCVector3(0,0,0));
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return false;
+	}
+
+	unsigned char level = octree->findBestLevelForAGivenPopulationPerCell(knn);
+
+	void* additionalParameters[2] = {	static_cast<void*>(&knn),
+										static_cast<void*>(&normals) };
+
+	return octree->executeFunctionForAllCellsAtLevel(	level,
+														&ComputeCellNormalsAtLevel,
+														additionalParameters,
+														true,
+														progressCb,
+														"Normals estimation",
+														maxThreadCount) != 0;
+}
+
 ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexedCloudPersist* inputModelCloud,
 																	GenericIndexedMesh* inputModelMesh,
 																	GenericIndexedCloudPersist* inputDataCloud,
@@ -160,7 +356,8 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 																	ScaledTransformation& transform,
 																	double& finalRMS,
 																	unsigned& finalPointCount,
-																	GenericProgressCallback* progressCb/*=0*/)
+																	GenericProgressCallback* progressCb/*=0*/,
+																	std::vector<IterationTimings>* iterationTimings/*=0*/)
 {
 	if (!inputModelCloud || !inputDataCloud)
 	{
@@ -168,12 +365,22 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 		return ICP_ERROR_INVALID_INPUT;
 	}
 
+	//coarse-to-fine registration
+	if (params.multiResolutionLevels > 1)
+	{
+		return RegisterMultiResolution(inputModelCloud, inputModelMesh, inputDataCloud, params, transform, finalRMS, finalPointCount, progressCb, iterationTimings);
+	}
+
 
 	//hopefully the user will understand it's not possible ;)
 	finalRMS = -1.0;
 
 	Garbage<GenericIndexedCloudPersist> cloudGarbage;
 	Garbage<ScalarField> sfGarbage;
+	Garbage<DgmOctree> octreeGarbage;
+
+	if (iterationTimings)
+		iterationTimings->clear();
 
 	//DATA CLOUD (will move)
 	DataCloud data;
@@ -242,6 +449,7 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 
 	//MODEL ENTITY (reference, won't move)
 	ModelCloud model;
+	DgmOctree* modelOctree = 0;
 	if (inputModelMesh)
 	{
 		assert(!params.modelWeights);
@@ -301,6 +509,41 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 			model.weights = params.modelWeights;
 		}
 		assert(model.cloud);
+
+		//the model octree will be built once and reused at each iteration
+		modelOctree = new DgmOctree(model.cloud);
+		octreeGarbage.add(modelOctree);
+	}
+
+	//model normals (for the point-to-plane metric)
+	bool pointToPlane = (params.errorMetric == POINT_TO_PLANE && !inputModelMesh && model.cloud->size() >= 3);
+	std::vector<CCVector3> modelNormals;
+	if (pointToPlane && params.modelNormals)
+	{
+		if (params.modelNormals->currentSize() != inputModelCloud->size())
+		{
+			assert(false);
+			return ICP_ERROR_INVALID_INPUT;
+		}
+
+		unsigned count = model.cloud->size();
+		try
+		{
+			modelNormals.resize(count);
+		}
+		catch (const std::bad_alloc&)
+		{
+			//not enough memory
+			return ICP_ERROR_NOT_ENOUGH_MEMORY;
+		}
+
+		//the model cloud may have been resampled
+		ReferenceCloud* subModelCloud = (model.cloud != inputModelCloud ? static_cast<ReferenceCloud*>(model.cloud) : 0);
+		for (unsigned i = 0; i < count; ++i)
+		{
+			unsigned pointIndex = (subModelCloud ? subModelCloud->getPointGlobalIndex(i) : i);
+			modelNormals[i] = CCVector3::fromArray(params.modelNormals->getValue(pointIndex));
+		}
 	}
 
 	//for partial overlap
@@ -342,6 +585,10 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 		sfGarbage.add(coupleWeights);
 	}
 
+	//timings of the current step
+	IterationTimings stepTimings;
+	ICPClock::time_point stepStart = ICPClock::now();
+
 	//we compute the initial distance between the two clouds (and the CPSet by the way)
 	//data.cloud->forEach(ScalarFieldTools::SetScalarValueToNaN); //DGM: done automatically in computeCloud2CloudDistance now
 	if (inputModelMesh)
@@ -363,7 +610,7 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 		DistanceComputationTools::Cloud2CloudDistanceComputationParams c2cDistParams;
 		c2cDistParams.CPSet = data.CPSetRef;
 		c2cDistParams.maxThreadCount = params.maxThreadCount;
-		if (DistanceComputationTools::computeCloud2CloudDistance(data.cloud, model.cloud, c2cDistParams, progressCb) < 0)
+		if (ComputeCloud2ModelDistances(data.cloud, model.cloud, modelOctree, c2cDistParams, progressCb) < 0)
 		{
 			//an error occurred during distances computation...
 			return ICP_ERROR_DIST_COMPUTATION;
@@ -374,6 +621,17 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 		assert(false);
 	}
 
+	//we estimate the model normals if necessary (now that the model octree is ready)
+	if (pointToPlane && modelNormals.empty())
+	{
+		if (!EstimateNormals(modelOctree, params.normalsNeighbourCount, modelNormals, params.maxThreadCount, progressCb))
+		{
+			//not enough memory (or process canceled by the user)
+			return ICP_ERROR_NOT_ENOUGH_MEMORY;
+		}
+	}
+	stepTimings.distancesTime_s = SecondsSince(stepStart);
+
 	FILE* fTraceFile = 0;
 #ifdef QT_DEBUG
 	fTraceFile = fopen("registration_trace_log.csv","wt");
@@ -387,6 +645,11 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 
 	for (unsigned iteration = 0 ;; ++iteration)
 	{
+		//store the timings of the previous step
+		StoreStepTimings(iterationTimings, stepTimings, stepStart);
+		stepTimings = ICPRegistrationTools::IterationTimings();
+		stepStart = ICPClock::now();
+
 		if (progressCb && progressCb->isCancelRequested())
 		{
 			result = ICP_ERROR_CANCELED_BY_USER;
@@ -478,6 +741,7 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 		//shall we ignore/remove some points based on their distance?
 		DataCloud trueData;
 		unsigned pointCount = data.cloud->size();
+		ScalarType maxCoupleDist = -1; //no limit by default
 		if (maxOverlapCount != 0 && pointCount > maxOverlapCount)
 		{
 			assert(overlapDistances.size() >= pointCount);
@@ -489,8 +753,21 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 			SortAlgo(overlapDistances.begin(), overlapDistances.begin() + pointCount);
 
 			assert(maxOverlapCount != 0);
-			ScalarType maxOverlapDist = overlapDistances[maxOverlapCount-1];
+			maxCoupleDist = overlapDistances[maxOverlapCount-1];
+		}
+		if (params.maxCoupleDistance > 0 && (maxCoupleDist < 0 || params.maxCoupleDistance < maxCoupleDist))
+		{
+			//we only apply this limit if enough couples remain
+			unsigned closeCount = 0;
+			for (unsigned i=0; i<pointCount; ++i)
+				if (data.cloud->getPointScalarValue(i) <= params.maxCoupleDistance)
+					++closeCount;
+			if (closeCount >= c_minCoupleCount)
+				maxCoupleDist = static_cast<ScalarType>(params.maxCoupleDistance);
+		}
 
+		if (maxCoupleDist >= 0)
+		{
 			DataCloud filteredData;
 			filteredData.cloud = new ReferenceCloud(data.cloud->getAssociatedCloud());
 			if (data.CPSetRef)
@@ -510,7 +787,7 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 				sfGarbage.add(filteredData.weights);
 			}
 
-			if (	!filteredData.cloud->reserve(pointCount) //should be maxOverlapCount in theory, but there may be several points with the same value as maxOverlapDist!
+			if (	!filteredData.cloud->reserve(pointCount) //should be maxOverlapCount in theory, but there may be several points with the same value as maxCoupleDist!
 				||	(filteredData.CPSetRef && !filteredData.CPSetRef->reserve(pointCount))
 				||	(filteredData.CPSetPlain && !filteredData.CPSetPlain->reserve(pointCount))
 				||	(filteredData.weights && !filteredData.weights->reserve(pointCount)))
@@ -523,7 +800,7 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 			//we keep only the points with "not too high" distances
 			for (unsigned i=0; i<pointCount; ++i)
 			{
-				if (data.cloud->getPointScalarValue(i) <= maxOverlapDist)
+				if (data.cloud->getPointScalarValue(i) <= maxCoupleDist)
 				{
 					filteredData.cloud->addPointIndex(data.cloud->getPointGlobalIndex(i));
 					if (filteredData.CPSetRef)
@@ -534,7 +811,7 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 						filteredData.weights->addElement(data.weights->getValue(i));
 				}
 			}
-			assert(filteredData.cloud->size() >= maxOverlapCount);
+			assert(filteredData.cloud->size() >= std::min(maxOverlapCount, c_minCoupleCount));
 
 			//resize should be ok as we have called reserve first
 			filteredData.cloud->resize(filteredData.cloud->size()); //should always be ok as current size < pointCount
@@ -582,6 +859,14 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 			for (unsigned i = 0; i < data.cloud->size(); ++i)
 			{
 				ScalarType V = data.cloud->getPointScalarValue(i);
+				if (pointToPlane && ScalarField::ValidValue(V))
+				{
+					//we use the distance to the tangent plane instead
+					const CCVector3& N = modelNormals[data.CPSetRef->getPointGlobalIndex(i)];
+					if (N.norm2() == 0)
+						continue;
+					V = static_cast<ScalarType>(fabs((*data.cloud->getPoint(i) - *data.CPSetRef->getPoint(i)).dot(N)));
+				}
 				if (ScalarField::ValidValue(V))
 				{
 					double wi = 1.0;
@@ -709,15 +994,29 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 
 		//single iteration of the registration procedure
 		currentTrans = ScaledTransformation();
-		if (!RegistrationTools::RegistrationProcedure(	data.cloud,
-														data.CPSetRef ? static_cast<CCLib::GenericCloud*>(data.CPSetRef) : static_cast<CCLib::GenericCloud*>(data.CPSetPlain),
-														currentTrans,
-														params.adjustScale,
-														coupleWeights))
+		ICPClock::time_point registrationStart = ICPClock::now();
+		if (pointToPlane)
+		{
+			if (!PointToPlaneRegistrationProcedure(	data.cloud,
+													data.CPSetRef,
+													modelNormals,
+													currentTrans,
+													coupleWeights))
+			{
+				result = ICP_ERROR_REGISTRATION_STEP;
+				break;
+			}
+		}
+		else if (!RegistrationTools::RegistrationProcedure(	data.cloud,
+															data.CPSetRef ? static_cast<CCLib::GenericCloud*>(data.CPSetRef) : static_cast<CCLib::GenericCloud*>(data.CPSetPlain),
+															currentTrans,
+															params.adjustScale,
+															coupleWeights))
 		{
 			result = ICP_ERROR_REGISTRATION_STEP;
 			break;
 		}
+		stepTimings.registrationTime_s = SecondsSince(registrationStart);
 
 		//restore original data sets (if any were stored)
 		if (trueData.cloud)
@@ -775,6 +1074,7 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 		}
 
 		//compute (new) distances to model
+		ICPClock::time_point distancesStart = ICPClock::now();
 		if (inputModelMesh)
 		{
 			DistanceComputationTools::Cloud2MeshDistanceComputationParams c2mDistParams;
@@ -793,7 +1093,7 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 			DistanceComputationTools::Cloud2CloudDistanceComputationParams c2cDistParams;
 			c2cDistParams.CPSet = data.CPSetRef;
 			c2cDistParams.maxThreadCount = params.maxThreadCount;
-			if (DistanceComputationTools::computeCloud2CloudDistance(data.cloud, model.cloud, c2cDistParams) < 0)
+			if (ComputeCloud2ModelDistances(data.cloud, model.cloud, modelOctree, c2cDistParams) < 0)
 			{
 				//an error occurred during distances computation...
 				result = ICP_ERROR_REGISTRATION_STEP;
@@ -804,8 +1104,12 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 		{
 			assert(false);
 		}
+		stepTimings.distancesTime_s = SecondsSince(distancesStart);
 	}
 
+	//store the timings of the last step
+	StoreStepTimings(iterationTimings, stepTimings, stepStart);
+
 	//end of tracefile
 	if (fTraceFile)
 	{
@@ -822,6 +1126,343 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::Register(	GenericIndexed
 	return result;
 }
 
+//! Max couple distance at each coarse level (relatively to the cell size)
+static const PointCoordinateType c_multiResMaxDistCellFactor = static_cast<PointCoordinateType>(4);
+//! Minimum number of points to register at a coarse level
+static const unsigned c_multiResMinPointCount = 256;
+//! Indicative number of points at the coarsest level
+static const unsigned c_multiResCoarsestPointCount = 1000;
+
+//! Composes two transformations: total <- current o total
+static void ComposeTransformations(	RegistrationTools::ScaledTransformation& total,
+									const RegistrationTools::ScaledTransformation& current)
+{
+	if (current.R.isValid())
+	{
+		if (total.R.isValid())
+			total.R = current.R * total.R;
+		else
+			total.R = current.R;
+
+		total.T = current.R * total.T;
+	}
+
+	total.s *= current.s;
+	total.T = total.T * current.s + current.T;
+}
+
+ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::RegisterMultiResolution(GenericIndexedCloudPersist* inputModelCloud,
+																				GenericIndexedMesh* inputModelMesh,
+																				GenericIndexedCloudPersist* inputDataCloud,
+																				const Parameters& params,
+																				ScaledTransformation& transform,
+																				double& finalRMS,
+																				unsigned& finalPointCount,
+																				GenericProgressCallback* progressCb,
+																				std::vector<IterationTimings>* iterationTimings)
+{
+	assert(inputModelCloud && inputDataCloud);
+	assert(params.multiResolutionLevels > 1);
+
+	finalRMS = -1.0;
+	transform = ScaledTransformation();
+	if (iterationTimings)
+		iterationTimings->clear();
+
+	Garbage<GenericIndexedCloudPersist> cloudGarbage;
+
+	//the octree levels are defined relatively to the data cloud octree
+	DgmOctree dataOctree(inputDataCloud);
+	if (dataOctree.build(progressCb) < 1)
+	{
+		//not enough memory
+		return ICP_ERROR_NOT_ENOUGH_MEMORY;
+	}
+	//the coarsest level is the one giving (roughly) c_multiResCoarsestPointCount points
+	unsigned char coarsestLevel = dataOctree.findBestLevelForAGivenCellNumber(c_multiResCoarsestPointCount);
+
+	DgmOctree modelOctree(inputModelCloud);
+	if (!inputModelMesh && modelOctree.build(progressCb) < 1)
+	{
+		//not enough memory
+		return ICP_ERROR_NOT_ENOUGH_MEMORY;
+	}
+
+	bool hasMoved = false;
+	std::vector<IterationTimings> stageTimings;
+
+	for (unsigned l = 0; l + 1 < params.multiResolutionLevels; ++l)
+	{
+		unsigned level = coarsestLevel + l;
+		if (level > static_cast<unsigned>(DgmOctree::MAX_OCTREE_LEVEL))
+			break;
+
+		ReferenceCloud* stageDataCloud = CloudSamplingTools::subsampleCloudWithOctreeAtLevel(inputDataCloud, static_cast<unsigned char>(level), CloudSamplingTools::NEAREST_POINT_TO_CELL_CENTER, 0, &dataOctree);
+		if (!stageDataCloud)
+		{
+			//not enough memory
+			return ICP_ERROR_NOT_ENOUGH_MEMORY;
+		}
+		cloudGarbage.add(stageDataCloud);
+		if (stageDataCloud->size() < c_multiResMinPointCount)
+		{
+			//too coarse
+			cloudGarbage.destroy(stageDataCloud);
+			continue;
+		}
+		if (stageDataCloud->size() >= params.samplingLimit)
+		{
+			//not coarser than the last stage
+			cloudGarbage.destroy(stageDataCloud);
+			break;
+		}
+
+		//the model cloud is subsampled as well (the mesh is used as is)
+		GenericIndexedCloudPersist* stageModelCloud = inputModelCloud;
+		if (!inputModelMesh)
+		{
+			ReferenceCloud* subModelCloud = CloudSamplingTools::subsampleCloudWithOctreeAtLevel(inputModelCloud, static_cast<unsigned char>(level), CloudSamplingTools::NEAREST_POINT_TO_CELL_CENTER, 0, &modelOctree);
+			if (!subModelCloud)
+			{
+				//not enough memory
+				return ICP_ERROR_NOT_ENOUGH_MEMORY;
+			}
+			cloudGarbage.add(subModelCloud);
+			stageModelCloud = subModelCloud;
+		}
+
+		//we apply the current transformation to the data points
+		SimpleCloud* movedDataCloud = PointProjectionTools::applyTransformation(stageDataCloud, transform);
+		if (!movedDataCloud || movedDataCloud->size() != stageDataCloud->size())
+		{
+			//not enough memory
+			delete movedDataCloud;
+			return ICP_ERROR_NOT_ENOUGH_MEMORY;
+		}
+		cloudGarbage.add(movedDataCloud);
+
+		//the max couple distance shrinks with the cell size
+		Parameters stageParams = params;
+		stageParams.multiResolutionLevels = 1;
+		stageParams.samplingLimit = std::max(movedDataCloud->size(), stageModelCloud->size());
+		stageParams.maxCoupleDistance = c_multiResMaxDistCellFactor * dataOctree.getCellSize(static_cast<unsigned char>(level));
+		if (params.maxCoupleDistance > 0)
+			stageParams.maxCoupleDistance = std::min(stageParams.maxCoupleDistance, params.maxCoupleDistance);
+		//weights and normals are defined for the input points only
+		stageParams.modelWeights = 0;
+		stageParams.dataWeights = 0;
+		stageParams.modelNormals = 0;
+
+		ScaledTransformation stageTrans;
+		double stageRMS = -1.0;
+		unsigned stagePointCount = 0;
+		RESULT_TYPE result = Register(	stageModelCloud,
+										inputModelMesh,
+										movedDataCloud,
+										stageParams,
+										stageTrans,
+										stageRMS,
+										stagePointCount,
+										progressCb,
+										iterationTimings ? &stageTimings : 0);
+		if (result >= ICP_ERROR)
+		{
+			return result;
+		}
+		if (iterationTimings)
+		{
+			iterationTimings->insert(iterationTimings->end(), stageTimings.begin(), stageTimings.end());
+		}
+
+		if (result == ICP_APPLY_TRANSFO)
+		{
+			ComposeTransformations(transform, stageTrans);
+			hasMoved = true;
+		}
+
+		//we don't need the subsampled clouds anymore
+		cloudGarbage.destroy(movedDataCloud);
+		cloudGarbage.destroy(stageDataCloud);
+		if (stageModelCloud != inputModelCloud)
+			cloudGarbage.destroy(stageModelCloud);
+	}
+
+	//last stage: standard registration
+	GenericIndexedCloudPersist* finalDataCloud = inputDataCloud;
+	if (hasMoved)
+	{
+		SimpleCloud* movedDataCloud = PointProjectionTools::applyTransformation(inputDataCloud, transform);
+		if (!movedDataCloud || movedDataCloud->size() != inputDataCloud->size())
+		{
+			//not enough memory
+			delete movedDataCloud;
+			return ICP_ERROR_NOT_ENOUGH_MEMORY;
+		}
+		cloudGarbage.add(movedDataCloud);
+		finalDataCloud = movedDataCloud;
+	}
+
+	Parameters finalParams = params;
+	finalParams.multiResolutionLevels = 1;
+
+	ScaledTransformation finalTrans;
+	RESULT_TYPE result = Register(	inputModelCloud,
+									inputModelMesh,
+									finalDataCloud,
+									finalParams,
+									finalTrans,
+									finalRMS,
+									finalPointCount,
+									progressCb,
+									iterationTimings ? &stageTimings : 0);
+	if (result >= ICP_ERROR)
+	{
+		return result;
+	}
+	if (iterationTimings)
+	{
+		iterationTimings->insert(iterationTimings->end(), stageTimings.begin(), stageTimings.end());
+	}
+
+	if (result == ICP_APPLY_TRANSFO)
+	{
+		ComposeTransformations(transform, finalTrans);
+		hasMoved = true;
+	}
+
+	return hasMoved ? ICP_APPLY_TRANSFO : result;
+}
+
+bool ICPRegistrationTools::PointToPlaneRegistrationProcedure(	GenericCloud* P,
+																ReferenceCloud* X,
+																const std::vector<CCVector3>& modelNormals,
+																ScaledTransformation& trans,
+																ScalarField* coupleWeights/*=0*/)
+{
+	assert(P && X);
+	unsigned count = P->size();
+	if (!P || !X || X->size() != count || count < 6)
+		return false;
+	if (coupleWeights && coupleWeights->currentSize() != count)
+		return false;
+
+	//we work relatively to the data gravity center (for a better conditioning)
+	CCVector3d Gp(0,0,0);
+	{
+		P->placeIteratorAtBegining();
+		for (unsigned i=0; i<count; ++i)
+			Gp += CCVector3d::fromArray(P->getNextPoint()->u);
+		Gp /= static_cast<double>(count);
+	}
+
+	//for each couple, the linearized residual (R ~ I + [a]x) writes:
+	//	(Pi' x Ni).a + Ni.t = (Xi' - Pi').Ni
+	//we accumulate the corresponding normal equations (A^t.A).x = A^t.b
+	double AtA[6][6] = { {0} };
+	double Atb[6] = { 0 };
+	unsigned validCouples = 0;
+	{
+		P->placeIteratorAtBegining();
+		for (unsigned i=0; i<count; ++i)
+		{
+			const CCVector3* Pi = P->getNextPoint();
+
+			double wi = 1.0;
+			if (coupleWeights)
+			{
+				ScalarType w = coupleWeights->getValue(i);
+				if (!ScalarField::ValidValue(w))
+					continue;
+				wi = fabs(w);
+			}
+
+			const CCVector3& N = modelNormals[X->getPointGlobalIndex(i)];
+			if (N.norm2() == 0)
+				continue;
+
+			CCVector3d Nd = CCVector3d::fromArray(N.u);
+			CCVector3d Pd = CCVector3d::fromArray(Pi->u) - Gp;
+			CCVector3d Xd = CCVector3d::fromArray(X->getPoint(i)->u) - Gp;
+			CCVector3d C = Pd.cross(Nd);
+
+			double row[6] = { C.x, C.y, C.z, Nd.x, Nd.y, Nd.z };
+			double bi = (Xd - Pd).dot(Nd);
+
+			double wi2 = wi * wi;
+			for (unsigned r=0; r<6; ++r)
+			{
+				for (unsigned c=r; c<6; ++c)
+					AtA[r][c] += wi2 * row[r] * row[c];
+				Atb[r] += wi2 * row[r] * bi;
+			}
+			++validCouples;
+		}
+	}
+
+	if (validCouples < 6)
+		return false;
+
+	//we solve the system with the pseudo-inverse of A^t.A (so that degenerate
+	//configurations, such as a single plane, don't make the solution explode)
+	double x[6] = { 0 };
+	{
+		SquareMatrixd M(6);
+		for (unsigned r=0; r<6; ++r)
+			for (unsigned c=r; c<6; ++c)
+				M.m_values[r][c] = M.m_values[c][r] = AtA[r][c];
+
+		SquareMatrixd eigVectors;
+		std::vector<double> eigValues;
+		if (!Jacobi<double>::ComputeEigenValuesAndVectors(M, eigVectors, eigValues))
+		{
+			//failure
+			return false;
+		}
+
+		double maxEigValue = 0;
+		for (unsigned k=0; k<6; ++k)
+			maxEigValue = std::max(maxEigValue, fabs(eigValues[k]));
+		if (maxEigValue < ZERO_TOLERANCE)
+			return false;
+
+		for (unsigned k=0; k<6; ++k)
+		{
+			if (fabs(eigValues[k]) < 1.0e-8 * maxEigValue)
+				continue; //unconstrained direction
+
+			double proj = 0;
+			for (unsigned r=0; r<6; ++r)
+				proj += eigVectors.m_values[r][k] * Atb[r];
+			proj /= eigValues[k];
+			for (unsigned r=0; r<6; ++r)
+				x[r] += proj * eigVectors.m_values[r][k];
+		}
+	}
+
+	//we convert the rotation vector 'a' to a proper rotation matrix
+	CCVector3d a(x[0], x[1], x[2]);
+	double angle_rad = a.norm();
+	if (angle_rad > ZERO_TOLERANCE)
+	{
+		a /= angle_rad;
+		double sin_half = sin(angle_rad / 2);
+		double q[4] = { cos(angle_rad / 2), a.x * sin_half, a.y * sin_half, a.z * sin_half };
+		trans.R.initFromQuaternion(q);
+	}
+	else
+	{
+		trans.R = SquareMatrix(3);
+		trans.R.toIdentity();
+	}
+	trans.s = 1;
+
+	//X = R.(P - Gp) + Gp + t
+	CCVector3 G = CCVector3::fromArray(Gp.u);
+	trans.T = G - trans.R * G + CCVector3(static_cast<PointCoordinateType>(x[3]), static_cast<PointCoordinateType>(x[4]), static_cast<PointCoordinateType>(x[5]));
+
+	return true;
+}
+
 bool HornRegistrationTools::FindAbsoluteOrientation(GenericCloud* lCloud,
 													GenericCloud* rCloud,
 													ScaledTransformation& trans,
@@ -1120,6 +1761,128 @@ bool RegistrationTools::RegistrationProcedure(	GenericCloud* P, //data
 	return true;
 }
 
+//! Shared (read-only) context of the 4PCS trials
+struct FPCSContext
+{
+	GenericIndexedCloud* modelCloud;
+	GenericIndexedCloud* dataCloud;
+	KDTree* modelTree;
+	KDTree* dataTree;
+	const std::vector<CCVector3>* dataPoints;
+	ScalarType delta;
+	ScalarType beta;
+	PointCoordinateType overlap;
+	unsigned nbTries;
+	unsigned nbMaxCandidates;
+	unsigned randomSeed;
+};
+
+struct FPCSRegistrationTools::Trial
+{
+	//input
+	const FPCSContext* context;
+	//! Trial index (used to seed the trial own random generator)
+	unsigned index;
+	//! Best score of the previous batches (candidates can't win if they don't beat it)
+	unsigned scoreToBeat;
+
+	//output
+	unsigned score;
+	ScaledTransformation transform;
+	bool error;
+};
+
+//! Number of 4PCS trials processed between two checks of the best score (should not depend on the number of threads!)
+static const unsigned c_fpcsTrialBatchSize = 16;
+
+//! Returns a random index in [0 ; size-1] (uniform distribution)
+/** std::uniform_int_distribution is implementation-defined, so the indexes are directly
+	derived from the generator output (rejection sampling, to avoid the modulo bias). This
+	way the same seed gives the same registration whatever the compiler/standard library.
+**/
+static unsigned RandomIndex(std::mt19937& generator, unsigned size)
+{
+	assert(size != 0);
+	//the values below (2^32 mod size) are rejected so that the remaining range is a multiple of 'size'
+	const unsigned threshold = (0u - size) % size;
+	while (true)
+	{
+		unsigned value = static_cast<unsigned>(generator());
+		if (value >= threshold)
+			return value % size;
+	}
+}
+
+void FPCSRegistrationTools::ProcessTrial(Trial& trial)
+{
+	const FPCSContext& context = *trial.context;
+	trial.score = 0;
+	trial.error = false;
+
+	//each trial has its own random generator so that the result doesn't depend on the processing order
+	std::seed_seq seedSequence = { context.randomSeed, trial.index };
+	std::mt19937 generator(seedSequence);
+
+	//Randomly find the current reference base
+	Base reference;
+	if (!FindBase(context.modelCloud, context.overlap, context.nbTries, reference, generator))
+		return;
+
+	//Search for all the congruent bases in the second cloud
+	std::vector<Base> candidates;
+	try
+	{
+		candidates.reserve(context.dataCloud->size());
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		trial.error = true;
+		return;
+	}
+	const CCVector3* referenceBasePoints[4];
+	{
+		for (unsigned j=0; j<4; j++)
+			referenceBasePoints[j] = context.modelCloud->getPoint(reference.getIndex(j));
+	}
+	int result = FindCongruentBases(context.dataTree, context.beta, referenceBasePoints, candidates);
+	if (result == 0)
+		return;
+	else if (result < 0) //something bad happened!
+	{
+		trial.error = true;
+		return;
+	}
+
+	//Compute rigid transforms and filter bases if necessary
+	std::vector<ScaledTransformation> transforms;
+	if (!FilterCandidates(context.modelCloud, context.dataCloud, reference, candidates, context.nbMaxCandidates, transforms))
+	{
+		trial.error = true;
+		return;
+	}
+
+	unsigned bestScore = trial.scoreToBeat;
+	for (size_t j=0; j<transforms.size(); j++)
+	{
+		//Register the current candidate base with the reference base
+		const ScaledTransformation& RT = transforms[j];
+		//Apply the rigid transform to the data cloud and compute the registration score
+		if (RT.R.isValid())
+		{
+			unsigned score = ComputeRegistrationScore(context.modelTree, *context.dataPoints, context.delta, RT, bestScore);
+
+			//Keep parameters that lead to the best result
+			if (score > bestScore)
+			{
+				trial.transform.R = RT.R;
+				trial.transform.T = RT.T;
+				trial.score = bestScore = score;
+			}
+		}
+	}
+}
+
 bool FPCSRegistrationTools::RegisterClouds(	GenericIndexedCloud* modelCloud,
 											GenericIndexedCloud* dataCloud,
 											ScaledTransformation& transform,
@@ -1129,7 +1892,10 @@ bool FPCSRegistrationTools::RegisterClouds(	GenericIndexedCloud* modelCloud,
 											unsigned nbBases,
 											unsigned nbTries,
 											GenericProgressCallback* progressCb,
-											unsigned nbMaxCandidates)
+											unsigned nbMaxCandidates,
+											unsigned randomSeed,
+											double targetScoreRatio,
+											bool multiThread)
 {
 	//DGM: KDTree::buildFromCloud will call reset right away!
 	//if (progressCb)
@@ -1143,10 +1909,11 @@ bool FPCSRegistrationTools::RegisterClouds(	GenericIndexedCloud* modelCloud,
 	//	progressCb->start();
 	//}
 
-	//Initialize random seed with current time
-	srand(static_cast<unsigned>(time(0)));
+	//Initialize random seed with current time (if none is specified)
+	if (randomSeed == 0)
+		randomSeed = static_cast<unsigned>(time(0));
 
-	unsigned bestScore = 0, score = 0;
+	unsigned bestScore = 0;
 	transform.R.invalidate();
 	transform.T = CCVector3(0,0,0);
 
@@ -1158,6 +1925,21 @@ bool FPCSRegistrationTools::RegisterClouds(	GenericIndexedCloud* modelCloud,
 		overlap *= diff.norm() / 2;
 	}
 
+	//Contiguous copy of the data points (scanned once per candidate)
+	std::vector<CCVector3> dataPoints;
+	try
+	{
+		unsigned count = dataCloud->size();
+		dataPoints.resize(count);
+		for (unsigned i=0; i<count; ++i)
+			dataCloud->getPoint(i, dataPoints[i]);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return false;
+	}
+
 	//Build the associated KDtrees
 	KDTree* dataTree = new KDTree();
 	if (!dataTree->buildFromCloud(dataCloud, progressCb))
@@ -1176,94 +1958,99 @@ bool FPCSRegistrationTools::RegisterClouds(	GenericIndexedCloud* modelCloud,
 	//if (progressCb)
 	//    progressCb->stop();
 
-	for (unsigned i=0; i<nbBases; i++)
+	FPCSContext context;
+	context.modelCloud = modelCloud;
+	context.dataCloud = dataCloud;
+	context.modelTree = modelTree;
+	context.dataTree = dataTree;
+	context.dataPoints = &dataPoints;
+	context.delta = delta;
+	context.beta = beta;
+	context.overlap = overlap;
+	context.nbTries = nbTries;
+	context.nbMaxCandidates = nbMaxCandidates;
+	context.randomSeed = randomSeed;
+
+	unsigned targetScore = 0;
+	if (targetScoreRatio > 0)
+		targetScore = static_cast<unsigned>(ceil(std::min(targetScoreRatio, 1.0) * dataPoints.size()));
+
+	//The trials are processed by batches: the best score is only updated between two batches so that
+	//the result (as well as the early termination) doesn't depend on the number of threads
+	std::vector<Trial> batch;
+	bool success = true;
+	for (unsigned firstTrial=0; firstTrial<nbBases; firstTrial+=c_fpcsTrialBatchSize)
 	{
-		//Randomly find the current reference base
-		Base reference;
-		if (!FindBase(modelCloud, overlap, nbTries, reference))
-			continue;
-
-		//Search for all the congruent bases in the second cloud
-		std::vector<Base> candidates;
-		unsigned count = dataCloud->size();
-		candidates.reserve(count);
-		if (candidates.capacity() < count) //not enough memory
+		unsigned batchSize = std::min(c_fpcsTrialBatchSize, nbBases - firstTrial);
+		batch.resize(batchSize);
+		for (unsigned i=0; i<batchSize; ++i)
 		{
-			delete dataTree;
-			delete modelTree;
-			transform.R = SquareMatrix();
-			return false;
-		}
-		const CCVector3* referenceBasePoints[4];
-		{
-			for(unsigned j=0; j<4; j++)
-				referenceBasePoints[j] = modelCloud->getPoint(reference.getIndex(j));
-		}
-		int result = FindCongruentBases(dataTree, beta, referenceBasePoints, candidates);
-		if (result == 0)
-			continue;
-		else if (result < 0) //something bad happened!
-		{
-			delete dataTree;
-			delete modelTree;
-			transform.R = SquareMatrix();
-			return false;
+			batch[i].context = &context;
+			batch[i].index = firstTrial + i;
+			batch[i].scoreToBeat = bestScore;
 		}
 
-		//Compute rigid transforms and filter bases if necessary
+#ifdef ENABLE_MT_REGISTRATION
+		if (multiThread && batchSize > 1)
+			QtConcurrent::blockingMap(batch, ProcessTrial);
+		else
+#else
+		(void)multiThread;
+#endif
+		for (unsigned i=0; i<batchSize; ++i)
+			ProcessTrial(batch[i]);
+
+		//merge the results in the trials order (ties are won by the first trial)
+		for (unsigned i=0; i<batchSize; ++i)
 		{
-			std::vector<ScaledTransformation> transforms;
-			if (!FilterCandidates(modelCloud, dataCloud, reference, candidates, nbMaxCandidates, transforms))
+			const Trial& trial = batch[i];
+			if (trial.error)
 			{
-				delete dataTree;
-				delete modelTree;
-				transform.R = SquareMatrix();
-				return false;
+				success = false;
+				break;
 			}
-
-			for(unsigned j=0; j<candidates.size(); j++)
+			if (trial.score > bestScore)
 			{
-				//Register the current candidate base with the reference base
-				const ScaledTransformation& RT = transforms[j];
-				//Apply the rigid transform to the data cloud and compute the registration score
-				if (RT.R.isValid())
-				{
-					score = ComputeRegistrationScore(modelTree, dataCloud, delta, RT);
-
-					//Keep parameters that lead to the best result
-					if (score > bestScore)
-					{
-						transform.R = RT.R;
-						transform.T = RT.T;
-						bestScore = score;
-					}
-				}
+				transform.R = trial.transform.R;
+				transform.T = trial.transform.T;
+				bestScore = trial.score;
 			}
 		}
+		if (!success)
+			break;
 
+		unsigned trialCount = firstTrial + batchSize;
 		if (progressCb)
 		{
 			if (progressCb->textCanBeEdited())
 			{
 				char buffer[256];
-				sprintf(buffer, "Trial %u/%u [best score = %u]\n", i + 1, nbBases, bestScore);
+				sprintf(buffer, "Trial %u/%u [best score = %u]\n", trialCount, nbBases, bestScore);
 				progressCb->setInfo(buffer);
-				progressCb->update(((i + 1)*100.0f) / nbBases);
+				progressCb->update((trialCount*100.0f) / nbBases);
 			}
 
 			if (progressCb->isCancelRequested())
 			{
-				delete dataTree;
-				delete modelTree;
-				transform.R = SquareMatrix();
-				return false;
+				success = false;
+				break;
 			}
 		}
+
+		//early termination
+		if (targetScore != 0 && bestScore >= targetScore)
+			break;
 	}
 
 	delete dataTree;
 	delete modelTree;
 
+	if (!success)
+	{
+		transform.R = SquareMatrix();
+		return false;
+	}
+
 	if (progressCb)
 	{
 		progressCb->stop();
@@ -1274,23 +2061,24 @@ bool FPCSRegistrationTools::RegisterClouds(	GenericIndexedCloud* modelCloud,
 
 
  unsigned FPCSRegistrationTools::ComputeRegistrationScore(	KDTree *modelTree,
-															GenericIndexedCloud *dataCloud,
+															const std::vector<CCVector3>& dataPoints,
 															ScalarType delta,
-															const ScaledTransformation& dataToModel)
+															const ScaledTransformation& dataToModel,
+															unsigned scoreToBeat)
 {
-	CCVector3 Q;
-
 	unsigned score = 0;
 
-	unsigned count = dataCloud->size();
+	unsigned count = static_cast<unsigned>(dataPoints.size());
 	for (unsigned i=0; i<count; ++i)
 	{
-		dataCloud->getPoint(i,Q);
 		//Apply rigid transform to each point
-		Q = dataToModel.R * Q + dataToModel.T;
+		CCVector3 Q = dataToModel.R * dataPoints[i] + dataToModel.T;
 		//Check if there is a point in the model cloud that is close enough to q
 		if (modelTree->findPointBelowDistance(Q.u, delta))
 			score++;
+		//no need to continue if the score can't beat the current best one anymore
+		else if (score + (count - 1 - i) <= scoreToBeat)
+			break;
 	}
 
 	return score;
@@ -1299,7 +2087,8 @@ bool FPCSRegistrationTools::RegisterClouds(	GenericIndexedCloud* modelCloud,
 bool FPCSRegistrationTools::FindBase(	GenericIndexedCloud* cloud,
 										PointCoordinateType overlap,
 										unsigned nbTries,
-										Base &base)
+										Base &base,
+										std::mt19937& generator)
 {
 	unsigned a, b, c, d;
 	unsigned i, size;
@@ -1309,15 +2098,17 @@ bool FPCSRegistrationTools::FindBase(	GenericIndexedCloud* cloud,
 
 	overlap *= overlap;
 	size = cloud->size();
+	if (size == 0)
+		return false;
 	best = 0.;
 	b = c = 0;
-	a = rand()%size;
+	a = RandomIndex(generator, size);
 	p0 = cloud->getPoint(a);
 	//Randomly pick 3 points as sparsed as possible
 	for(i=0; i<nbTries; i++)
 	{
-		unsigned t1 = (rand() % size);
-		unsigned t2 = (rand() % size);
+		unsigned t1 = RandomIndex(generator, size);
+		unsigned t2 = RandomIndex(generator, size);
 		if (t1 == a || t2 == a || t1 == t2)
 			continue;
 
@@ -1367,7 +2158,7 @@ bool FPCSRegistrationTools::FindBase(	GenericIndexedCloud* cloud,
 	p2 = cloud->getPoint(c);
 	for(i=0; i<nbTries; i++)
 	{
-		unsigned t1 = (rand() % size);
+		unsigned t1 = RandomIndex(generator, size);
 		if (t1 == a || t1 == b || t1 == c)
 			continue;
 		p3 = cloud->getPoint(t1);
@@ -1761,7 +2552,7 @@ bool FPCSRegistrationTools::FilterCandidates(	GenericIndexedCloud *modelCloud,
 		{
 			if (scores[i] <= score && j < nbMaxCandidates)
 			{
-				candidates[i].copy(table[i]);
+				candidates[j].copy(table[i]);
 				transforms.push_back(tarray[i]);
 				j++;
 			}
@@ -81,31 +81,36 @@ void ScalarField::computeMeanAndVariance(ScalarType &mean, ScalarType* variance)
 
 void ScalarField::computeMinAndMax()
 {
-	if (currentSize() != 0)
+	PointIndexType count = currentSize();
+
+	//look for the first valid value (used to init min and max)
+	PointIndexType firstValidIndex = 0;
+	while (firstValidIndex < count && !ValidValue(getValue(firstValidIndex)))
+		++firstValidIndex;
+
+	if (firstValidIndex < count)
 	{
-		bool minMaxInitialized = false;
-		for (unsigned i=0; i<currentSize(); ++i)
+		ScalarType minVal = getValue(firstValidIndex);
+		ScalarType maxVal = minVal;
+
+		//we process the values range by range (stateless access)
+		//NaN values are automatically ignored by the (branchless) tests below
+		for (PointIndexType i=firstValidIndex+1; i<count; )
 		{
-			const ScalarType& val = getValue(i);
-			if (ValidValue(val))
+			PointIndexType rangeSize = count - i;
+			const ScalarType* values = rangeStartPtr(i, rangeSize);
+			for (PointIndexType j=0; j<rangeSize; ++j)
 			{
-				if (minMaxInitialized)
-				{
-					if (val < m_minVal)
-						m_minVal = val;
-					else if (val > m_maxVal)
-						m_maxVal = val;
-				}
-				else
-				{
-					//first valid value is used to init min and max
-					m_minVal = m_maxVal = val;
-					minMaxInitialized = true;
-				}
+				minVal = (values[j] < minVal ? values[j] : minVal);
+				maxVal = (values[j] > maxVal ? values[j] : maxVal);
 			}
+			i += rangeSize;
 		}
+
+		m_minVal = minVal;
+		m_maxVal = maxVal;
 	}
-	else //particular case: no value
+	else //particular case: no (valid) value
 	{
 		m_minVal = m_maxVal = 0;
 	}
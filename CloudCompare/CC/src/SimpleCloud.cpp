@@ -51,7 +51,7 @@ void SimpleCloud::clear()
 	m_validBB=false;
 }
 
-unsigned SimpleCloud::size() const
+PointIndexType SimpleCloud::size() const
 {
 	return m_points->currentSize();
 }
@@ -70,11 +70,11 @@ void SimpleCloud::addPoint(const PointCoordinateType P[])
 
 void SimpleCloud::forEach(genericPointAction& action)
 {
-	unsigned n = m_points->currentSize();
+	PointIndexType n = m_points->currentSize();
 
 	if (m_scalarField->currentSize() >= n) //existing scalar field?
 	{
-		for (unsigned i=0; i<n; ++i)
+		for (PointIndexType i=0; i<n; ++i)
 		{
 			action(*reinterpret_cast<CCVector3*>(m_points->getValue(i)),(*m_scalarField)[i]);
 		}
@@ -82,7 +82,7 @@ void SimpleCloud::forEach(genericPointAction& action)
 	else //otherwise (we provide a fake zero distance)
 	{
 		ScalarType d = 0;
-		for (unsigned i=0; i<n; ++i)
+		for (PointIndexType i=0; i<n; ++i)
 		{
 			action(*reinterpret_cast<CCVector3*>(m_points->getValue(i)),d);
 		}
@@ -101,7 +101,7 @@ void SimpleCloud::getBoundingBox(CCVector3& bbMin, CCVector3& bbMax)
 	bbMax = CCVector3(m_points->getMax());
 }
 
-bool SimpleCloud::reserve(unsigned n)
+bool SimpleCloud::reserve(PointIndexType n)
 {
 	if (!m_points->reserve(n))
 	{
@@ -116,9 +116,9 @@ bool SimpleCloud::reserve(unsigned n)
 	return true;
 }
 
-bool SimpleCloud::resize(unsigned n)
+bool SimpleCloud::resize(PointIndexType n)
 {
-	unsigned oldCount = m_points->capacity();
+	PointIndexType oldCount = m_points->capacity();
 	if (!m_points->resize(n))
 	{
 		return false;
@@ -142,25 +142,25 @@ const CCVector3* SimpleCloud::getNextPoint()
 	return reinterpret_cast<CCVector3*>(globalIterator < m_points->currentSize() ? m_points->getValue(globalIterator++) : 0);
 }
 
-const CCVector3* SimpleCloud::getPointPersistentPtr(unsigned index)
+const CCVector3* SimpleCloud::getPointPersistentPtr(PointIndexType index)
 {
 	assert(index < m_points->currentSize());
 	return reinterpret_cast<CCVector3*>(m_points->getValue(index));
 }
 
-void SimpleCloud::getPoint(unsigned index, CCVector3& P) const
+void SimpleCloud::getPoint(PointIndexType index, CCVector3& P) const
 {
 	assert(index < m_points->currentSize());
 	P = *reinterpret_cast<CCVector3*>(m_points->getValue(index));
 }
 
-void SimpleCloud::setPointScalarValue(unsigned pointIndex, ScalarType value)
+void SimpleCloud::setPointScalarValue(PointIndexType pointIndex, ScalarType value)
 {
 	assert(pointIndex<m_scalarField->currentSize());
 	m_scalarField->setValue(pointIndex,value);
 }
 
-ScalarType SimpleCloud::getPointScalarValue(unsigned pointIndex)  const
+ScalarType SimpleCloud::getPointScalarValue(PointIndexType pointIndex)  const
 {
 	assert(pointIndex<m_scalarField->currentSize());
 	return m_scalarField->getValue(pointIndex);
@@ -178,11 +178,11 @@ bool SimpleCloud::isScalarFieldEnabled() const
 
 void SimpleCloud::applyTransformation(PointProjectionTools::Transformation& trans)
 {
-	unsigned count = m_points->currentSize();
+	PointIndexType count = m_points->currentSize();
 
 	if (fabs(trans.s - 1.0) > ZERO_TOLERANCE)
 	{
-		for (unsigned i=0; i<count; ++i)
+		for (PointIndexType i=0; i<count; ++i)
 		{
 			CCVector3* P = reinterpret_cast<CCVector3*>(m_points->getValue(i));
 			(*P) *= trans.s;
@@ -192,7 +192,7 @@ void SimpleCloud::applyTransformation(PointProjectionTools::Transformation& tran
 
 	if (trans.R.isValid())
 	{
-		for (unsigned i=0; i<count; ++i)
+		for (PointIndexType i=0; i<count; ++i)
 		{
 			CCVector3* P = reinterpret_cast<CCVector3*>(m_points->getValue(i));
 			(*P) = trans.R * (*P);
@@ -202,7 +202,7 @@ void SimpleCloud::applyTransformation(PointProjectionTools::Transformation& tran
 
 	if (trans.T.norm() > ZERO_TOLERANCE)
 	{
-		for (unsigned i=0; i<count; ++i)
+		for (PointIndexType i=0; i<count; ++i)
 		{
 			CCVector3* P = reinterpret_cast<CCVector3*>(m_points->getValue(i));
 			(*P) += trans.T;
@@ -0,0 +1,552 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 or later of the  #
+//#  License.                                                              #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "TriangleBVH.h"
+
+//local
+#include "DistanceComputationTools.h"
+#include "GenericIndexedMesh.h"
+#include "GenericProgressCallback.h"
+#include "SimpleTriangle.h"
+
+//system
+#include <algorithm>
+#include <assert.h>
+#include <limits>
+#include <stdio.h>
+
+using namespace CCLib;
+
+//! Maximum number of triangles per leaf
+static const unsigned BVH_MAX_LEAF_SIZE = 8;
+//! Number of bins used to evaluate the Surface Area Heuristic
+static const unsigned BVH_BIN_COUNT = 16;
+//! Depth beyond which the nodes are split at the median (so that the traversal stack is bounded)
+static const unsigned BVH_MAX_SAH_DEPTH = 64;
+//! Traversal stack size (the hierarchy depth is at most BVH_MAX_SAH_DEPTH + 32)
+static const unsigned BVH_STACK_SIZE = 128;
+
+//! Triangle bounding-box and centroid (for the hierarchy construction)
+struct BuildTriangle
+{
+	CCVector3 bbMin;
+	CCVector3 bbMax;
+	CCVector3 centroid;
+};
+
+//! Node to split (for the hierarchy construction)
+struct BuildTask
+{
+	unsigned nodeIndex;
+	unsigned depth;
+};
+
+//! SAH bin
+struct BuildBin
+{
+	CCVector3 bbMin;
+	CCVector3 bbMax;
+	unsigned count;
+};
+
+//! Returns half the area of a bounding-box
+static inline double HalfArea(const CCVector3& bbMin, const CCVector3& bbMax)
+{
+	CCVector3d d(	static_cast<double>(bbMax.x) - bbMin.x,
+					static_cast<double>(bbMax.y) - bbMin.y,
+					static_cast<double>(bbMax.z) - bbMin.z);
+	return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+//! Extends a bounding-box with another one
+static inline void ExtendBox(CCVector3& bbMin, CCVector3& bbMax, const CCVector3& otherMin, const CCVector3& otherMax)
+{
+	for (unsigned char k = 0; k < 3; ++k)
+	{
+		bbMin.u[k] = std::min(bbMin.u[k], otherMin.u[k]);
+		bbMax.u[k] = std::max(bbMax.u[k], otherMax.u[k]);
+	}
+}
+
+//! Compares the centroids of two triangles along a given dimension
+struct CentroidComp
+{
+	const std::vector<BuildTriangle>* triangles;
+	unsigned char dim;
+
+	inline bool operator()(unsigned a, unsigned b) const
+	{
+		return (*triangles)[a].centroid.u[dim] < (*triangles)[b].centroid.u[dim];
+	}
+};
+
+//! Tells whether a triangle lies on the left side of a SAH split
+struct SplitPredicate
+{
+	const std::vector<BuildTriangle>* triangles;
+	unsigned char dim;
+	PointCoordinateType minCentroid;
+	double binScale;
+	unsigned splitBin;
+
+	inline bool operator()(unsigned i) const
+	{
+		unsigned bin = static_cast<unsigned>(((*triangles)[i].centroid.u[dim] - minCentroid) * binScale);
+		return std::min(bin, BVH_BIN_COUNT - 1) < splitBin;
+	}
+};
+
+TriangleBVH::TriangleBVH()
+{
+}
+
+void TriangleBVH::clear()
+{
+	m_nodes.clear();
+	m_triangleIndexes.clear();
+	m_vertices.clear();
+}
+
+size_t TriangleBVH::memoryUsage() const
+{
+	return	m_nodes.capacity() * sizeof(Node)
+		+	m_triangleIndexes.capacity() * sizeof(unsigned)
+		+	m_vertices.capacity() * sizeof(CCVector3);
+}
+
+bool TriangleBVH::build(GenericIndexedMesh* mesh, GenericProgressCallback* progressCb/*=0*/)
+{
+	clear();
+
+	if (!mesh || mesh->size() == 0)
+	{
+		return false;
+	}
+
+	unsigned triCount = mesh->size();
+
+	std::vector<BuildTriangle> triangles;
+	std::vector<CCVector3> vertices;
+	std::vector<BuildTask> tasks;
+	try
+	{
+		triangles.resize(triCount);
+		vertices.resize(3 * static_cast<size_t>(triCount));
+		m_triangleIndexes.resize(triCount);
+		m_nodes.reserve(2 * static_cast<size_t>(triCount / BVH_MAX_LEAF_SIZE) + 1);
+		tasks.reserve(BVH_STACK_SIZE);
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		clear();
+		return false;
+	}
+
+	if (progressCb)
+	{
+		if (progressCb->textCanBeEdited())
+		{
+			progressCb->setMethodTitle("Triangles BVH");
+			char buffer[256];
+			sprintf(buffer, "Triangles: %u", triCount);
+			progressCb->setInfo(buffer);
+		}
+		progressCb->update(0);
+		progressCb->start();
+	}
+	NormalizedProgress nprogress(progressCb, triCount);
+
+	//read the triangles
+	CCVector3 rootMin, rootMax;
+	for (unsigned i = 0; i < triCount; ++i)
+	{
+		CCVector3* V = &(vertices[3 * static_cast<size_t>(i)]);
+		mesh->getTriangleVertices(i, V[0], V[1], V[2]);
+
+		BuildTriangle& tri = triangles[i];
+		tri.bbMin = tri.bbMax = V[0];
+		ExtendBox(tri.bbMin, tri.bbMax, V[1], V[1]);
+		ExtendBox(tri.bbMin, tri.bbMax, V[2], V[2]);
+		tri.centroid = (V[0] + V[1] + V[2]) / 3;
+
+		if (i != 0)
+		{
+			ExtendBox(rootMin, rootMax, tri.bbMin, tri.bbMax);
+		}
+		else
+		{
+			rootMin = tri.bbMin;
+			rootMax = tri.bbMax;
+		}
+
+		m_triangleIndexes[i] = i;
+
+		if (progressCb && !nprogress.oneStep())
+		{
+			//process cancelled by the user
+			progressCb->stop();
+			clear();
+			return false;
+		}
+	}
+
+	if (progressCb)
+	{
+		progressCb->stop();
+	}
+
+	try
+	{
+		Node root;
+		root.bbMin = rootMin;
+		root.bbMax = rootMax;
+		root.first = 0;
+		root.count = triCount;
+		m_nodes.push_back(root);
+
+		BuildTask rootTask;
+		rootTask.nodeIndex = 0;
+		rootTask.depth = 0;
+		tasks.push_back(rootTask);
+
+		BuildBin bins[BVH_BIN_COUNT];
+		double rightAreas[BVH_BIN_COUNT];
+		unsigned rightCounts[BVH_BIN_COUNT];
+
+		while (!tasks.empty())
+		{
+			BuildTask task = tasks.back();
+			tasks.pop_back();
+
+			const unsigned first = m_nodes[task.nodeIndex].first;
+			const unsigned count = m_nodes[task.nodeIndex].count;
+			if (count <= 1)
+			{
+				continue;
+			}
+			unsigned* indexes = &(m_triangleIndexes[first]);
+
+			//centroids bounding-box
+			CCVector3 cMin = triangles[indexes[0]].centroid;
+			CCVector3 cMax = cMin;
+			for (unsigned i = 1; i < count; ++i)
+			{
+				ExtendBox(cMin, cMax, triangles[indexes[i]].centroid, triangles[indexes[i]].centroid);
+			}
+
+			//we split along the largest dimension
+			CCVector3 cDiag = cMax - cMin;
+			unsigned char dim = (cDiag.x >= cDiag.y ? (cDiag.x >= cDiag.z ? 0 : 2) : (cDiag.y >= cDiag.z ? 1 : 2));
+
+			unsigned leftCount = 0;
+			if (cDiag.u[dim] > 0 && task.depth < BVH_MAX_SAH_DEPTH)
+			{
+				//SAH: we sort the triangles in bins (based on their centroid)
+				double binScale = BVH_BIN_COUNT / static_cast<double>(cDiag.u[dim]);
+				for (unsigned b = 0; b < BVH_BIN_COUNT; ++b)
+				{
+					bins[b].count = 0;
+				}
+				for (unsigned i = 0; i < count; ++i)
+				{
+					const BuildTriangle& tri = triangles[indexes[i]];
+					unsigned b = std::min(static_cast<unsigned>((tri.centroid.u[dim] - cMin.u[dim]) * binScale), BVH_BIN_COUNT - 1);
+					if (bins[b].count++ == 0)
+					{
+						bins[b].bbMin = tri.bbMin;
+						bins[b].bbMax = tri.bbMax;
+					}
+					else
+					{
+						ExtendBox(bins[b].bbMin, bins[b].bbMax, tri.bbMin, tri.bbMax);
+					}
+				}
+
+				//right side costs
+				{
+					CCVector3 bbMin, bbMax;
+					unsigned rightCount = 0;
+					for (unsigned b = BVH_BIN_COUNT - 1; b > 0; --b)
+					{
+						if (bins[b].count != 0)
+						{
+							if (rightCount == 0)
+							{
+								bbMin = bins[b].bbMin;
+								bbMax = bins[b].bbMax;
+							}
+							else
+							{
+								ExtendBox(bbMin, bbMax, bins[b].bbMin, bins[b].bbMax);
+							}
+							rightCount += bins[b].count;
+						}
+						rightCounts[b] = rightCount;
+						rightAreas[b] = (rightCount ? HalfArea(bbMin, bbMax) : 0);
+					}
+				}
+
+				//best split (between bins 'splitBin-1' and 'splitBin')
+				unsigned splitBin = 0;
+				double bestCost = std::numeric_limits<double>::max();
+				{
+					CCVector3 bbMin, bbMax;
+					unsigned leftBinCount = 0;
+					for (unsigned b = 1; b < BVH_BIN_COUNT; ++b)
+					{
+						if (bins[b - 1].count != 0)
+						{
+							if (leftBinCount == 0)
+							{
+								bbMin = bins[b - 1].bbMin;
+								bbMax = bins[b - 1].bbMax;
+							}
+							else
+							{
+								ExtendBox(bbMin, bbMax, bins[b - 1].bbMin, bins[b - 1].bbMax);
+							}
+							leftBinCount += bins[b - 1].count;
+						}
+						if (leftBinCount == 0 || rightCounts[b] == 0)
+						{
+							continue;
+						}
+
+						double cost = HalfArea(bbMin, bbMax) * leftBinCount + rightAreas[b] * rightCounts[b];
+						if (cost < bestCost)
+						{
+							bestCost = cost;
+							splitBin = b;
+						}
+					}
+				}
+
+				if (splitBin != 0)
+				{
+					//we only split if it's cheaper than testing all the triangles (unless the leaf would be too big)
+					const Node& node = m_nodes[task.nodeIndex];
+					double nodeArea = HalfArea(node.bbMin, node.bbMax);
+					if (count > BVH_MAX_LEAF_SIZE || nodeArea + bestCost < nodeArea * count)
+					{
+						SplitPredicate isLeft;
+						isLeft.triangles = &triangles;
+						isLeft.dim = dim;
+						isLeft.minCentroid = cMin.u[dim];
+						isLeft.binScale = binScale;
+						isLeft.splitBin = splitBin;
+						leftCount = static_cast<unsigned>(std::partition(indexes, indexes + count, isLeft) - indexes);
+					}
+					else
+					{
+						//this node becomes a leaf
+						continue;
+					}
+				}
+			}
+
+			if (leftCount == 0 || leftCount == count)
+			{
+				if (count <= BVH_MAX_LEAF_SIZE)
+				{
+					//this node becomes a leaf
+					continue;
+				}
+
+				//no valid SAH split: we split at the median
+				leftCount = count / 2;
+				CentroidComp comp;
+				comp.triangles = &triangles;
+				comp.dim = dim;
+				std::nth_element(indexes, indexes + leftCount, indexes + count, comp);
+			}
+
+			//create the two children
+			unsigned childIndex = static_cast<unsigned>(m_nodes.size());
+			for (unsigned c = 0; c < 2; ++c)
+			{
+				Node child;
+				child.first = (c == 0 ? first : first + leftCount);
+				child.count = (c == 0 ? leftCount : count - leftCount);
+				child.bbMin = triangles[m_triangleIndexes[child.first]].bbMin;
+				child.bbMax = triangles[m_triangleIndexes[child.first]].bbMax;
+				for (unsigned i = 1; i < child.count; ++i)
+				{
+					const BuildTriangle& tri = triangles[m_triangleIndexes[child.first + i]];
+					ExtendBox(child.bbMin, child.bbMax, tri.bbMin, tri.bbMax);
+				}
+				m_nodes.push_back(child);
+
+				BuildTask childTask;
+				childTask.nodeIndex = childIndex + c;
+				childTask.depth = task.depth + 1;
+				tasks.push_back(childTask);
+			}
+
+			m_nodes[task.nodeIndex].first = childIndex;
+			m_nodes[task.nodeIndex].count = 0;
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		clear();
+		return false;
+	}
+
+	//we store the vertices in the leaves order
+	try
+	{
+		m_vertices.resize(vertices.size());
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		clear();
+		return false;
+	}
+	for (unsigned i = 0; i < triCount; ++i)
+	{
+		const CCVector3* V = &(vertices[3 * static_cast<size_t>(m_triangleIndexes[i])]);
+		CCVector3* _V = &(m_vertices[3 * static_cast<size_t>(i)]);
+		_V[0] = V[0];
+		_V[1] = V[1];
+		_V[2] = V[2];
+	}
+
+	return true;
+}
+
+double TriangleBVH::SquareDistanceToNode(const CCVector3& P, const Node& node)
+{
+	double squareDist = 0;
+	for (unsigned char k = 0; k < 3; ++k)
+	{
+		double d = 0;
+		if (P.u[k] < node.bbMin.u[k])
+			d = static_cast<double>(node.bbMin.u[k]) - P.u[k];
+		else if (P.u[k] > node.bbMax.u[k])
+			d = static_cast<double>(P.u[k]) - node.bbMax.u[k];
+		squareDist += d * d;
+	}
+	return squareDist;
+}
+
+bool TriangleBVH::findNearestTriangle(	const CCVector3& P,
+										double maxSquareDist,
+										NearestTriangle& result,
+										CCVector3* nearestPoint/*=0*/) const
+{
+	if (m_nodes.empty())
+	{
+		return false;
+	}
+
+	double bestSquareDist = maxSquareDist;
+	unsigned bestTriangle = 0;
+	bool found = false;
+
+	//nodes to visit (with their distance)
+	unsigned stackNodes[BVH_STACK_SIZE];
+	double stackDists[BVH_STACK_SIZE];
+	unsigned stackSize = 0;
+
+	double rootDist = SquareDistanceToNode(P, m_nodes[0]);
+	if (rootDist < bestSquareDist)
+	{
+		stackNodes[0] = 0;
+		stackDists[0] = rootDist;
+		stackSize = 1;
+	}
+
+	while (stackSize != 0)
+	{
+		--stackSize;
+		//the nearest triangle may have been found in the meantime
+		if (stackDists[stackSize] >= bestSquareDist)
+		{
+			continue;
+		}
+
+		const Node& node = m_nodes[stackNodes[stackSize]];
+		if (node.count != 0)
+		{
+			//leaf: we test all its triangles
+			for (unsigned i = node.first; i < node.first + node.count; ++i)
+			{
+				const CCVector3* V = &(m_vertices[3 * static_cast<size_t>(i)]);
+				SimpleRefTriangle tri(V, V + 1, V + 2);
+				double squareDist = DistanceComputationTools::computePoint2TriangleDistance(&P, &tri, false);
+				if (squareDist < bestSquareDist)
+				{
+					bestSquareDist = squareDist;
+					bestTriangle = i;
+					found = true;
+				}
+			}
+		}
+		else
+		{
+			//we visit the nearest child first (i.e. we push it last)
+			unsigned c0 = node.first;
+			unsigned c1 = node.first + 1;
+			double d0 = SquareDistanceToNode(P, m_nodes[c0]);
+			double d1 = SquareDistanceToNode(P, m_nodes[c1]);
+			if (d1 < d0)
+			{
+				std::swap(c0, c1);
+				std::swap(d0, d1);
+			}
+
+			assert(stackSize + 2 <= BVH_STACK_SIZE);
+			if (d1 < bestSquareDist)
+			{
+				stackNodes[stackSize] = c1;
+				stackDists[stackSize++] = d1;
+			}
+			if (d0 < bestSquareDist)
+			{
+				stackNodes[stackSize] = c0;
+				stackDists[stackSize++] = d0;
+			}
+		}
+	}
+
+	if (!found)
+	{
+		return false;
+	}
+
+	const CCVector3* V = &(m_vertices[3 * static_cast<size_t>(bestTriangle)]);
+	result.triangleIndex = m_triangleIndexes[bestTriangle];
+	result.squareDist = bestSquareDist;
+
+	//side of the triangle (see DistanceComputationTools::computePoint2TriangleDistance)
+	CCVector3d AP(P.x - V[0].x, P.y - V[0].y, P.z - V[0].z);
+	CCVector3d AB(V[1].x - V[0].x, V[1].y - V[0].y, V[1].z - V[0].z);
+	CCVector3d AC(V[2].x - V[0].x, V[2].y - V[0].y, V[2].z - V[0].z);
+	result.negativeSide = (AP.dot(AB.cross(AC)) < 0);
+
+	if (nearestPoint)
+	{
+		SimpleRefTriangle tri(V, V + 1, V + 2);
+		DistanceComputationTools::computePoint2TriangleDistance(&P, &tri, false, nearestPoint);
+	}
+
+	return true;
+}
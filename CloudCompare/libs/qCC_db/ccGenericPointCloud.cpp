@@ -187,6 +187,13 @@ ccOctree::Shared ccGenericPointCloud::computeOctree(CCLib::GenericProgressCallba
 	ccOctree::Shared octree = ccOctree::Shared(new ccOctree(this));
 	if (octree->build(progressCb) > 0)
 	{
+		const CCLib::DgmOctree::BuildTimings& timings = octree->getLastBuildTimings();
+		ccLog::PrintDebug("[Octree] Built in %.3f s. (projection: %.3f s. / sort: %.3f s. / statistics: %.3f s.)",
+							timings.totalTime_s,
+							timings.projectionTime_s,
+							timings.sortTime_s,
+							timings.statisticsTime_s);
+
 		setOctree(octree, autoAddChild);
 	}
 	else
@@ -31,6 +31,11 @@
 #include <ScalarFieldTools.h>
 #include <RayAndBox.h>
 
+//Qt
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
 ccOctree::ccOctree(ccGenericPointCloud* aCloud)
 	: CCLib::DgmOctree(aCloud)
 	, m_theAssociatedCloudAsGPC(aCloud)
@@ -109,6 +114,9 @@ void ccOctree::multiplyBoundingBox(const PointCoordinateType multFactor)
 
 	for (int i=0; i<=MAX_OCTREE_LEVEL; ++i)
 		m_cellSize[i] *= multFactor;
+
+	//the points have been moved
+	releaseSortedPointsCoordinates();
 }
 
 void ccOctree::translateBoundingBox(const CCVector3& T)
@@ -117,6 +125,9 @@ void ccOctree::translateBoundingBox(const CCVector3& T)
 	m_dimMax += T;
 	m_pointsMin += T;
 	m_pointsMax += T;
+
+	//the points have been moved
+	releaseSortedPointsCoordinates();
 }
 
 /*** RENDERING METHODS ***/
@@ -702,3 +713,255 @@ bool ccOctree::pointPicking(const CCVector2d& clickPos,
 
 	return true;
 }
+
+//! Octree cache file header
+struct OctreeCacheHeader
+{
+	//! Magic bytes ("CCOCTREE")
+	char magic[8];
+	//! Cache format version
+	quint32 version;
+	//! Size of a cell code (in bytes)
+	quint32 cellCodeSize;
+	//! Size of an octree element (in bytes)
+	quint32 elementSize;
+	//! Size of a point coordinate (in bytes)
+	quint32 coordSize;
+	//! Max octree level
+	quint32 maxLevel;
+	//! Padding
+	quint32 reserved;
+	//! Number of points of the associated cloud
+	quint64 cloudSize;
+	//! Number of points projected in the octree
+	quint64 projectedPoints;
+	//! Associated cloud hash
+	quint64 cloudHash;
+};
+
+static const char OCTREE_CACHE_MAGIC[8] = { 'C', 'C', 'O', 'C', 'T', 'R', 'E', 'E' };
+static const quint32 OCTREE_CACHE_VERSION = 2;
+
+//! Writes a block of data in an octree cache file (a short write is considered as an error)
+static bool WriteCacheData(QFile& out, const void* data, qint64 size)
+{
+	return out.write(reinterpret_cast<const char*>(data), size) == size;
+}
+
+quint64 ccOctree::ComputeCloudHash(ccGenericPointCloud* cloud)
+{
+	if (!cloud)
+	{
+		assert(false);
+		return 0;
+	}
+
+	//64 bits FNV-1a hash (applied on 32 bits words)
+	static const quint64 FNV_PRIME = 1099511628211ULL;
+	quint64 hash = 14695981039346656037ULL;
+
+	unsigned pointCount = cloud->size();
+	hash = (hash ^ pointCount) * FNV_PRIME;
+
+	CCVector3 bbMin, bbMax;
+	cloud->getBoundingBox(bbMin, bbMax);
+	{
+		const quint32* words = reinterpret_cast<const quint32*>(bbMin.u);
+		for (size_t k = 0; k < sizeof(CCVector3) / sizeof(quint32); ++k)
+			hash = (hash ^ words[k]) * FNV_PRIME;
+	}
+	{
+		const quint32* words = reinterpret_cast<const quint32*>(bbMax.u);
+		for (size_t k = 0; k < sizeof(CCVector3) / sizeof(quint32); ++k)
+			hash = (hash ^ words[k]) * FNV_PRIME;
+	}
+
+	for (unsigned i = 0; i < pointCount; ++i)
+	{
+		const quint32* words = reinterpret_cast<const quint32*>(cloud->getPoint(i)->u);
+		for (size_t k = 0; k < sizeof(CCVector3) / sizeof(quint32); ++k)
+			hash = (hash ^ words[k]) * FNV_PRIME;
+	}
+
+	return hash;
+}
+
+QString ccOctree::GetCacheFilename(const QString& filename, quint64 cloudHash)
+{
+	return QString("%1.%2.octree").arg(filename).arg(cloudHash, 16, 16, QChar('0'));
+}
+
+QStringList ccOctree::GetCacheFiles(const QString& filename)
+{
+	QFileInfo fi(filename);
+	QDir dir = fi.absoluteDir();
+
+	//we don't use the file name in a wildcard filter, as it may contain special characters ('[', '*', '?', etc.)
+	const QString prefix = fi.fileName() + ".";
+	const QString suffix = ".octree";
+	const int hashLength = 16;
+
+	QStringList cacheFiles;
+	QStringList candidates = dir.entryList(QStringList(QString("*") + suffix), QDir::Files);
+	for (int i = 0; i < candidates.size(); ++i)
+	{
+		const QString& name = candidates[i];
+		if (	name.length() != prefix.length() + hashLength + suffix.length()
+			||	!name.startsWith(prefix)
+			||	!name.endsWith(suffix))
+		{
+			continue;
+		}
+
+		bool ok = false;
+		name.mid(prefix.length(), hashLength).toULongLong(&ok, 16);
+		if (ok)
+		{
+			cacheFiles << dir.absoluteFilePath(name);
+		}
+	}
+
+	return cacheFiles;
+}
+
+bool ccOctree::saveToCacheFile(const QString& filename, quint64 cloudHash) const
+{
+	if (m_thePointsAndTheirCellCodes.empty() || !m_theAssociatedCloud)
+	{
+		return false;
+	}
+
+	QFile out(filename);
+	if (!out.open(QIODevice::WriteOnly))
+	{
+		ccLog::Warning(QString("[ccOctree] Failed to create octree cache file '%1'").arg(filename));
+		return false;
+	}
+
+	OctreeCacheHeader header;
+	memset(&header, 0, sizeof(OctreeCacheHeader));
+	memcpy(header.magic, OCTREE_CACHE_MAGIC, 8);
+	header.version = OCTREE_CACHE_VERSION;
+	header.cellCodeSize = static_cast<quint32>(sizeof(CellCode));
+	header.elementSize = static_cast<quint32>(sizeof(IndexAndCode));
+	header.coordSize = static_cast<quint32>(sizeof(PointCoordinateType));
+	header.maxLevel = static_cast<quint32>(MAX_OCTREE_LEVEL);
+	header.cloudSize = static_cast<quint64>(m_theAssociatedCloud->size());
+	header.projectedPoints = static_cast<quint64>(m_numberOfProjectedPoints);
+	header.cloudHash = cloudHash;
+
+	bool success =	WriteCacheData(out, &header, sizeof(OctreeCacheHeader))
+				&&	WriteCacheData(out, m_dimMin.u, sizeof(CCVector3))
+				&&	WriteCacheData(out, m_dimMax.u, sizeof(CCVector3))
+				&&	WriteCacheData(out, m_pointsMin.u, sizeof(CCVector3))
+				&&	WriteCacheData(out, m_pointsMax.u, sizeof(CCVector3))
+				&&	WriteCacheData(out, m_fillIndexes, sizeof(m_fillIndexes))
+				&&	WriteCacheData(out, m_cellCount, sizeof(m_cellCount))
+				&&	WriteCacheData(out, m_maxCellPopulation, sizeof(m_maxCellPopulation))
+				&&	WriteCacheData(out, m_averageCellPopulation, sizeof(m_averageCellPopulation))
+				&&	WriteCacheData(out, m_stdDevCellPopulation, sizeof(m_stdDevCellPopulation))
+				&&	WriteCacheData(out, &(m_thePointsAndTheirCellCodes[0]), static_cast<qint64>(sizeof(IndexAndCode) * m_thePointsAndTheirCellCodes.size()))
+				&&	out.flush();
+
+	out.close();
+
+	if (!success)
+	{
+		ccLog::Warning(QString("[ccOctree] Failed to write octree cache file '%1'").arg(filename));
+		QFile::remove(filename);
+	}
+
+	return success;
+}
+
+bool ccOctree::loadFromCacheFile(const QString& filename, quint64 cloudHash)
+{
+	if (!m_thePointsAndTheirCellCodes.empty())
+	{
+		clear();
+	}
+
+	if (!m_theAssociatedCloud)
+	{
+		return false;
+	}
+
+	QFile in(filename);
+	if (!in.open(QIODevice::ReadOnly))
+	{
+		return false;
+	}
+
+	qint64 fileSize = in.size();
+	const qint64 fixedPartSize =	static_cast<qint64>(sizeof(OctreeCacheHeader))
+								+	4 * sizeof(CCVector3)
+								+	sizeof(m_fillIndexes)
+								+	sizeof(m_cellCount)
+								+	sizeof(m_maxCellPopulation)
+								+	sizeof(m_averageCellPopulation)
+								+	sizeof(m_stdDevCellPopulation);
+	if (fileSize < fixedPartSize)
+	{
+		return false;
+	}
+
+	//the whole file is memory-mapped (no intermediate buffer)
+	const uchar* data = in.map(0, fileSize);
+	if (!data)
+	{
+		ccLog::Warning(QString("[ccOctree] Failed to map octree cache file '%1'").arg(filename));
+		return false;
+	}
+
+	OctreeCacheHeader header;
+	memcpy(&header, data, sizeof(OctreeCacheHeader));
+
+	//check that the cache matches the current cloud and the current build
+	if (	memcmp(header.magic, OCTREE_CACHE_MAGIC, 8) != 0
+		||	header.version != OCTREE_CACHE_VERSION
+		||	header.cellCodeSize != sizeof(CellCode)
+		||	header.elementSize != sizeof(IndexAndCode)
+		||	header.coordSize != sizeof(PointCoordinateType)
+		||	header.maxLevel != static_cast<quint32>(MAX_OCTREE_LEVEL)
+		||	header.cloudSize != static_cast<quint64>(m_theAssociatedCloud->size())
+		||	header.projectedPoints == 0
+		||	header.projectedPoints > header.cloudSize
+		||	header.cloudHash != cloudHash
+		||	fileSize != fixedPartSize + static_cast<qint64>(sizeof(IndexAndCode)) * header.projectedPoints )
+	{
+		ccLog::Warning(QString("[ccOctree] Octree cache file '%1' is invalid or outdated").arg(filename));
+		in.unmap(const_cast<uchar*>(data));
+		return false;
+	}
+
+	try
+	{
+		m_thePointsAndTheirCellCodes.resize(header.projectedPoints);
+	}
+	catch (const std::bad_alloc&)
+	{
+		in.unmap(const_cast<uchar*>(data));
+		return false;
+	}
+
+	const uchar* ptr = data + sizeof(OctreeCacheHeader);
+	memcpy(m_dimMin.u, ptr, sizeof(CCVector3));						ptr += sizeof(CCVector3);
+	memcpy(m_dimMax.u, ptr, sizeof(CCVector3));						ptr += sizeof(CCVector3);
+	memcpy(m_pointsMin.u, ptr, sizeof(CCVector3));					ptr += sizeof(CCVector3);
+	memcpy(m_pointsMax.u, ptr, sizeof(CCVector3));					ptr += sizeof(CCVector3);
+	memcpy(m_fillIndexes, ptr, sizeof(m_fillIndexes));				ptr += sizeof(m_fillIndexes);
+	memcpy(m_cellCount, ptr, sizeof(m_cellCount));					ptr += sizeof(m_cellCount);
+	memcpy(m_maxCellPopulation, ptr, sizeof(m_maxCellPopulation));	ptr += sizeof(m_maxCellPopulation);
+	memcpy(m_averageCellPopulation, ptr, sizeof(m_averageCellPopulation));	ptr += sizeof(m_averageCellPopulation);
+	memcpy(m_stdDevCellPopulation, ptr, sizeof(m_stdDevCellPopulation));		ptr += sizeof(m_stdDevCellPopulation);
+	memcpy(&(m_thePointsAndTheirCellCodes[0]), ptr, sizeof(IndexAndCode) * header.projectedPoints);
+
+	in.unmap(const_cast<uchar*>(data));
+	in.close();
+
+	m_numberOfProjectedPoints = static_cast<PointIndexType>(header.projectedPoints);
+	updateCellSizeTable();
+	m_glListIsDeprecated = true;
+
+	return true;
+}
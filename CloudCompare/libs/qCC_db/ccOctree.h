@@ -28,6 +28,7 @@
 
 //Qt
 #include <QSharedPointer>
+#include <QStringList>
 
 //system
 #include <vector>
@@ -108,6 +109,39 @@ public: //RENDERING
 						PointDescriptor& output,
 						double pickWidth_pix = 3.0) const;
 
+public: //CACHE
+
+	//! Computes the hash used to validate an octree cache file against a cloud
+	/** Based on the cloud size, bounding-box and points coordinates.
+	**/
+	static quint64 ComputeCloudHash(ccGenericPointCloud* cloud);
+
+	//! Returns the name of the octree cache file of a given cloud (stored next to another file)
+	/** \param filename file next to which the cache file is stored (typically a BIN file)
+		\param cloudHash the cloud hash (see ComputeCloudHash)
+	**/
+	static QString GetCacheFilename(const QString& filename, quint64 cloudHash);
+
+	//! Returns the (absolute) names of all the octree cache files stored next to a given file
+	static QStringList GetCacheFiles(const QString& filename);
+
+	//! Saves the octree structure in a cache file
+	/** \param filename cache filename (see GetCacheFilename)
+		\param cloudHash the associated cloud hash (see ComputeCloudHash)
+		\return success
+	**/
+	bool saveToCacheFile(const QString& filename, quint64 cloudHash) const;
+
+	//! Loads the octree structure from a cache file
+	/** The file is memory-mapped and checked against the associated cloud
+		(size, hash, etc.) before being used. The octree is left empty if the
+		cache file is invalid or outdated.
+		\param filename cache filename (see GetCacheFilename)
+		\param cloudHash the associated cloud hash (see ComputeCloudHash)
+		\return success
+	**/
+	bool loadFromCacheFile(const QString& filename, quint64 cloudHash);
+
 public: //HELPERS
 	
 	//! Computes the average color of a set of points
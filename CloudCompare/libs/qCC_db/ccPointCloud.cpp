@@ -1113,7 +1113,7 @@ bool ccPointCloud::resizeTheFWFTable()
 	return m_fwfData.capacity() >= m_points->capacity();
 }
 
-bool ccPointCloud::reserve(unsigned newNumberOfPoints)
+bool ccPointCloud::reserve(PointIndexType newNumberOfPoints)
 {
 	//reserve works only to enlarge the cloud
 	if (newNumberOfPoints < size())
@@ -1138,7 +1138,7 @@ bool ccPointCloud::reserve(unsigned newNumberOfPoints)
 		&&	( !hasFWF()     || m_fwfData.capacity()    >= newNumberOfPoints );
 }
 
-bool ccPointCloud::resize(unsigned newNumberOfPoints)
+bool ccPointCloud::resize(PointIndexType newNumberOfPoints)
 {
 	//can't reduce the size if the cloud if it is locked!
 	if (newNumberOfPoints < size() && isLocked())
@@ -1889,7 +1889,7 @@ void ccPointCloud::invertNormals()
 	releaseVBOs();
 }
 
-void ccPointCloud::swapPoints(unsigned firstIndex, unsigned secondIndex)
+void ccPointCloud::swapPoints(PointIndexType firstIndex, PointIndexType secondIndex)
 {
 	assert(!isLocked());
 	assert(firstIndex < size() && secondIndex < size());
@@ -216,7 +216,7 @@ public: //features allocation/resize
 		population. Only the already allocated features will be re-reserved.
 		\return true if ok, false if there's not enough memory
 	**/
-	virtual bool reserve(unsigned numberOfPoints) override;
+	virtual bool reserve(PointIndexType numberOfPoints) override;
 
 	//! Resizes all the active features arrays
 	/** This method is meant to be called after having increased the cloud
@@ -224,7 +224,7 @@ public: //features allocation/resize
 		reserved size). Otherwise, it fills all new elements with blank values.
 		\return true if ok, false if there's not enough memory
 	**/
-	virtual bool resize(unsigned numberOfPoints) override;
+	virtual bool resize(PointIndexType numberOfPoints) override;
 
 	//! Removes unused capacity
 	inline void shrinkToFit() { if (size() < capacity()) resize(size()); }
@@ -662,7 +662,7 @@ protected:
 	//inherited from ChunkedPointCloud
 	/** \warning Doesn't handle scan grids!
 	**/
-	virtual void swapPoints(unsigned firstIndex, unsigned secondIndex) override;
+	virtual void swapPoints(PointIndexType firstIndex, PointIndexType secondIndex) override;
 
 	//! Colors
 	ColorsTableType* m_rgbColors;
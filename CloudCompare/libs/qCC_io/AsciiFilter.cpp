@@ -16,12 +16,16 @@
 //##########################################################################
 
 #include "AsciiFilter.h"
+#include "AsciiTokenizer.h"
 
 //Qt
 #include <QFile>
 #include <QFileInfo>
 #include <QTextStream>
 #include <QSharedPointer>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtConcurrentMap>
 
 //CClib
 #include <ScalarField.h>
@@ -670,6 +674,535 @@ cloudAttributesDescriptor prepareCloud(	const AsciiOpenDlg::Sequence &openSequen
 	return cloudDesc;
 }
 
+//! Parsing layout shared by all the blocks of a file (see AsciiBlock)
+struct AsciiBlockLayout
+{
+	//! Column indexes
+	cloudAttributesDescriptor desc;
+	//! Separator
+	char separator;
+	//! Max. column index (i.e. min. number of columns - 1)
+	int maxPartIndex;
+};
+
+//! Corrupted line (see AsciiBlock)
+struct AsciiLineIssue
+{
+	//! Line index (in the block, starting at 1)
+	unsigned line;
+	//! Number of columns found (or -1 if the line is empty)
+	int partCount;
+	//! Number of valid points (in the block) before this line
+	size_t pointIndex;
+};
+
+//! Block of consecutive lines of a memory-mapped ASCII file
+/** Blocks are parsed independently (and in parallel) then merged in order.
+	Their buffers are re-used from one block to the next, so that the parsing
+	doesn't allocate memory anymore once the first blocks have been processed.
+**/
+struct AsciiBlock
+{
+	//! Layout
+	const AsciiBlockLayout* layout;
+	//! Block start (beginning of a line)
+	const char* begin;
+	//! Block end (after an end of line, or end of file)
+	const char* end;
+
+	//! Number of lines
+	unsigned lineCount;
+	//! Points
+	std::vector<CCVector3d> points;
+	//! Normals (if any)
+	std::vector<CCVector3> normals;
+	//! Colors (if any)
+	std::vector<ccColor::Rgb> colors;
+	//! Scalar values (if any - one per scalar field and per point)
+	std::vector<ScalarType> scalars;
+	//! Corrupted lines
+	std::vector<AsciiLineIssue> issues;
+	//! Columns of the current line
+	std::vector<AsciiTokenizer::Token> parts;
+	//! Whether the process failed because of a lack of memory
+	bool notEnoughMemory;
+
+	AsciiBlock()
+		: layout(0)
+		, begin(0)
+		, end(0)
+		, lineCount(0)
+		, notEnoughMemory(false)
+	{}
+};
+
+//! Parses all the lines of a block (see AsciiFilter::loadCloudFromFormatedAsciiFile)
+static void ParseAsciiBlock(AsciiBlock& block)
+{
+	const cloudAttributesDescriptor& desc = block.layout->desc;
+	const char separator = block.layout->separator;
+	const int maxPartIndex = block.layout->maxPartIndex;
+	const size_t sfCount = desc.scalarIndexes.size();
+	const bool hasColors = (desc.hasRGBColors || desc.greyIndex >= 0);
+
+	block.lineCount = 0;
+	block.points.clear();
+	block.normals.clear();
+	block.colors.clear();
+	block.scalars.clear();
+	block.issues.clear();
+	block.notEnoughMemory = false;
+
+	//same buffers as the sequential version
+	CCVector3d P(0, 0, 0);
+	CCVector3 N(0, 0, 0);
+	ccColor::Rgb col;
+
+	try
+	{
+		//we only need the first 'maxPartIndex+1' columns of each line
+		block.parts.resize(static_cast<size_t>(maxPartIndex) + 1);
+		AsciiTokenizer::Token* parts = block.parts.data();
+
+		const char* pos = block.begin;
+		AsciiTokenizer::Token line;
+		while (AsciiTokenizer::NextLine(pos, block.end, line))
+		{
+			++block.lineCount;
+
+			//comment
+			if (line.size() >= 2 && line.begin[0] == '/' && line.begin[1] == '/')
+				continue;
+
+			if (line.size() == 0)
+			{
+				AsciiLineIssue issue = { block.lineCount, -1, block.points.size() };
+				block.issues.push_back(issue);
+				continue;
+			}
+
+			//we split the current line (empty parts are skipped)
+			int nParts = AsciiTokenizer(line.begin, line.end, separator).split(parts, maxPartIndex + 1);
+			if (nParts <= maxPartIndex)
+			{
+				AsciiLineIssue issue = { block.lineCount, nParts, block.points.size() };
+				block.issues.push_back(issue);
+				continue;
+			}
+
+			//(X,Y,Z)
+			if (desc.xCoordIndex >= 0)
+				parts[desc.xCoordIndex].toDouble(P.x);
+			if (desc.yCoordIndex >= 0)
+				parts[desc.yCoordIndex].toDouble(P.y);
+			if (desc.zCoordIndex >= 0)
+				parts[desc.zCoordIndex].toDouble(P.z);
+			block.points.push_back(P);
+
+			//Normal vector
+			if (desc.hasNorms)
+			{
+				double n = 0;
+				if (desc.xNormIndex >= 0)
+				{
+					parts[desc.xNormIndex].toDouble(n);
+					N.x = static_cast<PointCoordinateType>(n);
+				}
+				if (desc.yNormIndex >= 0)
+				{
+					parts[desc.yNormIndex].toDouble(n);
+					N.y = static_cast<PointCoordinateType>(n);
+				}
+				if (desc.zNormIndex >= 0)
+				{
+					parts[desc.zNormIndex].toDouble(n);
+					N.z = static_cast<PointCoordinateType>(n);
+				}
+				block.normals.push_back(N);
+			}
+
+			//Colors
+			if (desc.hasRGBColors)
+			{
+				double c = 0;
+				if (desc.iRgbaIndex >= 0)
+				{
+					int i = 0;
+					parts[desc.iRgbaIndex].toInt(i);
+					const uint32_t rgb = static_cast<uint32_t>(i);
+					col.r = ((rgb >> 16) & 0x0000ff);
+					col.g = ((rgb >> 8 ) & 0x0000ff);
+					col.b = ((rgb      ) & 0x0000ff);
+				}
+				else if (desc.fRgbaIndex >= 0)
+				{
+					parts[desc.fRgbaIndex].toDouble(c);
+					const float rgbf = static_cast<float>(c);
+					uint32_t rgb = 0;
+					memcpy(&rgb, &rgbf, sizeof(uint32_t));
+					col.r = ((rgb >> 16) & 0x0000ff);
+					col.g = ((rgb >> 8 ) & 0x0000ff);
+					col.b = ((rgb      ) & 0x0000ff);
+				}
+				else
+				{
+					if (desc.redIndex >= 0)
+					{
+						float multiplier = desc.hasFloatRGBColors[0] ? static_cast<float>(ccColor::MAX) : 1.0f;
+						parts[desc.redIndex].toDouble(c);
+						col.r = static_cast<ColorCompType>(static_cast<float>(c) * multiplier);
+					}
+					if (desc.greenIndex >= 0)
+					{
+						float multiplier = desc.hasFloatRGBColors[1] ? static_cast<float>(ccColor::MAX) : 1.0f;
+						parts[desc.greenIndex].toDouble(c);
+						col.g = static_cast<ColorCompType>(static_cast<float>(c) * multiplier);
+					}
+					if (desc.blueIndex >= 0)
+					{
+						float multiplier = desc.hasFloatRGBColors[2] ? static_cast<float>(ccColor::MAX) : 1.0f;
+						parts[desc.blueIndex].toDouble(c);
+						col.b = static_cast<ColorCompType>(static_cast<float>(c) * multiplier);
+					}
+				}
+			}
+			else if (desc.greyIndex >= 0)
+			{
+				int i = 0;
+				parts[desc.greyIndex].toInt(i);
+				col.r = col.g = col.b = static_cast<ColorCompType>(i);
+			}
+			if (hasColors)
+			{
+				block.colors.push_back(col);
+			}
+
+			//Scalar values
+			for (size_t j=0; j<sfCount; ++j)
+			{
+				double d = 0;
+				parts[desc.scalarIndexes[j]].toDouble(d);
+				block.scalars.push_back(static_cast<ScalarType>(d));
+			}
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		block.notEnoughMemory = true;
+	}
+}
+
+//! Logs a corrupted line (same messages as the sequential version)
+static void LogAsciiLineIssue(const AsciiLineIssue& issue, unsigned firstLine, int maxPartIndex)
+{
+	if (issue.partCount < 0)
+		ccLog::Warning("[AsciiFilter::Load] Line %i is corrupted (empty)!",firstLine+issue.line);
+	else
+		ccLog::Warning("[AsciiFilter::Load] Line %i is corrupted (found %i part(s) on %i expected)!",firstLine+issue.line,issue.partCount,maxPartIndex+1);
+}
+
+//! Size of the blocks of lines parsed in parallel (in bytes)
+static const qint64 c_asciiBlockSize = (1 << 21);
+//! Number of blocks per thread processed between two merges
+static const int c_asciiBlocksPerThread = 2;
+
+//! Loads a memory-mapped ASCII file (see AsciiFilter::loadCloudFromFormatedAsciiFile)
+/** The file is split into blocks of complete lines which are parsed in parallel,
+	then merged in order into the cloud(s).
+**/
+static CC_FILE_ERROR LoadMappedAsciiFile(	const char* data,
+											qint64 dataSize,
+											const QString& filename,
+											ccHObject& container,
+											const AsciiOpenDlg::Sequence& openSequence,
+											char separator,
+											unsigned approximateNumberOfLines,
+											unsigned maxCloudSize,
+											unsigned skipLines,
+											FileIOFilter::LoadParameters& parameters)
+{
+	QElapsedTimer eTimer;
+	eTimer.start();
+
+	const char* dataEnd = data + dataSize;
+
+	//UTF-8 BOM
+	const char* start = data;
+	if (dataSize >= 3 && memcmp(start, "\xEF\xBB\xBF", 3) == 0)
+		start += 3;
+
+	//we skip lines as defined on input
+	for (unsigned i = 0; i < skipLines && start < dataEnd; ++i)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(start, '\n', dataEnd - start));
+		start = (lineEnd ? lineEnd + 1 : dataEnd);
+	}
+
+	//we may have to "slice" clouds when opening them if they are too big!
+	unsigned cloudChunkSize = std::min(maxCloudSize,approximateNumberOfLines);
+	unsigned cloudChunkPos = 0;
+	unsigned chunkRank = 1;
+
+	//we initialize the loading accelerator structure and point cloud
+	int maxPartIndex = -1;
+	cloudAttributesDescriptor cloudDesc = prepareCloud(openSequence, cloudChunkSize, maxPartIndex, separator, chunkRank);
+	if (!cloudDesc.cloud)
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+
+	//the parsing layout is the same for all the blocks
+	AsciiBlockLayout layout;
+	layout.desc = cloudDesc;
+	layout.desc.cloud = 0;
+	layout.separator = separator;
+	layout.maxPartIndex = maxPartIndex;
+
+	//blocks (parsed in parallel, then merged in order)
+	int threadCount = std::max(1, QThread::idealThreadCount());
+	std::vector<AsciiBlock> blocks;
+	try
+	{
+		blocks.resize(static_cast<size_t>(threadCount) * c_asciiBlocksPerThread);
+	}
+	catch (const std::bad_alloc&)
+	{
+		clearStructure(cloudDesc);
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+	}
+
+	//progress indicator
+	ccProgressDialog pdlg(true, parameters.parentWidget);
+	if (parameters.parentWidget)
+	{
+		pdlg.setMethodTitle(QObject::tr("Open ASCII file [%1]").arg(filename));
+		pdlg.setInfo(QObject::tr("Approximate number of points: %1").arg(approximateNumberOfLines));
+		pdlg.start();
+	}
+
+	CCVector3d Pshift(0,0,0);
+	unsigned linesRead = 0;
+	unsigned pointsRead = 0;
+	unsigned nextLimit = cloudChunkSize;
+
+	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
+
+	const char* blockStart = start;
+	while (blockStart < dataEnd && result == CC_FERR_NO_ERROR)
+	{
+		//we split the next part of the file in blocks of complete lines
+		size_t blockCount = 0;
+		for (; blockCount < blocks.size() && blockStart < dataEnd; ++blockCount)
+		{
+			AsciiBlock& block = blocks[blockCount];
+			block.layout = &layout;
+			block.begin = blockStart;
+			block.end = dataEnd;
+			if (dataEnd - blockStart > c_asciiBlockSize)
+			{
+				const char* lineEnd = static_cast<const char*>(memchr(blockStart + c_asciiBlockSize, '\n', dataEnd - blockStart - c_asciiBlockSize));
+				if (lineEnd)
+					block.end = lineEnd + 1;
+			}
+			blockStart = block.end;
+		}
+
+		//parse them
+		if (blockCount > 1)
+		{
+			QtConcurrent::blockingMap(blocks.begin(), blocks.begin() + blockCount, ParseAsciiBlock);
+		}
+		else
+		{
+			ParseAsciiBlock(blocks.front());
+		}
+
+		//and merge them in order
+		for (size_t b = 0; b < blockCount && result == CC_FERR_NO_ERROR; ++b)
+		{
+			const AsciiBlock& block = blocks[b];
+			if (block.notEnoughMemory)
+			{
+				ccLog::Error("Not enough memory! Process stopped ...");
+				result = CC_FERR_NOT_ENOUGH_MEMORY;
+				break;
+			}
+
+			size_t sfCount = std::min(cloudDesc.scalarFields.size(), layout.desc.scalarFields.size());
+			size_t blockPointCount = block.points.size();
+			size_t issueIndex = 0;
+			for (size_t i = 0; i < blockPointCount; ++i)
+			{
+				//corrupted lines before this point (logged in the same order as the sequential version)
+				for (; issueIndex < block.issues.size() && block.issues[issueIndex].pointIndex <= i; ++issueIndex)
+				{
+					LogAsciiLineIssue(block.issues[issueIndex], linesRead, maxPartIndex);
+				}
+
+				//if we have reached the max. number of points per cloud
+				if (pointsRead == nextLimit)
+				{
+					ccLog::PrintDebug("[ASCII] Point %i -> end of chunk (%i points)",pointsRead,cloudChunkSize);
+
+					//we re-evaluate the average line size
+					{
+						double bytesRead = static_cast<double>(block.begin - start) + static_cast<double>(block.end - block.begin) * i / blockPointCount;
+						double averageLineSize = bytesRead / pointsRead;
+						double newNbOfLinesApproximation = std::max(1.0, static_cast<double>(dataEnd - start) / averageLineSize);
+
+						//if approximation is smaller than actual one, we add 2% by default
+						if (newNbOfLinesApproximation <= pointsRead)
+						{
+							newNbOfLinesApproximation = std::max(static_cast<double>(cloudChunkPos+cloudChunkSize)+1.0,static_cast<double>(pointsRead) * 1.02);
+						}
+						approximateNumberOfLines = static_cast<unsigned>(ceil(newNbOfLinesApproximation));
+						ccLog::PrintDebug("[ASCII] New approximate nb of lines: %i",approximateNumberOfLines);
+					}
+
+					//we try to resize actual clouds
+					if (cloudChunkSize < maxCloudSize || approximateNumberOfLines-cloudChunkPos <= maxCloudSize)
+					{
+						ccLog::PrintDebug("[ASCII] We choose to enlarge existing clouds");
+
+						cloudChunkSize = std::min(maxCloudSize,approximateNumberOfLines-cloudChunkPos);
+						if (!cloudDesc.cloud->reserve(cloudChunkSize))
+						{
+							ccLog::Error("Not enough memory! Process stopped ...");
+							result = CC_FERR_NOT_ENOUGH_MEMORY;
+							break;
+						}
+					}
+					else //otherwise we have to create new clouds
+					{
+						ccLog::PrintDebug("[ASCII] We choose to instantiate new clouds");
+
+						//we store (and resize) actual cloud
+						if (!cloudDesc.cloud->resize(cloudChunkSize))
+							ccLog::Warning("Memory reallocation failed ... some memory may have been wasted ...");
+						if (!cloudDesc.scalarFields.empty())
+						{
+							for (unsigned k=0; k<cloudDesc.scalarFields.size(); ++k)
+								cloudDesc.scalarFields[k]->computeMinAndMax();
+							cloudDesc.cloud->setCurrentDisplayedScalarField(0);
+							cloudDesc.cloud->showSF(true);
+						}
+						//we add this cloud to the output container
+						container.addChild(cloudDesc.cloud);
+						cloudDesc.reset();
+
+						//and create new one
+						cloudChunkPos = pointsRead;
+						cloudChunkSize = std::min(maxCloudSize,approximateNumberOfLines-cloudChunkPos);
+						cloudDesc = prepareCloud(openSequence, cloudChunkSize, maxPartIndex, separator, ++chunkRank);
+						if (!cloudDesc.cloud)
+						{
+							ccLog::Error("Not enough memory! Process stopped ...");
+							result = CC_FERR_NOT_ENOUGH_MEMORY;
+							break;
+						}
+						cloudDesc.cloud->setGlobalShift(Pshift);
+						sfCount = std::min(cloudDesc.scalarFields.size(), layout.desc.scalarFields.size());
+					}
+
+					//we update the progress info
+					if (parameters.parentWidget)
+					{
+						pdlg.setInfo(QObject::tr("Approximate number of points: %1").arg(approximateNumberOfLines));
+					}
+
+					nextLimit = cloudChunkPos+cloudChunkSize;
+				}
+
+				const CCVector3d& P = block.points[i];
+
+				//first point: check for 'big' coordinates
+				if (pointsRead == 0)
+				{
+					if (FileIOFilter::HandleGlobalShift(P,Pshift,parameters))
+					{
+						cloudDesc.cloud->setGlobalShift(Pshift);
+						ccLog::Warning("[ASCIIFilter::loadFile] Cloud has been recentered! Translation: (%.2f,%.2f,%.2f)",Pshift.x,Pshift.y,Pshift.z);
+					}
+				}
+
+				//add point
+				cloudDesc.cloud->addPoint(CCVector3::fromArray((P+Pshift).u));
+
+				//Normal vector
+				if (cloudDesc.hasNorms && layout.desc.hasNorms)
+				{
+					cloudDesc.cloud->addNorm(block.normals[i]);
+				}
+
+				//Colors
+				if (!block.colors.empty() && (cloudDesc.hasRGBColors || cloudDesc.greyIndex >= 0))
+				{
+					cloudDesc.cloud->addRGBColor(block.colors[i].rgb);
+				}
+
+				//Scalar values
+				if (sfCount != 0)
+				{
+					const ScalarType* values = &block.scalars[i * layout.desc.scalarIndexes.size()];
+					for (size_t j=0; j<sfCount; ++j)
+					{
+						cloudDesc.scalarFields[j]->setValue(pointsRead-cloudChunkPos,values[j]);
+					}
+				}
+
+				++pointsRead;
+			}
+
+			if (result == CC_FERR_NO_ERROR)
+			{
+				//corrupted lines after the last point of the block
+				for (; issueIndex < block.issues.size(); ++issueIndex)
+				{
+					LogAsciiLineIssue(block.issues[issueIndex], linesRead, maxPartIndex);
+				}
+			}
+			linesRead += block.lineCount;
+		}
+
+		if (parameters.parentWidget)
+		{
+			pdlg.update(static_cast<float>(100.0 * (blockStart - data) / dataSize));
+			if (pdlg.isCancelRequested())
+			{
+				//cancel requested
+				result = CC_FERR_CANCELED_BY_USER;
+			}
+		}
+	}
+
+	if (cloudDesc.cloud)
+	{
+		if (cloudDesc.cloud->size() < cloudDesc.cloud->capacity())
+			cloudDesc.cloud->resize(cloudDesc.cloud->size());
+
+		//add cloud to output
+		if (!cloudDesc.scalarFields.empty())
+		{
+			for (size_t j=0; j<cloudDesc.scalarFields.size(); ++j)
+			{
+				cloudDesc.scalarFields[j]->resize(cloudDesc.cloud->size(),true,NAN_VALUE);
+				cloudDesc.scalarFields[j]->computeMinAndMax();
+			}
+			cloudDesc.cloud->setCurrentDisplayedScalarField(0);
+			cloudDesc.cloud->showSF(true);
+		}
+
+		container.addChild(cloudDesc.cloud);
+	}
+
+	double elapsed_s = eTimer.elapsed() / 1000.0;
+	ccLog::Print(QString("[ASCII] %1 points loaded in %2 s. (%3 MB/s, %4 thread(s))")
+					.arg(pointsRead)
+					.arg(elapsed_s, 0, 'f', 2)
+					.arg(dataSize / (1024.0 * 1024.0) / std::max(elapsed_s, 0.001), 0, 'f', 1)
+					.arg(threadCount));
+
+	return result;
+}
+
 CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filename,
 															ccHObject& container,
 															const AsciiOpenDlg::Sequence& openSequence,
@@ -682,6 +1215,35 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filena
 {
 	//we may have to "slice" clouds when opening them if they are too big!
 	maxCloudSize = std::min(maxCloudSize,CC_MAX_NUMBER_OF_POINTS_PER_CLOUD);
+
+	//fast path: the file is memory-mapped and parsed in parallel
+	//(the sequential version below is only used for the files that can't be mapped or that are not 8-bit encoded)
+	{
+		QFile file(filename);
+		if (file.open(QFile::ReadOnly) && file.size() > 0)
+		{
+			const char* data = reinterpret_cast<const char*>(file.map(0, file.size()));
+			if (data)
+			{
+				bool utf16or32 = (file.size() >= 2 && (memcmp(data, "\xFF\xFE", 2) == 0 || memcmp(data, "\xFE\xFF", 2) == 0))
+							||	(file.size() >= 4 && memcmp(data, "\x00\x00\xFE\xFF", 4) == 0);
+				if (!utf16or32)
+				{
+					return LoadMappedAsciiFile(	data,
+												file.size(),
+												filename,
+												container,
+												openSequence,
+												separator,
+												approximateNumberOfLines,
+												maxCloudSize,
+												skipLines,
+												parameters);
+				}
+			}
+		}
+	}
+
 	unsigned cloudChunkSize = std::min(maxCloudSize,approximateNumberOfLines);
 	unsigned cloudChunkPos = 0;
 	unsigned chunkRank = 1;
@@ -907,7 +1469,7 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const QString& filena
 			}
 			else if (cloudDesc.greyIndex >= 0)
 			{
-				col.r = col.r = col.b = static_cast<ColorCompType>(parts[cloudDesc.greyIndex].toInt());
+				col.r = col.g = col.b = static_cast<ColorCompType>(parts[cloudDesc.greyIndex].toInt());
 				cloudDesc.cloud->addRGBColor(col.rgb);
 			}
 
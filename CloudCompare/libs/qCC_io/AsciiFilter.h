@@ -52,6 +52,9 @@ public:
 	virtual bool canSave(CC_CLASS_ENUM type, bool& multiple, bool& exclusive) const override;
 
 	//! Loads an ASCII file with a predefined format
+	/** If possible, the file is memory-mapped and parsed by blocks of lines in parallel
+		(the throughput is logged in the console).
+	**/
 	CC_FILE_ERROR loadCloudFromFormatedAsciiFile(	const QString& filename,
 													ccHObject& container,
 													const AsciiOpenDlg::Sequence& openSequence,
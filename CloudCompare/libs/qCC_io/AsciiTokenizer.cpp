@@ -0,0 +1,147 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "AsciiTokenizer.h"
+
+//Qt
+#include <QFile>
+
+//System
+#include <algorithm>
+#include <assert.h>
+
+AsciiFileReader::AsciiFileReader()
+	: m_file(0)
+	, m_mapped(0)
+	, m_size(0)
+	, m_pos(0)
+	, m_consumed(0)
+	, m_error(false)
+{
+}
+
+bool AsciiFileReader::open(QFile& file)
+{
+	m_file = &file;
+	m_size = file.size();
+	m_pos = 0;
+	m_buffer.clear();
+	m_consumed = 0;
+	m_error = false;
+
+	if (m_size <= 0)
+		return false;
+
+	m_mapped = reinterpret_cast<const char*>(file.map(0, m_size));
+	if (!m_mapped && !file.seek(0))
+	{
+		m_error = true;
+		return false;
+	}
+
+	return true;
+}
+
+bool AsciiFileReader::next(qint64 minSize, const char*& begin, const char*& end)
+{
+	if (m_error || !m_file || m_pos >= m_size)
+		return false;
+
+	if (m_mapped)
+	{
+		const char* dataEnd = m_mapped + m_size;
+		begin = m_mapped + m_pos;
+		end = dataEnd;
+		if (dataEnd - begin > minSize)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(begin + minSize, '\n', dataEnd - begin - minSize));
+			if (lineEnd)
+				end = lineEnd + 1;
+		}
+		m_pos = static_cast<qint64>(end - m_mapped);
+		return true;
+	}
+
+	try
+	{
+		//we keep the (incomplete) last line of the previous piece
+		m_buffer.erase(m_buffer.begin(), m_buffer.begin() + m_consumed);
+		m_consumed = 0;
+
+		bool endOfFile = false;
+		size_t searchStart = 0;
+		while (true)
+		{
+			//read more data
+			size_t previousSize = m_buffer.size();
+			qint64 toRead = std::max<qint64>(minSize, 1 << 16);
+			m_buffer.resize(previousSize + static_cast<size_t>(toRead));
+			qint64 readBytes = m_file->read(m_buffer.data() + previousSize, toRead);
+			if (readBytes < 0)
+			{
+				m_error = true;
+				return false;
+			}
+			m_buffer.resize(previousSize + static_cast<size_t>(readBytes));
+			endOfFile = (readBytes < toRead);
+
+			//look for the last end of line character
+			const char* data = m_buffer.data();
+			const char* lastLineEnd = 0;
+			for (const char* c = data + m_buffer.size(); c > data + searchStart; )
+			{
+				--c;
+				if (*c == '\n')
+				{
+					lastLineEnd = c;
+					break;
+				}
+			}
+
+			if (endOfFile)
+			{
+				m_consumed = m_buffer.size();
+				break;
+			}
+			else if (lastLineEnd)
+			{
+				m_consumed = static_cast<size_t>(lastLineEnd + 1 - data);
+				break;
+			}
+
+			//very long line: we need to read more
+			searchStart = m_buffer.size();
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		m_error = true;
+		return false;
+	}
+
+	if (m_consumed == 0)
+	{
+		m_pos = m_size;
+		return false;
+	}
+
+	begin = m_buffer.data();
+	end = begin + m_consumed;
+	m_pos += static_cast<qint64>(m_consumed);
+	return true;
+}
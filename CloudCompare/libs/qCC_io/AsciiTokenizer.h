@@ -0,0 +1,443 @@
+//##########################################################################
+//#                                                                        #
+//#                              CLOUDCOMPARE                              #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 or later of the License.      #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the          #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_ASCII_TOKENIZER_HEADER
+#define CC_ASCII_TOKENIZER_HEADER
+
+//local
+#include "qCC_io.h"
+
+//Qt
+#include <QtGlobal>
+
+//System
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+class QFile;
+
+//! In-place tokenizer for ASCII files
+/** Splits a line (typically inside a memory-mapped buffer, see AsciiFileReader)
+	into tokens without any allocation. Tokens are separated either by a given
+	character (empty tokens are skipped, as with QString::split(sep, QString::SkipEmptyParts))
+	or by any sequence of white spaces (as with QString::split(QRegExp("\\s+"))).
+
+	The static conversion methods follow the same rules as QString::toDouble,
+	toInt and toUInt (leading and trailing white spaces are ignored, and 0 is
+	returned if the token is invalid).
+**/
+class AsciiTokenizer
+{
+public:
+
+	//! Token (part of a line)
+	struct Token
+	{
+		const char* begin;
+		const char* end;
+
+		//! Returns the token length
+		inline size_t size() const { return static_cast<size_t>(end - begin); }
+		//! Returns whether the token is equal to a given (null-terminated) string
+		inline bool operator == (const char* str) const { size_t n = strlen(str); return size() == n && memcmp(begin, str, n) == 0; }
+		//! Returns whether the token starts with a given character
+		inline bool startsWith(char c) const { return begin != end && *begin == c; }
+
+		//! Converts the token to a double (see AsciiTokenizer::ToDouble)
+		inline bool toDouble(double& value) const { return ToDouble(begin, end, value); }
+		//! Converts the token to an integer (see AsciiTokenizer::ToInt)
+		inline bool toInt(int& value) const { return ToInt(begin, end, value); }
+		//! Converts the token to an unsigned integer (see AsciiTokenizer::ToUInt)
+		inline bool toUInt(unsigned& value) const { return ToUInt(begin, end, value); }
+	};
+
+	//! Default constructor
+	/** \param begin line start
+		\param end line end (end of line characters excluded)
+		\param separator separator character (or 0 for any white space)
+	**/
+	AsciiTokenizer(const char* begin, const char* end, char separator = 0)
+		: m_pos(begin)
+		, m_end(end)
+		, m_separator(separator)
+	{}
+
+	//! Extracts the next (non empty) token
+	/** \return false if there's no more token on the line
+	**/
+	inline bool next(Token& token)
+	{
+		if (m_separator == 0)
+		{
+			while (m_pos < m_end && IsBlank(*m_pos))
+				++m_pos;
+			if (m_pos == m_end)
+				return false;
+			token.begin = m_pos;
+			while (m_pos < m_end && !IsBlank(*m_pos))
+				++m_pos;
+			token.end = m_pos;
+			return true;
+		}
+
+		while (m_pos < m_end)
+		{
+			const char* tokenEnd = static_cast<const char*>(memchr(m_pos, m_separator, m_end - m_pos));
+			if (!tokenEnd)
+				tokenEnd = m_end;
+			token.begin = m_pos;
+			token.end = tokenEnd;
+			m_pos = (tokenEnd < m_end ? tokenEnd + 1 : m_end);
+			if (token.end != token.begin)
+				return true;
+		}
+		return false;
+	}
+
+	//! Extracts at most 'maxCount' tokens
+	/** \return the number of tokens extracted (if equal to 'maxCount', there may be more tokens on the line)
+	**/
+	inline int split(Token* tokens, int maxCount)
+	{
+		int count = 0;
+		while (count < maxCount && next(tokens[count]))
+			++count;
+		return count;
+	}
+
+	//! Returns the remaining part of the line
+	inline Token remaining() const { Token token = { m_pos, m_end }; return token; }
+
+	//! Extracts the next line of a buffer
+	/** \param[in,out] pos current position (moved to the beginning of the next line)
+		\param[in] end buffer end
+		\param[out] line the line (without the end of line characters)
+		\return false if the end of the buffer has been reached
+	**/
+	static inline bool NextLine(const char*& pos, const char* end, Token& line)
+	{
+		if (pos >= end)
+			return false;
+		const char* lineEnd = static_cast<const char*>(memchr(pos, '\n', end - pos));
+		line.begin = pos;
+		line.end = (lineEnd ? lineEnd : end);
+		pos = (lineEnd ? lineEnd + 1 : end);
+		if (line.end != line.begin && line.end[-1] == '\r')
+			--line.end;
+		return true;
+	}
+
+	//! Skips a given number of lines
+	/** \return the number of lines actually skipped
+	**/
+	static inline unsigned SkipLines(const char*& pos, const char* end, unsigned count)
+	{
+		unsigned skipped = 0;
+		while (skipped < count && pos < end)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(pos, '\n', end - pos));
+			pos = (lineEnd ? lineEnd + 1 : end);
+			++skipped;
+		}
+		return skipped;
+	}
+
+	//! Whether a character is a white space (see QString::trimmed)
+	static inline bool IsBlank(char c) { return (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f'); }
+
+	//! Whether a character is a decimal digit
+	static inline bool IsDigit(char c) { return (c >= '0' && c <= '9'); }
+
+	//! Removes the leading and trailing white spaces of a token
+	static inline void Trim(const char*& begin, const char*& end)
+	{
+		while (begin < end && IsBlank(*begin))
+			++begin;
+		while (end > begin && IsBlank(end[-1]))
+			--end;
+	}
+
+	//! Converts a token to a floating point number (same result as QString::toDouble)
+	/** Numbers with at most 19 significant digits and a small exponent (which covers
+		virtually all the values found in ASCII files) are converted exactly without
+		any allocation. The other ones are handed over to strtod.
+		\return false (and value = 0) if the token is not a valid number
+	**/
+	static inline bool ToDouble(const char* begin, const char* end, double& value)
+	{
+		static const double s_pow10[] = {	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,
+											1e8,  1e9,  1e10, 1e11, 1e12, 1e13, 1e14, 1e15,
+											1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+		value = 0;
+		Trim(begin, end);
+
+		const char* p = begin;
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = (*p == '-');
+			++p;
+		}
+
+		uint64_t mantissa = 0;
+		int significantDigits = 0;
+		int exponent = 0;
+		bool hasDigits = false;
+
+		//integer part
+		for (; p < end && IsDigit(*p); ++p)
+		{
+			hasDigits = true;
+			if (mantissa != 0 || *p != '0')
+			{
+				if (++significantDigits > 19)
+					return ToDoubleSlow(begin, end, value);
+				mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+			}
+		}
+
+		//decimal part
+		if (p < end && *p == '.')
+		{
+			for (++p; p < end && IsDigit(*p); ++p)
+			{
+				hasDigits = true;
+				if (mantissa != 0 || *p != '0')
+				{
+					if (++significantDigits > 19)
+						return ToDoubleSlow(begin, end, value);
+					mantissa = mantissa * 10 + static_cast<unsigned>(*p - '0');
+				}
+				--exponent;
+			}
+		}
+
+		if (!hasDigits)
+		{
+			//'inf', 'nan', or invalid token
+			return ToDoubleSlow(begin, end, value);
+		}
+
+		//exponent
+		if (p < end && (*p == 'e' || *p == 'E'))
+		{
+			++p;
+			bool negativeExp = false;
+			if (p < end && (*p == '-' || *p == '+'))
+			{
+				negativeExp = (*p == '-');
+				++p;
+			}
+			if (p == end || !IsDigit(*p))
+				return false;
+
+			int e = 0;
+			for (; p < end && IsDigit(*p); ++p)
+			{
+				if (e < 100000)
+					e = e * 10 + (*p - '0');
+			}
+			exponent += (negativeExp ? -e : e);
+		}
+
+		if (p != end)
+		{
+			//trailing characters
+			return false;
+		}
+
+		//exact conversion (both the mantissa and the power of 10 are exactly representable)
+		if ((mantissa >> 53) == 0 && exponent >= -22 && exponent <= 22)
+		{
+			double d = static_cast<double>(mantissa);
+			d = (exponent < 0 ? d / s_pow10[-exponent] : d * s_pow10[exponent]);
+			value = (negative ? -d : d);
+			return true;
+		}
+
+		return ToDoubleSlow(begin, end, value);
+	}
+
+	//! Converts a token to an integer (same result as QString::toInt)
+	/** \return false (and value = 0) if the token is not a valid integer
+	**/
+	static inline bool ToInt(const char* begin, const char* end, int& value)
+	{
+		value = 0;
+		Trim(begin, end);
+
+		const char* p = begin;
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = (*p == '-');
+			++p;
+		}
+		if (p == end)
+			return false;
+
+		int64_t i = 0;
+		for (; p < end; ++p)
+		{
+			if (!IsDigit(*p))
+				return false;
+			i = i * 10 + (*p - '0');
+			if (i > static_cast<int64_t>(INT_MAX) + 1)
+				return false;
+		}
+		if (negative)
+			i = -i;
+		if (i < INT_MIN || i > INT_MAX)
+			return false;
+
+		value = static_cast<int>(i);
+		return true;
+	}
+
+	//! Converts a token to an unsigned integer (same result as QString::toUInt)
+	/** \return false (and value = 0) if the token is not a valid unsigned integer
+	**/
+	static inline bool ToUInt(const char* begin, const char* end, unsigned& value)
+	{
+		value = 0;
+		Trim(begin, end);
+
+		const char* p = begin;
+		if (p < end && *p == '+')
+			++p;
+		if (p == end)
+			return false;
+
+		uint64_t i = 0;
+		for (; p < end; ++p)
+		{
+			if (!IsDigit(*p))
+				return false;
+			i = i * 10 + static_cast<unsigned>(*p - '0');
+			if (i > UINT_MAX)
+				return false;
+		}
+
+		value = static_cast<unsigned>(i);
+		return true;
+	}
+
+protected:
+
+	//! Converts a (trimmed) token to a floating point number with strtod (slow path)
+	static inline bool ToDoubleSlow(const char* begin, const char* end, double& value)
+	{
+		value = 0;
+
+		size_t length = static_cast<size_t>(end - begin);
+		if (length == 0)
+			return false;
+
+		//hexadecimal values are not accepted by QString::toDouble
+		if (memchr(begin, 'x', length) || memchr(begin, 'X', length))
+			return false;
+
+		//strtod needs a null-terminated string (long tokens are copied on the heap)
+		char localBuffer[64];
+		std::string heapBuffer;
+		const char* buffer = localBuffer;
+		if (length < sizeof(localBuffer))
+		{
+			memcpy(localBuffer, begin, length);
+			localBuffer[length] = 0;
+		}
+		else
+		{
+			heapBuffer.assign(begin, length);
+			buffer = heapBuffer.c_str();
+		}
+
+		char* parsedEnd = 0;
+		double d = strtod(buffer, &parsedEnd);
+		if (parsedEnd != buffer + length)
+			return false;
+
+		value = d;
+		return true;
+	}
+
+	//! Current position
+	const char* m_pos;
+	//! Line end
+	const char* m_end;
+	//! Separator (0 = any white space)
+	char m_separator;
+};
+
+//! Reads an ASCII file by pieces of complete lines
+/** The file is memory-mapped if possible. Otherwise it is read piece by piece
+	in an internal buffer. In both cases, the returned pieces can be parsed in
+	place (e.g. with AsciiTokenizer) until the next call to 'next'.
+**/
+class QCC_IO_LIB_API AsciiFileReader
+{
+public:
+
+	//! Default constructor
+	AsciiFileReader();
+
+	//! Starts reading a file (already opened in read mode)
+	/** \return false if the file is empty
+	**/
+	bool open(QFile& file);
+
+	//! Returns the next piece of complete lines
+	/** \param minSize minimum piece size (in bytes - the last piece may be smaller)
+		\param[out] begin piece start
+		\param[out] end piece end (after the last end of line character, or end of file)
+		\return false if the end of the file has been reached, or if an error occurred (see 'error')
+	**/
+	bool next(qint64 minSize, const char*& begin, const char*& end);
+
+	//! Returns the position of the next piece in the file (in bytes)
+	inline qint64 pos() const { return m_pos; }
+	//! Returns the file size (in bytes)
+	inline qint64 size() const { return m_size; }
+	//! Returns whether the file is memory-mapped
+	inline bool isMapped() const { return m_mapped != 0; }
+	//! Returns whether an error occurred (reading error or not enough memory)
+	inline bool error() const { return m_error; }
+
+protected:
+
+	//! File
+	QFile* m_file;
+	//! Memory-mapped file content (if any)
+	const char* m_mapped;
+	//! File size
+	qint64 m_size;
+	//! Position of the next piece
+	qint64 m_pos;
+	//! Buffer (if the file is not memory-mapped)
+	std::vector<char> m_buffer;
+	//! Number of bytes of the buffer returned by the last call to 'next'
+	size_t m_consumed;
+	//! Whether an error occurred
+	bool m_error;
+};
+
+#endif //CC_ASCII_TOKENIZER_HEADER
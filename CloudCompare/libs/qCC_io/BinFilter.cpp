@@ -22,9 +22,11 @@
 #include <QApplication>
 #include <QFileInfo>
 #include <QtConcurrentRun>
+#include <QSharedPointer>
 
 //CCLib
 #include <ScalarField.h>
+#include <CloudSamplingTools.h>
 
 //qCC_db
 #include <ccFlags.h>
@@ -149,6 +151,77 @@ CC_FILE_ERROR _SaveFileV2()
 	return (s_file && s_container ? BinFilter::SaveFileV2(*s_file,s_container) : CC_FERR_BAD_ARGUMENT);
 }
 
+//! Returns all the point clouds of a tree (including its root)
+static void GetPointClouds(ccHObject* root, ccHObject::Container& clouds)
+{
+	if (root->isKindOf(CC_TYPES::POINT_CLOUD))
+	{
+		clouds.push_back(root);
+	}
+	root->filterChildren(clouds, true, CC_TYPES::POINT_CLOUD);
+}
+
+//! Saves the octrees of the clouds of a tree as cache files next to a BIN file
+/** Previous cache files (associated to the same BIN file) are removed.
+**/
+static void SaveOctreeCaches(ccHObject* root, const QString& filename)
+{
+	QFileInfo fi(filename);
+	QStringList previousCaches = ccOctree::GetCacheFiles(filename);
+	for (int i = 0; i < previousCaches.size(); ++i)
+	{
+		QFile::remove(previousCaches[i]);
+	}
+
+	ccHObject::Container clouds;
+	GetPointClouds(root, clouds);
+	for (size_t i = 0; i < clouds.size(); ++i)
+	{
+		ccGenericPointCloud* cloud = ccHObjectCaster::ToGenericPointCloud(clouds[i]);
+		ccOctree::Shared octree = (cloud ? cloud->getOctree() : ccOctree::Shared(0));
+		if (!octree)
+			continue;
+
+		quint64 hash = ccOctree::ComputeCloudHash(cloud);
+		if (octree->saveToCacheFile(ccOctree::GetCacheFilename(fi.absoluteFilePath(), hash), hash))
+		{
+			ccLog::Print(QString("[BIN] Octree of cloud '%1' saved in cache").arg(cloud->getName()));
+		}
+	}
+}
+
+//! Restores the octrees of the clouds of a tree from the cache files stored next to a BIN file
+static void LoadOctreeCaches(ccHObject& container, const QString& filename)
+{
+	QFileInfo fi(filename);
+	if (ccOctree::GetCacheFiles(filename).empty())
+	{
+		//no cache file (we don't need to compute the clouds hash)
+		return;
+	}
+
+	ccHObject::Container clouds;
+	GetPointClouds(&container, clouds);
+	for (size_t i = 0; i < clouds.size(); ++i)
+	{
+		ccGenericPointCloud* cloud = ccHObjectCaster::ToGenericPointCloud(clouds[i]);
+		if (!cloud || cloud->size() == 0 || cloud->getOctree())
+			continue;
+
+		quint64 hash = ccOctree::ComputeCloudHash(cloud);
+		QString cacheFilename = ccOctree::GetCacheFilename(fi.absoluteFilePath(), hash);
+		if (!QFile::exists(cacheFilename))
+			continue;
+
+		ccOctree::Shared octree(new ccOctree(cloud));
+		if (octree->loadFromCacheFile(cacheFilename, hash))
+		{
+			cloud->setOctree(octree);
+			ccLog::Print(QString("[BIN] Octree of cloud '%1' restored from cache").arg(cloud->getName()));
+		}
+	}
+}
+
 CC_FILE_ERROR BinFilter::saveToFile(ccHObject* root, QString filename, SaveParameters& parameters)
 {
 	if (!root || filename.isNull())
@@ -193,6 +266,11 @@ CC_FILE_ERROR BinFilter::saveToFile(ccHObject* root, QString filename, SaveParam
 
 	CC_FILE_ERROR result = future.result();
 
+	if (result == CC_FERR_NO_ERROR)
+	{
+		SaveOctreeCaches(root, filename);
+	}
+
 	return result;
 }
 
@@ -357,6 +435,8 @@ CC_FILE_ERROR BinFilter::loadFile(QString filename, ccHObject& container, LoadPa
 			}
 		}
 
+		CC_FILE_ERROR result = CC_FERR_NO_ERROR;
+
 		//if (sizeof(PointCoordinateType) == 8 && strncmp((char*)&firstBytes,"CCB3",4) != 0)
 		//{
 		//	QMessageBox::information(0, QString("Wrong version"), QString("This file has been generated with the standard 'float' version!\nAt this time it cannot be read with the 'double' version."),QMessageBox::Ok);
@@ -404,12 +484,19 @@ CC_FILE_ERROR BinFilter::loadFile(QString filename, ccHObject& container, LoadPa
 			s_file = 0;
 			s_container = 0;
 
-			return future.result();
+			result = future.result();
 		}
 		else
 		{
-			return BinFilter::LoadFileV2(in, container, flags);
+			result = BinFilter::LoadFileV2(in, container, flags);
 		}
+
+		if (result == CC_FERR_NO_ERROR)
+		{
+			LoadOctreeCaches(container, filename);
+		}
+
+		return result;
 	}
 }
 
@@ -1021,6 +1108,20 @@ CC_FILE_ERROR BinFilter::LoadFileV2(QFile& in, ccHObject& container, int flags)
 	return result;
 }
 
+//! Reservation step for the clouds subsampled at loading time
+static const unsigned c_subsampledCloudReserveStep = 1 << 20;
+
+//! Enlarges a cloud being loaded (V1 files)
+static bool ReserveMorePoints(ccPointCloud* cloud, unsigned newCapacity)
+{
+	if (!cloud->reserve(newCapacity))
+		return false;
+
+	//the scalar field values are set (not added)
+	CCLib::ScalarField* sf = cloud->getCurrentInScalarField();
+	return (!sf || sf->resize(newCapacity));
+}
+
 CC_FILE_ERROR BinFilter::LoadFileV1(QFile& in, ccHObject& container, unsigned nbScansTotal, const LoadParameters& parameters)
 {
 	ccLog::Print("[BIN] Version 1.0");
@@ -1119,7 +1220,14 @@ CC_FILE_ERROR BinFilter::LoadFileV1(QFile& in, ccHObject& container, unsigned nb
 		unsigned fileChunkPos = 0;
 		unsigned fileChunkSize = std::min(nbOfPoints,CC_MAX_NUMBER_OF_POINTS_PER_CLOUD);
 
-		loadedCloud->reserveThePointsTable(fileChunkSize);
+		//spatial subsampling at loading time (the memory then only depends on the number of kept points)
+		QSharedPointer<CCLib::SpatialStreamSampler> sampler;
+		if (parameters.spatialSubsamplingStep > 0)
+		{
+			sampler = QSharedPointer<CCLib::SpatialStreamSampler>(new CCLib::SpatialStreamSampler(parameters.spatialSubsamplingStep));
+		}
+
+		loadedCloud->reserveThePointsTable(sampler ? std::min(fileChunkSize, c_subsampledCloudReserveStep) : fileChunkSize);
 		if (header.colors)
 		{
 			loadedCloud->reserveTheRGBTable();
@@ -1143,6 +1251,8 @@ CC_FILE_ERROR BinFilter::LoadFileV1(QFile& in, ccHObject& container, unsigned nb
 		{
 			if (lineRead == fileChunkPos+fileChunkSize)
 			{
+				if (sampler)
+					loadedCloud->resize(loadedCloud->size());
 				if (header.scalarField)
 					loadedCloud->getCurrentInScalarField()->computeMinAndMax();
 
@@ -1153,7 +1263,7 @@ CC_FILE_ERROR BinFilter::LoadFileV1(QFile& in, ccHObject& container, unsigned nb
 				++parts;
 				sprintf(partName,"%s.part_%i",cloudName,parts);
 				loadedCloud = new ccPointCloud(partName);
-				loadedCloud->reserveThePointsTable(fileChunkSize);
+				loadedCloud->reserveThePointsTable(sampler ? std::min(fileChunkSize, c_subsampledCloudReserveStep) : fileChunkSize);
 
 				if (header.colors)
 				{
@@ -1175,47 +1285,70 @@ CC_FILE_ERROR BinFilter::LoadFileV1(QFile& in, ccHObject& container, unsigned nb
 				//Console::print("[BinFilter::loadModelFromBinaryFile] Error reading the %ith entity point !\n",k);
 				return CC_FERR_READING;
 			}
-			loadedCloud->addPoint(CCVector3::fromArray(Pf));
+			CCVector3 P = CCVector3::fromArray(Pf);
 
+			unsigned char C[3];
 			if (header.colors)
 			{
-				unsigned char C[3];
 				if (in.read((char*)C,sizeof(ColorCompType)*3) < 0)
 				{
 					//Console::print("[BinFilter::loadModelFromBinaryFile] Error reading the %ith entity colors !\n",k);
 					return CC_FERR_READING;
 				}
-				loadedCloud->addRGBColor(C);
 			}
 
+			CCVector3 N;
 			if (header.normals)
 			{
-				CCVector3 N;
 				if (in.read((char*)N.u,sizeof(float)*3) < 0)
 				{
 					//Console::print("[BinFilter::loadModelFromBinaryFile] Error reading the %ith entity norms !\n",k);
 					return CC_FERR_READING;
 				}
-				loadedCloud->addNorm(N);
 			}
 
+			double D = 0;
 			if (header.scalarField)
 			{
-				double D;
 				if (in.read((char*)&D,sizeof(double)) < 0)
 				{
 					//Console::print("[BinFilter::loadModelFromBinaryFile] Error reading the %ith entity distance!\n",k);
 					return CC_FERR_READING;
 				}
-				ScalarType d = static_cast<ScalarType>(D);
-				loadedCloud->setPointScalarValue(i,d);
+			}
+
+			//points too close to an already loaded point are skipped
+			bool keepPoint = true;
+			if (sampler)
+			{
+				CCLib::SpatialStreamSampler::Result sampling = sampler->addPoint(P);
+				if (	sampling == CCLib::SpatialStreamSampler::NOT_ENOUGH_MEMORY
+					||	(	sampling == CCLib::SpatialStreamSampler::KEPT
+						&&	loadedCloud->size() == loadedCloud->capacity()
+						&&	!ReserveMorePoints(loadedCloud, std::min(loadedCloud->capacity() + c_subsampledCloudReserveStep, fileChunkSize))))
+				{
+					delete loadedCloud;
+					return CC_FERR_NOT_ENOUGH_MEMORY;
+				}
+				keepPoint = (sampling == CCLib::SpatialStreamSampler::KEPT);
+			}
+
+			if (keepPoint)
+			{
+				loadedCloud->addPoint(P);
+				if (header.colors)
+					loadedCloud->addRGBColor(C);
+				if (header.normals)
+					loadedCloud->addNorm(N);
+				if (header.scalarField)
+					loadedCloud->setPointScalarValue(loadedCloud->size()-1, static_cast<ScalarType>(D));
 			}
 
 			lineRead++;
 
 			if (parameters.alwaysDisplayLoadDialog && !nprogress.oneStep())
 			{
-				loadedCloud->resize(i+1-fileChunkPos);
+				loadedCloud->resize(loadedCloud->size());
 				k=nbScansTotal;
 				i=nbOfPoints;
 			}
@@ -1227,6 +1360,13 @@ CC_FILE_ERROR BinFilter::LoadFileV1(QFile& in, ccHObject& container, unsigned nb
 			QApplication::processEvents();
 		}
 
+		if (sampler)
+		{
+			//remove the unused (reserved) memory
+			loadedCloud->resize(loadedCloud->size());
+			ccLog::Print(QString("[BIN] Spatial subsampling on load (step = %1): %2 points kept out of %3").arg(sampler->minDistance()).arg(sampler->size()).arg(nbOfPoints));
+		}
+
 		if (header.scalarField)
 		{
 			CCLib::ScalarField* sf = loadedCloud->getCurrentInScalarField();
@@ -44,10 +44,21 @@
 #include <QMap>
 #include <QUuid>
 #include <QBuffer>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QtConcurrentMap>
 
 //system
 #include <string.h>
 #include <assert.h>
+#if defined(CC_WINDOWS)
+#include <windows.h>
+#else
+#include <time.h>
+#include <unistd.h>
+#endif
 
 typedef double colorFieldType;
 //typedef boost::uint16_t colorFieldType;
@@ -1329,22 +1340,336 @@ static ScalarType s_minIntensity = 0;
 //for coordinate shift handling
 FileIOFilter::LoadParameters s_loadParameters;
 
-ccHObject* LoadScan(e57::Node& node, QString& guidStr, ccProgressDialog* progressDlg = 0)
+//! Registers the normals extension (if necessary)
+static void RegisterNormalsExtension(e57::ImageFile& imf)
+{
+	static const e57::ustring normalsExtension("http://www.libe57.org/E57_NOR_surface_normals.txt");
+	e57::ustring _normalsExtension;
+	if (!imf.extensionsLookupPrefix("nor", _normalsExtension)) //the extension may already be registered
+	{
+		imf.extensionsAdd("nor", normalsExtension);
+	}
+}
+
+//! Scan loading job
+/** Scans are prepared sequentially (header decoding, memory allocation,
+	global shift handling) then their points are read concurrently.
+**/
+struct E57ScanJob
+{
+	E57ScanJob()
+		: index(0)
+		, sphericalMode(false)
+		, pointCount(0)
+		, chunkSize(0)
+		, validPoseMat(false)
+		, Pshift(0,0,0)
+		, cloud(0)
+		, intensitySF(0)
+		, returnIndexSF(0)
+		, hasNormals(false)
+		, hasColors(false)
+		, realCount(0)
+		, validIntensityCount(0)
+		, minIntensity(0)
+		, maxIntensity(0)
+		, readTime_s(0)
+		, processed(false)
+	{
+		for (unsigned c=0; c<3; ++c)
+		{
+			colorOffset[c] = 0;
+			colorRange[c] = 1.0;
+		}
+	}
+
+	//! Scan index (in 'data3D')
+	unsigned index;
+	//! Scan node name
+	QString nodeName;
+	//! Scan GUID
+	QString guid;
+	//! Scan header
+	E57ScanHeader header;
+	//! Whether points are defined by spherical coordinates
+	bool sphericalMode;
+	//! Number of points (as declared in the file)
+	boost::int64_t pointCount;
+	//! Number of points read at once
+	unsigned chunkSize;
+	//! Scan pose
+	ccGLMatrixd poseMat;
+	//! Whether the scan pose is valid
+	bool validPoseMat;
+	//! Shift applied to the points (if the pose hasn't been shifted)
+	CCVector3d Pshift;
+
+	//! Output cloud
+	ccPointCloud* cloud;
+	//! Intensity field (if any)
+	ccScalarField* intensitySF;
+	//! Return index field (if any)
+	ccScalarField* returnIndexSF;
+	//! Whether the scan has normals
+	bool hasNormals;
+	//! Whether the scan has colors
+	bool hasColors;
+	//! Color offsets (red, green, blue)
+	double colorOffset[3];
+	//! Color ranges (red, green, blue)
+	double colorRange[3];
+
+	//! Number of (valid) points actually read
+	boost::int64_t realCount;
+	//! Number of valid intensity values
+	boost::int64_t validIntensityCount;
+	//! Min intensity value
+	ScalarType minIntensity;
+	//! Max intensity value
+	ScalarType maxIntensity;
+	//! Time spent reading the points (in seconds)
+	double readTime_s;
+	//! Whether the points have been read
+	bool processed;
+	//! Error message (if any)
+	QString errorMessage;
+};
+
+//! Returns the number of chunks necessary to read a scan
+static inline int ChunkCount(const E57ScanJob& job)
+{
+	return job.chunkSize != 0 ? static_cast<int>((job.pointCount + job.chunkSize - 1) / job.chunkSize) : 0;
+}
+
+//! Prepares the buffers to read the points of a scan
+/** \param imf image file used to read the points
+	\param prototype points prototype
+	\param job scan job
+	\param chunkSize number of points read at once
+	\param coordinatesOnly whether to only read coordinates (and validity) or all the supported fields
+	\param arrays output arrays
+	\param dbufs output buffers
+**/
+static void SetupPointBuffers(	e57::ImageFile& imf,
+								e57::StructureNode& prototype,
+								const E57ScanJob& job,
+								unsigned chunkSize,
+								bool coordinatesOnly,
+								TempArrays& arrays,
+								std::vector<e57::SourceDestBuffer>& dbufs)
+{
+	const E57ScanHeader& header = job.header;
+
+	if (job.sphericalMode)
+	{
+		//spherical coordinates
+		if (header.pointFields.sphericalRangeField)
+		{
+			arrays.xData.resize(chunkSize);
+			dbufs.push_back(e57::SourceDestBuffer(imf, "sphericalRange", &(arrays.xData.front()), chunkSize, true, (prototype.get("sphericalRange").type() == e57::E57_SCALED_INTEGER)));
+		}
+		if (header.pointFields.sphericalAzimuthField)
+		{
+			arrays.yData.resize(chunkSize);
+			dbufs.push_back(e57::SourceDestBuffer(imf, "sphericalAzimuth", &(arrays.yData.front()), chunkSize, true, (prototype.get("sphericalAzimuth").type() == e57::E57_SCALED_INTEGER)));
+		}
+		if (header.pointFields.sphericalElevationField)
+		{
+			arrays.zData.resize(chunkSize);
+			dbufs.push_back(e57::SourceDestBuffer(imf, "sphericalElevation", &(arrays.zData.front()), chunkSize, true, (prototype.get("sphericalElevation").type() == e57::E57_SCALED_INTEGER)));
+		}
+
+		//data validity
+		if (header.pointFields.sphericalInvalidStateField)
+		{
+			arrays.isInvalidData.resize(chunkSize);
+			dbufs.push_back(e57::SourceDestBuffer(imf, "sphericalInvalidState", &(arrays.isInvalidData.front()), chunkSize, true, (prototype.get("sphericalInvalidState").type() == e57::E57_SCALED_INTEGER)));
+		}
+	}
+	else
+	{
+		//cartesian coordinates
+		if (header.pointFields.cartesianXField)
+		{
+			arrays.xData.resize(chunkSize);
+			dbufs.push_back(e57::SourceDestBuffer(imf, "cartesianX", &(arrays.xData.front()), chunkSize, true, (prototype.get("cartesianX").type() == e57::E57_SCALED_INTEGER)));
+		}
+		if (header.pointFields.cartesianYField)
+		{
+			arrays.yData.resize(chunkSize);
+			dbufs.push_back(e57::SourceDestBuffer(imf, "cartesianY", &(arrays.yData.front()), chunkSize, true, (prototype.get("cartesianY").type() == e57::E57_SCALED_INTEGER)));
+		}
+		if (header.pointFields.cartesianZField)
+		{
+			arrays.zData.resize(chunkSize);
+			dbufs.push_back(e57::SourceDestBuffer(imf, "cartesianZ", &(arrays.zData.front()), chunkSize, true, (prototype.get("cartesianZ").type() == e57::E57_SCALED_INTEGER)));
+		}
+
+		//data validity
+		if ( header.pointFields.cartesianInvalidStateField)
+		{
+			arrays.isInvalidData.resize(chunkSize);
+			dbufs.push_back(e57::SourceDestBuffer(imf, "cartesianInvalidState", &(arrays.isInvalidData.front()), chunkSize, true, (prototype.get("cartesianInvalidState").type() == e57::E57_SCALED_INTEGER)));
+		}
+	}
+
+	if (coordinatesOnly)
+		return;
+
+	//normals
+	if (job.hasNormals)
+	{
+		if (header.pointFields.normXField)
+		{
+			arrays.xNormData.resize(chunkSize);
+			dbufs.push_back(e57::SourceDestBuffer(imf, "nor:normalX", &(arrays.xNormData.front()), chunkSize, true, (prototype.get("nor:normalX").type() == e57::E57_SCALED_INTEGER)));
+		}
+		if (header.pointFields.normYField)
+		{
+			arrays.yNormData.resize(chunkSize);
+			dbufs.push_back(e57::SourceDestBuffer(imf, "nor:normalY", &(arrays.yNormData.front()), chunkSize, true, (prototype.get("nor:normalY").type() == e57::E57_SCALED_INTEGER)));
+		}
+		if (header.pointFields.normZField)
+		{
+			arrays.zNormData.resize(chunkSize);
+			dbufs.push_back(e57::SourceDestBuffer(imf, "nor:normalZ", &(arrays.zNormData.front()), chunkSize, true, (prototype.get("nor:normalZ").type() == e57::E57_SCALED_INTEGER)));
+		}
+	}
+
+	//intensity
+	if (job.intensitySF)
+	{
+		arrays.intData.resize(chunkSize);
+		dbufs.push_back(e57::SourceDestBuffer(imf, "intensity", &(arrays.intData.front()), chunkSize, true, (prototype.get("intensity").type() == e57::E57_SCALED_INTEGER)));
+
+		if (header.pointFields.isIntensityInvalidField)
+		{
+			arrays.isInvalidIntData.resize(chunkSize);
+			dbufs.push_back(e57::SourceDestBuffer(imf, "isIntensityInvalid", &(arrays.isInvalidIntData.front()), chunkSize, true, (prototype.get("isIntensityInvalid").type() == e57::E57_SCALED_INTEGER)));
+		}
+	}
+
+	//colors
+	if (job.hasColors)
+	{
+		if (header.pointFields.colorRedField)
+		{
+			arrays.redData.resize(chunkSize);
+			dbufs.push_back(e57::SourceDestBuffer(imf, "colorRed", &(arrays.redData.front()), chunkSize, true, (prototype.get("colorRed").type() == e57::E57_SCALED_INTEGER)));
+		}
+		if (header.pointFields.colorGreenField)
+		{
+			arrays.greenData.resize(chunkSize);
+			dbufs.push_back(e57::SourceDestBuffer(imf, "colorGreen", &(arrays.greenData.front()), chunkSize, true, (prototype.get("colorGreen").type() == e57::E57_SCALED_INTEGER)));
+		}
+		if (header.pointFields.colorBlueField)
+		{
+			arrays.blueData.resize(chunkSize);
+			dbufs.push_back(e57::SourceDestBuffer(imf, "colorBlue", &(arrays.blueData.front()), chunkSize, true, (prototype.get("colorBlue").type() == e57::E57_SCALED_INTEGER)));
+		}
+	}
+
+	//return index
+	if (job.returnIndexSF)
+	{
+		arrays.scanIndexData.resize(chunkSize);
+		dbufs.push_back(e57::SourceDestBuffer(imf, "returnIndex", &(arrays.scanIndexData.front()), chunkSize, true, (prototype.get("returnIndex").type() == e57::E57_SCALED_INTEGER)));
+	}
+}
+
+//! Returns the (local) coordinates of a point
+static inline CCVector3d GetPoint(const TempArrays& arrays, unsigned i, bool sphericalMode)
+{
+	CCVector3d Pd(0,0,0);
+	if (sphericalMode)
+	{
+		double r = (arrays.xData.empty() ? 0 : arrays.xData[i]);
+		double theta = (arrays.yData.empty() ? 0 : arrays.yData[i]);	//Azimuth
+		double phi = (arrays.zData.empty() ? 0 : arrays.zData[i]);		//Elevation
+
+		double cos_phi = cos(phi);
+		Pd.x = r * cos_phi * cos(theta);
+		Pd.y = r * cos_phi * sin(theta);
+		Pd.z = r * sin(phi);
+	}
+	//DGM TODO: not handled yet (-->what are the standard cylindrical field names?)
+	/*else if (cylindricalMode)
+	{
+		//from cylindrical coordinates
+		assert(arrays.xData);
+		double theta = (arrays.yData ? arrays.yData[i] : 0);
+		Pd.x = arrays.xData[i] * cos(theta);
+		Pd.y = arrays.xData[i] * sin(theta);
+		if (arrays.zData)
+			Pd.z = arrays.zData[i];
+	}
+	//*/
+	else //cartesian
+	{
+		if (!arrays.xData.empty())
+			Pd.x = arrays.xData[i];
+		if (!arrays.yData.empty())
+			Pd.y = arrays.yData[i];
+		if (!arrays.zData.empty())
+			Pd.z = arrays.zData[i];
+	}
+
+	return Pd;
+}
+
+//! Reads the first valid point of a scan (for global shift handling)
+static bool ReadFirstValidPoint(e57::ImageFile& imf, e57::CompressedVectorNode& points, const E57ScanJob& job, CCVector3d& P)
+{
+	static const unsigned c_firstPointChunkSize = 1024;
+	unsigned chunkSize = std::min<unsigned>(job.chunkSize, c_firstPointChunkSize);
+
+	e57::StructureNode prototype(points.prototype());
+	TempArrays arrays;
+	std::vector<e57::SourceDestBuffer> dbufs;
+	SetupPointBuffers(imf, prototype, job, chunkSize, true, arrays, dbufs);
+
+	e57::CompressedVectorReader dataReader = points.reader(dbufs);
+	bool found = false;
+	unsigned size = 0;
+	while (!found && (size = dataReader.read()))
+	{
+		for (unsigned i=0; i<size; i++)
+		{
+			//we skip invalid points!
+			if (arrays.isInvalidData.empty() || arrays.isInvalidData[i] == 0)
+			{
+				P = GetPoint(arrays, i, job.sphericalMode);
+				found = true;
+				break;
+			}
+		}
+	}
+	dataReader.close();
+
+	return found;
+}
+
+//! Prepares a scan for loading (header decoding, memory allocation, global shift handling)
+/** Must be called from the main thread (the global shift may be asked to the user).
+	\return success (otherwise the scan should be skipped)
+**/
+static bool PrepareScan(e57::Node& node, E57ScanJob& job)
 {
 	if (node.type() != e57::E57_STRUCTURE)
 	{
 		ccLog::Warning("[E57Filter] Scan nodes should be STRUCTURES!");
-		return 0;
+		return false;
 	}
 	e57::StructureNode scanNode(node);
+	job.nodeName = QString(scanNode.elementName().c_str());
 
 	//log
-	ccLog::Print(QString("[E57] Reading new scan node (%1)").arg(scanNode.elementName().c_str()));
+	ccLog::Print(QString("[E57] Reading new scan node (%1)").arg(job.nodeName));
 
 	if (!scanNode.isDefined("points"))
 	{
-		ccLog::Warning(QString("[E57Filter] No point in scan '%1'!").arg(scanNode.elementName().c_str()));
-		return 0;
+		ccLog::Warning(QString("[E57Filter] No point in scan '%1'!").arg(job.nodeName));
+		return false;
 	}
 
 	//unique GUID
@@ -1352,24 +1677,24 @@ ccHObject* LoadScan(e57::Node& node, QString& guidStr, ccProgressDialog* progres
 	{
 		e57::Node guidNode = scanNode.get("guid");
 		assert(guidNode.type() == e57::E57_STRING);
-		guidStr = QString(static_cast<e57::StringNode>(guidNode).value().c_str());
+		job.guid = QString(static_cast<e57::StringNode>(guidNode).value().c_str());
 	}
 	else
 	{
 		//No GUID!
-		guidStr.clear();
+		job.guid.clear();
 	}
 
 	//points
 	e57::CompressedVectorNode points(scanNode.get("points"));
-	boost::int64_t pointCount = points.childCount();
+	job.pointCount = points.childCount();
 	
 	//prototype for points
 	e57::StructureNode prototype(points.prototype());
-	E57ScanHeader header;
+	E57ScanHeader& header = job.header;
 	DecodePrototype(scanNode, prototype, header);
 
-	bool sphericalMode = false;
+	job.sphericalMode = false;
 	//no cartesian fields?
 	if (!header.pointFields.cartesianXField &&
 		!header.pointFields.cartesianYField && 
@@ -1380,10 +1705,16 @@ ccHObject* LoadScan(e57::Node& node, QString& guidStr, ccProgressDialog* progres
 			!header.pointFields.sphericalAzimuthField &&
 			!header.pointFields.sphericalElevationField)
 		{
-			ccLog::Warning(QString("[E57Filter] No readable point in scan '%1'! (only cartesian and spherical coordinates are supported right now)").arg(scanNode.elementName().c_str()));
-			return 0;
+			ccLog::Warning(QString("[E57Filter] No readable point in scan '%1'! (only cartesian and spherical coordinates are supported right now)").arg(job.nodeName));
+			return false;
 		}
-		sphericalMode = true;
+		job.sphericalMode = true;
+	}
+
+	if (job.pointCount <= 0)
+	{
+		ccLog::Warning(QString("[E57] No valid point in scan '%1'!").arg(job.nodeName));
+		return false;
 	}
 
 	ccPointCloud* cloud = new ccPointCloud();
@@ -1413,404 +1744,422 @@ ccHObject* LoadScan(e57::Node& node, QString& guidStr, ccProgressDialog* progres
 	//*/
 
 	//scan "pose" relatively to the others
-	ccGLMatrixd poseMat;
-	bool validPoseMat = GetPoseInformation(scanNode, poseMat);
+	job.validPoseMat = GetPoseInformation(scanNode, job.poseMat);
 	bool poseMatWasShifted = false;
 
-	if (validPoseMat)
+	if (job.validPoseMat)
 	{
-		CCVector3d T = poseMat.getTranslationAsVec3D();
+		CCVector3d T = job.poseMat.getTranslationAsVec3D();
 		CCVector3d Tshift;
 		if (FileIOFilter::HandleGlobalShift(T, Tshift, s_loadParameters))
 		{
 			cloud->setGlobalShift(Tshift);
-			poseMat.setTranslation((T + Tshift).u);
+			job.poseMat.setTranslation((T + Tshift).u);
 			poseMatWasShifted = true;
-			ccLog::Warning("[E57Filter::loadFile] Cloud %s has been recentered! Translation: (%.2f,%.2f,%.2f)", qPrintable(guidStr), Tshift.x, Tshift.y, Tshift.z);
+			ccLog::Warning("[E57Filter::loadFile] Cloud %s has been recentered! Translation: (%.2f,%.2f,%.2f)", qPrintable(job.guid), Tshift.x, Tshift.y, Tshift.z);
 		}
 
 		//cloud->setGLTransformation(poseMat); //TODO-> apply it at the end instead! Otherwise we will loose original coordinates!
 	}
 
-	//prepare temporary structures
-	const unsigned chunkSize = std::min<unsigned>(pointCount,(1 << 20)); //we load the file in several steps to limit the memory consumption
-	TempArrays arrays;
-	std::vector<e57::SourceDestBuffer> dbufs;
+	//we load the file in several steps to limit the memory consumption
+	job.chunkSize = static_cast<unsigned>(std::min<boost::int64_t>(job.pointCount, (1 << 20)));
 
-	if (!cloud->reserve(static_cast<unsigned>(pointCount)))
+	if (!cloud->reserve(static_cast<unsigned>(job.pointCount)))
 	{
 		ccLog::Error("[E57] Not enough memory!");
 		delete cloud;
-		return 0;
-	}
-
-	if (sphericalMode)
-	{
-		//spherical coordinates
-		if (header.pointFields.sphericalRangeField)
-		{
-			arrays.xData.resize(chunkSize);
-			dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "sphericalRange", &(arrays.xData.front()), chunkSize, true, (prototype.get("sphericalRange").type() == e57::E57_SCALED_INTEGER)));
-		}
-		if (header.pointFields.sphericalAzimuthField)
-		{
-			arrays.yData.resize(chunkSize);
-			dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "sphericalAzimuth", &(arrays.yData.front()), chunkSize, true, (prototype.get("sphericalAzimuth").type() == e57::E57_SCALED_INTEGER)));
-		}
-		if (header.pointFields.sphericalElevationField)
-		{
-			arrays.zData.resize(chunkSize);
-			dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "sphericalElevation", &(arrays.zData.front()), chunkSize, true, (prototype.get("sphericalElevation").type() == e57::E57_SCALED_INTEGER)));
-		}
-
-		//data validity
-		if (header.pointFields.sphericalInvalidStateField)
-		{
-			arrays.isInvalidData.resize(chunkSize);
-			dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "sphericalInvalidState", &(arrays.isInvalidData.front()), chunkSize, true, (prototype.get("sphericalInvalidState").type() == e57::E57_SCALED_INTEGER)));
-		}
-	}
-	else
-	{
-		//cartesian coordinates
-		if (header.pointFields.cartesianXField)
-		{
-			arrays.xData.resize(chunkSize);
-			dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "cartesianX", &(arrays.xData.front()), chunkSize, true, (prototype.get("cartesianX").type() == e57::E57_SCALED_INTEGER)));
-		}
-		if (header.pointFields.cartesianYField)
-		{
-			arrays.yData.resize(chunkSize);
-			dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "cartesianY", &(arrays.yData.front()), chunkSize, true, (prototype.get("cartesianY").type() == e57::E57_SCALED_INTEGER)));
-		}
-		if (header.pointFields.cartesianZField)
-		{
-			arrays.zData.resize(chunkSize);
-			dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "cartesianZ", &(arrays.zData.front()), chunkSize, true, (prototype.get("cartesianZ").type() == e57::E57_SCALED_INTEGER)));
-		}
-
-		//data validity
-		if ( header.pointFields.cartesianInvalidStateField)
-		{
-			arrays.isInvalidData.resize(chunkSize);
-			dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "cartesianInvalidState", &(arrays.isInvalidData.front()), chunkSize, true, (prototype.get("cartesianInvalidState").type() == e57::E57_SCALED_INTEGER)));
-		}
+		return false;
 	}
 
 	//normals
-	bool hasNormals = (header.pointFields.normXField
-					  || header.pointFields.normYField
-					  || header.pointFields.normZField);
-	if (hasNormals)
+	job.hasNormals = (	header.pointFields.normXField
+					||	header.pointFields.normYField
+					||	header.pointFields.normZField);
+	if (job.hasNormals)
 	{
 		if (!cloud->reserveTheNormsTable())
 		{
 			ccLog::Error("[E57] Not enough memory!");
 			delete cloud;
-			return 0;
+			return false;
 		}
 		cloud->showNormals(true);
-		if (header.pointFields.normXField)
-		{
-			arrays.xNormData.resize(chunkSize);
-			dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "nor:normalX", &(arrays.xNormData.front()), chunkSize, true, (prototype.get("nor:normalX").type() == e57::E57_SCALED_INTEGER)));
-		}
-		if (header.pointFields.normYField)
-		{
-			arrays.yNormData.resize(chunkSize);
-			dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "nor:normalY", &(arrays.yNormData.front()), chunkSize, true, (prototype.get("nor:normalY").type() == e57::E57_SCALED_INTEGER)));
-		}
-		if (header.pointFields.normZField)
-		{
-			arrays.zNormData.resize(chunkSize);
-			dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "nor:normalZ", &(arrays.zNormData.front()), chunkSize, true, (prototype.get("nor:normalZ").type() == e57::E57_SCALED_INTEGER)));
-		}
 	}
 
 	//intensity
-	//double intRange = 0;
-	//double intOffset = 0;
-	//ScalarType invalidSFValue = 0;
-
-	ccScalarField* intensitySF = 0;
 	if (header.pointFields.intensityField)
 	{
-		intensitySF = new ccScalarField(CC_E57_INTENSITY_FIELD_NAME);
-		if (!intensitySF->resize(static_cast<unsigned>(pointCount)))
+		job.intensitySF = new ccScalarField(CC_E57_INTENSITY_FIELD_NAME);
+		if (!job.intensitySF->resize(static_cast<unsigned>(job.pointCount)))
 		{
 			ccLog::Error("[E57] Not enough memory!");
-			intensitySF->release();
+			job.intensitySF->release();
+			job.intensitySF = 0;
 			delete cloud;
-			return 0;
-		}
-		cloud->addScalarField(intensitySF);
-
-		arrays.intData.resize(chunkSize);
-		dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "intensity", &(arrays.intData.front()), chunkSize, true, (prototype.get("intensity").type() == e57::E57_SCALED_INTEGER)));
-		//intRange = header.intensityLimits.intensityMaximum - header.intensityLimits.intensityMinimum;
-		//intOffset = header.intensityLimits.intensityMinimum;
-
-		if (header.pointFields.isIntensityInvalidField)
-		{
-			arrays.isInvalidIntData.resize(chunkSize);
-			dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "isIntensityInvalid", &(arrays.isInvalidIntData.front()), chunkSize, true, (prototype.get("isIntensityInvalid").type() == e57::E57_SCALED_INTEGER)));
+			return false;
 		}
-
+		cloud->addScalarField(job.intensitySF);
 	}
 
-	//color buffers
-	double colorRedRange = 1;
-	double colorRedOffset = 0;
-	double colorGreenRange = 1;
-	double colorGreenOffset = 0;
-	double colorBlueRange = 1;
-	double colorBlueOffset = 0;
-	bool hasColors = (header.pointFields.colorRedField
-					  || header.pointFields.colorGreenField
-					  || header.pointFields.colorBlueField);
-	if (hasColors)
+	//colors
+	job.hasColors = (	header.pointFields.colorRedField
+					||	header.pointFields.colorGreenField
+					||	header.pointFields.colorBlueField);
+	if (job.hasColors)
 	{
 		if (!cloud->reserveTheRGBTable())
 		{
 			ccLog::Error("[E57] Not enough memory!");
 			delete cloud;
-			return 0;
+			return false;
 		}
 		if (header.pointFields.colorRedField)
 		{
-			arrays.redData.resize(chunkSize);
-			colorRedOffset = header.colorLimits.colorRedMinimum;
-			colorRedRange = header.colorLimits.colorRedMaximum - header.colorLimits.colorRedMinimum;
-			if (colorRedRange <= 0.0)
-				colorRedRange = 1.0;
-			dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "colorRed", &(arrays.redData.front()), chunkSize, true, (prototype.get("colorRed").type() == e57::E57_SCALED_INTEGER)));
+			job.colorOffset[0] = header.colorLimits.colorRedMinimum;
+			job.colorRange[0] = header.colorLimits.colorRedMaximum - header.colorLimits.colorRedMinimum;
 		}
 		if (header.pointFields.colorGreenField)
 		{
-			arrays.greenData.resize(chunkSize);
-			colorGreenOffset = header.colorLimits.colorGreenMinimum;
-			colorGreenRange = header.colorLimits.colorGreenMaximum - header.colorLimits.colorGreenMinimum;
-			if (colorGreenRange <= 0.0)
-				colorGreenRange = 1.0;
-			dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "colorGreen", &(arrays.greenData.front()), chunkSize, true, (prototype.get("colorGreen").type() == e57::E57_SCALED_INTEGER)));
+			job.colorOffset[1] = header.colorLimits.colorGreenMinimum;
+			job.colorRange[1] = header.colorLimits.colorGreenMaximum - header.colorLimits.colorGreenMinimum;
 		}
 		if (header.pointFields.colorBlueField)
 		{
-			arrays.blueData.resize(chunkSize);
-			colorBlueOffset = header.colorLimits.colorBlueMinimum;
-			colorBlueRange = header.colorLimits.colorBlueMaximum - header.colorLimits.colorBlueMinimum;
-			if (colorBlueRange <= 0.0)
-				colorBlueRange = 1.0;
-			dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "colorBlue", &(arrays.blueData.front()), chunkSize, true, (prototype.get("colorBlue").type() == e57::E57_SCALED_INTEGER)));
+			job.colorOffset[2] = header.colorLimits.colorBlueMinimum;
+			job.colorRange[2] = header.colorLimits.colorBlueMaximum - header.colorLimits.colorBlueMinimum;
+		}
+		for (unsigned c=0; c<3; ++c)
+		{
+			if (job.colorRange[c] <= 0.0)
+				job.colorRange[c] = 1.0;
 		}
 	}
 
 	//return index (multiple shoots scanners)
-	ccScalarField* returnIndexSF = 0;
 	if (header.pointFields.returnIndexField && header.pointFields.returnMaximum>0)
 	{
 		//we store the point return index as a scalar field
-		returnIndexSF = new ccScalarField(CC_E57_RETURN_INDEX_FIELD_NAME);
-		if (!returnIndexSF->resize(static_cast<unsigned>(pointCount)))
+		job.returnIndexSF = new ccScalarField(CC_E57_RETURN_INDEX_FIELD_NAME);
+		if (!job.returnIndexSF->resize(static_cast<unsigned>(job.pointCount)))
 		{
 			ccLog::Error("[E57] Not enough memory!");
 			delete cloud;
-			returnIndexSF->release();
-			return 0;
+			job.returnIndexSF->release();
+			job.returnIndexSF = 0;
+			return false;
 		}
-		cloud->addScalarField(returnIndexSF);
-		arrays.scanIndexData.resize(chunkSize);
-		dbufs.push_back(e57::SourceDestBuffer(node.destImageFile(), "returnIndex", &(arrays.scanIndexData.front()), chunkSize, true, (prototype.get("returnIndex").type() == e57::E57_SCALED_INTEGER)));
+		cloud->addScalarField(job.returnIndexSF);
 	}
 
-	//Read the point data
-	e57::CompressedVectorReader dataReader = points.reader(dbufs);
-
-	//local progress bar
-	CCLib::NormalizedProgress nprogress(progressDlg, static_cast<unsigned>(pointCount / chunkSize));
-	if (progressDlg)
-	{
-		progressDlg->setMethodTitle(QObject::tr("Read E57 file"));
-		progressDlg->setInfo(QObject::tr("Scan #%1 - %2 points").arg(s_absoluteScanIndex).arg(pointCount));
-		progressDlg->start();
-		QApplication::processEvents();
-	}
-
-	CCVector3d Pshift(0,0,0);
-	unsigned size = 0;
-	boost::int64_t realCount = 0;
-	while (size = dataReader.read())
+	//first point: check for 'big' coordinates
+	if (!job.validPoseMat || !poseMatWasShifted)
 	{
-		for (unsigned i=0; i<size; i++)
+		CCVector3d Pd;
+		e57::ImageFile imf = node.destImageFile();
+		if (ReadFirstValidPoint(imf, points, job, Pd))
 		{
-			//we skip invalid points!
-			if (!arrays.isInvalidData.empty() && arrays.isInvalidData[i] != 0)
+			if (FileIOFilter::HandleGlobalShift(Pd, job.Pshift, s_loadParameters))
 			{
-				continue;
+				cloud->setGlobalShift(job.Pshift);
+				ccLog::Warning("[E57Filter::loadFile] Cloud %s has been recentered! Translation: (%.2f,%.2f,%.2f)", qPrintable(job.guid), job.Pshift.x, job.Pshift.y, job.Pshift.z);
 			}
+		}
+	}
 
-			CCVector3d Pd(0,0,0);
-			if (sphericalMode)
-			{
-				double r = (arrays.xData.empty() ? 0 : arrays.xData[i]);
-				double theta = (arrays.yData.empty() ? 0 : arrays.yData[i]);	//Azimuth
-				double phi = (arrays.zData.empty() ? 0 : arrays.zData[i]);		//Elevation
-
-				double cos_phi = cos(phi);
-				Pd.x = r * cos_phi * cos(theta);
-				Pd.y = r * cos_phi * sin(theta);
-				Pd.z = r * sin(phi);
-			}
-			//DGM TODO: not handled yet (-->what are the standard cylindrical field names?)
-			/*else if (cylindricalMode)
-			{
-				//from cylindrical coordinates
-				assert(arrays.xData);
-				double theta = (arrays.yData ? arrays.yData[i] : 0);
-				Pd.x = arrays.xData[i] * cos(theta);
-				Pd.y = arrays.xData[i] * sin(theta);
-				if (arrays.zData)
-					Pd.z = arrays.zData[i];
-			}
-			//*/
-			else //cartesian
-			{
-				if (!arrays.xData.empty())
-					Pd.x = arrays.xData[i];
-				if (!arrays.yData.empty())
-					Pd.y = arrays.yData[i];
-				if (!arrays.zData.empty())
-					Pd.z = arrays.zData[i];
-			}
+	job.cloud = cloud;
+	return true;
+}
+
+//! Shared state of the concurrent scan readers
+/** The counters are only accessed with fetchAndXxx methods (QAtomicInt::load
+	and store don't exist in Qt 4).
+**/
+struct E57ReadingContext
+{
+	//! File name
+	QString filename;
+	//! Scan jobs
+	std::vector<E57ScanJob>* jobs;
+	//! Index of the next job to process
+	QAtomicInt nextJob;
+	//! Number of chunks read so far (for progress notification)
+	QAtomicInt readChunks;
+	//! Whether the process has been cancelled
+	QAtomicInt cancelRequested;
+};
 
-			//first point: check for 'big' coordinates
-			if (	realCount == 0
-				&& (!validPoseMat || !poseMatWasShifted) )
+//! Reads the points of a (prepared) scan
+/** May be called concurrently for different scans (as long as the image
+	files are different: libE57 handles are not thread-safe).
+**/
+static void ReadScanPoints(e57::ImageFile& imf, E57ScanJob& job, E57ReadingContext& context)
+{
+	QElapsedTimer eTimer;
+	eTimer.start();
+
+	try
+	{
+		e57::VectorNode data3D(imf.root().get("/data3D"));
+		e57::StructureNode scanNode(data3D.get(job.index));
+		e57::CompressedVectorNode points(scanNode.get("points"));
+		e57::StructureNode prototype(points.prototype());
+
+		//prepare temporary structures
+		TempArrays arrays;
+		std::vector<e57::SourceDestBuffer> dbufs;
+		SetupPointBuffers(imf, prototype, job, job.chunkSize, false, arrays, dbufs);
+
+		//Read the point data
+		e57::CompressedVectorReader dataReader = points.reader(dbufs);
+
+		ccPointCloud* cloud = job.cloud;
+		const E57ScanHeader& header = job.header;
+		unsigned size = 0;
+		while ((size = dataReader.read()) != 0)
+		{
+			for (unsigned i=0; i<size; i++)
 			{
-				if (FileIOFilter::HandleGlobalShift(Pd, Pshift, s_loadParameters))
+				//we skip invalid points!
+				if (!arrays.isInvalidData.empty() && arrays.isInvalidData[i] != 0)
 				{
-					cloud->setGlobalShift(Pshift);
-					ccLog::Warning("[E57Filter::loadFile] Cloud %s has been recentered! Translation: (%.2f,%.2f,%.2f)", qPrintable(guidStr), Pshift.x, Pshift.y, Pshift.z);
+					continue;
 				}
-			}
-
-			CCVector3 P = CCVector3::fromArray((Pd + Pshift).u);
-			cloud->addPoint(P);
 
-			if (hasNormals)
-			{
-				CCVector3 N(0,0,0);
-				if (!arrays.xNormData.empty())
-					N.x = static_cast<PointCoordinateType>(arrays.xNormData[i]);
-				if (!arrays.yNormData.empty())
-					N.y = static_cast<PointCoordinateType>(arrays.yNormData[i]);
-				if (!arrays.zNormData.empty())
-					N.z = static_cast<PointCoordinateType>(arrays.zNormData[i]);
-				N.normalize();
-				cloud->addNorm(N);
-			}
+				CCVector3d Pd = GetPoint(arrays, i, job.sphericalMode);
+				CCVector3 P = CCVector3::fromArray((Pd + job.Pshift).u);
+				cloud->addPoint(P);
 
-			if (!arrays.intData.empty())
-			{
-				assert(intensitySF);
-				if (!header.pointFields.isIntensityInvalidField || arrays.isInvalidIntData[i] != 0)
+				if (job.hasNormals)
 				{
-					//ScalarType intensity = (ScalarType)((arrays.intData[i] - intOffset)/intRange); //Normalize intensity to 0 - 1.
-					ScalarType intensity = static_cast<ScalarType>(arrays.intData[i]);
-					intensitySF->setValue(static_cast<unsigned>(realCount),intensity);
+					CCVector3 N(0,0,0);
+					if (!arrays.xNormData.empty())
+						N.x = static_cast<PointCoordinateType>(arrays.xNormData[i]);
+					if (!arrays.yNormData.empty())
+						N.y = static_cast<PointCoordinateType>(arrays.yNormData[i]);
+					if (!arrays.zNormData.empty())
+						N.z = static_cast<PointCoordinateType>(arrays.zNormData[i]);
+					N.normalize();
+					cloud->addNorm(N);
+				}
 
-					//track max intensity (for proper visualization)
-					if (s_absoluteScanIndex != 0 || realCount != 0)
+				if (!arrays.intData.empty())
+				{
+					assert(job.intensitySF);
+					if (!header.pointFields.isIntensityInvalidField || arrays.isInvalidIntData[i] != 0)
 					{
-						if (s_maxIntensity < intensity)
-							s_maxIntensity = intensity;
-						else if (s_minIntensity > intensity)
-							s_minIntensity = intensity;
+						ScalarType intensity = static_cast<ScalarType>(arrays.intData[i]);
+						job.intensitySF->setValue(static_cast<unsigned>(job.realCount),intensity);
+
+						//track min and max intensity (for proper visualization)
+						if (job.validIntensityCount++ != 0)
+						{
+							if (job.maxIntensity < intensity)
+								job.maxIntensity = intensity;
+							else if (job.minIntensity > intensity)
+								job.minIntensity = intensity;
+						}
+						else
+						{
+							job.maxIntensity = job.minIntensity = intensity;
+						}
 					}
 					else
 					{
-						s_maxIntensity = s_minIntensity = intensity;
+						job.intensitySF->flagValueAsInvalid(static_cast<unsigned>(job.realCount));
 					}
 				}
-				else
+
+				if (job.hasColors)
 				{
-					intensitySF->flagValueAsInvalid(static_cast<unsigned>(realCount));
+					//Normalize color to 0 - 255
+					ColorCompType C[3] = { 0, 0, 0 };
+					if (!arrays.redData.empty())
+						C[0] = static_cast<ColorCompType>(((arrays.redData[i] - job.colorOffset[0]) * 255) / job.colorRange[0]);
+					if (!arrays.greenData.empty())
+						C[1] = static_cast<ColorCompType>(((arrays.greenData[i] - job.colorOffset[1]) * 255) / job.colorRange[1]);
+					if (!arrays.blueData.empty())
+						C[2] = static_cast<ColorCompType>(((arrays.blueData[i] - job.colorOffset[2]) * 255) / job.colorRange[2]);
+				
+					cloud->addRGBColor(C);
 				}
+
+				if (!arrays.scanIndexData.empty())
+				{
+					assert(job.returnIndexSF);
+					ScalarType s = static_cast<ScalarType>(arrays.scanIndexData[i]);
+					job.returnIndexSF->setValue(static_cast<unsigned>(job.realCount),s);
+				}
+
+				job.realCount++;
 			}
 
-			if (hasColors)
+			context.readChunks.fetchAndAddRelaxed(1);
+			if (context.cancelRequested.fetchAndAddRelaxed(0) != 0)
 			{
-				//Normalize color to 0 - 255
-				ColorCompType C[3] = { 0, 0, 0 };
-				if (!arrays.redData.empty())
-					C[0] = static_cast<ColorCompType>(((arrays.redData[i] - colorRedOffset) * 255) / colorRedRange);
-				if (!arrays.greenData.empty())
-					C[1] = static_cast<ColorCompType>(((arrays.greenData[i] - colorGreenOffset) * 255) / colorGreenRange);
-				if (!arrays.blueData.empty())
-					C[2] = static_cast<ColorCompType>(((arrays.blueData[i] - colorBlueOffset) * 255) / colorBlueRange);
-				
-				cloud->addRGBColor(C);
+				break;
 			}
+		}
+
+		dataReader.close();
+	}
+	catch (const e57::E57Exception& e)
+	{
+		job.errorMessage = QString("LibE57 has thrown an exception: %1").arg(e57::E57Utilities().errorCodeToString(e.errorCode()).c_str());
+	}
+	catch (const std::bad_alloc&)
+	{
+		job.errorMessage = "Not enough memory";
+	}
+	catch (...)
+	{
+		job.errorMessage = "LibE57 has thrown an unknown exception";
+	}
 
-			if (!arrays.scanIndexData.empty())
+	job.readTime_s = eTimer.elapsed() / 1000.0;
+	job.processed = true;
+}
+
+//! Serializes the opening and closing of the readers file handles (see ReadScans)
+static QMutex s_imageFileMutex;
+
+//! Concurrent scan reader
+/** Each reader opens its own handle on the file and processes
+	the remaining jobs one after the other. The handles are opened and
+	closed one at a time, as libE57 (and the Xerces-C parser it relies on)
+	initializes and releases some global state at these moments.
+**/
+struct E57ScanReader
+{
+	E57ScanReader() : context(0) {}
+
+	//! Shared context
+	E57ReadingContext* context;
+	//! Error message (if any)
+	QString errorMessage;
+};
+
+static void ReadScans(E57ScanReader& reader)
+{
+	E57ReadingContext& context = *reader.context;
+	std::vector<E57ScanJob>& jobs = *context.jobs;
+
+	e57::ImageFile* imf = 0;
+	try
+	{
+		//opening a handle sets up some process-wide state (Xerces parser, etc.)
+		{
+			QMutexLocker locker(&s_imageFileMutex);
+			imf = new e57::ImageFile(qPrintable(context.filename), "r"); //DGM: warning, toStdString doesn't preserve "local" characters
+			if (imf->isOpen())
+				RegisterNormalsExtension(*imf);
+		}
+
+		if (!imf->isOpen())
+		{
+			reader.errorMessage = "Failed to open the file";
+		}
+		else
+		{
+			while (context.cancelRequested.fetchAndAddRelaxed(0) == 0)
 			{
-				assert(returnIndexSF);
-				ScalarType s = static_cast<ScalarType>(arrays.scanIndexData[i]);
-				returnIndexSF->setValue(static_cast<unsigned>(realCount),s);
+				size_t jobIndex = static_cast<size_t>(context.nextJob.fetchAndAddRelaxed(1));
+				if (jobIndex >= jobs.size())
+					break;
+				ReadScanPoints(*imf, jobs[jobIndex], context);
 			}
+		}
+	}
+	catch (const e57::E57Exception& e)
+	{
+		reader.errorMessage = QString("LibE57 has thrown an exception: %1").arg(e57::E57Utilities().errorCodeToString(e.errorCode()).c_str());
+	}
+	catch (...)
+	{
+		reader.errorMessage = "LibE57 has thrown an unknown exception";
+	}
 
-			realCount++;
+	//closing it as well
+	if (imf)
+	{
+		QMutexLocker locker(&s_imageFileMutex);
+		try
+		{
+			if (imf->isOpen())
+				imf->close();
 		}
-		
-		if (progressDlg && !nprogress.oneStep())
+		catch (...)
 		{
-			QApplication::processEvents();
-			s_cancelRequestedByUser = true;
-			break;
+			//nothing to do: the points have already been read
 		}
+		delete imf;
+		imf = 0;
 	}
+}
 
-	dataReader.close();
+//! Finalizes a loaded scan (once its points have been read)
+/** \return the loaded cloud or 0 if the scan should be skipped
+**/
+static ccHObject* FinalizeScan(E57ScanJob& job)
+{
+	ccPointCloud* cloud = job.cloud;
+	if (!cloud)
+	{
+		return 0;
+	}
+	job.cloud = 0;
+
+	if (!job.errorMessage.isEmpty())
+	{
+		ccLog::Warning(QString("[E57] Failed to read scan '%1': %2").arg(job.nodeName).arg(job.errorMessage));
+	}
 
-	if (realCount == 0)
+	if (job.realCount == 0)
 	{
-		ccLog::Warning(QString("[E57] No valid point in scan '%1'!").arg(scanNode.elementName().c_str()));
+		if (job.processed && job.errorMessage.isEmpty())
+			ccLog::Warning(QString("[E57] No valid point in scan '%1'!").arg(job.nodeName));
 		delete cloud;
 		return 0;
 	}
-	else if (realCount < pointCount)
+	else if (job.realCount < job.pointCount)
 	{
-		ccLog::Warning(QString("[E57] We read less points than expected for scan '%1'! (%2/%3)").arg(scanNode.elementName().c_str()).arg(realCount).arg(pointCount));
-		cloud->resize(static_cast<unsigned>(realCount));
+		ccLog::Warning(QString("[E57] We read less points than expected for scan '%1'! (%2/%3)").arg(job.nodeName).arg(job.realCount).arg(job.pointCount));
+		cloud->resize(static_cast<unsigned>(job.realCount));
 	}
 
+	ccLog::Print(QString("[E57] Scan '%1': %2 points read in %3 s. (%4 Mpts/s)")
+		.arg(job.nodeName)
+		.arg(job.realCount)
+		.arg(job.readTime_s, 0, 'f', 2)
+		.arg(job.realCount / 1.0e6 / std::max(job.readTime_s, 0.001), 0, 'f', 2));
+
 	//Scalar fields
-	if (intensitySF)
+	if (job.intensitySF)
 	{
-		intensitySF->computeMinAndMax();
-		if (intensitySF->getMin() >= 0 && intensitySF->getMax() <= 1.0)
-			intensitySF->setColorScale(ccColorScalesManager::GetDefaultScale(ccColorScalesManager::ABS_NORM_GREY));
+		job.intensitySF->computeMinAndMax();
+		if (job.intensitySF->getMin() >= 0 && job.intensitySF->getMax() <= 1.0)
+			job.intensitySF->setColorScale(ccColorScalesManager::GetDefaultScale(ccColorScalesManager::ABS_NORM_GREY));
 		else
-			intensitySF->setColorScale(ccColorScalesManager::GetDefaultScale(ccColorScalesManager::GREY));
-		cloud->setCurrentDisplayedScalarField(cloud->getScalarFieldIndexByName(intensitySF->getName()));
+			job.intensitySF->setColorScale(ccColorScalesManager::GetDefaultScale(ccColorScalesManager::GREY));
+		cloud->setCurrentDisplayedScalarField(cloud->getScalarFieldIndexByName(job.intensitySF->getName()));
 		cloud->showSF(true);
 	}
 
-	if (returnIndexSF)
+	if (job.returnIndexSF)
 	{
-		returnIndexSF->computeMinAndMax();
-		cloud->setCurrentDisplayedScalarField(cloud->getScalarFieldIndexByName(returnIndexSF->getName()));
+		job.returnIndexSF->computeMinAndMax();
+		cloud->setCurrentDisplayedScalarField(cloud->getScalarFieldIndexByName(job.returnIndexSF->getName()));
 		ccLog::Warning("[E57] Cloud has multiple echoes: use 'Edit > Scalar Fields > Filter by value' to extract one component");
 		cloud->showSF(true);
 	}
 
-	cloud->showColors(hasColors);
+	cloud->showColors(job.hasColors);
 	cloud->setVisible(true);
 
 	//we don't deal with virtual transformation (yet)
-	if (validPoseMat)
+	if (job.validPoseMat)
 	{
-		ccGLMatrix poseMatf = ccGLMatrix(poseMat.data());
+		ccGLMatrix poseMatf = ccGLMatrix(job.poseMat.data());
 		cloud->applyGLTransformation_recursive(&poseMatf);
 	}
 
@@ -2080,12 +2429,7 @@ CC_FILE_ERROR E57Filter::loadFile(QString filename, ccHObject& container, LoadPa
 	try
 	{
 		//for normals handling
-		static const e57::ustring normalsExtension("http://www.libe57.org/E57_NOR_surface_normals.txt");
-		e57::ustring _normalsExtension;
-		if (!imf.extensionsLookupPrefix("nor", _normalsExtension)) //the extension may already be registered
-		{
-			imf.extensionsAdd("nor", normalsExtension);
-		}
+		RegisterNormalsExtension(imf);
 
 		//get root
 		e57::StructureNode root = imf.root();
@@ -2137,52 +2481,141 @@ CC_FILE_ERROR E57Filter::loadFile(QString filename, ccHObject& container, LoadPa
 			//global progress bar
 			ccProgressDialog progressDlg(true, parameters.parentWidget);
 			progressDlg.setAutoClose(false);
+			progressDlg.setMethodTitle(QObject::tr("Read E57 file"));
+			progressDlg.setInfo(QObject::tr("Scans: %1").arg(scanCount));
+			progressDlg.start();
+			QApplication::processEvents();
 
-			bool showGlobalProgress = (scanCount > 10);
-			CCLib::NormalizedProgress nprogress(&progressDlg, showGlobalProgress ? scanCount : 100);
-			if (showGlobalProgress)
-			{
-				//Too many scans, will display a global progress bar
-				progressDlg.setMethodTitle(QObject::tr("Read E57 file"));
-				progressDlg.setInfo(QObject::tr("Scans: %1").arg(scanCount));
-				progressDlg.start();
-				QApplication::processEvents();
-			}
-			
 			//static states
-			s_absoluteScanIndex = 0;
 			s_cancelRequestedByUser = false;
 			s_minIntensity = s_maxIntensity = 0;
+
+			QElapsedTimer eTimer;
+			eTimer.start();
+
+			//first pass: we prepare the scans sequentially (the global shift may be asked to the user)
+			std::vector<E57ScanJob> jobs;
+			jobs.reserve(scanCount);
+			int totalChunkCount = 0;
 			for (unsigned i=0; i<scanCount; ++i)
 			{
 				e57::Node scanNode = data3D.get(i);
-				QString scanGUID;
-				ccHObject* scan = LoadScan(scanNode, scanGUID, showGlobalProgress ? 0 : &progressDlg);
-				if (scan)
+				E57ScanJob job;
+				job.index = i;
+				if (PrepareScan(scanNode, job))
 				{
-					if (scan->getName().isEmpty())
+					jobs.push_back(job);
+					totalChunkCount += ChunkCount(job);
+				}
+
+				QApplication::processEvents();
+				if (progressDlg.wasCanceled())
+				{
+					s_cancelRequestedByUser = true;
+					break;
+				}
+			}
+
+			//second pass: we read the points of the scans concurrently
+			if (!s_cancelRequestedByUser && !jobs.empty())
+			{
+				//one reader (and one file handle) per thread
+				int threadCount = std::max(1, std::min(QThread::idealThreadCount(), static_cast<int>(jobs.size())));
+
+				E57ReadingContext context;
+				context.filename = filename;
+				context.jobs = &jobs;
+
+				std::vector<E57ScanReader> readers(threadCount);
+				for (size_t j=0; j<readers.size(); ++j)
+				{
+					readers[j].context = &context;
+				}
+
+				progressDlg.setInfo(QObject::tr("Scans: %1 (%2 thread(s))").arg(static_cast<unsigned>(jobs.size())).arg(threadCount));
+				QApplication::processEvents();
+
+				QFuture<void> future = QtConcurrent::map(readers.begin(), readers.end(), ReadScans);
+
+				while (!future.isFinished())
+				{
+#if defined(CC_WINDOWS)
+					::Sleep(100);
+#else
+					usleep(100 * 1000);
+#endif
+					if (totalChunkCount > 0)
 					{
-						QString name("Scan ");
-						e57::ustring nodeName = scanNode.elementName();
-						if (nodeName.c_str() != 0 && nodeName.c_str()[0] != 0)
-							name += QString(nodeName.c_str());
-						else
-							name += QString::number(i);
-						scan->setName(name);
+						progressDlg.update((100.0f * context.readChunks.fetchAndAddRelaxed(0)) / totalChunkCount);
 					}
-					container.addChild(scan);
+					QApplication::processEvents();
+					if (progressDlg.wasCanceled())
+					{
+						context.cancelRequested.fetchAndStoreRelaxed(1);
+						s_cancelRequestedByUser = true;
+					}
+				}
 
-					//we also add the scan to the GUID/object map
-					if (!scanGUID.isEmpty())
-						scans.insert(scanGUID,scan);
+				for (size_t j=0; j<readers.size(); ++j)
+				{
+					if (!readers[j].errorMessage.isEmpty())
+						ccLog::Warning(QString("[E57] Reader #%1: %2").arg(static_cast<unsigned>(j+1)).arg(readers[j].errorMessage));
 				}
-				if ((showGlobalProgress && !nprogress.oneStep()) || s_cancelRequestedByUser)
+			}
+
+			//last pass: we finalize the scans (in the file order)
+			unsigned loadedScanCount = 0;
+			qint64 totalPointCount = 0;
+			bool firstIntensity = true;
+			for (size_t j=0; j<jobs.size(); ++j)
+			{
+				E57ScanJob& job = jobs[j];
+				ccHObject* scan = FinalizeScan(job);
+				if (!scan)
+					continue;
+
+				if (scan->getName().isEmpty())
 				{
-					break;
+					QString name("Scan ");
+					if (!job.nodeName.isEmpty())
+						name += job.nodeName;
+					else
+						name += QString::number(job.index);
+					scan->setName(name);
+				}
+				container.addChild(scan);
+
+				//we also add the scan to the GUID/object map
+				if (!job.guid.isEmpty())
+					scans.insert(job.guid,scan);
+
+				++loadedScanCount;
+				totalPointCount += job.realCount;
+
+				//track global min and max intensity (for proper visualization)
+				if (job.validIntensityCount != 0)
+				{
+					if (firstIntensity)
+					{
+						s_minIntensity = job.minIntensity;
+						s_maxIntensity = job.maxIntensity;
+						firstIntensity = false;
+					}
+					else
+					{
+						s_minIntensity = std::min(s_minIntensity, job.minIntensity);
+						s_maxIntensity = std::max(s_maxIntensity, job.maxIntensity);
+					}
 				}
-				++s_absoluteScanIndex;
 			}
 
+			double elapsed_s = eTimer.elapsed() / 1000.0;
+			ccLog::Print(QString("[E57] %1 scan(s) / %2 points loaded in %3 s. (%4 Mpts/s)")
+				.arg(loadedScanCount)
+				.arg(totalPointCount)
+				.arg(elapsed_s, 0, 'f', 2)
+				.arg(totalPointCount / 1.0e6 / std::max(elapsed_s, 0.001), 0, 'f', 2));
+
 			progressDlg.stop();
 			QApplication::processEvents();
 
@@ -59,6 +59,7 @@
 #endif
 
 //system
+#include <algorithm>
 #include <assert.h>
 #include <vector>
 
@@ -200,6 +201,38 @@ FileIOFilter::Shared FileIOFilter::FindBestFilterForExtension(QString ext)
 	return Shared(0);
 }
 
+bool FileIOFilter::LoadFilter::accept(const CCVector3d& P, unsigned classification, qint64 index) const
+{
+	if (stride > 1 && (index % stride) != 0)
+		return false;
+
+	if (useBox
+		&&	(	P.x < boxMin.x || P.x > boxMax.x
+			||	P.y < boxMin.y || P.y > boxMax.y
+			||	P.z < boxMin.z || P.z > boxMax.z ) )
+		return false;
+
+	if (!classes.empty() && std::find(classes.begin(), classes.end(), classification) == classes.end())
+		return false;
+
+	if (polygon.size() > 2)
+	{
+		//crossing number test (in double precision, as LAS coordinates are generally big)
+		bool inside = false;
+		for (size_t i = 0, j = polygon.size() - 1; i < polygon.size(); j = i++)
+		{
+			const CCVector2d& A = polygon[i];
+			const CCVector2d& B = polygon[j];
+			if ((A.y > P.y) != (B.y > P.y) && P.x < (B.x - A.x) * (P.y - A.y) / (B.y - A.y) + A.x)
+				inside = !inside;
+		}
+		if (!inside)
+			return false;
+	}
+
+	return true;
+}
+
 ccHObject* FileIOFilter::LoadFromFile(	const QString& filename,
 										LoadParameters& loadParameters,
 										Shared filter,
@@ -59,6 +59,48 @@ public: //initialization
 	//! Destructor
 	virtual ~FileIOFilter() {}
 
+	//! Point filters applied at loading time (if supported - e.g. LAS files)
+	/** Rejected points are skipped while the file is read (they are never stored).
+	**/
+	struct LoadFilter
+	{
+		//! Default constructor
+		LoadFilter()
+			: useBox(false)
+			, boxMin(0,0,0)
+			, boxMax(0,0,0)
+			, stride(1)
+			, voxelStep(0)
+		{}
+
+		//! Returns whether at least one filter is enabled
+		inline bool isActive() const { return useBox || polygon.size() > 2 || !classes.empty() || stride > 1 || voxelStep > 0; }
+
+		//! Returns whether a point passes the box, polygon, classification and stride filters
+		/** The voxel decimation is order dependent and must be handled by the I/O filter itself.
+			\param P point (original coordinates, i.e. before any global shift)
+			\param classification point classification
+			\param index point index in the file
+			\return whether the point should be loaded
+		**/
+		QCC_IO_LIB_API bool accept(const CCVector3d& P, unsigned classification, qint64 index) const;
+
+		//! Whether points outside of [boxMin ; boxMax] should be rejected
+		bool useBox;
+		//! Filtering box min corner (original coordinates)
+		CCVector3d boxMin;
+		//! Filtering box max corner (original coordinates)
+		CCVector3d boxMax;
+		//! 2D polygon (XY plane, original coordinates) outside of which points are rejected (ignored if less than 3 vertices)
+		std::vector<CCVector2d> polygon;
+		//! Classification values to keep (all if empty)
+		std::vector<unsigned> classes;
+		//! Only one point out of 'stride' is kept (1 = all points)
+		unsigned stride;
+		//! If > 0, only the first point of each voxel of this size is kept
+		double voxelStep;
+	};
+
 	//! Generic loading parameters
 	struct LoadParameters
 	{
@@ -69,6 +111,7 @@ public: //initialization
 			, coordinatesShiftEnabled(0)
 			, coordinatesShift(0)
 			, autoComputeNormals(false)
+			, spatialSubsamplingStep(0)
 			, parentWidget(0)
 		{}
 
@@ -82,6 +125,10 @@ public: //initialization
 		CCVector3d* coordinatesShift;
 		//! Whether normals should be computed at loading time (if possible - e.g. for gridded clouds) or not
 		bool autoComputeNormals;
+		//! If > 0, points nearer than this distance to an already loaded point are skipped at loading time (if supported - e.g. LAS and BIN V1 files)
+		PointCoordinateType spatialSubsamplingStep;
+		//! Point filters applied while the file is read (if supported - e.g. LAS files)
+		LoadFilter filter;
 		//! Parent widget (if any)
 		QWidget* parentWidget;
 	};
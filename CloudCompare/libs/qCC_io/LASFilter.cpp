@@ -31,6 +31,7 @@
 
 //CCLib
 #include <CCPlatform.h>
+#include <CloudSamplingTools.h>
 
 //Liblas
 #include <liblas/point.hpp>
@@ -39,15 +40,23 @@
 #include <liblas/factory.hpp>	// liblas::ReaderFactory
 
 //Qt
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QFile>
 #include <QFileInfo>
 #include <QSharedPointer>
 #include <QInputDialog>
+#include <QSysInfo>
+#include <QThread>
+#include <QtConcurrentMap>
 
 //Qt gui
 #include <ui_saveLASFileDlg.h>
 
 //System
 #include <string.h>
+#include <math.h>
+#include <unordered_set>
 #include <fstream>				// std::ifstream
 #include <iostream>				// std::cout
 
@@ -762,6 +771,990 @@ protected:
 	std::vector<LASWriter*> tileFiles;
 };
 
+//! Enlarges a cloud being loaded (as well as the scalar fields not yet attached to it)
+static bool ReserveMorePoints(ccPointCloud* cloud, std::vector<LasField::Shared>& fields, unsigned newCapacity)
+{
+	if (!cloud->reserve(newCapacity))
+		return false;
+
+	for (std::vector<LasField::Shared>::iterator it = fields.begin(); it != fields.end(); ++it)
+	{
+		if ((*it)->sf && !(*it)->sf->reserve(newCapacity))
+			return false;
+	}
+
+	return true;
+}
+
+//! Reservation step for the clouds subsampled or filtered at loading time
+static const unsigned c_subsampledCloudReserveStep = 1 << 20;
+
+//! Voxel decimation at loading time: only the first point of each voxel is kept
+/** Only the non empty voxels are stored (the memory depends on the output size).
+**/
+class LasVoxelDecimator
+{
+public:
+
+	//! Point submission result
+	enum Result { REJECTED = 0, KEPT = 1, NOT_ENOUGH_MEMORY = -1 };
+
+	//! Default constructor
+	explicit LasVoxelDecimator(double step)
+		: m_step(step)
+	{
+		assert(step > 0);
+	}
+
+	//! Submits a new point
+	Result addPoint(const CCVector3d& P)
+	{
+		VoxelKey key = {	static_cast<long long>(floor(P.x / m_step)),
+							static_cast<long long>(floor(P.y / m_step)),
+							static_cast<long long>(floor(P.z / m_step)) };
+		try
+		{
+			return m_voxels.insert(key).second ? KEPT : REJECTED;
+		}
+		catch (const std::bad_alloc&)
+		{
+			return NOT_ENOUGH_MEMORY;
+		}
+	}
+
+	//! Returns the voxel size
+	inline double step() const { return m_step; }
+
+protected:
+
+	//! Voxel key
+	struct VoxelKey
+	{
+		long long i, j, k;
+		inline bool operator == (const VoxelKey& key) const { return i == key.i && j == key.j && k == key.k; }
+	};
+
+	//! Voxel key hash function
+	struct VoxelKeyHash
+	{
+		inline size_t operator () (const VoxelKey& key) const
+		{
+			return static_cast<size_t>((key.i * 73856093LL) ^ (key.j * 19349663LL) ^ (key.k * 83492791LL));
+		}
+	};
+
+	//! Voxel size
+	double m_step;
+	//! Non empty voxels
+	std::unordered_set<VoxelKey, VoxelKeyHash> m_voxels;
+};
+
+//! Applies the loading filters to a point (the order dependent voxel decimation comes last)
+/** \param P point (original coordinates)
+	\param classification point classification (5 bits)
+	\param index point index in the file
+	\param filter loading filters
+	\param decimator voxel decimator (optional)
+**/
+static LasVoxelDecimator::Result FilterLasPoint(const CCVector3d& P,
+												unsigned classification,
+												qint64 index,
+												const FileIOFilter::LoadFilter& filter,
+												LasVoxelDecimator* decimator)
+{
+	if (!filter.accept(P, classification, index))
+		return LasVoxelDecimator::REJECTED;
+
+	return decimator ? decimator->addPoint(P) : LasVoxelDecimator::KEPT;
+}
+
+//! Prepares the (optional) fields to load (as selected in the open dialog)
+static void PrepareFieldsToLoad(std::vector<LasField::Shared>& fieldsToLoad, const liblas::Dimension* extraDimension, const std::vector<EVLR>& evlrs)
+{
+	//DGM: from now on, we only enable scalar fields when we detect a valid value!
+	if (s_lasOpenDlg->doLoad(LAS_CLASSIFICATION))
+		fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_CLASSIFICATION,0,0,255))); //unsigned char: between 0 and 255
+	if (s_lasOpenDlg->doLoad(LAS_CLASSIF_VALUE))
+		fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_CLASSIF_VALUE,0,0,31))); //5 bits: between 0 and 31
+	if (s_lasOpenDlg->doLoad(LAS_CLASSIF_SYNTHETIC))
+		fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_CLASSIF_SYNTHETIC,0,0,1))); //1 bit: 0 or 1
+	if (s_lasOpenDlg->doLoad(LAS_CLASSIF_KEYPOINT))
+		fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_CLASSIF_KEYPOINT,0,0,1))); //1 bit: 0 or 1
+	if (s_lasOpenDlg->doLoad(LAS_CLASSIF_WITHHELD))
+		fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_CLASSIF_WITHHELD,0,0,1))); //1 bit: 0 or 1
+	if (s_lasOpenDlg->doLoad(LAS_INTENSITY))
+		fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_INTENSITY,0,0,65535))); //16 bits: between 0 and 65536
+	if (s_lasOpenDlg->doLoad(LAS_TIME))
+		fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_TIME,0,0,-1.0))); //8 bytes (double) --> we use global shift!
+	if (s_lasOpenDlg->doLoad(LAS_RETURN_NUMBER))
+		fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_RETURN_NUMBER,1,1,7))); //3 bits: between 1 and 7
+	if (s_lasOpenDlg->doLoad(LAS_NUMBER_OF_RETURNS))
+		fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_NUMBER_OF_RETURNS,1,1,7))); //3 bits: between 1 and 7
+	if (s_lasOpenDlg->doLoad(LAS_SCAN_DIRECTION))
+		fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_SCAN_DIRECTION,0,0,1))); //1 bit: 0 or 1
+	if (s_lasOpenDlg->doLoad(LAS_FLIGHT_LINE_EDGE))
+		fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_FLIGHT_LINE_EDGE,0,0,1))); //1 bit: 0 or 1
+	if (s_lasOpenDlg->doLoad(LAS_SCAN_ANGLE_RANK))
+		fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_SCAN_ANGLE_RANK,0,-90,90))); //signed char: between -90 and +90
+	if (s_lasOpenDlg->doLoad(LAS_USER_DATA))
+		fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_USER_DATA,0,0,255))); //unsigned char: between 0 and 255
+	if (s_lasOpenDlg->doLoad(LAS_POINT_SOURCE_ID))
+		fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_POINT_SOURCE_ID,0,0,65535))); //16 bits: between 0 and 65536
+
+	//Extra fields
+	if (s_lasOpenDlg->doLoad(LAS_EXTRA))
+	{
+		if (extraDimension)
+		{
+			assert(!evlrs.empty());
+			const size_t extraBytesOffset = extraDimension->GetByteOffset();
+			size_t localOffset = 0;
+			for (size_t i=0; i<evlrs.size(); ++i)
+			{
+				unsigned char data_type = evlrs[i].data_type;
+				//We split the fields with mutliple values in multiple scalar fields!
+				unsigned subFieldCount = 1;
+				if (evlrs[i].data_type > 20)
+				{
+					subFieldCount = 3;
+					data_type -= 20;
+				}
+				else if (evlrs[i].data_type > 10)
+				{
+					subFieldCount = 2;
+					data_type -= 10;
+				}
+
+				for (unsigned j = 0; j < subFieldCount; ++j)
+				{
+					size_t dataOffset = extraBytesOffset + localOffset;
+
+					//move forward (and check that the byte count is ok!)
+					assert(data_type <= ExtraLasField::EXTRA_DOUBLE);
+					ExtraLasField::Type type = static_cast<ExtraLasField::Type>(data_type);
+					localOffset += ExtraLasField::GetSizeBytes(type);
+				
+					if (localOffset <= extraDimension->GetByteSize())
+					{
+						if (s_lasOpenDlg->doLoadEVLR(i))
+						{
+							QString fieldName(evlrs[i].getName());
+							if (subFieldCount > 1)
+								fieldName += QString(".%1").arg(j+1);
+
+							const unsigned char options = evlrs[i].options;
+
+							//read the first optional informations
+							double defaultVal = 0;
+							double minVal = 0;
+							double maxVal = -1.0;
+							//DGM: the first 3 (no_data, min and max) are a bit
+							//dangerous to use because we don't know if they have
+							//been saved as double values (as Laspy do!) or if
+							//the same type as ExtraLasField::Type is used!
+							if (false)
+							{
+								if (options & 1) //1st bit = no_data_bit
+									defaultVal = evlrs[i].no_data[j];
+								if (options & 2) //2nd bit = min_bit
+									minVal = evlrs[i].min[j];
+								if (options & 3) //3rd bit = max_bit
+									maxVal = evlrs[i].max[j];
+							}
+
+							ExtraLasField* eField = new ExtraLasField(fieldName,type,static_cast<int>(dataOffset),defaultVal,minVal,maxVal);
+
+							//read the other optional information (scale and offset)
+							{
+								if (options & 4) //4th bit = scale_bit
+									eField->scale = evlrs[i].scale[j];
+								if (options & 5) //5th bit = offset_bit
+									eField->offset = evlrs[i].offset[j];
+							}
+							fieldsToLoad.push_back(LasField::Shared(eField));
+						}
+					}
+					else
+					{
+						ccLog::Warning("[LAS] Internal consistency of extra fields is broken! (more values defined that available types...)");
+						break;
+					}
+				}
+			}
+		}
+		else
+		{
+			//shouldn't happen:
+			assert(false);
+		}
+	}
+}
+
+//! Decodes an extra ("Extra bytes") field value
+static double DecodeExtraValue(const uint8_t* v, const ExtraLasField& field)
+{
+	double value = 0.0;
+	switch(field.valType)
+	{
+	case ExtraLasField::EXTRA_UINT8:
+		value = static_cast<double>(*(reinterpret_cast<const uint8_t*>(v)));
+		break;
+	case ExtraLasField::EXTRA_INT8:
+		value = static_cast<double>(*(reinterpret_cast<const int8_t*>(v)));
+		break;
+	case ExtraLasField::EXTRA_UINT16:
+		value = static_cast<double>(*(reinterpret_cast<const uint16_t*>(v)));
+		break;
+	case ExtraLasField::EXTRA_INT16:
+		value = static_cast<double>(*(reinterpret_cast<const int16_t*>(v)));
+		break;
+	case ExtraLasField::EXTRA_UINT32:
+		value = static_cast<double>(*(reinterpret_cast<const uint32_t*>(v)));
+		break;
+	case ExtraLasField::EXTRA_INT32:
+		value = static_cast<double>(*(reinterpret_cast<const int32_t*>(v)));
+		break;
+	case ExtraLasField::EXTRA_UINT64:
+		value = static_cast<double>(*(reinterpret_cast<const uint64_t*>(v)));
+		break;
+	case ExtraLasField::EXTRA_INT64:
+		value = static_cast<double>(*(reinterpret_cast<const int64_t*>(v)));
+		break;
+	case ExtraLasField::EXTRA_FLOAT:
+		value = static_cast<double>(*(reinterpret_cast<const float*>(v)));
+		break;
+	case ExtraLasField::EXTRA_DOUBLE:
+		value = static_cast<double>(*(reinterpret_cast<const double*>(v)));
+		break;
+	default:
+		assert(false);
+		break;
+	}
+
+	return field.offset + field.scale * value;
+}
+
+//! Handles the global shift of the first loaded point (the LAS offset is used as default shift)
+static void HandleLasGlobalShift(const CCVector3d& P, const CCVector3d& lasShift, CCVector3d& Pshift, FileIOFilter::LoadParameters& parameters, ccPointCloud* cloud)
+{
+	//backup input global parameters
+	ccGlobalShiftManager::Mode csModeBackup = parameters.shiftHandlingMode;
+	bool useLasShift = false;
+	//set the LAS shift as default shift (if none was provided)
+	if (lasShift.norm2() != 0 && (!parameters.coordinatesShiftEnabled || !*parameters.coordinatesShiftEnabled))
+	{
+		useLasShift = true;
+		Pshift = lasShift;
+		if (	csModeBackup != ccGlobalShiftManager::NO_DIALOG
+			&&	csModeBackup != ccGlobalShiftManager::NO_DIALOG_AUTO_SHIFT)
+		{
+			parameters.shiftHandlingMode = ccGlobalShiftManager::ALWAYS_DISPLAY_DIALOG;
+		}
+	}
+	if (FileIOFilter::HandleGlobalShift(P, Pshift, parameters, useLasShift))
+	{
+		cloud->setGlobalShift(Pshift);
+		ccLog::Warning("[LAS] Cloud has been recentered! Translation: (%.2f,%.2f,%.2f)", Pshift.x, Pshift.y, Pshift.z);
+	}
+
+	//restore previous parameters
+	parameters.shiftHandlingMode = csModeBackup;
+}
+
+//! Finalizes a loaded cloud (scalar fields, colors, name, etc.) and adds it to the container
+/** The cloud is deleted if it's empty.
+**/
+static void FinalizeLoadedCloud(ccPointCloud* loadedCloud, std::vector<LasField::Shared>& fieldsToLoad, bool loadColor, const CCVector3d& lasScale, ccHObject& container)
+{
+	if (loadedCloud->size())
+	{
+		bool thisChunkHasColors = loadedCloud->hasColors();
+		loadedCloud->showColors(thisChunkHasColors);
+		if (loadColor && !thisChunkHasColors)
+		{
+			ccLog::Warning("[LAS] Color field was all black! We ignored it...");
+		}
+
+		while (!fieldsToLoad.empty())
+		{
+			LasField::Shared& field = fieldsToLoad.back();
+			if (field && field->sf)
+			{
+				field->sf->computeMinAndMax();
+
+				if (	field->type == LAS_CLASSIFICATION
+					||	field->type == LAS_CLASSIF_VALUE
+					||	field->type == LAS_CLASSIF_SYNTHETIC
+					||	field->type == LAS_CLASSIF_KEYPOINT
+					||	field->type == LAS_CLASSIF_WITHHELD
+					||	field->type == LAS_RETURN_NUMBER
+					||	field->type == LAS_NUMBER_OF_RETURNS)
+				{
+					int cMin = static_cast<int>(field->sf->getMin());
+					int cMax = static_cast<int>(field->sf->getMax());
+					field->sf->setColorRampSteps(std::min<int>(cMax-cMin+1,256));
+					//classifSF->setMinSaturation(cMin);
+				}
+				else if (field->type == LAS_INTENSITY)
+				{
+					field->sf->setColorScale(ccColorScalesManager::GetDefaultScale(ccColorScalesManager::GREY));
+				}
+
+				int sfIndex = loadedCloud->addScalarField(field->sf);
+				if (!loadedCloud->hasDisplayedScalarField())
+				{
+					loadedCloud->setCurrentDisplayedScalarField(sfIndex);
+					loadedCloud->showSF(!thisChunkHasColors);
+				}
+				field->sf->release();
+				field->sf = 0;
+			}
+			else
+			{
+				ccLog::Warning(QString("[LAS] All '%1' values were the same (%2)! We ignored them...").arg(field->type == LAS_EXTRA ? field->getName() : QString(LAS_FIELD_NAMES[field->type])).arg(field->firstValue));
+			}
+
+			fieldsToLoad.pop_back();
+		}
+
+		//if we have reserved too much memory
+		if (loadedCloud->size() < loadedCloud->capacity())
+		{
+			loadedCloud->resize(loadedCloud->size());
+		}
+
+		QString chunkName("unnamed - Cloud");
+		unsigned n = container.getChildrenNumber();
+		if (n != 0) //if we have more than one cloud, we append an index
+		{
+			if (n == 1)  //we must also update the first one!
+			{
+				container.getChild(0)->setName(chunkName + QString(" #1"));
+			}
+			chunkName += QString(" #%1").arg(n+1);
+		}
+		loadedCloud->setName(chunkName);
+
+		loadedCloud->setMetaData(LAS_SCALE_X_META_DATA, QVariant(lasScale.x));
+		loadedCloud->setMetaData(LAS_SCALE_Y_META_DATA, QVariant(lasScale.y));
+		loadedCloud->setMetaData(LAS_SCALE_Z_META_DATA, QVariant(lasScale.z));
+
+		container.addChild(loadedCloud);
+	}
+	else
+	{
+		//empty cloud?!
+		delete loadedCloud;
+	}
+}
+
+//! Offsets of the standard fields in a LAS point record (formats 0 to 5)
+enum LasRecordOffsets {	LAS_OFFSET_X				= 0,
+						LAS_OFFSET_Y				= 4,
+						LAS_OFFSET_Z				= 8,
+						LAS_OFFSET_INTENSITY		= 12,
+						LAS_OFFSET_RETURN_FLAGS		= 14,
+						LAS_OFFSET_CLASSIFICATION	= 15,
+						LAS_OFFSET_SCAN_ANGLE_RANK	= 16,
+						LAS_OFFSET_USER_DATA		= 17,
+						LAS_OFFSET_POINT_SOURCE_ID	= 18,
+						LAS_OFFSET_END_OF_CORE		= 20 };
+
+//! LAS point record layout (formats 0 to 5)
+struct LasRecordLayout
+{
+	//! Default constructor
+	LasRecordLayout()
+		: recordLength(0)
+		, timeOffset(-1)
+		, rgbOffset(-1)
+	{}
+
+	//! Initializes the layout for a given point format
+	/** \return false if the format is not supported (or if the record length is too small)
+	**/
+	bool init(int formatId, size_t length)
+	{
+		size_t minLength = 0;
+		switch (formatId)
+		{
+		case 0:
+			timeOffset = rgbOffset = -1;
+			minLength = LAS_OFFSET_END_OF_CORE;
+			break;
+		case 1:
+		case 4: //+ wave packets (ignored)
+			timeOffset = LAS_OFFSET_END_OF_CORE;
+			rgbOffset = -1;
+			minLength = LAS_OFFSET_END_OF_CORE + 8;
+			break;
+		case 2:
+			timeOffset = -1;
+			rgbOffset = LAS_OFFSET_END_OF_CORE;
+			minLength = LAS_OFFSET_END_OF_CORE + 6;
+			break;
+		case 3:
+		case 5: //+ wave packets (ignored)
+			timeOffset = LAS_OFFSET_END_OF_CORE;
+			rgbOffset = LAS_OFFSET_END_OF_CORE + 8;
+			minLength = LAS_OFFSET_END_OF_CORE + 14;
+			break;
+		default:
+			return false;
+		}
+
+		recordLength = length;
+		return (recordLength >= minLength);
+	}
+
+	//! Record length (in bytes)
+	size_t recordLength;
+	//! GPS time offset (or -1 if none)
+	int timeOffset;
+	//! RGB color offset (or -1 if none)
+	int rgbOffset;
+};
+
+//! Reads a (little endian) value from a raw LAS record
+template <typename T> static inline T ReadLasValue(const uint8_t* data)
+{
+	T value;
+	memcpy(&value, data, sizeof(T));
+	return value;
+}
+
+//! Returns the value of a scalar field from a raw LAS point record
+static double GetLasFieldValue(const LasField& field, const uint8_t* record, const LasRecordLayout& layout)
+{
+	switch (field.type)
+	{
+	case LAS_INTENSITY:
+		return static_cast<double>(ReadLasValue<uint16_t>(record + LAS_OFFSET_INTENSITY));
+	case LAS_RETURN_NUMBER:
+		return static_cast<double>(record[LAS_OFFSET_RETURN_FLAGS] & 7); //bits #1 to #3
+	case LAS_NUMBER_OF_RETURNS:
+		return static_cast<double>((record[LAS_OFFSET_RETURN_FLAGS] >> 3) & 7); //bits #4 to #6
+	case LAS_SCAN_DIRECTION:
+		return static_cast<double>((record[LAS_OFFSET_RETURN_FLAGS] >> 6) & 1); //bit #7
+	case LAS_FLIGHT_LINE_EDGE:
+		return static_cast<double>((record[LAS_OFFSET_RETURN_FLAGS] >> 7) & 1); //bit #8
+	case LAS_CLASSIFICATION:
+	case LAS_CLASSIF_VALUE:
+		return static_cast<double>(record[LAS_OFFSET_CLASSIFICATION] & 31); //5 bits
+	case LAS_CLASSIF_SYNTHETIC:
+		return static_cast<double>((record[LAS_OFFSET_CLASSIFICATION] >> 5) & 1); //bit #6
+	case LAS_CLASSIF_KEYPOINT:
+		return static_cast<double>((record[LAS_OFFSET_CLASSIFICATION] >> 6) & 1); //bit #7
+	case LAS_CLASSIF_WITHHELD:
+		return static_cast<double>((record[LAS_OFFSET_CLASSIFICATION] >> 7) & 1); //bit #8
+	case LAS_SCAN_ANGLE_RANK:
+		return static_cast<double>(static_cast<int8_t>(record[LAS_OFFSET_SCAN_ANGLE_RANK]));
+	case LAS_USER_DATA:
+		return static_cast<double>(record[LAS_OFFSET_USER_DATA]);
+	case LAS_POINT_SOURCE_ID:
+		return static_cast<double>(ReadLasValue<uint16_t>(record + LAS_OFFSET_POINT_SOURCE_ID));
+	case LAS_TIME:
+		return layout.timeOffset >= 0 ? ReadLasValue<double>(record + layout.timeOffset) : 0.0;
+	case LAS_EXTRA:
+		{
+			const ExtraLasField& extraField = static_cast<const ExtraLasField&>(field);
+			return DecodeExtraValue(record + extraField.dataOffset, extraField);
+		}
+	default:
+		assert(false);
+		break;
+	}
+
+	return 0.0;
+}
+
+//! Number of points per block (bulk reading)
+static const unsigned c_lasBlockSize = 1 << 16;
+//! Number of blocks per thread and per pass (bulk reading)
+static const unsigned c_lasBlocksPerThread = 8;
+
+//! Shared context of the bulk reading of a cloud chunk
+struct LasBulkContext
+{
+	//! First record of the chunk
+	const uint8_t* records;
+	//! Record layout
+	LasRecordLayout layout;
+	//! LAS scale
+	CCVector3d scale;
+	//! LAS offset
+	CCVector3d offset;
+	//! Global shift
+	CCVector3d Pshift;
+	//! Output cloud
+	ccPointCloud* cloud;
+	//! Index of the first record of the chunk (in the file)
+	unsigned chunkStart;
+	//! Loading filters (if any)
+	const FileIOFilter::LoadFilter* filter;
+	//! Fields to load
+	std::vector<LasField*> fields;
+	//! Field value shifts (for time values)
+	std::vector<double> valueShifts;
+	//! Color mask
+	uint16_t rgbMask[3];
+	//! Whether colors should be read
+	bool readColors;
+	//! Color components bit shift (16 bits --> 8 bits)
+	unsigned char colorCompBitShift;
+};
+
+//! Block of points (bulk reading)
+struct LasBulkBlock
+{
+	//! Shared context
+	const LasBulkContext* context;
+	//! Index of the first point (in the chunk)
+	unsigned first;
+	//! Number of points
+	unsigned count;
+	//! Number of points passing the loading filters
+	unsigned keptCount;
+	//! Index of the first kept point in the output cloud
+	unsigned outputFirst;
+	//! Logical OR of all the (masked) color components (kept points only)
+	uint16_t colorBits;
+	//! Field values of the first kept point
+	std::vector<double> firstValues;
+	//! Whether each field has at least one value different from the first one (kept points only)
+	std::vector<char> fieldVaries;
+};
+
+//! Returns whether a record passes the loading filters (if any)
+static inline bool AcceptLasRecord(const LasBulkContext& context, const uint8_t* record, unsigned index)
+{
+	if (!context.filter)
+		return true;
+
+	CCVector3d P(	ReadLasValue<int32_t>(record + LAS_OFFSET_X) * context.scale.x + context.offset.x,
+					ReadLasValue<int32_t>(record + LAS_OFFSET_Y) * context.scale.y + context.offset.y,
+					ReadLasValue<int32_t>(record + LAS_OFFSET_Z) * context.scale.z + context.offset.z);
+	return context.filter->accept(P, record[LAS_OFFSET_CLASSIFICATION] & 31, static_cast<qint64>(context.chunkStart) + index);
+}
+
+//! Scans a block of records (first pass): loading filters, color and field statistics
+static void ScanLasBlock(LasBulkBlock& block)
+{
+	const LasBulkContext& context = *block.context;
+	const size_t recordLength = context.layout.recordLength;
+	const size_t fieldCount = context.fields.size();
+
+	block.keptCount = 0;
+	block.colorBits = 0;
+	block.firstValues.assign(fieldCount, 0.0);
+	block.fieldVaries.assign(fieldCount, 0);
+
+	const uint8_t* record = context.records + static_cast<size_t>(block.first) * recordLength;
+	for (unsigned i=0; i<block.count; ++i, record += recordLength)
+	{
+		if (!AcceptLasRecord(context, record, block.first + i))
+			continue;
+
+		if (block.keptCount++ == 0)
+		{
+			for (size_t j=0; j<fieldCount; ++j)
+				block.firstValues[j] = GetLasFieldValue(*context.fields[j], record, context.layout);
+		}
+
+		if (context.readColors)
+		{
+			const uint8_t* rgb = record + context.layout.rgbOffset;
+			block.colorBits |=	(ReadLasValue<uint16_t>(rgb    ) & context.rgbMask[0])
+							|	(ReadLasValue<uint16_t>(rgb + 2) & context.rgbMask[1])
+							|	(ReadLasValue<uint16_t>(rgb + 4) & context.rgbMask[2]);
+		}
+
+		for (size_t j=0; j<fieldCount; ++j)
+		{
+			if (!block.fieldVaries[j] && GetLasFieldValue(*context.fields[j], record, context.layout) != block.firstValues[j])
+				block.fieldVaries[j] = 1;
+		}
+	}
+}
+
+//! Reads a block of records (second pass): points, colors and scalar fields
+/** Only the points passing the loading filters are written (from block.outputFirst).
+**/
+static void ReadLasBlock(LasBulkBlock& block)
+{
+	const LasBulkContext& context = *block.context;
+	const size_t recordLength = context.layout.recordLength;
+	ccPointCloud* cloud = context.cloud;
+	ColorsTableType* colors = (cloud->hasColors() ? cloud->rgbColors() : 0);
+
+	//the kept records are processed by small batches (the coordinates are converted in a vectorizable loop)
+	static const unsigned c_batchSize = 1024;
+	const uint8_t* batchRecords[c_batchSize];
+	int32_t raw[3][c_batchSize];
+	PointCoordinateType coords[3][c_batchSize];
+
+	const uint8_t* blockRecords = context.records + static_cast<size_t>(block.first) * recordLength;
+	unsigned outputIndex = block.outputFirst;
+	unsigned i = 0;
+	while (i < block.count)
+	{
+		//collect the next kept records
+		unsigned batchCount = 0;
+		for (; i<block.count && batchCount<c_batchSize; ++i)
+		{
+			const uint8_t* record = blockRecords + static_cast<size_t>(i) * recordLength;
+			if (AcceptLasRecord(context, record, block.first + i))
+				batchRecords[batchCount++] = record;
+		}
+		if (batchCount == 0)
+			break;
+
+		//raw coordinates
+		for (unsigned k=0; k<batchCount; ++k)
+		{
+			raw[0][k] = ReadLasValue<int32_t>(batchRecords[k] + LAS_OFFSET_X);
+			raw[1][k] = ReadLasValue<int32_t>(batchRecords[k] + LAS_OFFSET_Y);
+			raw[2][k] = ReadLasValue<int32_t>(batchRecords[k] + LAS_OFFSET_Z);
+		}
+
+		//scale, offset and shift
+		for (unsigned d=0; d<3; ++d)
+		{
+			const double scale = context.scale.u[d];
+			const double offset = context.offset.u[d];
+			const double shift = context.Pshift.u[d];
+			const int32_t* _raw = raw[d];
+			PointCoordinateType* _coords = coords[d];
+			for (unsigned k=0; k<batchCount; ++k)
+			{
+				_coords[k] = static_cast<PointCoordinateType>((_raw[k] * scale + offset) + shift);
+			}
+		}
+
+		for (unsigned k=0; k<batchCount; ++k)
+		{
+			CCVector3* P = cloud->point(outputIndex + k);
+			P->x = coords[0][k];
+			P->y = coords[1][k];
+			P->z = coords[2][k];
+		}
+
+		//colors
+		if (colors)
+		{
+			for (unsigned k=0; k<batchCount; ++k)
+			{
+				const uint8_t* record = batchRecords[k] + context.layout.rgbOffset;
+				ColorCompType* rgb = colors->getValue(outputIndex + k);
+				rgb[0] = static_cast<ColorCompType>((ReadLasValue<uint16_t>(record    ) & context.rgbMask[0]) >> context.colorCompBitShift);
+				rgb[1] = static_cast<ColorCompType>((ReadLasValue<uint16_t>(record + 2) & context.rgbMask[1]) >> context.colorCompBitShift);
+				rgb[2] = static_cast<ColorCompType>((ReadLasValue<uint16_t>(record + 4) & context.rgbMask[2]) >> context.colorCompBitShift);
+			}
+		}
+
+		//scalar fields
+		for (size_t j=0; j<context.fields.size(); ++j)
+		{
+			const LasField& field = *context.fields[j];
+			if (!field.sf)
+				continue;
+
+			const double valueShift = context.valueShifts[j];
+			for (unsigned k=0; k<batchCount; ++k)
+			{
+				double value = GetLasFieldValue(field, batchRecords[k], context.layout) - valueShift;
+				field.sf->setValue(outputIndex + k, static_cast<ScalarType>(value));
+			}
+		}
+
+		outputIndex += batchCount;
+	}
+
+	assert(outputIndex == block.outputFirst + block.keptCount);
+}
+
+//! Runs one pass over the blocks of a cloud chunk (by groups of blocks, so as to update the progress bar)
+/** \return false if the process has been cancelled
+**/
+static bool ProcessLasBlocks(	std::vector<LasBulkBlock>& blocks,
+								void (*process)(LasBulkBlock&),
+								ccProgressDialog* pDlg,
+								float progressStart,
+								float progressRange,
+								size_t* processedBlocks = 0)
+{
+	if (blocks.empty())
+		return true;
+	const float chunkSize = static_cast<float>(blocks.back().first + blocks.back().count);
+
+	size_t groupSize = std::max<size_t>(1, static_cast<size_t>(QThread::idealThreadCount()) * c_lasBlocksPerThread);
+	for (size_t start=0; start<blocks.size(); start+=groupSize)
+	{
+		size_t stop = std::min(blocks.size(), start + groupSize);
+		QtConcurrent::blockingMap(blocks.begin() + start, blocks.begin() + stop, process);
+		if (processedBlocks)
+			*processedBlocks = stop;
+
+		if (pDlg)
+		{
+			float pointsDone = static_cast<float>(blocks[stop-1].first + blocks[stop-1].count);
+			pDlg->update(progressStart + progressRange * pointsDone / chunkSize);
+			QApplication::processEvents();
+			if (pDlg->wasCanceled())
+				return false;
+		}
+	}
+
+	return true;
+}
+
+//! Loads the points of an uncompressed LAS file (formats 0 to 5) by blocks, directly from the mapped records
+/** The result is the same as with the point-by-point reader (the same fields and colors are
+	kept, the clouds are split in the same way), except that the blocks are decoded in parallel.
+	The loading filters (if any) are applied in the first pass, so that only the kept points
+	are allocated.
+	\param keptPoints number of points actually loaded (output)
+**/
+static CC_FILE_ERROR LoadMappedLasRecords(	const uint8_t* records,
+											unsigned pointCount,
+											const LasRecordLayout& layout,
+											const liblas::Header& header,
+											const liblas::Dimension* extraDimension,
+											const std::vector<EVLR>& evlrs,
+											const liblas::Color& rgbColorMask,
+											bool loadColor,
+											bool ignoreDefaultFields,
+											bool forced8bitRgbMode,
+											ccProgressDialog* pDlg,
+											FileIOFilter::LoadParameters& parameters,
+											ccHObject& container,
+											unsigned& keptPoints)
+{
+	CCVector3d lasScale  = CCVector3d(header.GetScaleX(),  header.GetScaleY(),  header.GetScaleZ());
+	CCVector3d lasOffset = CCVector3d(header.GetOffsetX(), header.GetOffsetY(), header.GetOffsetZ());
+	CCVector3d lasShift = -lasOffset;
+
+	LasBulkContext context;
+	context.layout = layout;
+	context.scale = lasScale;
+	context.offset = lasOffset;
+	context.Pshift = CCVector3d(0,0,0);
+	context.cloud = 0;
+	context.chunkStart = 0;
+	//the voxel decimation is order dependent: it can't be handled here
+	assert(parameters.filter.voxelStep <= 0);
+	context.filter = (parameters.filter.isActive() ? &parameters.filter : 0);
+	context.rgbMask[0] = static_cast<uint16_t>(rgbColorMask.GetRed());
+	context.rgbMask[1] = static_cast<uint16_t>(rgbColorMask.GetGreen());
+	context.rgbMask[2] = static_cast<uint16_t>(rgbColorMask.GetBlue());
+	context.readColors = false;
+	context.colorCompBitShift = 0;
+
+	keptPoints = 0;
+	bool cancelled = false;
+	unsigned pointsRead = 0;
+	while (pointsRead < pointCount && !cancelled)
+	{
+		unsigned chunkSize = std::min(pointCount - pointsRead, CC_MAX_NUMBER_OF_POINTS_PER_CLOUD);
+		context.records = records + static_cast<size_t>(pointsRead) * layout.recordLength;
+		context.chunkStart = pointsRead;
+
+		//the points will only be reserved once we know how many of them are kept
+		ccPointCloud* loadedCloud = new ccPointCloud();
+		loadedCloud->setGlobalShift(context.Pshift);
+		context.cloud = loadedCloud;
+
+		//first point: check for 'big' coordinates
+		if (pointsRead == 0)
+		{
+			const uint8_t* firstRecord = context.records;
+			CCVector3d P(	ReadLasValue<int32_t>(firstRecord + LAS_OFFSET_X) * lasScale.x + lasOffset.x,
+							ReadLasValue<int32_t>(firstRecord + LAS_OFFSET_Y) * lasScale.y + lasOffset.y,
+							ReadLasValue<int32_t>(firstRecord + LAS_OFFSET_Z) * lasScale.z + lasOffset.z);
+			HandleLasGlobalShift(P, lasShift, context.Pshift, parameters, loadedCloud);
+		}
+
+		std::vector<LasField::Shared> fieldsToLoad;
+		PrepareFieldsToLoad(fieldsToLoad, extraDimension, evlrs);
+		for (size_t j=0; j<fieldsToLoad.size(); )
+		{
+			const ExtraLasField* extraField = (fieldsToLoad[j]->type == LAS_EXTRA ? static_cast<const ExtraLasField*>(fieldsToLoad[j].data()) : 0);
+			if (extraField && static_cast<size_t>(extraField->dataOffset) + ExtraLasField::GetSizeBytes(extraField->valType) > layout.recordLength)
+			{
+				ccLog::Warning(QString("[LAS] Extra field '%1' is out of the point records: it will be ignored").arg(extraField->getName()));
+				fieldsToLoad.erase(fieldsToLoad.begin() + j);
+			}
+			else
+			{
+				++j;
+			}
+		}
+
+		context.fields.clear();
+		context.valueShifts.clear();
+		for (size_t j=0; j<fieldsToLoad.size(); ++j)
+		{
+			context.fields.push_back(fieldsToLoad[j].data());
+			context.valueShifts.push_back(0.0);
+		}
+		context.readColors = (loadColor && layout.rgbOffset >= 0);
+
+		//blocks
+		std::vector<LasBulkBlock> blocks;
+		try
+		{
+			blocks.resize((chunkSize + c_lasBlockSize - 1) / c_lasBlockSize);
+		}
+		catch (const std::bad_alloc&)
+		{
+			delete loadedCloud;
+			return CC_FERR_NOT_ENOUGH_MEMORY;
+		}
+		for (size_t b=0; b<blocks.size(); ++b)
+		{
+			blocks[b].context = &context;
+			blocks[b].first = static_cast<unsigned>(b * c_lasBlockSize);
+			blocks[b].count = std::min(c_lasBlockSize, chunkSize - blocks[b].first);
+			blocks[b].keptCount = 0;
+			blocks[b].outputFirst = 0;
+			blocks[b].colorBits = 0;
+		}
+
+		//progress: each chunk is processed in 2 passes
+		const float chunkProgressStart = (100.0f * pointsRead) / pointCount;
+		const float passProgressRange = (50.0f * chunkSize) / pointCount;
+
+		//first pass: loading filters, colors and fields statistics
+		if (!ProcessLasBlocks(blocks, ScanLasBlock, pDlg, chunkProgressStart, passProgressRange))
+		{
+			delete loadedCloud;
+			break;
+		}
+
+		//position of each block in the output cloud
+		unsigned keptCount = 0;
+		const LasBulkBlock* firstKeptBlock = 0;
+		for (size_t b=0; b<blocks.size(); ++b)
+		{
+			blocks[b].outputFirst = keptCount;
+			keptCount += blocks[b].keptCount;
+			if (!firstKeptBlock && blocks[b].keptCount != 0)
+				firstKeptBlock = &blocks[b];
+		}
+		pointsRead += chunkSize;
+
+		if (keptCount == 0)
+		{
+			//all the points of this chunk have been filtered out
+			delete loadedCloud;
+			continue;
+		}
+
+		if (!loadedCloud->reserveThePointsTable(keptCount))
+		{
+			ccLog::Warning("[LAS] Not enough memory!");
+			delete loadedCloud;
+			return CC_FERR_NOT_ENOUGH_MEMORY;
+		}
+
+		//colors
+		if (context.readColors)
+		{
+			uint16_t colorBits = 0;
+			for (size_t b=0; b<blocks.size(); ++b)
+				colorBits |= blocks[b].colorBits;
+
+			//we only load the colors if at least one is not black
+			if (colorBits != 0)
+			{
+				if (!loadedCloud->reserveTheRGBTable())
+				{
+					ccLog::Warning("[LAS] Not enough memory: color field will be ignored!");
+					loadColor = false; //no need to retry with the other chunks anyway
+				}
+				//we test if the color components are on 16 bits (standard) or only on 8 bits (it happens ;)
+				else if (!forced8bitRgbMode && context.colorCompBitShift == 0 && (colorBits & 0xFF00))
+				{
+					ccLog::Print("[LAS] Color components are coded on 16 bits");
+					//the whole chunk is shifted (it is decoded after this test). The point-by-point reader
+					//instead resets the colors read before the first 16 bits one to black: this is the same
+					//result, as all the components of these colors are below 256 (255 >> 8 = 0!)
+					context.colorCompBitShift = 8;
+				}
+			}
+		}
+
+		if (!loadedCloud->resize(keptCount))
+		{
+			ccLog::Warning("[LAS] Not enough memory!");
+			delete loadedCloud;
+			return CC_FERR_NOT_ENOUGH_MEMORY;
+		}
+
+		//scalar fields (we only enable them when we detect a valid value)
+		for (size_t j=0; j<context.fields.size(); ++j)
+		{
+			LasField* field = context.fields[j];
+			field->firstValue = firstKeptBlock->firstValues[j];
+			bool varies = false;
+			for (size_t b=0; b<blocks.size() && !varies; ++b)
+			{
+				varies = (		blocks[b].keptCount != 0
+							&&	(blocks[b].fieldVaries[j] != 0 || blocks[b].firstValues[j] != field->firstValue));
+			}
+
+			if (	!ignoreDefaultFields
+				||	varies
+				||	(field->firstValue != field->defaultValue && field->firstValue >= field->minValue))
+			{
+				field->sf = new ccScalarField(qPrintable(field->getName()));
+				if (field->sf->resize(keptCount))
+				{
+					field->sf->link();
+
+					if (field->type == LAS_TIME)
+					{
+						//we use the first value as 'global shift' (otherwise we will lose accuracy)
+						field->sf->setGlobalShift(field->firstValue);
+						context.valueShifts[j] = field->firstValue;
+						ccLog::Warning("[LAS] Time SF has been shifted to prevent a loss of accuracy (%.2f)",field->firstValue);
+						field->firstValue = 0;
+					}
+				}
+				else
+				{
+					ccLog::Warning(QString("[LAS] Not enough memory: '%1' field will be ignored!").arg(field->getName()));
+					field->sf->release();
+					field->sf = 0;
+				}
+			}
+		}
+
+		//second pass: points, colors and scalar fields
+		size_t readBlocks = 0;
+		if (!ProcessLasBlocks(blocks, ReadLasBlock, pDlg, chunkProgressStart + passProgressRange, passProgressRange, &readBlocks))
+		{
+			//we keep the points read so far
+			cancelled = true;
+			unsigned readCount = (readBlocks < blocks.size() ? blocks[readBlocks].outputFirst : keptCount);
+			loadedCloud->resize(readCount);
+			for (size_t j=0; j<context.fields.size(); ++j)
+			{
+				if (context.fields[j]->sf)
+					context.fields[j]->sf->resize(readCount);
+			}
+			keptCount = readCount;
+		}
+
+		FinalizeLoadedCloud(loadedCloud, fieldsToLoad, loadColor, lasScale, container);
+		context.cloud = 0;
+
+		keptPoints += keptCount;
+	}
+
+	return CC_FERR_NO_ERROR;
+}
+
 CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadParameters& parameters)
 {
 	//opening file
@@ -950,6 +1943,81 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 		unsigned int fileChunkPos = 0;
 		unsigned int fileChunkSize = 0;
 
+		//spatial subsampling at loading time (the memory then only depends on the number of kept points)
+		QSharedPointer<CCLib::SpatialStreamSampler> sampler;
+		if (parameters.spatialSubsamplingStep > 0 && !tiling)
+		{
+			sampler = QSharedPointer<CCLib::SpatialStreamSampler>(new CCLib::SpatialStreamSampler(parameters.spatialSubsamplingStep));
+		}
+
+		//point filters (the rejected points are skipped before being stored)
+		const FileIOFilter::LoadFilter& pointFilter = parameters.filter;
+		const bool filterPoints = pointFilter.isActive();
+		QSharedPointer<LasVoxelDecimator> decimator;
+		if (pointFilter.voxelStep > 0)
+		{
+			decimator = QSharedPointer<LasVoxelDecimator>(new LasVoxelDecimator(pointFilter.voxelStep));
+		}
+		//number of points actually loaded (or written in tiles)
+		unsigned keptPoints = 0;
+		//whether the clouds should grow progressively
+		const bool streamedSelection = (sampler || filterPoints);
+
+		//uncompressed files: we can read the point records by blocks, directly from the mapped file
+		//(much faster than the point-by-point reader, but neither for tiling nor for order dependent subsampling)
+		LasRecordLayout recordLayout;
+		if (	!tiling
+			&&	!sampler
+			&&	!decimator
+			&&	!header.Compressed()
+			&&	QSysInfo::ByteOrder == QSysInfo::LittleEndian
+			&&	recordLayout.init(static_cast<int>(header.GetDataFormatId()), header.GetDataRecordLength()))
+		{
+			QFile rawFile(filename);
+			qint64 dataOffset = static_cast<qint64>(header.GetDataOffset());
+			qint64 dataSize = static_cast<qint64>(recordLayout.recordLength) * nbOfPoints;
+			uchar* records = 0;
+			if (rawFile.open(QIODevice::ReadOnly) && rawFile.size() >= dataOffset + dataSize)
+			{
+				records = rawFile.map(dataOffset, dataSize);
+			}
+
+			if (records)
+			{
+				QElapsedTimer eTimer;
+				eTimer.start();
+
+				result = LoadMappedLasRecords(	records,
+												nbOfPoints,
+												recordLayout,
+												header,
+												extraDimension,
+												evlrs,
+												rgbColorMask,
+												loadColor,
+												ignoreDefaultFields,
+												forced8bitRgbMode,
+												parameters.parentWidget ? &pdlg : 0,
+												parameters,
+												container,
+												keptPoints);
+
+				double elapsed_s = eTimer.elapsed() / 1000.0;
+				ccLog::Print(QString("[LAS] %1 points read by blocks in %2 s. (%3 Mpts/s)").arg(nbOfPoints).arg(elapsed_s, 0, 'f', 2).arg(nbOfPoints / 1.0e6 / std::max(elapsed_s, 0.001), 0, 'f', 2));
+				if (filterPoints)
+				{
+					ccLog::Print(QString("[LAS] Loading filters: %1 points kept out of %2").arg(keptPoints).arg(nbOfPoints));
+				}
+
+				rawFile.unmap(records);
+				rawFile.close();
+				ifs.close();
+				return result;
+			}
+
+			ccLog::Warning("[LAS] Failed to map the file: points will be read one by one");
+		}
+
 		while (true)
 		{
 			//if we reach the end of the file, or the max. cloud size limit (in which case we cerate a new chunk)
@@ -970,7 +2038,22 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 				if (newPointAvailable)
 				{
 					const liblas::Point& p = reader.GetPoint();
-					tiler.writePoint(p);
+					LasVoxelDecimator::Result filtering = LasVoxelDecimator::KEPT;
+					if (filterPoints)
+					{
+						filtering = FilterLasPoint(CCVector3d(p.GetX(), p.GetY(), p.GetZ()), p.GetClassification().GetClass(), pointsRead, pointFilter, decimator.data());
+					}
+					if (filtering == LasVoxelDecimator::NOT_ENOUGH_MEMORY)
+					{
+						result = CC_FERR_NOT_ENOUGH_MEMORY;
+						break;
+					}
+					if (filtering == LasVoxelDecimator::KEPT)
+					{
+						tiler.writePoint(p);
+						++keptPoints;
+					}
+					++pointsRead;
 				}
 				else
 				{
@@ -985,88 +2068,8 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 				if (loadedCloud)
 				{
 					assert(!tiling);
-					if (loadedCloud->size())
-					{
-						bool thisChunkHasColors = loadedCloud->hasColors();
-						loadedCloud->showColors(thisChunkHasColors);
-						if (loadColor && !thisChunkHasColors)
-						{
-							ccLog::Warning("[LAS] Color field was all black! We ignored it...");
-						}
-
-						while (!fieldsToLoad.empty())
-						{
-							LasField::Shared& field = fieldsToLoad.back();
-							if (field && field->sf)
-							{
-								field->sf->computeMinAndMax();
-
-								if (	field->type == LAS_CLASSIFICATION
-									||	field->type == LAS_CLASSIF_VALUE
-									||	field->type == LAS_CLASSIF_SYNTHETIC
-									||	field->type == LAS_CLASSIF_KEYPOINT
-									||	field->type == LAS_CLASSIF_WITHHELD
-									||	field->type == LAS_RETURN_NUMBER
-									||	field->type == LAS_NUMBER_OF_RETURNS)
-								{
-									int cMin = static_cast<int>(field->sf->getMin());
-									int cMax = static_cast<int>(field->sf->getMax());
-									field->sf->setColorRampSteps(std::min<int>(cMax-cMin+1,256));
-									//classifSF->setMinSaturation(cMin);
-								}
-								else if (field->type == LAS_INTENSITY)
-								{
-									field->sf->setColorScale(ccColorScalesManager::GetDefaultScale(ccColorScalesManager::GREY));
-								}
-
-								int sfIndex = loadedCloud->addScalarField(field->sf);
-								if (!loadedCloud->hasDisplayedScalarField())
-								{
-									loadedCloud->setCurrentDisplayedScalarField(sfIndex);
-									loadedCloud->showSF(!thisChunkHasColors);
-								}
-								field->sf->release();
-								field->sf = 0;
-							}
-							else
-							{
-								ccLog::Warning(QString("[LAS] All '%1' values were the same (%2)! We ignored them...").arg(field->type == LAS_EXTRA ? field->getName() : QString(LAS_FIELD_NAMES[field->type])).arg(field->firstValue));
-							}
-
-							fieldsToLoad.pop_back();
-						}
-
-						//if we have reserved too much memory
-						if (loadedCloud->size() < loadedCloud->capacity())
-						{
-							loadedCloud->resize(loadedCloud->size());
-						}
-
-						QString chunkName("unnamed - Cloud");
-						unsigned n = container.getChildrenNumber();
-						if (n != 0) //if we have more than one cloud, we append an index
-						{
-							if (n == 1)  //we must also update the first one!
-							{
-								container.getChild(0)->setName(chunkName + QString(" #1"));
-							}
-							chunkName += QString(" #%1").arg(n+1);
-						}
-						loadedCloud->setName(chunkName);
-
-						loadedCloud->setMetaData(LAS_SCALE_X_META_DATA, QVariant(lasScale.x));
-						loadedCloud->setMetaData(LAS_SCALE_Y_META_DATA, QVariant(lasScale.y));
-						loadedCloud->setMetaData(LAS_SCALE_Z_META_DATA, QVariant(lasScale.z));
-
-						container.addChild(loadedCloud);
-						loadedCloud = 0;
-					}
-					else
-					{
-						//empty cloud?!
-						delete loadedCloud;
-						loadedCloud = 0;
-					}
+					FinalizeLoadedCloud(loadedCloud, fieldsToLoad, loadColor, lasScale, container);
+					loadedCloud = 0;
 				}
 
 				if (!newPointAvailable)
@@ -1078,7 +2081,7 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 				fileChunkPos = pointsRead;
 				fileChunkSize = std::min(nbOfPoints - pointsRead, CC_MAX_NUMBER_OF_POINTS_PER_CLOUD);
 				loadedCloud = new ccPointCloud();
-				if (!loadedCloud->reserveThePointsTable(fileChunkSize))
+				if (!loadedCloud->reserveThePointsTable(streamedSelection ? std::min(fileChunkSize, c_subsampledCloudReserveStep) : fileChunkSize))
 				{
 					ccLog::Warning("[LAS] Not enough memory!");
 					delete loadedCloud;
@@ -1087,123 +2090,7 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 				}
 				loadedCloud->setGlobalShift(Pshift);
 
-				//DGM: from now on, we only enable scalar fields when we detect a valid value!
-				if (s_lasOpenDlg->doLoad(LAS_CLASSIFICATION))
-					fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_CLASSIFICATION,0,0,255))); //unsigned char: between 0 and 255
-				if (s_lasOpenDlg->doLoad(LAS_CLASSIF_VALUE))
-					fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_CLASSIF_VALUE,0,0,31))); //5 bits: between 0 and 31
-				if (s_lasOpenDlg->doLoad(LAS_CLASSIF_SYNTHETIC))
-					fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_CLASSIF_SYNTHETIC,0,0,1))); //1 bit: 0 or 1
-				if (s_lasOpenDlg->doLoad(LAS_CLASSIF_KEYPOINT))
-					fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_CLASSIF_KEYPOINT,0,0,1))); //1 bit: 0 or 1
-				if (s_lasOpenDlg->doLoad(LAS_CLASSIF_WITHHELD))
-					fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_CLASSIF_WITHHELD,0,0,1))); //1 bit: 0 or 1
-				if (s_lasOpenDlg->doLoad(LAS_INTENSITY))
-					fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_INTENSITY,0,0,65535))); //16 bits: between 0 and 65536
-				if (s_lasOpenDlg->doLoad(LAS_TIME))
-					fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_TIME,0,0,-1.0))); //8 bytes (double) --> we use global shift!
-				if (s_lasOpenDlg->doLoad(LAS_RETURN_NUMBER))
-					fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_RETURN_NUMBER,1,1,7))); //3 bits: between 1 and 7
-				if (s_lasOpenDlg->doLoad(LAS_NUMBER_OF_RETURNS))
-					fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_NUMBER_OF_RETURNS,1,1,7))); //3 bits: between 1 and 7
-				if (s_lasOpenDlg->doLoad(LAS_SCAN_DIRECTION))
-					fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_SCAN_DIRECTION,0,0,1))); //1 bit: 0 or 1
-				if (s_lasOpenDlg->doLoad(LAS_FLIGHT_LINE_EDGE))
-					fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_FLIGHT_LINE_EDGE,0,0,1))); //1 bit: 0 or 1
-				if (s_lasOpenDlg->doLoad(LAS_SCAN_ANGLE_RANK))
-					fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_SCAN_ANGLE_RANK,0,-90,90))); //signed char: between -90 and +90
-				if (s_lasOpenDlg->doLoad(LAS_USER_DATA))
-					fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_USER_DATA,0,0,255))); //unsigned char: between 0 and 255
-				if (s_lasOpenDlg->doLoad(LAS_POINT_SOURCE_ID))
-					fieldsToLoad.push_back(LasField::Shared(new LasField(LAS_POINT_SOURCE_ID,0,0,65535))); //16 bits: between 0 and 65536
-
-				//Extra fields
-				if (s_lasOpenDlg->doLoad(LAS_EXTRA))
-				{
-					if (extraDimension)
-					{
-						assert(!evlrs.empty());
-						const size_t extraBytesOffset = extraDimension->GetByteOffset();
-						size_t localOffset = 0;
-						for (size_t i=0; i<evlrs.size(); ++i)
-						{
-							unsigned char data_type = evlrs[i].data_type;
-							//We split the fields with mutliple values in multiple scalar fields!
-							unsigned subFieldCount = 1;
-							if (evlrs[i].data_type > 20)
-							{
-								subFieldCount = 3;
-								data_type -= 20;
-							}
-							else if (evlrs[i].data_type > 10)
-							{
-								subFieldCount = 2;
-								data_type -= 10;
-							}
-
-							for (unsigned j = 0; j < subFieldCount; ++j)
-							{
-								size_t dataOffset = extraBytesOffset + localOffset;
-
-								//move forward (and check that the byte count is ok!)
-								assert(data_type <= ExtraLasField::EXTRA_DOUBLE);
-								ExtraLasField::Type type = static_cast<ExtraLasField::Type>(data_type);
-								localOffset += ExtraLasField::GetSizeBytes(type);
-							
-								if (localOffset <= extraDimension->GetByteSize())
-								{
-									if (s_lasOpenDlg->doLoadEVLR(i))
-									{
-										QString fieldName(evlrs[i].getName());
-										if (subFieldCount > 1)
-											fieldName += QString(".%1").arg(j+1);
-
-										const unsigned char options = evlrs[i].options;
-
-										//read the first optional informations
-										double defaultVal = 0;
-										double minVal = 0;
-										double maxVal = -1.0;
-										//DGM: the first 3 (no_data, min and max) are a bit
-										//dangerous to use because we don't know if they have
-										//been saved as double values (as Laspy do!) or if
-										//the same type as ExtraLasField::Type is used!
-										if (false)
-										{
-											if (options & 1) //1st bit = no_data_bit
-												defaultVal = evlrs[i].no_data[j];
-											if (options & 2) //2nd bit = min_bit
-												minVal = evlrs[i].min[j];
-											if (options & 3) //3rd bit = max_bit
-												maxVal = evlrs[i].max[j];
-										}
-
-										ExtraLasField* eField = new ExtraLasField(fieldName,type,static_cast<int>(dataOffset),defaultVal,minVal,maxVal);
-
-										//read the other optional information (scale and offset)
-										{
-											if (options & 4) //4th bit = scale_bit
-												eField->scale = evlrs[i].scale[j];
-											if (options & 5) //5th bit = offset_bit
-												eField->offset = evlrs[i].offset[j];
-										}
-										fieldsToLoad.push_back(LasField::Shared(eField));
-									}
-								}
-								else
-								{
-									ccLog::Warning("[LAS] Internal consistency of extra fields is broken! (more values defined that available types...)");
-									break;
-								}
-							}
-						}
-					}
-					else
-					{
-						//shouldn't happen:
-						assert(false);
-					}
-				}
+				PrepareFieldsToLoad(fieldsToLoad, extraDimension, evlrs);
 			}
 
 			assert(newPointAvailable);
@@ -1212,35 +2099,59 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 			//first point: check for 'big' coordinates
 			if (pointsRead == 0)
 			{
-				CCVector3d P(p.GetX(), p.GetY(), p.GetZ());
-				//backup input global parameters
-				ccGlobalShiftManager::Mode csModeBackup = parameters.shiftHandlingMode;
-				bool useLasShift = false;
-				//set the LAS shift as default shift (if none was provided)
-				if (lasShift.norm2() != 0 && (!parameters.coordinatesShiftEnabled || !*parameters.coordinatesShiftEnabled))
+				HandleLasGlobalShift(CCVector3d(p.GetX(), p.GetY(), p.GetZ()), lasShift, Pshift, parameters, loadedCloud);
+			}
+
+			CCVector3 P(static_cast<PointCoordinateType>(p.GetX() + Pshift.x),
+						static_cast<PointCoordinateType>(p.GetY() + Pshift.y),
+						static_cast<PointCoordinateType>(p.GetZ() + Pshift.z));
+
+			bool notEnoughMemory = false;
+			if (filterPoints)
+			{
+				LasVoxelDecimator::Result filtering = FilterLasPoint(CCVector3d(p.GetX(), p.GetY(), p.GetZ()), p.GetClassification().GetClass(), pointsRead, pointFilter, decimator.data());
+				if (filtering == LasVoxelDecimator::REJECTED)
 				{
-					useLasShift = true;
-					Pshift = lasShift;
-					if (	csModeBackup != ccGlobalShiftManager::NO_DIALOG
-						&&	csModeBackup != ccGlobalShiftManager::NO_DIALOG_AUTO_SHIFT)
-					{
-						parameters.shiftHandlingMode = ccGlobalShiftManager::ALWAYS_DISPLAY_DIALOG;
-					}
+					//filtered out
+					++pointsRead;
+					continue;
 				}
-				if (HandleGlobalShift(P, Pshift, parameters, useLasShift))
+				notEnoughMemory = (filtering == LasVoxelDecimator::NOT_ENOUGH_MEMORY);
+			}
+
+			if (sampler && !notEnoughMemory)
+			{
+				CCLib::SpatialStreamSampler::Result sampling = sampler->addPoint(P);
+				if (sampling == CCLib::SpatialStreamSampler::REJECTED)
 				{
-					loadedCloud->setGlobalShift(Pshift);
-					ccLog::Warning("[LAS] Cloud has been recentered! Translation: (%.2f,%.2f,%.2f)", Pshift.x, Pshift.y, Pshift.z);
+					//too close to an already loaded point
+					++pointsRead;
+					continue;
 				}
+				notEnoughMemory = (sampling == CCLib::SpatialStreamSampler::NOT_ENOUGH_MEMORY);
+			}
 
-				//restore previous parameters
-				parameters.shiftHandlingMode = csModeBackup;
+			if (	notEnoughMemory
+				||	(	streamedSelection
+					&&	loadedCloud->size() == loadedCloud->capacity()
+					&&	!ReserveMorePoints(loadedCloud, fieldsToLoad, std::min(loadedCloud->capacity() + c_subsampledCloudReserveStep, fileChunkSize))))
+			{
+				ccLog::Warning("[LAS] Not enough memory!");
+				for (std::vector<LasField::Shared>::iterator it = fieldsToLoad.begin(); it != fieldsToLoad.end(); ++it)
+				{
+					if ((*it)->sf)
+					{
+						(*it)->sf->release();
+						(*it)->sf = 0;
+					}
+				}
+				delete loadedCloud;
+				ifs.close();
+				return CC_FERR_NOT_ENOUGH_MEMORY;
 			}
 
-			CCVector3 P(static_cast<PointCoordinateType>(p.GetX() + Pshift.x),
-						static_cast<PointCoordinateType>(p.GetY() + Pshift.y),
-						static_cast<PointCoordinateType>(p.GetZ() + Pshift.z));
 			loadedCloud->addPoint(P);
+			++keptPoints;
 
 			//color field
 			if (loadColor)
@@ -1355,44 +2266,7 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 						assert(extraDimension && extraField->dataOffset < static_cast<int>(p.GetData().size()));
 						const uint8_t* v = &(p.GetData()[extraField->dataOffset]);
 
-						switch(extraField->valType)
-						{
-						case ExtraLasField::EXTRA_UINT8:
-							value = static_cast<double>(*(reinterpret_cast<const uint8_t*>(v)));
-							break;
-						case ExtraLasField::EXTRA_INT8:
-							value = static_cast<double>(*(reinterpret_cast<const int8_t*>(v)));
-							break;
-						case ExtraLasField::EXTRA_UINT16:
-							value = static_cast<double>(*(reinterpret_cast<const uint16_t*>(v)));
-							break;
-						case ExtraLasField::EXTRA_INT16:
-							value = static_cast<double>(*(reinterpret_cast<const int16_t*>(v)));
-							break;
-						case ExtraLasField::EXTRA_UINT32:
-							value = static_cast<double>(*(reinterpret_cast<const uint32_t*>(v)));
-							break;
-						case ExtraLasField::EXTRA_INT32:
-							value = static_cast<double>(*(reinterpret_cast<const int32_t*>(v)));
-							break;
-						case ExtraLasField::EXTRA_UINT64:
-							value = static_cast<double>(*(reinterpret_cast<const uint64_t*>(v)));
-							break;
-						case ExtraLasField::EXTRA_INT64:
-							value = static_cast<double>(*(reinterpret_cast<const int64_t*>(v)));
-							break;
-						case ExtraLasField::EXTRA_FLOAT:
-							value = static_cast<double>(*(reinterpret_cast<const float*>(v)));
-							break;
-						case ExtraLasField::EXTRA_DOUBLE:
-							value = static_cast<double>(*(reinterpret_cast<const double*>(v)));
-							break;
-						default:
-							assert(false);
-							break;
-						}
-
-						value = extraField->offset + extraField->scale * value;
+						value = DecodeExtraValue(v, *extraField);
 					}
 					break;
 				case LAS_RED:
@@ -1412,13 +2286,13 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 					value = static_cast<double>(p.GetClassification().GetClass() & 31); //5 bits
 					break;
 				case LAS_CLASSIF_SYNTHETIC:
-					value = static_cast<double>(p.GetClassification().GetClass() & 32); //bit #6
+					value = static_cast<double>((p.GetData()[LAS_OFFSET_CLASSIFICATION] >> 5) & 1); //bit #6
 					break;
 				case LAS_CLASSIF_KEYPOINT:
-					value = static_cast<double>(p.GetClassification().GetClass() & 64); //bit #7
+					value = static_cast<double>((p.GetData()[LAS_OFFSET_CLASSIFICATION] >> 6) & 1); //bit #7
 					break;
 				case LAS_CLASSIF_WITHHELD:
-					value = static_cast<double>(p.GetClassification().GetClass() & 128); //bit #8
+					value = static_cast<double>((p.GetData()[LAS_OFFSET_CLASSIFICATION] >> 7) & 1); //bit #8
 					break;
 				case LAS_INVALID:
 				default:
@@ -1444,7 +2318,7 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 						||	(field->firstValue != field->defaultValue && field->firstValue >= field->minValue))
 					{
 						field->sf = new ccScalarField(qPrintable(field->getName()));
-						if (field->sf->reserve(fileChunkSize))
+						if (field->sf->reserve(loadedCloud->capacity()))
 						{
 							field->sf->link();
 
@@ -1480,6 +2354,15 @@ CC_FILE_ERROR LASFilter::loadFile(QString filename, ccHObject& container, LoadPa
 			++pointsRead;
 		}
 
+		if (sampler)
+		{
+			ccLog::Print(QString("[LAS] Spatial subsampling on load (step = %1): %2 points kept out of %3").arg(sampler->minDistance()).arg(sampler->size()).arg(pointsRead));
+		}
+		else if (filterPoints)
+		{
+			ccLog::Print(QString("[LAS] Loading filters: %1 points kept out of %2").arg(keptPoints).arg(pointsRead));
+		}
+
 		if (tiling)
 		{
 			size_t tileCount = tiler.tileCount();
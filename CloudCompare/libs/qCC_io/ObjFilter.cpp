@@ -16,6 +16,7 @@
 //##########################################################################
 
 #include "ObjFilter.h"
+#include "AsciiTokenizer.h"
 
 //Qt
 #include <QApplication>
@@ -24,6 +25,10 @@
 #include <QString>
 #include <QFile>
 #include <QTextStream>
+#include <QElapsedTimer>
+#include <QRegExp>
+#include <QThread>
+#include <QtConcurrentMap>
 
 //qCC_db
 #include <ccLog.h>
@@ -397,6 +402,243 @@ struct facetElement
 	}
 };
 
+//! Size of the blocks of lines pre-parsed in parallel (in bytes)
+static const qint64 c_objBlockSize = (1 << 21);
+//! Number of blocks per thread pre-parsed between two merges
+static const int c_objBlocksPerThread = 2;
+
+//! Type of a (pre-parsed) OBJ line
+enum ObjLineType {	OBJ_LINE_VERTEX,
+					OBJ_LINE_TEX_COORD,
+					OBJ_LINE_NORMAL,
+					OBJ_LINE_FACE,
+					OBJ_LINE_OTHER
+};
+
+//! Pre-parsed OBJ line (see ObjBlock)
+struct ObjLine
+{
+	//! Line type
+	ObjLineType type;
+	//! Whether the line is well formed (for vertices, texture coordinates, normals and faces)
+	bool valid;
+	//! Line number (in the block, starting at 1)
+	unsigned lineIndex;
+	//! Number of elements (faces only)
+	unsigned elementCount;
+	//! Line content
+	AsciiTokenizer::Token text;
+};
+
+//! Block of consecutive lines of an OBJ file
+/** The numbers (vertices, texture coordinates, normals and face indexes) of
+	each block are parsed in parallel. The blocks are then processed in order.
+**/
+struct ObjBlock
+{
+	//! Block start (beginning of a line)
+	const char* begin;
+	//! Block end (after an end of line, or end of file)
+	const char* end;
+
+	//! Number of lines
+	unsigned lineCount;
+	//! Meaningful lines (comments and empty lines are skipped)
+	std::vector<ObjLine> lines;
+	//! Vertices ('v' lines)
+	std::vector<CCVector3d> vertices;
+	//! Texture coordinates ('vt' lines - 2 per line)
+	std::vector<float> texCoords;
+	//! Normals ('vn' lines)
+	std::vector<CompressedNormType> normals;
+	//! Face elements ('f' lines - see ObjLine::elementCount)
+	std::vector<facetElement> faceElements;
+	//! Whether some normals were invalid
+	bool invalidNormals;
+	//! Whether the process failed because of a lack of memory
+	bool notEnoughMemory;
+
+	ObjBlock()
+		: begin(0)
+		, end(0)
+		, lineCount(0)
+		, invalidNormals(false)
+		, notEnoughMemory(false)
+	{}
+};
+
+//! Pre-parses all the lines of a block (see ObjFilter::loadFile)
+static void ParseObjBlock(ObjBlock& block)
+{
+	block.lineCount = 0;
+	block.lines.clear();
+	block.vertices.clear();
+	block.texCoords.clear();
+	block.normals.clear();
+	block.faceElements.clear();
+	block.invalidNormals = false;
+	block.notEnoughMemory = false;
+
+	try
+	{
+		const char* pos = block.begin;
+		AsciiTokenizer::Token text;
+		while (AsciiTokenizer::NextLine(pos, block.end, text))
+		{
+			++block.lineCount;
+
+			AsciiTokenizer tokenizer(text.begin, text.end);
+			AsciiTokenizer::Token keyword;
+
+			//skip comments & empty lines
+			if (!tokenizer.next(keyword) || keyword.startsWith('/') || keyword.startsWith('#'))
+				continue;
+
+			ObjLine line;
+			line.type = OBJ_LINE_OTHER;
+			line.valid = true;
+			line.lineIndex = block.lineCount;
+			line.elementCount = 0;
+			line.text = text;
+
+			AsciiTokenizer::Token tokens[3];
+
+			/*** new vertex ***/
+			if (keyword == "v")
+			{
+				line.type = OBJ_LINE_VERTEX;
+				if (tokenizer.split(tokens, 3) == 3)
+				{
+					CCVector3d Pd;
+					tokens[0].toDouble(Pd.x);
+					tokens[1].toDouble(Pd.y);
+					tokens[2].toDouble(Pd.z);
+					block.vertices.push_back(Pd);
+				}
+				else
+				{
+					line.valid = false;
+				}
+			}
+			/*** new vertex texture coordinates ***/
+			else if (keyword == "vt")
+			{
+				line.type = OBJ_LINE_TEX_COORD;
+				int count = tokenizer.split(tokens, 2);
+				if (count != 0)
+				{
+					double t = 0;
+					tokens[0].toDouble(t);
+					block.texCoords.push_back(static_cast<float>(t));
+					t = 0;
+					if (count > 1) //OBJ specification allows for only one value!!!
+						tokens[1].toDouble(t);
+					block.texCoords.push_back(static_cast<float>(t));
+				}
+				else
+				{
+					line.valid = false;
+				}
+			}
+			/*** new vertex normal ***/
+			else if (keyword == "vn") //--> in fact it can also be a facet normal!!!
+			{
+				line.type = OBJ_LINE_NORMAL;
+				if (tokenizer.split(tokens, 3) == 3)
+				{
+					double n[3] = { 0, 0, 0 };
+					for (int i=0; i<3; ++i)
+						tokens[i].toDouble(n[i]);
+					CCVector3 N(static_cast<PointCoordinateType>(n[0]),
+								static_cast<PointCoordinateType>(n[1]),
+								static_cast<PointCoordinateType>(n[2]));
+
+					if (fabs(N.norm2() - 1.0) > 0.005)
+					{
+						block.invalidNormals = true;
+						N.normalize();
+					}
+					block.normals.push_back(ccNormalVectors::GetNormIndex(N.u));
+				}
+				else
+				{
+					line.valid = false;
+				}
+			}
+			/*** new group ***/
+			else if (keyword == "g" || keyword == "o")
+			{
+				//processed sequentially
+			}
+			/*** new face ***/
+			else if (keyword.startsWith('f'))
+			{
+				line.type = OBJ_LINE_FACE;
+
+				//read the face elements (singleton, pair or triplet)
+				size_t firstElement = block.faceElements.size();
+				AsciiTokenizer::Token vertexToken;
+				while (tokenizer.next(vertexToken))
+				{
+					//split the element in (up to) 3 parts: 'v/tc/n' (empty parts are kept)
+					AsciiTokenizer::Token vertexTokens[3] = { vertexToken, vertexToken, vertexToken };
+					int partCount = 0;
+					for (const char* c = vertexToken.begin; partCount < 3; ++partCount)
+					{
+						const char* partEnd = static_cast<const char*>(memchr(c, '/', vertexToken.end - c));
+						vertexTokens[partCount].begin = c;
+						vertexTokens[partCount].end = (partEnd ? partEnd : vertexToken.end);
+						if (!partEnd)
+						{
+							++partCount;
+							break;
+						}
+						c = partEnd + 1;
+					}
+
+					if (vertexTokens[0].size() == 0)
+					{
+						//malformed element
+						line.valid = false;
+					}
+
+					//new vertex
+					facetElement fe; //(0,0,0) by default
+					vertexTokens[0].toInt(fe.vIndex);
+					if (partCount > 1 && vertexTokens[1].size() != 0)
+						vertexTokens[1].toInt(fe.tcIndex);
+					if (partCount > 2 && vertexTokens[2].size() != 0)
+						vertexTokens[2].toInt(fe.nIndex);
+
+					block.faceElements.push_back(fe);
+				}
+				line.elementCount = static_cast<unsigned>(block.faceElements.size() - firstElement);
+			}
+			/*** polyline ***/
+			else if (keyword.startsWith('l'))
+			{
+				//processed sequentially
+			}
+			/*** material ***/
+			else if (keyword == "usemtl" || keyword == "mtllib")
+			{
+				//processed sequentially
+			}
+			else
+			{
+				//ignored
+				continue;
+			}
+
+			block.lines.push_back(line);
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		block.notEnoughMemory = true;
+	}
+}
+
 CC_FILE_ERROR ObjFilter::loadFile(QString filename, ccHObject& container, LoadParameters& parameters)
 {
 	ccLog::Print(QString("[OBJ] ") + filename);
@@ -405,7 +647,9 @@ CC_FILE_ERROR ObjFilter::loadFile(QString filename, ccHObject& container, LoadPa
 	QFile file(filename);
 	if (!file.open(QFile::ReadOnly))
 		return CC_FERR_READING;
-	QTextStream stream(&file);
+
+	QElapsedTimer eTimer;
+	eTimer.start();
 
 	//current vertex shift
 	CCVector3d Pshift(0,0,0);
@@ -455,7 +699,7 @@ CC_FILE_ERROR ObjFilter::loadFile(QString filename, ccHObject& container, LoadPa
 	ccProgressDialog pDlg(true, parameters.parentWidget);
 	pDlg.setMethodTitle(QObject::tr("OBJ file"));
 	pDlg.setInfo(QObject::tr("Loading in progress..."));
-	pDlg.setRange(0, static_cast<int>(file.size()));
+	pDlg.setRange(0, 100);
 	pDlg.show();
 	QApplication::processEvents();
 
@@ -471,483 +715,502 @@ CC_FILE_ERROR ObjFilter::loadFile(QString filename, ccHObject& container, LoadPa
 
 	try
 	{
+		//blocks of lines (pre-parsed in parallel, then processed in order)
+		int threadCount = std::max(1, QThread::idealThreadCount());
+		std::vector<ObjBlock> blocks(static_cast<size_t>(threadCount) * c_objBlocksPerThread);
+		//only used for the (rare) lines that are not pre-parsed
+		const QRegExp whiteSpaces("\\s+");
+
+		std::vector<facetElement> currentFace;
 		unsigned lineCount = 0;
 		unsigned polyCount = 0;
-		QString currentLine = stream.readLine();
-		while (!currentLine.isNull())
+
+		AsciiFileReader reader;
+		reader.open(file);
+		const char* pieceBegin = 0;
+		const char* pieceEnd = 0;
+		while (!error && reader.next(c_objBlockSize * static_cast<qint64>(blocks.size()), pieceBegin, pieceEnd))
 		{
-			if ((++lineCount % 2048) == 0)
+			//we split the next piece of the file in blocks of complete lines
+			size_t blockCount = 0;
+			for (const char* blockStart = pieceBegin; blockCount < blocks.size() && blockStart < pieceEnd; ++blockCount)
 			{
-				if (pDlg.wasCanceled())
+				ObjBlock& block = blocks[blockCount];
+				block.begin = blockStart;
+				block.end = pieceEnd;
+				if (blockCount + 1 < blocks.size() && pieceEnd - blockStart > c_objBlockSize)
 				{
-					error = true;
-					objWarnings[CANCELLED_BY_USER] = true;
-					break;
+					const char* lineEnd = static_cast<const char*>(memchr(blockStart + c_objBlockSize, '\n', pieceEnd - blockStart - c_objBlockSize));
+					if (lineEnd)
+						block.end = lineEnd + 1;
 				}
-				pDlg.setValue(static_cast<int>(file.pos()));
-				QApplication::processEvents();
+				blockStart = block.end;
 			}
 
-			QStringList tokens = QString(currentLine).split(QRegExp("\\s+"),QString::SkipEmptyParts);
-
-			//skip comments & empty lines
-			if( tokens.empty() || tokens.front().startsWith('/',Qt::CaseInsensitive) || tokens.front().startsWith('#',Qt::CaseInsensitive) )
+			//pre-parse them
+			if (blockCount > 1)
 			{
-				currentLine = stream.readLine();
-				continue;
+				QtConcurrent::blockingMap(blocks.begin(), blocks.begin() + blockCount, ParseObjBlock);
 			}
-
-			/*** new vertex ***/
-			if (tokens.front() == "v")
+			else
 			{
-				//reserve more memory if necessary
-				if (vertices->size() == vertices->capacity())
-				{
-					if (!vertices->reserve(vertices->capacity()+MAX_NUMBER_OF_ELEMENTS_PER_CHUNK))
-					{
-						objWarnings[NOT_ENOUGH_MEMORY] = true;
-						error = true;
-						break;
-					}
-				}
-
-				//malformed line?
-				if (tokens.size() < 4)
-				{
-					objWarnings[INVALID_LINE] = true;
-					error = true;
-					break;
-				}
-
-				CCVector3d Pd( tokens[1].toDouble(), tokens[2].toDouble(), tokens[3].toDouble() );
-
-				//first point: check for 'big' coordinates
-				if (pointsRead == 0)
-				{
-					if (HandleGlobalShift(Pd,Pshift,parameters))
-					{
-						vertices->setGlobalShift(Pshift);
-						ccLog::Warning("[OBJ] Cloud has been recentered! Translation: (%.2f,%.2f,%.2f)",Pshift.x,Pshift.y,Pshift.z);
-					}
-				}
-
-				//shifted point
-				CCVector3 P = CCVector3::fromArray((Pd + Pshift).u);
-				vertices->addPoint(P);
-				++pointsRead;
+				ParseObjBlock(blocks.front());
 			}
-			/*** new vertex texture coordinates ***/
-			else if (tokens.front() == "vt")
-			{
-				//create and reserve memory for tex. coords container if necessary
-				if (!texCoords)
-				{
-					texCoords = new TextureCoordsContainer();
-					texCoords->link();
-				}
-				if (texCoords->currentSize() == texCoords->capacity())
-				{
-					if (!texCoords->reserve(texCoords->capacity() + MAX_NUMBER_OF_ELEMENTS_PER_CHUNK))
-					{
-						objWarnings[NOT_ENOUGH_MEMORY] = true;
-						error = true;
-						break;
-					}
-				}
-
-				//malformed line?
-				if (tokens.size() < 2)
-				{
-					objWarnings[INVALID_LINE] = true;
-					error = true;
-					break;
-				}
-
-				float T[2] = { T[0] = tokens[1].toFloat(), 0 };
 
-				if (tokens.size() > 2) //OBJ specification allows for only one value!!!
-				{
-					T[1] = tokens[2].toFloat();
-				}
-
-				texCoords->addElement(T);
-				++texCoordsRead;
-			}
-			/*** new vertex normal ***/
-			else if (tokens.front() == "vn") //--> in fact it can also be a facet normal!!!
+			//and process them in order
+			for (size_t b = 0; b < blockCount && !error; ++b)
 			{
-				//create and reserve memory for normals container if necessary
-				if (!normals)
-				{
-					normals = new NormsIndexesTableType;
-					normals->link();
-				}
-				if (normals->currentSize() == normals->capacity())
+				const ObjBlock& block = blocks[b];
+				if (block.notEnoughMemory)
 				{
-					if (!normals->reserve(normals->capacity() + MAX_NUMBER_OF_ELEMENTS_PER_CHUNK))
-					{
-						objWarnings[NOT_ENOUGH_MEMORY] = true;
-						error = true;
-						break;
-					}
-				}
-
-				//malformed line?
-				if (tokens.size() < 4)
-				{
-					objWarnings[INVALID_LINE] = true;
+					objWarnings[NOT_ENOUGH_MEMORY] = true;
 					error = true;
 					break;
 				}
-
-				CCVector3 N(static_cast<PointCoordinateType>(tokens[1].toDouble()),
-							static_cast<PointCoordinateType>(tokens[2].toDouble()),
-							static_cast<PointCoordinateType>(tokens[3].toDouble()));
-
-				if (fabs(N.norm2() - 1.0) > 0.005)
+				if (block.invalidNormals)
 				{
 					objWarnings[INVALID_NORMALS] = true;
-					N.normalize();
 				}
-				CompressedNormType nIndex = ccNormalVectors::GetNormIndex(N.u);
 
-				normals->addElement(nIndex); //we don't know yet if it's per-vertex or per-triangle normal...
-				++normsRead;
-			}
-			/*** new group ***/
-			else if (tokens.front() == "g" || tokens.front() == "o")
-			{
-				//update new group index
-				facesRead = 0;
-				//get the group name
-				QString groupName = (tokens.size() > 1 && !tokens[1].isEmpty() ? tokens[1] : "default");
-				for (int i=2; i<tokens.size(); ++i) //multiple parts?
-					groupName.append(QString(" ")+tokens[i]);
-				//push previous group descriptor (if none was pushed)
-				if (groups.empty() && totalFacesRead > 0)
-					groups.push_back(std::pair<unsigned,QString>(0,"default"));
-				//push new group descriptor
-				if (!groups.empty() && groups.back().first == totalFacesRead)
-					groups.back().second = groupName; //simply replace the group name if the previous group was empty!
-				else
-					groups.push_back(std::pair<unsigned,QString>(totalFacesRead,groupName));
-				polyCount = 0; //restart polyline count at 0!
-			}
-			/*** new face ***/
-			else if (tokens.front().startsWith('f'))
-			{
-				//malformed line?
-				if (tokens.size() < 4)
-				{
-					objWarnings[INVALID_LINE] = true;
-					currentLine = stream.readLine();
-					continue;
-					//error = true;
-					//break;
-				}
+				size_t vertexIndex = 0;
+				size_t texCoordIndex = 0;
+				size_t normalIndex = 0;
+				size_t faceElementIndex = 0;
 
-				//read the face elements (singleton, pair or triplet)
-				std::vector<facetElement> currentFace;
+				for (size_t l = 0; l < block.lines.size() && !error; ++l)
 				{
-					for (int i=1; i<tokens.size(); ++i)
+					const ObjLine& line = block.lines[l];
+
+					/*** new vertex ***/
+					if (line.type == OBJ_LINE_VERTEX)
 					{
-						QStringList vertexTokens = tokens[i].split('/');
-						if (vertexTokens.size() == 0 || vertexTokens[0].isEmpty())
+						//reserve more memory if necessary
+						if (vertices->size() == vertices->capacity())
+						{
+							if (!vertices->reserve(vertices->capacity()+MAX_NUMBER_OF_ELEMENTS_PER_CHUNK))
+							{
+								objWarnings[NOT_ENOUGH_MEMORY] = true;
+								error = true;
+								break;
+							}
+						}
+
+						//malformed line?
+						if (!line.valid)
 						{
 							objWarnings[INVALID_LINE] = true;
 							error = true;
 							break;
 						}
-						else
-						{
-							//new vertex
-							facetElement fe; //(0,0,0) by default
-							
-							fe.vIndex = vertexTokens[0].toInt();
-							if (vertexTokens.size() > 1 && !vertexTokens[1].isEmpty())
-								fe.tcIndex = vertexTokens[1].toInt();
-							if (vertexTokens.size() > 2 && !vertexTokens[2].isEmpty())
-								fe.nIndex = vertexTokens[2].toInt();
-						
-							currentFace.push_back(fe);
-						}
-					}
-				}
 
-				if (error)
-					break;
+						const CCVector3d& Pd = block.vertices[vertexIndex++];
 
-				if (currentFace.size() < 3)
-				{
-					ccLog::Warning("[OBJ] Malformed file: polygon on line %1 has less than 3 vertices!",lineCount);
-					error = true;
-					break;
-				}
-
-				//first vertex
-				std::vector<facetElement>::iterator A = currentFace.begin();
-
-				//the very first vertex of the group tells us about the whole sequence
-				if (facesRead == 0)
-				{
-					//we have a tex. coord index as second vertex element!
-					if (!hasTexCoords && A->tcIndex != 0 && !materialsLoadFailed)
-					{
-						if (!baseMesh->reservePerTriangleTexCoordIndexes())
+						//first point: check for 'big' coordinates
+						if (pointsRead == 0)
 						{
-							objWarnings[NOT_ENOUGH_MEMORY] = true;
-							error = true;
-							break;
+							if (HandleGlobalShift(Pd,Pshift,parameters))
+							{
+								vertices->setGlobalShift(Pshift);
+								ccLog::Warning("[OBJ] Cloud has been recentered! Translation: (%.2f,%.2f,%.2f)",Pshift.x,Pshift.y,Pshift.z);
+							}
 						}
-						for (unsigned int i=0; i<totalFacesRead; ++i)
-							baseMesh->addTriangleTexCoordIndexes(-1, -1, -1);
 
-						hasTexCoords = true;
+						//shifted point
+						CCVector3 P = CCVector3::fromArray((Pd + Pshift).u);
+						vertices->addPoint(P);
+						++pointsRead;
 					}
-
-					//we have a normal index as third vertex element!
-					if (!normalsPerFacet && A->nIndex != 0)
+					/*** new vertex texture coordinates ***/
+					else if (line.type == OBJ_LINE_TEX_COORD)
 					{
-						//so the normals are 'per-facet'
-						if (!baseMesh->reservePerTriangleNormalIndexes())
+						//create and reserve memory for tex. coords container if necessary
+						if (!texCoords)
 						{
-							objWarnings[NOT_ENOUGH_MEMORY] = true;
-							error = true;
-							break;
+							texCoords = new TextureCoordsContainer();
+							texCoords->link();
+						}
+						if (texCoords->currentSize() == texCoords->capacity())
+						{
+							if (!texCoords->reserve(texCoords->capacity() + MAX_NUMBER_OF_ELEMENTS_PER_CHUNK))
+							{
+								objWarnings[NOT_ENOUGH_MEMORY] = true;
+								error = true;
+								break;
+							}
 						}
-						for (unsigned int i=0; i<totalFacesRead; ++i)
-							baseMesh->addTriangleNormalIndexes(-1, -1, -1);
-						normalsPerFacet = true;
-					}
-				}
-
-				//we process all vertices accordingly
-				for (std::vector<facetElement>::iterator it = currentFace.begin() ; it!=currentFace.end(); ++it)
-				{
-					facetElement& vertex = *it;
 
-					//vertex index
-					{
-						if (!vertex.updatePointIndex(pointsRead))
+						//malformed line?
+						if (!line.valid)
 						{
-							objWarnings[INVALID_INDEX] = true;
+							objWarnings[INVALID_LINE] = true;
 							error = true;
 							break;
 						}
-						if (vertex.vIndex > maxVertexIndex)
-							maxVertexIndex = vertex.vIndex;
+
+						texCoords->addElement(&block.texCoords[2 * texCoordIndex++]);
+						++texCoordsRead;
 					}
-					//should we have a tex. coord index as second vertex element?
-					if (hasTexCoords && currentMaterialDefined)
+					/*** new vertex normal ***/
+					else if (line.type == OBJ_LINE_NORMAL) //--> in fact it can also be a facet normal!!!
 					{
-						if (!vertex.updateTexCoordIndex(texCoordsRead))
+						//create and reserve memory for normals container if necessary
+						if (!normals)
 						{
-							objWarnings[INVALID_INDEX] = true;
-							error = true;
-							break;
+							normals = new NormsIndexesTableType;
+							normals->link();
+						}
+						if (normals->currentSize() == normals->capacity())
+						{
+							if (!normals->reserve(normals->capacity() + MAX_NUMBER_OF_ELEMENTS_PER_CHUNK))
+							{
+								objWarnings[NOT_ENOUGH_MEMORY] = true;
+								error = true;
+								break;
+							}
 						}
-						if (vertex.tcIndex > maxTexCoordIndex)
-							maxTexCoordIndex = vertex.tcIndex;
-					}
 
-					//should we have a normal index as third vertex element?
-					if (normalsPerFacet)
-					{
-						if (!vertex.updateNormalIndex(normsRead))
+						//malformed line?
+						if (!line.valid)
 						{
-							objWarnings[INVALID_INDEX] = true;
+							objWarnings[INVALID_LINE] = true;
 							error = true;
 							break;
 						}
-						if (vertex.nIndex > maxTriNormIndex)
-							maxTriNormIndex = vertex.nIndex;
-					}
-				}
 
-				//don't forget material (common for all vertices)
-				if (currentMaterialDefined && !materialsLoadFailed)
-				{
-					if (!hasMaterial)
+						normals->addElement(block.normals[normalIndex++]); //we don't know yet if it's per-vertex or per-triangle normal...
+						++normsRead;
+					}
+					/*** new face ***/
+					else if (line.type == OBJ_LINE_FACE)
 					{
-						if (!baseMesh->reservePerTriangleMtlIndexes())
+						const facetElement* elements = block.faceElements.data() + faceElementIndex;
+						faceElementIndex += line.elementCount;
+
+						//malformed line?
+						if (line.elementCount < 3)
 						{
-							objWarnings[NOT_ENOUGH_MEMORY] = true;
+							objWarnings[INVALID_LINE] = true;
+							continue;
+							//error = true;
+							//break;
+						}
+						if (!line.valid)
+						{
+							objWarnings[INVALID_LINE] = true;
 							error = true;
 							break;
 						}
-						for (unsigned int i=0; i<totalFacesRead; ++i)
-							baseMesh->addTriangleMtlIndex(-1);
 
-						hasMaterial = true;
-					}
-				}
-
-				if (error)
-					break;
+						//the face elements (singleton, pair or triplet)
+						currentFace.assign(elements, elements + line.elementCount);
 
-				//Now, let's tesselate the whole polygon
-				//FIXME: yeah, we do very ulgy tesselation here!
-				std::vector<facetElement>::const_iterator B = A+1;
-				std::vector<facetElement>::const_iterator C = B+1;
-				for ( ; C != currentFace.end(); ++B,++C)
-				{
-					//need more space?
-					if (baseMesh->size() == baseMesh->capacity())
-					{
-						if (!baseMesh->reserve(baseMesh->size()+128))
+						if (currentFace.size() < 3)
 						{
-							objWarnings[NOT_ENOUGH_MEMORY] = true;
+							ccLog::Warning("[OBJ] Malformed file: polygon on line %i has less than 3 vertices!",lineCount+line.lineIndex);
 							error = true;
 							break;
 						}
-					}
 
-					//push new triangle
-					baseMesh->addTriangle(A->vIndex, B->vIndex, C->vIndex);
-					++facesRead;
-					++totalFacesRead;
+						//first vertex
+						std::vector<facetElement>::iterator A = currentFace.begin();
 
-					if (hasMaterial)
-						baseMesh->addTriangleMtlIndex(currentMaterial);
+						//the very first vertex of the group tells us about the whole sequence
+						if (facesRead == 0)
+						{
+							//we have a tex. coord index as second vertex element!
+							if (!hasTexCoords && A->tcIndex != 0 && !materialsLoadFailed)
+							{
+								if (!baseMesh->reservePerTriangleTexCoordIndexes())
+								{
+									objWarnings[NOT_ENOUGH_MEMORY] = true;
+									error = true;
+									break;
+								}
+								for (unsigned int i=0; i<totalFacesRead; ++i)
+									baseMesh->addTriangleTexCoordIndexes(-1, -1, -1);
+
+								hasTexCoords = true;
+							}
+
+							//we have a normal index as third vertex element!
+							if (!normalsPerFacet && A->nIndex != 0)
+							{
+								//so the normals are 'per-facet'
+								if (!baseMesh->reservePerTriangleNormalIndexes())
+								{
+									objWarnings[NOT_ENOUGH_MEMORY] = true;
+									error = true;
+									break;
+								}
+								for (unsigned int i=0; i<totalFacesRead; ++i)
+									baseMesh->addTriangleNormalIndexes(-1, -1, -1);
+								normalsPerFacet = true;
+							}
+						}
 
-					if (hasTexCoords)
-						baseMesh->addTriangleTexCoordIndexes(A->tcIndex, B->tcIndex, C->tcIndex);
+						//we process all vertices accordingly
+						for (std::vector<facetElement>::iterator it = currentFace.begin() ; it!=currentFace.end(); ++it)
+						{
+							facetElement& vertex = *it;
+
+							//vertex index
+							{
+								if (!vertex.updatePointIndex(pointsRead))
+								{
+									objWarnings[INVALID_INDEX] = true;
+									error = true;
+									break;
+								}
+								if (vertex.vIndex > maxVertexIndex)
+									maxVertexIndex = vertex.vIndex;
+							}
+							//should we have a tex. coord index as second vertex element?
+							if (hasTexCoords && currentMaterialDefined)
+							{
+								if (!vertex.updateTexCoordIndex(texCoordsRead))
+								{
+									objWarnings[INVALID_INDEX] = true;
+									error = true;
+									break;
+								}
+								if (vertex.tcIndex > maxTexCoordIndex)
+									maxTexCoordIndex = vertex.tcIndex;
+							}
+
+							//should we have a normal index as third vertex element?
+							if (normalsPerFacet)
+							{
+								if (!vertex.updateNormalIndex(normsRead))
+								{
+									objWarnings[INVALID_INDEX] = true;
+									error = true;
+									break;
+								}
+								if (vertex.nIndex > maxTriNormIndex)
+									maxTriNormIndex = vertex.nIndex;
+							}
+						}
 
-					if (normalsPerFacet)
-						baseMesh->addTriangleNormalIndexes(A->nIndex, B->nIndex, C->nIndex);
-				}
-			}
-			/*** polyline ***/
-			else if (tokens.front().startsWith('l'))
-			{
-				//malformed line?
-				if (tokens.size() < 3)
-				{
-					objWarnings[INVALID_LINE] = true;
-					currentLine = stream.readLine();
-					continue;
-				}
+						//don't forget material (common for all vertices)
+						if (currentMaterialDefined && !materialsLoadFailed)
+						{
+							if (!hasMaterial)
+							{
+								if (!baseMesh->reservePerTriangleMtlIndexes())
+								{
+									objWarnings[NOT_ENOUGH_MEMORY] = true;
+									error = true;
+									break;
+								}
+								for (unsigned int i=0; i<totalFacesRead; ++i)
+									baseMesh->addTriangleMtlIndex(-1);
+
+								hasMaterial = true;
+							}
+						}
 
-				//read the face elements (singleton, pair or triplet)
-				ccPolyline* polyline = new ccPolyline(vertices);
-				if (!polyline->reserve(static_cast<unsigned>(tokens.size()-1)))
-				{
-					//not enough memory
-					objWarnings[NOT_ENOUGH_MEMORY] = true;
-					delete polyline;
-					polyline = 0;
-					currentLine = stream.readLine();
-					continue;
-				}
+						if (error)
+							break;
 
-				for (int i=1; i<tokens.size(); ++i)
-				{
-					//get next polyline's vertex index
-					QStringList vertexTokens = tokens[i].split('/');
-					if (vertexTokens.size() == 0 || vertexTokens[0].isEmpty())
-					{
-						objWarnings[INVALID_LINE] = true;
-						error = true;
-						break;
+						//Now, let's tesselate the whole polygon
+						//FIXME: yeah, we do very ulgy tesselation here!
+						std::vector<facetElement>::const_iterator B = A+1;
+						std::vector<facetElement>::const_iterator C = B+1;
+						for ( ; C != currentFace.end(); ++B,++C)
+						{
+							//need more space?
+							if (baseMesh->size() == baseMesh->capacity())
+							{
+								if (!baseMesh->reserve(baseMesh->size()+128))
+								{
+									objWarnings[NOT_ENOUGH_MEMORY] = true;
+									error = true;
+									break;
+								}
+							}
+
+							//push new triangle
+							baseMesh->addTriangle(A->vIndex, B->vIndex, C->vIndex);
+							++facesRead;
+							++totalFacesRead;
+
+							if (hasMaterial)
+								baseMesh->addTriangleMtlIndex(currentMaterial);
+
+							if (hasTexCoords)
+								baseMesh->addTriangleTexCoordIndexes(A->tcIndex, B->tcIndex, C->tcIndex);
+
+							if (normalsPerFacet)
+								baseMesh->addTriangleNormalIndexes(A->nIndex, B->nIndex, C->nIndex);
+						}
 					}
+					/*** other lines (processed sequentially) ***/
 					else
 					{
-						int index = vertexTokens[0].toInt(); //we ignore normal index (if any!)
-						if (!UpdatePointIndex(index,pointsRead))
+						QString currentLine = QString::fromLocal8Bit(line.text.begin, static_cast<int>(line.text.size()));
+						QStringList tokens = currentLine.split(whiteSpaces,QString::SkipEmptyParts);
+
+						/*** new group ***/
+						if (tokens.front() == "g" || tokens.front() == "o")
 						{
-							objWarnings[INVALID_INDEX] = true;
-							error = true;
-							break;
+							//update new group index
+							facesRead = 0;
+							//get the group name
+							QString groupName = (tokens.size() > 1 && !tokens[1].isEmpty() ? tokens[1] : "default");
+							for (int i=2; i<tokens.size(); ++i) //multiple parts?
+								groupName.append(QString(" ")+tokens[i]);
+							//push previous group descriptor (if none was pushed)
+							if (groups.empty() && totalFacesRead > 0)
+								groups.push_back(std::pair<unsigned,QString>(0,"default"));
+							//push new group descriptor
+							if (!groups.empty() && groups.back().first == totalFacesRead)
+								groups.back().second = groupName; //simply replace the group name if the previous group was empty!
+							else
+								groups.push_back(std::pair<unsigned,QString>(totalFacesRead,groupName));
+							polyCount = 0; //restart polyline count at 0!
 						}
+						/*** polyline ***/
+						else if (tokens.front().startsWith('l'))
+						{
+							//malformed line?
+							if (tokens.size() < 3)
+							{
+								objWarnings[INVALID_LINE] = true;
+								continue;
+							}
+
+							//read the face elements (singleton, pair or triplet)
+							ccPolyline* polyline = new ccPolyline(vertices);
+							if (!polyline->reserve(static_cast<unsigned>(tokens.size()-1)))
+							{
+								//not enough memory
+								objWarnings[NOT_ENOUGH_MEMORY] = true;
+								delete polyline;
+								polyline = 0;
+								continue;
+							}
+
+							for (int i=1; i<tokens.size(); ++i)
+							{
+								//get next polyline's vertex index
+								QStringList vertexTokens = tokens[i].split('/');
+								if (vertexTokens.size() == 0 || vertexTokens[0].isEmpty())
+								{
+									objWarnings[INVALID_LINE] = true;
+									error = true;
+									break;
+								}
+								else
+								{
+									int index = vertexTokens[0].toInt(); //we ignore normal index (if any!)
+									if (!UpdatePointIndex(index,pointsRead))
+									{
+										objWarnings[INVALID_INDEX] = true;
+										error = true;
+										break;
+									}
+
+									polyline->addPointIndex(index);
+								}
+							}
+
+							if (error)
+							{
+								delete polyline;
+								polyline = 0;
+								break;
+							}
+			
+							polyline->setVisible(true);
+							QString name = groups.empty() ? QString("Line") : groups.back().second+QString(".line");
+							polyline->setName(QString("%1 %2").arg(name).arg(++polyCount));
+							vertices->addChild(polyline);
 
-						polyline->addPointIndex(index);
+						}
+						/*** material ***/
+						else if (tokens.front() == "usemtl") //see 'MTL file' below
+						{
+							if (materials) //otherwise we have failed to load MTL file!!!
+							{
+								QString mtlName = currentLine.mid(7).trimmed();
+								//DGM: in case there's space characters in the material name, we must read it again from the original line buffer
+								//QString mtlName = (tokens.size() > 1 && !tokens[1].isEmpty() ? tokens[1] : "");
+								currentMaterial = (!mtlName.isEmpty() ? materials->findMaterialByName(mtlName) : -1);
+								currentMaterialDefined = true;
+							}
+						}
+						/*** material file (MTL) ***/
+						else if (tokens.front() == "mtllib")
+						{
+							//malformed line?
+							if (tokens.size() < 2 || tokens[1].isEmpty())
+							{
+								objWarnings[INVALID_LINE] = true;
+							}
+							else
+							{
+								//we build the whole MTL filename + path
+								//DGM: in case there's space characters in the filename, we must read it again from the original line buffer
+								//QString mtlFilename = tokens[1];
+								QString mtlFilename = currentLine.mid(7).trimmed();
+								ccLog::Print(QString("[OBJ] Material file: ")+mtlFilename);
+								QString mtlPath = QFileInfo(filename).canonicalPath();
+								//we try to load it
+								if (!materials)
+								{
+									materials = new ccMaterialSet("materials");
+									materials->link();
+								}
+
+								size_t oldSize = materials->size();
+								QStringList errors;
+								if (ccMaterialSet::ParseMTL(mtlPath,mtlFilename,*materials,errors))
+								{
+									ccLog::Print("[OBJ] %i materials loaded",materials->size()-oldSize);
+									materialsLoadFailed = false;
+								}
+								else
+								{
+									ccLog::Error(QString("[OBJ] Failed to load material file! (should be in '%1')").arg(mtlPath+'/'+QString(mtlFilename)));
+									materialsLoadFailed = true;
+								}
+
+								if (!errors.empty())
+								{
+									for (int i=0; i<errors.size(); ++i)
+										ccLog::Warning(QString("[OBJ::Load::MTL parser] ")+errors[i]);
+								}
+								if (materials->empty())
+								{
+									materials->release();
+									materials=0;
+									materialsLoadFailed = true;
+								}
+							}
+						}
 					}
 				}
 
-				if (error)
-				{
-					delete polyline;
-					polyline = 0;
-					break;
-				}
-			
-				polyline->setVisible(true);
-				QString name = groups.empty() ? QString("Line") : groups.back().second+QString(".line");
-				polyline->setName(QString("%1 %2").arg(name).arg(++polyCount));
-				vertices->addChild(polyline);
-
-			}
-			/*** material ***/
-			else if (tokens.front() == "usemtl") //see 'MTL file' below
-			{
-				if (materials) //otherwise we have failed to load MTL file!!!
-				{
-					QString mtlName = currentLine.mid(7).trimmed();
-					//DGM: in case there's space characters in the material name, we must read it again from the original line buffer
-					//QString mtlName = (tokens.size() > 1 && !tokens[1].isEmpty() ? tokens[1] : "");
-					currentMaterial = (!mtlName.isEmpty() ? materials->findMaterialByName(mtlName) : -1);
-					currentMaterialDefined = true;
-				}
+				lineCount += block.lineCount;
 			}
-			/*** material file (MTL) ***/
-			else if (tokens.front() == "mtllib")
+
+			if (!error)
 			{
-				//malformed line?
-				if (tokens.size() < 2 || tokens[1].isEmpty())
-				{
-					objWarnings[INVALID_LINE] = true;
-				}
-				else
+				if (pDlg.wasCanceled())
 				{
-					//we build the whole MTL filename + path
-					//DGM: in case there's space characters in the filename, we must read it again from the original line buffer
-					//QString mtlFilename = tokens[1];
-					QString mtlFilename = currentLine.mid(7).trimmed();
-					ccLog::Print(QString("[OBJ] Material file: ")+mtlFilename);
-					QString mtlPath = QFileInfo(filename).canonicalPath();
-					//we try to load it
-					if (!materials)
-					{
-						materials = new ccMaterialSet("materials");
-						materials->link();
-					}
-
-					size_t oldSize = materials->size();
-					QStringList errors;
-					if (ccMaterialSet::ParseMTL(mtlPath,mtlFilename,*materials,errors))
-					{
-						ccLog::Print("[OBJ] %i materials loaded",materials->size()-oldSize);
-						materialsLoadFailed = false;
-					}
-					else
-					{
-						ccLog::Error(QString("[OBJ] Failed to load material file! (should be in '%1')").arg(mtlPath+'/'+QString(mtlFilename)));
-						materialsLoadFailed = true;
-					}
-
-					if (!errors.empty())
-					{
-						for (int i=0; i<errors.size(); ++i)
-							ccLog::Warning(QString("[OBJ::Load::MTL parser] ")+errors[i]);
-					}
-					if (materials->empty())
-					{
-						materials->release();
-						materials=0;
-						materialsLoadFailed = true;
-					}
+					error = true;
+					objWarnings[CANCELLED_BY_USER] = true;
+					break;
 				}
+				pDlg.setValue(static_cast<int>((100 * reader.pos()) / std::max<qint64>(1, reader.size())));
+				QApplication::processEvents();
 			}
-			///*** shading group ***/
-			//else if (tokens.front() == "s")
-			//{
-			//	//ignored!
-			//}
-
-			if (error)
-				break;
+		}
 
-			currentLine = stream.readLine();
+		if (reader.error())
+		{
+			ccLog::Warning("[OBJ] Failed to read the file");
+			error = true;
 		}
 	}
 	catch (const std::bad_alloc&)
@@ -970,6 +1233,8 @@ CC_FILE_ERROR ObjFilter::loadFile(QString filename, ccHObject& container, LoadPa
 	if (!error)
 	{
 		ccLog::Print("[OBJ] %i points, %u faces",pointsRead,totalFacesRead);
+		double elapsed_s = eTimer.elapsed() / 1000.0;
+		ccLog::Print(QString("[OBJ] File loaded in %1 s. (%2 MB/s)").arg(elapsed_s, 0, 'f', 2).arg(file.size() / (1024.0 * 1024.0) / std::max(elapsed_s, 0.001), 0, 'f', 1));
 		if (texCoordsRead > 0 || normsRead > 0)
 			ccLog::Print("[OBJ] %i tex. coords, %i normals",texCoordsRead,normsRead);
 
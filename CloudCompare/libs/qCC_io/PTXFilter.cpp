@@ -16,6 +16,7 @@
 //##########################################################################
 
 #include "PTXFilter.h"
+#include "AsciiTokenizer.h"
 
 //qCC_db
 #include <ccLog.h>
@@ -28,8 +29,10 @@
 
 //Qt
 #include <QFile>
-#include <QTextStream>
+#include <QElapsedTimer>
 #include <QMessageBox>
+#include <QThread>
+#include <QtConcurrentMap>
 
 //System
 #include <assert.h>
@@ -88,18 +91,148 @@ void CleanMatrix(ccGLMatrixd& mat)
 	}
 }
 
+//! Size of the blocks of point lines parsed in parallel (in bytes)
+static const qint64 c_ptxBlockSize = (1 << 21);
+//! Number of blocks per thread parsed between two merges
+static const int c_ptxBlocksPerThread = 2;
+
+//! Parsed PTX point line (see PtxBlock)
+struct PtxLine
+{
+	//! X, Y, Z and intensity
+	double values[4];
+	//! Color (if any)
+	ccColor::Rgb color;
+	//! Number of values on the line (capped to 8)
+	int tokenCount;
+	//! Whether the 4 first values are valid
+	bool valuesOk;
+	//! Whether the 3 color components are valid
+	bool colorOk;
+};
+
+//! Block of consecutive point lines of a PTX scan
+/** Blocks are parsed independently (and in parallel) then merged in order.
+**/
+struct PtxBlock
+{
+	//! Block start (beginning of a line)
+	const char* begin;
+	//! Block end (after an end of line, or end of file)
+	const char* end;
+	//! Parsed lines
+	std::vector<PtxLine> lines;
+	//! Whether the process failed because of a lack of memory
+	bool notEnoughMemory;
+
+	PtxBlock()
+		: begin(0)
+		, end(0)
+		, notEnoughMemory(false)
+	{}
+};
+
+//! Parses all the point lines of a block (see PTXFilter::loadFile)
+static void ParsePtxBlock(PtxBlock& block)
+{
+	block.lines.clear();
+	block.notEnoughMemory = false;
+
+	try
+	{
+		const char* pos = block.begin;
+		AsciiTokenizer::Token text;
+		AsciiTokenizer::Token tokens[8];
+		while (AsciiTokenizer::NextLine(pos, block.end, text))
+		{
+			PtxLine line;
+			line.tokenCount = AsciiTokenizer(text.begin, text.end, ' ').split(tokens, 8);
+
+			line.valuesOk = (line.tokenCount >= 4);
+			for (int v=0; v<4; ++v)
+			{
+				line.values[v] = 0;
+				if (v < line.tokenCount)
+					line.valuesOk &= tokens[v].toDouble(line.values[v]);
+			}
+
+			line.colorOk = (line.tokenCount >= 7);
+			for (int c=0; c<3 && 4+c<line.tokenCount; ++c)
+			{
+				unsigned temp = 0;
+				bool ok = tokens[4+c].toUInt(temp) && temp <= 255;
+				line.color.rgb[c] = static_cast<unsigned char>(ok ? temp : 0);
+				line.colorOk &= ok;
+			}
+
+			block.lines.push_back(line);
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		block.notEnoughMemory = true;
+	}
+}
+
+//! Sequential access to the lines of a PTX file (see AsciiFileReader)
+struct PtxLineReader
+{
+	//! File reader
+	AsciiFileReader reader;
+	//! Minimum size of the pieces read from the file
+	qint64 pieceSize;
+	//! Current position (in the current piece)
+	const char* pos;
+	//! End of the current piece
+	const char* end;
+
+	PtxLineReader(qint64 minPieceSize)
+		: pieceSize(minPieceSize)
+		, pos(0)
+		, end(0)
+	{}
+
+	//! Makes sure that some lines are available (reads the next piece of the file if necessary)
+	inline bool fill()
+	{
+		return pos < end || reader.next(pieceSize, pos, end);
+	}
+
+	//! Extracts the next line
+	inline bool nextLine(AsciiTokenizer::Token& line)
+	{
+		return fill() && AsciiTokenizer::NextLine(pos, end, line);
+	}
+};
+
 CC_FILE_ERROR PTXFilter::loadFile(	QString filename,
 									ccHObject& container,
 									LoadParameters& parameters)
 {
 	//open ASCII file for reading
 	QFile file(filename);
-	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+	if (!file.open(QIODevice::ReadOnly))
 	{
 		return CC_FERR_READING;
 	}
 
-	QTextStream inFile(&file);
+	QElapsedTimer eTimer;
+	eTimer.start();
+
+	//blocks of point lines (parsed in parallel, then merged in order)
+	int threadCount = std::max(1, QThread::idealThreadCount());
+	std::vector<PtxBlock> blocks;
+	try
+	{
+		blocks.resize(static_cast<size_t>(threadCount) * c_ptxBlocksPerThread);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+	}
+
+	PtxLineReader inFile(c_ptxBlockSize * static_cast<qint64>(blocks.size()));
+	inFile.reader.open(file);
 
 	CCVector3d PshiftTrans(0,0,0);
 	CCVector3d PshiftCloud(0,0,0);
@@ -130,19 +263,16 @@ CC_FILE_ERROR PTXFilter::loadFile(	QString filename,
 
 		//read header
 		{
-			QString line = inFile.readLine();
-			if (line.isNull() && container.getChildrenNumber() != 0) //end of file?
+			AsciiTokenizer::Token line;
+			bool hasLine = inFile.nextLine(line);
+			if (!hasLine && container.getChildrenNumber() != 0) //end of file?
 				break;
 
 			//read the width (number of columns) and the height (number of rows) on the two first lines
 			//(DGM: we transpose the matrix right away)
-			bool ok;
-			height = line.toUInt(&ok);
-			if (!ok)
+			if (!hasLine || !line.toUInt(height))
 				return CC_FERR_MALFORMED_FILE;
-			line = inFile.readLine();
-			width = line.toUInt(&ok);
-			if (!ok)
+			if (!inFile.nextLine(line) || !line.toUInt(width))
 				return CC_FERR_MALFORMED_FILE;
 
 			ccLog::Print(QString("[PTX] Scan #%1 - grid size: %2 x %3").arg(cloudIndex+1).arg(height).arg(width));
@@ -150,9 +280,8 @@ CC_FILE_ERROR PTXFilter::loadFile(	QString filename,
 			//read sensor transformation matrix
 			for (int i=0; i<4; ++i)
 			{
-				line = inFile.readLine();
-				QStringList tokens = line.split(" ",QString::SkipEmptyParts);
-				if (tokens.size() != 3)
+				AsciiTokenizer::Token tokens[4];
+				if (!inFile.nextLine(line) || AsciiTokenizer(line.begin, line.end, ' ').split(tokens, 4) != 3)
 					return CC_FERR_MALFORMED_FILE;
 
 				double* colDest = 0;
@@ -170,8 +299,7 @@ CC_FILE_ERROR PTXFilter::loadFile(	QString filename,
 				for (int j=0; j<3; ++j)
 				{
 					assert(colDest);
-					colDest[j] = tokens[j].toDouble(&ok);
-					if (!ok)
+					if (!tokens[j].toDouble(colDest[j]))
 						return CC_FERR_MALFORMED_FILE;
 				}
 			}
@@ -181,16 +309,14 @@ CC_FILE_ERROR PTXFilter::loadFile(	QString filename,
 			//read cloud transformation matrix
 			for (int i=0; i<4; ++i)
 			{
-				line = inFile.readLine();
-				QStringList tokens = line.split(" ",QString::SkipEmptyParts);
-				if (tokens.size() != 4)
+				AsciiTokenizer::Token tokens[5];
+				if (!inFile.nextLine(line) || AsciiTokenizer(line.begin, line.end, ' ').split(tokens, 5) != 4)
 					return CC_FERR_MALFORMED_FILE;
 
 				double* col = cloudTransD.getColumn(i);
 				for (int j=0; j<4; ++j)
 				{
-					col[j] = tokens[j].toDouble(&ok);
-					if (!ok)
+					if (!tokens[j].toDouble(col[j]))
 						return CC_FERR_MALFORMED_FILE;
 				}
 			}
@@ -275,137 +401,164 @@ CC_FILE_ERROR PTXFilter::loadFile(	QString filename,
 			bool loadColors = false;
 			bool loadGridColors = false;
 			size_t gridIndex = 0;
+			bool stop = false;
 
-			for (unsigned j=0; j<height; ++j)
+			while (gridIndex < gridSize && !stop)
 			{
-				for (unsigned i=0; i<width; ++i, ++gridIndex)
+				//the next point lines already in memory
+				if (!inFile.fill())
+				{
+					//missing lines
+					result = CC_FERR_MALFORMED_FILE;
+					break;
+				}
+				const char* regionStart = inFile.pos;
+				unsigned regionLineCount = AsciiTokenizer::SkipLines(inFile.pos, inFile.end, static_cast<unsigned>(gridSize - gridIndex));
+				const char* regionEnd = inFile.pos;
+
+				//we split them in blocks of complete lines
+				size_t blockCount = 0;
+				for (const char* blockStart = regionStart; blockCount < blocks.size() && blockStart < regionEnd; ++blockCount)
+				{
+					PtxBlock& block = blocks[blockCount];
+					block.begin = blockStart;
+					block.end = regionEnd;
+					if (blockCount + 1 < blocks.size() && regionEnd - blockStart > c_ptxBlockSize)
+					{
+						const char* lineEnd = static_cast<const char*>(memchr(blockStart + c_ptxBlockSize, '\n', regionEnd - blockStart - c_ptxBlockSize));
+						if (lineEnd && lineEnd + 1 < regionEnd)
+							block.end = lineEnd + 1;
+					}
+					blockStart = block.end;
+				}
+
+				//parse them
+				if (blockCount > 1)
+				{
+					QtConcurrent::blockingMap(blocks.begin(), blocks.begin() + blockCount, ParsePtxBlock);
+				}
+				else
+				{
+					ParsePtxBlock(blocks.front());
+				}
+
+				//and merge them in order
+				for (size_t b = 0; b < blockCount && !stop; ++b)
 				{
-					QString line = inFile.readLine();
-					QStringList tokens = line.split(" ",QString::SkipEmptyParts);
+					const PtxBlock& block = blocks[b];
+					if (block.notEnoughMemory)
+					{
+						result = CC_FERR_NOT_ENOUGH_MEMORY;
+						stop = true;
+						break;
+					}
 
-					if (firstPoint)
+					for (size_t k = 0; k < block.lines.size(); ++k, ++gridIndex)
 					{
-						hasColors = (tokens.size() == 7);
-						if (hasColors)
+						const PtxLine& cell = block.lines[k];
+
+						if (firstPoint)
 						{
-							loadColors = cloud->reserveTheRGBTable();
-							if (!loadColors)
+							hasColors = (cell.tokenCount == 7);
+							if (hasColors)
 							{
-								ccLog::Warning("[PTX] Not enough memory to load RGB colors!");
-							}
-							else if (hasIndexGrid)
-							{
-								//we also load the colors into the grid (as invalid/missing points can have colors!)
-								try
+								loadColors = cloud->reserveTheRGBTable();
+								if (!loadColors)
 								{
-									grid->colors.resize(gridSize, ccColor::Rgb(0, 0, 0));
-									loadGridColors = true;
+									ccLog::Warning("[PTX] Not enough memory to load RGB colors!");
 								}
-								catch (const std::bad_alloc&)
+								else if (hasIndexGrid)
 								{
-									ccLog::Warning("[PTX] Not enough memory to load the grid colors");
+									//we also load the colors into the grid (as invalid/missing points can have colors!)
+									try
+									{
+										grid->colors.resize(gridSize, ccColor::Rgb(0, 0, 0));
+										loadGridColors = true;
+									}
+									catch (const std::bad_alloc&)
+									{
+										ccLog::Warning("[PTX] Not enough memory to load the grid colors");
+									}
 								}
 							}
 						}
-					}
-					if ((hasColors && tokens.size() != 7) || (!hasColors && tokens.size() != 4))
-					{
-						result = CC_FERR_MALFORMED_FILE;
-						//early stop
-						j = height;
-						break;
-					}
-
-					double values[4];
-					for (int v=0; v<4; ++v)
-					{
-						bool ok;
-						values[v] = tokens[v].toDouble(&ok);
-						if (!ok)
+						if (	(hasColors && cell.tokenCount != 7) || (!hasColors && cell.tokenCount != 4)
+							||	!cell.valuesOk )
 						{
 							result = CC_FERR_MALFORMED_FILE;
 							//early stop
-							j = height;
+							stop = true;
 							break;
 						}
-					}
 
-					//we skip "empty" cells
-					bool pointIsValid = (CCVector3d::fromArray(values).norm2() != 0);
-					if (pointIsValid)
-					{
-						const double* Pd = values;
-						//first point: check for 'big' coordinates
-						if (firstPoint)
+						const double* values = cell.values;
+
+						//we skip "empty" cells
+						bool pointIsValid = (CCVector3d::fromArray(values).norm2() != 0);
+						if (pointIsValid)
 						{
-							if (cloudIndex == 0 && !cloud->isShifted()) //in case the trans. matrix was ok!
+							const double* Pd = values;
+							//first point: check for 'big' coordinates
+							if (firstPoint)
 							{
-								CCVector3d P(Pd);
-								if (HandleGlobalShift(P,PshiftCloud,parameters))
+								if (cloudIndex == 0 && !cloud->isShifted()) //in case the trans. matrix was ok!
 								{
-									cloud->setGlobalShift(PshiftCloud);
-									ccLog::Warning("[PTXFilter::loadFile] Cloud has been recentered! Translation: (%.2f,%.2f,%.2f)",PshiftCloud.x,PshiftCloud.y,PshiftCloud.z);
+									CCVector3d P(Pd);
+									if (HandleGlobalShift(P,PshiftCloud,parameters))
+									{
+										cloud->setGlobalShift(PshiftCloud);
+										ccLog::Warning("[PTXFilter::loadFile] Cloud has been recentered! Translation: (%.2f,%.2f,%.2f)",PshiftCloud.x,PshiftCloud.y,PshiftCloud.z);
+									}
 								}
+								firstPoint = false;
 							}
-							firstPoint = false;
-						}
 
-						//update index grid
-						if (hasIndexGrid)
-						{
-							grid->indexes[gridIndex] = static_cast<int>(cloud->size()); // = index (default value = -1, means no point)
-						}
+							//update index grid
+							if (hasIndexGrid)
+							{
+								grid->indexes[gridIndex] = static_cast<int>(cloud->size()); // = index (default value = -1, means no point)
+							}
 
-						//add point
-						cloud->addPoint(CCVector3(	static_cast<PointCoordinateType>(Pd[0] + PshiftCloud.x),
-													static_cast<PointCoordinateType>(Pd[1] + PshiftCloud.y),
-													static_cast<PointCoordinateType>(Pd[2] + PshiftCloud.z)) );
+							//add point
+							cloud->addPoint(CCVector3(	static_cast<PointCoordinateType>(Pd[0] + PshiftCloud.x),
+														static_cast<PointCoordinateType>(Pd[1] + PshiftCloud.y),
+														static_cast<PointCoordinateType>(Pd[2] + PshiftCloud.z)) );
 
-						//add intensity
-						if (intensitySF)
-						{
-							intensitySF->addElement(static_cast<ScalarType>(values[3]));
+							//add intensity
+							if (intensitySF)
+							{
+								intensitySF->addElement(static_cast<ScalarType>(values[3]));
+							}
 						}
-					}
 
-					//color
-					if (loadColors && (pointIsValid || loadGridColors))
-					{
-						ccColor::Rgb color;
-						for (int c=0; c<3; ++c)
+						//color
+						if (loadColors && (pointIsValid || loadGridColors))
 						{
-							bool ok;
-							unsigned temp = tokens[4+c].toUInt(&ok);
-							ok &= (temp <= 255);
-							if (ok)
-							{
-								color.rgb[c] = static_cast<unsigned char>(temp);
-							}
-							else
+							if (!cell.colorOk)
 							{
 								result = CC_FERR_MALFORMED_FILE;
 								//early stop
-								j = height;
+								stop = true;
 								break;
 							}
-						}
 
-						if (pointIsValid)
-						{
-							cloud->addRGBColor(color.rgb);
-						}
-						if (loadGridColors)
-						{
-							assert(!grid->colors.empty());
-							grid->colors[gridIndex] = color;
+							if (pointIsValid)
+							{
+								cloud->addRGBColor(cell.color.rgb);
+							}
+							if (loadGridColors)
+							{
+								assert(!grid->colors.empty());
+								grid->colors[gridIndex] = cell.color;
+							}
 						}
 					}
+				}
 
-					if (parameters.parentWidget && !nprogress.oneStep())
-					{
-						result = CC_FERR_CANCELED_BY_USER;
-						break;
-					}
+				if (!stop && parameters.parentWidget && !nprogress.steps(regionLineCount))
+				{
+					result = CC_FERR_CANCELED_BY_USER;
+					break;
 				}
 			}
 		}
@@ -496,6 +649,9 @@ CC_FILE_ERROR PTXFilter::loadFile(	QString filename,
 		}
 	}
 
+	double elapsed_s = eTimer.elapsed() / 1000.0;
+	ccLog::Print(QString("[PTX] File loaded in %1 s. (%2 MB/s)").arg(elapsed_s, 0, 'f', 2).arg(file.size() / (1024.0 * 1024.0) / std::max(elapsed_s, 0.001), 0, 'f', 1));
+
 	//update scalar fields saturation (globally!)
 	{
 		bool validIntensityRange = true;
@@ -19,6 +19,7 @@ DEFINES +=  CC_PDMS_SUPPORT \
 HEADERS += AsciiFilter.h \
            AsciiOpenDlg.h \
            AsciiSaveDlg.h \
+           AsciiTokenizer.h \
            BinFilter.h \
            BundlerFilter.h \
            BundlerImportDlg.h \
@@ -72,6 +73,7 @@ FORMS += ui_templates/globalShiftAndScaleAboutDlg.ui \
 SOURCES += AsciiFilter.cpp \
            AsciiOpenDlg.cpp \
            AsciiSaveDlg.cpp \
+           AsciiTokenizer.cpp \
            BinFilter.cpp \
            BundlerFilter.cpp \
            BundlerImportDlg.cpp \
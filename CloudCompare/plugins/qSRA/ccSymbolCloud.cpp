@@ -13,7 +13,7 @@ ccSymbolCloud::ccSymbolCloud(QString name/*=QString()*/)
 {
 }
 
-bool ccSymbolCloud::reserve(unsigned numberOfPoints)
+bool ccSymbolCloud::reserve(PointIndexType numberOfPoints)
 {
 	if (!ccPointCloud::reserve(numberOfPoints))
 		return false;
@@ -24,7 +24,7 @@ bool ccSymbolCloud::reserve(unsigned numberOfPoints)
 	return true;
 }
 
-bool ccSymbolCloud::resize(unsigned numberOfPoints)
+bool ccSymbolCloud::resize(PointIndexType numberOfPoints)
 {
 	if (!ccPointCloud::resize(numberOfPoints))
 		return false;
@@ -56,8 +56,8 @@ public:
 	void clearLabelArray();
 
 	//! inherited from ccPointCloud
-	virtual bool reserve(unsigned numberOfPoints) override;
-	virtual bool resize(unsigned numberOfPoints) override;
+	virtual bool reserve(PointIndexType numberOfPoints) override;
+	virtual bool resize(PointIndexType numberOfPoints) override;
 	virtual void clear() override;
 
 	//! Sets symbol size
@@ -110,6 +110,16 @@ unsigned ccAlignDlg::getMaxNumberOfCandidates()
 	return nbMaxCandidates->value();
 }
 
+unsigned ccAlignDlg::getRandomSeed()
+{
+	return static_cast<unsigned>(randomSeed->value());
+}
+
+double ccAlignDlg::getTargetScoreRatio()
+{
+	return targetScore->value() / 100.0;
+}
+
 CCLib::ReferenceCloud *ccAlignDlg::getSampledModel()
 {
 	CCLib::ReferenceCloud* sampledCloud = 0;
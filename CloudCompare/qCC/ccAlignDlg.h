@@ -50,6 +50,8 @@ public:
 	CC_SAMPLING_METHOD getSamplingMethod();
 	bool isNumberOfCandidatesLimited();
 	unsigned getMaxNumberOfCandidates();
+	unsigned getRandomSeed();
+	double getTargetScoreRatio();
 	CCLib::ReferenceCloud *getSampledModel();
 	CCLib::ReferenceCloud *getSampledData();
 
@@ -7,6 +7,7 @@
 #include <StatisticalTestingTools.h>
 #include <Neighbourhood.h>
 #include <AutoSegmentationTools.h>
+#include <OutOfCoreStorage.h>
 
 //qCC_db
 #include <ccProgressDialog.h>
@@ -49,6 +50,12 @@ static const char COMMAND_SILENT_MODE[]						= "SILENT";
 static const char COMMAND_OPEN[]							= "O";				//+file name
 static const char COMMAND_OPEN_SKIP_LINES[]					= "SKIP";			//+number of lines to skip
 static const char COMMAND_OPEN_SHIFT_ON_LOAD[]				= "GLOBAL_SHIFT";	//+global shift
+static const char COMMAND_OPEN_SUBSAMPLE_ON_LOAD[]			= "SPATIAL_STEP";	//+spatial step (LAS and BIN V1 files)
+static const char COMMAND_OPEN_FILTER_BOX[]					= "FILTER_BOX";		//+box min and max corners (LAS files)
+static const char COMMAND_OPEN_FILTER_POLYGON[]				= "FILTER_POLYGON";	//+number of vertices + vertices XY coordinates (LAS files)
+static const char COMMAND_OPEN_FILTER_CLASSES[]				= "FILTER_CLASSES";	//+comma separated list of classification values (LAS files)
+static const char COMMAND_OPEN_STRIDE[]						= "STRIDE";			//+stride (LAS files)
+static const char COMMAND_OPEN_VOXEL_STEP[]					= "VOXEL_STEP";		//+voxel size (LAS files)
 static const char COMMAND_KEYWORD_AUTO[]					= "AUTO";			//"AUTO" keyword
 static const char COMMAND_SUBSAMPLE[]						= "SS";				//+ method (RANDOM/SPATIAL/OCTREE) + parameter (resp. point count / spatial step / octree level)
 static const char COMMAND_CURVATURE[]						= "CURV";			//+ curvature type (MEAN/GAUSS) +
@@ -92,6 +99,9 @@ static const char COMMAND_ICP_RANDOM_SAMPLING_LIMIT[]		= "RANDOM_SAMPLING_LIMIT"
 static const char COMMAND_ICP_ENABLE_FARTHEST_REMOVAL[]		= "FARTHEST_REMOVAL";
 static const char COMMAND_ICP_USE_MODEL_SF_AS_WEIGHT[]		= "MODEL_SF_AS_WEIGHTS";
 static const char COMMAND_ICP_USE_DATA_SF_AS_WEIGHT[]		= "DATA_SF_AS_WEIGHTS";
+static const char COMMAND_ICP_POINT_TO_PLANE[]				= "POINT_TO_PLANE";
+static const char COMMAND_ICP_LEVELS[]						= "LEVELS";				//+ number of resolution levels (coarse-to-fine registration)
+static const char COMMAND_ICP_MAX_COUPLE_DIST[]				= "MAX_COUPLE_DIST";	//+ max distance between the points of a couple
 static const char COMMAND_CLOUD_EXPORT_FORMAT[]				= "C_EXPORT_FMT";
 static const char COMMAND_ASCII_EXPORT_PRECISION[]			= "PREC";
 static const char COMMAND_ASCII_EXPORT_SEPARATOR[]			= "SEP";
@@ -126,11 +136,16 @@ static const char COMMAND_ORIENT_NORMALS[]					= "ORIENT_NORMS_MST";
 static const char COMMAND_DROP_GLOBAL_SHIFT[]				= "DROP_GLOBAL_SHIFT";
 static const char COMMAND_MAX_THREAD_COUNT[]				= "MAX_TCOUNT";
 static const char COMMAND_EXTRACT_CC[]						= "EXTRACT_CC";
+static const char COMMAND_OUT_OF_CORE[]						= "OUT_OF_CORE";		//+ directory for the (temporary) backing files
+static const char COMMAND_OUT_OF_CORE_MIN_SIZE[]				= "MIN_SIZE";		//+ minimum array size (in MB)
+static const char COMMAND_OCTREE_BUILD[]					= "OCTREE_BUILD";	//+ octree build algorithm (STANDARD/PARALLEL)
 
 static const char OPTION_ALL_AT_ONCE[]						= "ALL_AT_ONCE";
 static const char OPTION_ON[]								= "ON";
 static const char OPTION_OFF[]								= "OFF";
 static const char OPTION_LAST[]								= "LAST";
+static const char OPTION_STANDARD[]							= "STANDARD";
+static const char OPTION_PARALLEL[]							= "PARALLEL";
 
 //Current cloud(s) export format (can be modified with the 'COMMAND_CLOUD_EXPORT_FORMAT' option)
 static QString s_CloudExportFormat(BinFilter::GetFileFilter());
@@ -525,6 +540,8 @@ bool ccCommandLineParser::commandLoad(QStringList& arguments)
 
 	//optional parameters
 	int skipLines = 0;
+	s_loadParameters.spatialSubsamplingStep = 0;
+	s_loadParameters.filter = FileIOFilter::LoadFilter();
 	while (!arguments.empty())
 	{
 		QString argument = arguments.front();
@@ -591,6 +608,161 @@ bool ccCommandLineParser::commandLoad(QStringList& arguments)
 				s_loadParameters.m_coordinatesShift = shiftOnLoadVec;
 			}
 		}
+		else if (IsCommand(argument, COMMAND_OPEN_SUBSAMPLE_ON_LOAD))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+			{
+				return Error(QString("Missing parameter: spatial step after '%1'").arg(COMMAND_OPEN_SUBSAMPLE_ON_LOAD));
+			}
+
+			bool ok;
+			double step = arguments.takeFirst().toDouble(&ok);
+			if (!ok || step <= 0)
+			{
+				return Error(QString("Invalid parameter: spatial step after '%1'").arg(COMMAND_OPEN_SUBSAMPLE_ON_LOAD));
+			}
+
+			s_loadParameters.spatialSubsamplingStep = static_cast<PointCoordinateType>(step);
+			Print(QString("Will subsample the cloud(s) at loading time (min. distance between points = %1)").arg(step));
+		}
+		else if (IsCommand(argument, COMMAND_OPEN_FILTER_BOX))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.size() < 6)
+			{
+				return Error(QString("Missing parameter: box min and max corners after '%1' (6 values expected)").arg(COMMAND_OPEN_FILTER_BOX));
+			}
+
+			double values[6];
+			for (int i=0; i<6; ++i)
+			{
+				bool ok;
+				values[i] = arguments.takeFirst().toDouble(&ok);
+				if (!ok)
+					return Error(QString("Invalid parameter: box corner coordinate after '%1'").arg(COMMAND_OPEN_FILTER_BOX));
+			}
+
+			FileIOFilter::LoadFilter& filter = s_loadParameters.filter;
+			filter.useBox = true;
+			filter.boxMin = CCVector3d(values[0], values[1], values[2]);
+			filter.boxMax = CCVector3d(values[3], values[4], values[5]);
+			if (filter.boxMin.x > filter.boxMax.x || filter.boxMin.y > filter.boxMax.y || filter.boxMin.z > filter.boxMax.z)
+			{
+				return Error(QString("Invalid parameter: box min corner is greater than max corner after '%1'").arg(COMMAND_OPEN_FILTER_BOX));
+			}
+			Print(QString("Only the points inside the box [%1 ; %2 ; %3] - [%4 ; %5 ; %6] will be loaded").arg(values[0]).arg(values[1]).arg(values[2]).arg(values[3]).arg(values[4]).arg(values[5]));
+		}
+		else if (IsCommand(argument, COMMAND_OPEN_FILTER_POLYGON))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+			{
+				return Error(QString("Missing parameter: number of vertices after '%1'").arg(COMMAND_OPEN_FILTER_POLYGON));
+			}
+
+			bool ok;
+			int vertCount = arguments.takeFirst().toInt(&ok);
+			if (!ok || vertCount < 3)
+			{
+				return Error(QString("Invalid parameter: number of vertices after '%1' (3 or more expected)").arg(COMMAND_OPEN_FILTER_POLYGON));
+			}
+			if (arguments.size() < 2 * vertCount)
+			{
+				return Error(QString("Missing parameter: vertices coordinates after '%1' (%2 values expected)").arg(COMMAND_OPEN_FILTER_POLYGON).arg(2 * vertCount));
+			}
+
+			std::vector<CCVector2d>& polygon = s_loadParameters.filter.polygon;
+			polygon.clear();
+			for (int i=0; i<vertCount; ++i)
+			{
+				CCVector2d P;
+				P.x = arguments.takeFirst().toDouble(&ok);
+				if (!ok)
+					return Error(QString("Invalid parameter: X coordinate of vertex #%1 after '%2'").arg(i+1).arg(COMMAND_OPEN_FILTER_POLYGON));
+				P.y = arguments.takeFirst().toDouble(&ok);
+				if (!ok)
+					return Error(QString("Invalid parameter: Y coordinate of vertex #%1 after '%2'").arg(i+1).arg(COMMAND_OPEN_FILTER_POLYGON));
+				polygon.push_back(P);
+			}
+
+			Print(QString("Only the points inside the %1-vertex polygon (XY) will be loaded").arg(vertCount));
+		}
+		else if (IsCommand(argument, COMMAND_OPEN_FILTER_CLASSES))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+			{
+				return Error(QString("Missing parameter: classification values after '%1'").arg(COMMAND_OPEN_FILTER_CLASSES));
+			}
+
+			QString classList = arguments.takeFirst();
+			std::vector<unsigned>& classes = s_loadParameters.filter.classes;
+			classes.clear();
+			QStringList tokens = classList.split(',', QString::SkipEmptyParts);
+			for (int i=0; i<tokens.size(); ++i)
+			{
+				bool ok;
+				unsigned value = tokens[i].trimmed().toUInt(&ok);
+				if (!ok)
+					return Error(QString("Invalid parameter: classification value '%1' after '%2'").arg(tokens[i]).arg(COMMAND_OPEN_FILTER_CLASSES));
+				classes.push_back(value);
+			}
+			if (classes.empty())
+			{
+				return Error(QString("Invalid parameter: classification values after '%1'").arg(COMMAND_OPEN_FILTER_CLASSES));
+			}
+
+			Print(QString("Only the points with the following classification value(s) will be loaded: %1").arg(classList));
+		}
+		else if (IsCommand(argument, COMMAND_OPEN_STRIDE))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+			{
+				return Error(QString("Missing parameter: stride after '%1'").arg(COMMAND_OPEN_STRIDE));
+			}
+
+			bool ok;
+			unsigned stride = arguments.takeFirst().toUInt(&ok);
+			if (!ok || stride == 0)
+			{
+				return Error(QString("Invalid parameter: stride after '%1'").arg(COMMAND_OPEN_STRIDE));
+			}
+
+			s_loadParameters.filter.stride = stride;
+			Print(QString("Only one point out of %1 will be loaded").arg(stride));
+		}
+		else if (IsCommand(argument, COMMAND_OPEN_VOXEL_STEP))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+			{
+				return Error(QString("Missing parameter: voxel size after '%1'").arg(COMMAND_OPEN_VOXEL_STEP));
+			}
+
+			bool ok;
+			double step = arguments.takeFirst().toDouble(&ok);
+			if (!ok || step <= 0)
+			{
+				return Error(QString("Invalid parameter: voxel size after '%1'").arg(COMMAND_OPEN_VOXEL_STEP));
+			}
+
+			s_loadParameters.filter.voxelStep = step;
+			Print(QString("Only the first point of each voxel will be loaded (voxel size = %1)").arg(step));
+		}
 		else
 		{
 			break;
@@ -608,6 +780,16 @@ bool ccCommandLineParser::commandLoad(QStringList& arguments)
 	QString filename(arguments.takeFirst());
 	Print(QString("Opening file: '%1'").arg(filename));
 
+	//the loading filters are only handled by the LAS filter
+	if (s_loadParameters.filter.isActive())
+	{
+		FileIOFilter::Shared ioFilter = FileIOFilter::FindBestFilterForExtension(QFileInfo(filename).suffix());
+		if (!ioFilter || !ioFilter->canLoadExtension("LAS"))
+		{
+			Warning(QString("Loading filters (%1, %2, %3, %4, %5) are only supported for LAS files: they will be ignored").arg(COMMAND_OPEN_FILTER_BOX).arg(COMMAND_OPEN_FILTER_POLYGON).arg(COMMAND_OPEN_FILTER_CLASSES).arg(COMMAND_OPEN_STRIDE).arg(COMMAND_OPEN_VOXEL_STEP));
+		}
+	}
+
 	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
 	ccHObject* db = FileIOFilter::LoadFromFile(filename, s_loadParameters, result, QString());
 	if (!db)
@@ -3420,6 +3602,9 @@ bool ccCommandLineParser::commandICP(QStringList& arguments, QDialog* parent/*=0
 	int modelSFAsWeights = -1;
 	int dataSFAsWeights = -1;
 	int maxThreadCount = 0;
+	CCLib::ICPRegistrationTools::ERROR_METRIC errorMetric = CCLib::ICPRegistrationTools::POINT_TO_POINT;
+	unsigned multiResolutionLevels = 1;
+	double maxCoupleDistance = 0.0;
 
 	while (!arguments.empty())
 	{
@@ -3438,6 +3623,39 @@ bool ccCommandLineParser::commandICP(QStringList& arguments, QDialog* parent/*=0
 
 			adjustScale = true;
 		}
+		else if (IsCommand(argument, COMMAND_ICP_POINT_TO_PLANE))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			errorMetric = CCLib::ICPRegistrationTools::POINT_TO_PLANE;
+		}
+		else if (IsCommand(argument, COMMAND_ICP_LEVELS))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+				return Error(QString("Missing parameter: number of resolution levels after '%1'").arg(COMMAND_ICP_LEVELS));
+			bool ok;
+			QString arg = arguments.takeFirst();
+			multiResolutionLevels = arg.toUInt(&ok);
+			if (!ok || multiResolutionLevels == 0)
+				return Error(QString("Invalid number of resolution levels! (%1)").arg(arg));
+		}
+		else if (IsCommand(argument, COMMAND_ICP_MAX_COUPLE_DIST))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+				return Error(QString("Missing parameter: max couple distance after '%1'").arg(COMMAND_ICP_MAX_COUPLE_DIST));
+			bool ok;
+			QString arg = arguments.takeFirst();
+			maxCoupleDistance = arg.toDouble(&ok);
+			if (!ok || maxCoupleDistance < 0)
+				return Error(QString("Invalid max couple distance! (%1)").arg(arg));
+		}
 		else if (IsCommand(argument, COMMAND_ICP_ENABLE_FARTHEST_REMOVAL))
 		{
 			//local option confirmed, we can move on
@@ -3635,6 +3853,9 @@ bool ccCommandLineParser::commandICP(QStringList& arguments, QDialog* parent/*=0
 									modelSFAsWeights >= 0,
 									CCLib::ICPRegistrationTools::SKIP_NONE,
 									maxThreadCount,
+									errorMetric,
+									multiResolutionLevels,
+									maxCoupleDistance,
 									parent ))
 	{
 		ccHObject* data = dataAndModel[0]->getEntity();
@@ -4013,6 +4234,65 @@ bool ccCommandLineParser::commandLogFile(QStringList& arguments)
 	return ccConsole::TheInstance() ? ccConsole::TheInstance()->setLogFile(filename) : false;
 }
 
+bool ccCommandLineParser::commandOutOfCore(QStringList& arguments)
+{
+	Print("[OUT-OF-CORE STORAGE]");
+
+	if (arguments.empty())
+		return Error(QString("Missing parameter: directory after '%1'").arg(COMMAND_OUT_OF_CORE));
+
+	QString directory = arguments.takeFirst();
+	if (!QDir(directory).exists())
+		return Error(QString("Directory '%1' doesn't exist!").arg(directory));
+
+	//optional parameter: minimum array size
+	size_t minByteCount = 0;
+	if (!arguments.empty() && IsCommand(arguments.front(), COMMAND_OUT_OF_CORE_MIN_SIZE))
+	{
+		//local option confirmed, we can move on
+		arguments.pop_front();
+		if (arguments.empty())
+			return Error(QString("Missing parameter: size (in MB) after '%1'").arg(COMMAND_OUT_OF_CORE_MIN_SIZE));
+
+		bool ok;
+		double sizeMB = arguments.takeFirst().toDouble(&ok);
+		if (!ok || sizeMB < 0)
+			return Error(QString("Invalid size (after %1)").arg(COMMAND_OUT_OF_CORE_MIN_SIZE));
+		minByteCount = static_cast<size_t>(sizeMB * (1 << 20));
+	}
+
+	CCLib::OutOfCoreStorage::SetPolicy(qPrintable(QDir::toNativeSeparators(directory)), minByteCount);
+	Print(QString("Arrays bigger than %1 MB will be stored in memory-mapped files in '%2'").arg(minByteCount / static_cast<double>(1 << 20)).arg(directory));
+
+	return true;
+}
+
+bool ccCommandLineParser::commandOctreeBuild(QStringList& arguments)
+{
+	Print("[OCTREE BUILD ALGORITHM]");
+
+	if (arguments.empty())
+		return Error(QString("Missing parameter: algorithm (%2/%3) after '%1'").arg(COMMAND_OCTREE_BUILD).arg(OPTION_STANDARD).arg(OPTION_PARALLEL));
+
+	QString algo = arguments.takeFirst().toUpper();
+	if (algo == OPTION_STANDARD)
+	{
+		CCLib::DgmOctree::SetBuildAlgorithm(CCLib::DgmOctree::BUILD_STANDARD);
+		Print("Octrees will be built with the standard (sequential) algorithm");
+	}
+	else if (algo == OPTION_PARALLEL)
+	{
+		CCLib::DgmOctree::SetBuildAlgorithm(CCLib::DgmOctree::BUILD_PARALLEL_RADIX);
+		Print("Octrees will be built with the parallel (radix sort) algorithm");
+	}
+	else
+	{
+		return Error(QString("Invalid parameter: unknown algorithm '%1' after '%2'").arg(algo).arg(COMMAND_OCTREE_BUILD));
+	}
+
+	return true;
+}
+
 int ccCommandLineParser::parse(QStringList& arguments, QDialog* parent/*=0*/)
 {
 	ccProgressDialog progressDlg(false, parent);
@@ -4246,6 +4526,16 @@ int ccCommandLineParser::parse(QStringList& arguments, QDialog* parent/*=0*/)
 		{
 			success = commandLogFile(arguments);
 		}
+		//out-of-core storage
+		else if (IsCommand(argument, COMMAND_OUT_OF_CORE))
+		{
+			success = commandOutOfCore(arguments);
+		}
+		//octree build algorithm
+		else if (IsCommand(argument, COMMAND_OCTREE_BUILD))
+		{
+			success = commandOctreeBuild(arguments);
+		}
 		// "EXTRACT_CC" CONNECTED COMPONENTS
 		else if (IsCommand(argument, COMMAND_EXTRACT_CC))
 		{
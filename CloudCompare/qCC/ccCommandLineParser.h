@@ -61,6 +61,8 @@ protected:
 	bool commandOrientNormalsMST			(QStringList& arguments, ccProgressDialog* pDlg = 0);
 	bool commandDropGlobalShift				(QStringList& arguments);
 	bool commandExtractCC					(QStringList& arguments, ccProgressDialog* pDlg = 0);
+	bool commandOutOfCore					(QStringList& arguments);
+	bool commandOctreeBuild					(QStringList& arguments);
 
 protected:
 
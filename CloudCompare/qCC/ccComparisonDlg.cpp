@@ -830,11 +830,6 @@ bool ccComparisonDlg::computeDistances()
 
 	case CLOUDMESH_DIST: //cloud-mesh
 
-		if (multiThread && maxDistCheckBox->isChecked())
-		{
-			ccLog::Warning("[Cloud/Mesh comparison] Max search distance is not supported in multi-thread mode! Switching to single thread mode...");
-		}
-
 		//setup parameters
 		{
 			c2mParams.octreeLevel = static_cast<unsigned char>(octreeLevel);
@@ -859,6 +854,19 @@ bool ccComparisonDlg::computeDistances()
 	if (result >= 0)
 	{
 		ccLog::Print("[ComputeDistances] Time: %3.2f s.",static_cast<double>(elapsedTime_ms)/1.0e3);
+		if (multiThread)
+		{
+			//load balancing of the parallel process
+			const CCLib::DgmOctree::CellsProcessingStats& stats = m_compOctree->getLastCellsProcessingStats();
+			ccLog::PrintDebug("[ComputeDistances] %u threads / %u cells (%u heavy) / %u steals / idle time: %.3f s. / longest cell: %.3f s. (%llu points)",
+								stats.threadCount,
+								stats.cellCount,
+								stats.heavyCellCount,
+								stats.stealCount,
+								stats.idleTime_s,
+								stats.maxCellTime_s,
+								static_cast<unsigned long long>(stats.maxCellTimePopulation));
+		}
 
 		//display some statics about the computed distances
 		ScalarType mean,variance;
@@ -621,6 +621,9 @@ namespace ccLibAlgorithms
 								 false,
 								 transformationFilters,
 								 0,
+								 CCLib::ICPRegistrationTools::POINT_TO_POINT,
+								 1,
+								 0.0,
 								 parent))
 						{
 							scales[i] = finalScale;
@@ -45,6 +45,9 @@ static int      s_finalOverlap = 100;
 static int      s_rotComboIndex = 0;
 static bool     s_transCheckboxes[3] = { true, true, true };
 static int		s_maxThreadCount = 0;
+static int		s_errorMetricIndex = 0;
+static int		s_multiResolutionLevels = 1;
+static double	s_maxCoupleDistance = 0.0;
 
 
 ccRegistrationDlg::ccRegistrationDlg(ccHObject *data, ccHObject *model, QWidget* parent/*=0*/)
@@ -92,6 +95,9 @@ ccRegistrationDlg::ccRegistrationDlg(ccHObject *data, ccHObject *model, QWidget*
 		TxCheckBox->setChecked(s_transCheckboxes[0]);
 		TyCheckBox->setChecked(s_transCheckboxes[1]);
 		TzCheckBox->setChecked(s_transCheckboxes[2]);
+		errorMetricComboBox->setCurrentIndex(s_errorMetricIndex);
+		multiResLevelsSpinBox->setValue(s_multiResolutionLevels);
+		maxCoupleDistDoubleSpinBox->setValue(s_maxCoupleDistance);
 	}
 
 	connect(swapButton, SIGNAL(clicked()), this, SLOT(swapModelAndData()));
@@ -126,6 +132,9 @@ void ccRegistrationDlg::saveParameters() const
 	s_transCheckboxes[0] = TxCheckBox->isChecked();
 	s_transCheckboxes[1] = TyCheckBox->isChecked();
 	s_transCheckboxes[2] = TzCheckBox->isChecked();
+	s_errorMetricIndex = errorMetricComboBox->currentIndex();
+	s_multiResolutionLevels = multiResLevelsSpinBox->value();
+	s_maxCoupleDistance = maxCoupleDistDoubleSpinBox->value();
 }
 
 ccHObject *ccRegistrationDlg::getDataEntity()
@@ -178,6 +187,24 @@ int ccRegistrationDlg::getMaxThreadCount() const
 	return maxThreadCountSpinBox->value();
 }
 
+CCLib::ICPRegistrationTools::ERROR_METRIC ccRegistrationDlg::getErrorMetric() const
+{
+	if (errorMetricComboBox->currentIndex() == 1)
+		return CCLib::ICPRegistrationTools::POINT_TO_PLANE;
+	else
+		return CCLib::ICPRegistrationTools::POINT_TO_POINT;
+}
+
+unsigned ccRegistrationDlg::getMultiResolutionLevels() const
+{
+	return static_cast<unsigned>(multiResLevelsSpinBox->value());
+}
+
+double ccRegistrationDlg::getMaxCoupleDistance() const
+{
+	return maxCoupleDistDoubleSpinBox->value();
+}
+
 double ccRegistrationDlg::getMinRMSDecrease() const
 {
 	bool ok = true;
@@ -94,6 +94,15 @@ public:
 	//! Returns the maximum number of threads
 	int getMaxThreadCount() const;
 
+	//! Returns the error metric
+	CCLib::ICPRegistrationTools::ERROR_METRIC getErrorMetric() const;
+
+	//! Returns the number of resolution levels (coarse-to-fine registration)
+	unsigned getMultiResolutionLevels() const;
+
+	//! Returns the maximum distance between the points of a couple (0 = no limit)
+	double getMaxCoupleDistance() const;
+
 	//! Saves parameters for next call
 	void saveParameters() const;
 
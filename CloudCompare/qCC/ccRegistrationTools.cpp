@@ -37,6 +37,7 @@
 
 //system
 #include <set>
+#include <algorithm>
 
 //! Default number of points sampled on the 'data' mesh (if any)
 static const unsigned s_defaultSampledPointsOnDataMesh = 50000;
@@ -60,6 +61,9 @@ bool ccRegistrationTools::ICP(	ccHObject* data,
 								bool useModelSFAsWeights/*=false*/,
 								int filters/*=CCLib::ICPRegistrationTools::SKIP_NONE*/,
 								int maxThreadCount/*=0*/,
+								CCLib::ICPRegistrationTools::ERROR_METRIC errorMetric/*=CCLib::ICPRegistrationTools::POINT_TO_POINT*/,
+								unsigned multiResolutionLevels/*=1*/,
+								double maxCoupleDistance/*=0.0*/,
 								QWidget* parent/*=0*/)
 {
 	//progress bar
@@ -271,8 +275,39 @@ bool ccRegistrationTools::ICP(	ccHObject* data,
 		params.dataWeights = dataWeights;
 		params.transformationFilters = filters;
 		params.maxThreadCount = maxThreadCount;
+		params.errorMetric = errorMetric;
+		params.multiResolutionLevels = std::max(1u, multiResolutionLevels);
+		params.maxCoupleDistance = static_cast<PointCoordinateType>(std::max(0.0, maxCoupleDistance));
 	}
 
+	//model normals (for the point-to-plane metric)
+	CCLib::ICPRegistrationTools::NormalsContainer* modelNormals = 0;
+	if (errorMetric == CCLib::ICPRegistrationTools::POINT_TO_PLANE)
+	{
+		if (modelMesh)
+		{
+			ccLog::Warning("[ICP] The point-to-plane metric is only supported with a 'model' cloud (point-to-point will be used)");
+		}
+		else if (model->isA(CC_TYPES::POINT_CLOUD) && static_cast<ccPointCloud*>(model)->hasNormals())
+		{
+			ccPointCloud* pc = static_cast<ccPointCloud*>(model);
+			unsigned pointCount = pc->size();
+			modelNormals = new CCLib::ICPRegistrationTools::NormalsContainer();
+			modelNormals->link();
+			if (modelNormals->reserve(pointCount))
+			{
+				for (unsigned i = 0; i < pointCount; ++i)
+					modelNormals->addElement(pc->getPointNormal(i).u);
+				params.modelNormals = modelNormals;
+			}
+			else
+			{
+				ccLog::Warning("[ICP] Not enough memory to use the 'model' normals (they will be estimated)");
+			}
+		}
+	}
+
+	std::vector<CCLib::ICPRegistrationTools::IterationTimings> iterationTimings;
 	result = CCLib::ICPRegistrationTools::Register(	modelCloud,
 													modelMesh,
 													dataCloud,
@@ -280,7 +315,25 @@ bool ccRegistrationTools::ICP(	ccHObject* data,
 													transform,
 													finalRMS,
 													finalPointCount,
-													static_cast<CCLib::GenericProgressCallback*>(&pDlg));
+													static_cast<CCLib::GenericProgressCallback*>(&pDlg),
+													&iterationTimings);
+
+	if (!iterationTimings.empty())
+	{
+		double distancesTime_s = 0, registrationTime_s = 0, totalTime_s = 0;
+		for (size_t i=0; i<iterationTimings.size(); ++i)
+		{
+			distancesTime_s += iterationTimings[i].distancesTime_s;
+			registrationTime_s += iterationTimings[i].registrationTime_s;
+			totalTime_s += iterationTimings[i].totalTime_s;
+		}
+		ccLog::Print("[ICP] %u steps in %.3f s (distances: %.3f s incl. %.3f s for the initial step - registration: %.3f s)",
+						static_cast<unsigned>(iterationTimings.size()),
+						totalTime_s,
+						distancesTime_s,
+						iterationTimings.front().distancesTime_s,
+						registrationTime_s);
+	}
 
 	if (result >= CCLib::ICPRegistrationTools::ICP_ERROR)
 	{
@@ -292,6 +345,12 @@ bool ccRegistrationTools::ICP(	ccHObject* data,
 		finalScale = transform.s;
 	}
 
+	if (modelNormals)
+	{
+		modelNormals->release();
+		modelNormals = 0;
+	}
+
 	//remove temporary SF (if any)
 	if (dataSfIdx >= 0)
 	{
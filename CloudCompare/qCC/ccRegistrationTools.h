@@ -54,6 +54,9 @@ public:
 					bool useModelSFAsWeights = false,
 					int transformationFilters = CCLib::ICPRegistrationTools::SKIP_NONE,
 					int maxThreadCount = 0,
+					CCLib::ICPRegistrationTools::ERROR_METRIC errorMetric = CCLib::ICPRegistrationTools::POINT_TO_POINT,
+					unsigned multiResolutionLevels = 1,
+					double maxCoupleDistance = 0.0,
 					QWidget* parent = 0);
 
 };
@@ -3646,6 +3646,9 @@ void MainWindow::doActionRegister()
 	unsigned finalOverlap										= rDlg.getFinalOverlap();
 	CCLib::ICPRegistrationTools::CONVERGENCE_TYPE method		= rDlg.getConvergenceMethod();
 	int maxThreadCount											= rDlg.getMaxThreadCount();
+	CCLib::ICPRegistrationTools::ERROR_METRIC errorMetric		= rDlg.getErrorMetric();
+	unsigned multiResolutionLevels								= rDlg.getMultiResolutionLevels();
+	double maxCoupleDistance									= rDlg.getMaxCoupleDistance();
 
 	//semi-persistent storage (for next call)
 	rDlg.saveParameters();
@@ -3672,6 +3675,9 @@ void MainWindow::doActionRegister()
 									useModelSFAsWeights,
 									transformationFilters,
 									maxThreadCount,
+									errorMetric,
+									multiResolutionLevels,
+									maxCoupleDistance,
 									this))
 	{
 		QString rmsString = QString("Final RMS: %1 (computed on %2 points)").arg(finalError).arg(finalPointCount);
@@ -3864,7 +3870,9 @@ void MainWindow::doAction4pcsRegister()
 														aDlg.getNbTries(),
 														5000,
 														&pDlg,
-														nbMaxCandidates))
+														nbMaxCandidates,
+														aDlg.getRandomSeed(),
+														aDlg.getTargetScoreRatio()))
 	{
 		//output resulting transformation matrix
 		{